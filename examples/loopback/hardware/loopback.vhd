@@ -32,6 +32,13 @@ architecture top of loopback is
 		std_ulogic_vector(pcie.tx_count(pcie_config) - 1 downto 0) := (others => '0');
 	signal to_tx, from_tx: pcie.fragment_vector(pcie.tx_count(pcie_config) - 1 downto 0);
 
+	signal rx_chn_vld, rx_chn_req, tx_chn_vld, tx_chn_req: std_ulogic := '0';
+	signal rx_chn: pcie.rx_stream := pcie.default_rx_stream;
+	signal tx_chn: pcie.tx_stream := pcie.default_tx_stream;
+
+	signal traffic_ctrl: pcie.traffic_control := pcie.default_traffic_control;
+	signal traffic_status: pcie.traffic_counters := pcie.default_traffic_counters;
+
 	signal rx_user_vld, rx_user_req, tx_user_vld, tx_user_req: std_ulogic := '0';
 	signal rx_user: pcie.rx_stream := pcie.default_rx_stream;
 	signal tx_no_eos: pcie.tx_stream := pcie.default_tx_stream;
@@ -66,7 +73,10 @@ port map(
 	from_tx => from_tx,
 	to_tx_vld => to_tx_vld,
 	to_tx_req => to_tx_req,
-	to_tx => to_tx
+	to_tx => to_tx,
+
+	traffic_ctrl => traffic_ctrl,
+	traffic_status => traffic_status
 );
 
 rx: pcie.host_rx_channel
@@ -83,14 +93,42 @@ port map(
 	to_ep_req => from_rx_req(0),
 	to_ep => from_rx(0),
 
+	o_vld => rx_chn_vld,
+	o_req => rx_chn_req,
+	o => rx_chn
+);
+
+
+-- link tests of the host, transparent unless enabled through the config channel
+traffic: pcie_utilities.traffic_generator
+port map(
+	clk => clk,
+	rst => rst,
+
+	ctrl => traffic_ctrl,
+	status => traffic_status,
+
+	rx => rx_chn,
+	rx_vld => rx_chn_vld,
+	rx_req => rx_chn_req,
+
+	tx => tx_chn,
+	tx_vld => tx_chn_vld,
+	tx_req => tx_chn_req,
+
+	o => rx_user,
 	o_vld => rx_user_vld,
 	o_req => rx_user_req,
-	o => rx_user
+
+	i => tx_user,
+	i_vld => tx_user_vld,
+	i_req => tx_user_req
 );
 
 
 tx_no_eos.payload <= rx_user.payload;
 tx_no_eos.cnt     <= rx_user.cnt;
+tx_no_eos.last_bytes <= rx_user.last_bytes;
 timeout: pcie_utilities.tx_stream_timeout
 generic map(timeout => 100)
 port map(
@@ -120,9 +158,9 @@ port map(
 	to_ep_req => from_tx_req(0),
 	to_ep => from_tx(0),
 
-	i_vld => tx_user_vld,
-	i_req => tx_user_req,
-	i => tx_user
+	i_vld => tx_chn_vld,
+	i_req => tx_chn_req,
+	i => tx_chn
 );
 
 end architecture;
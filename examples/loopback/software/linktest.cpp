@@ -0,0 +1,307 @@
+// Measures the link with the traffic generator of the loopback design.
+//
+// stream: reads the generated pattern from the tx channel and writes the
+//         same pattern to the rx channel, then prints the bandwidth and
+//         the error counters of the hardware.
+// ping:   sends small messages which are echoed by the hardware and prints
+//         the round-trip latency.
+// iov:    moves the generated pattern in small segments, once with a
+//         read()/write() per segment and once with readv()/writev(), and
+//         prints the system calls, interrupts and buffers per MB.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/poll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../../../software/linux_driver/mmio_ioctl.h"
+
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+using clk = std::chrono::steady_clock;
+
+// config channel registers, see cfg_channel_types.vhd
+enum { TRAFFIC_CTRL = 3, TRAFFIC_DWORDS = 5, TRAFFIC_ERRORS = 6 };
+enum { TRAFFIC_OFF = 0, TRAFFIC_STREAM = 1, TRAFFIC_PING = 2 };
+
+static uint32_t read_reg(int ep, unsigned int reg) {
+	vcl_register r = {0, reg, 0};
+	ioctl(ep, VCL_MMIO_IOCTL_RDREG, &r);
+	return r.value;
+}
+
+static void write_reg(int ep, unsigned int reg, uint32_t value) {
+	vcl_register r = {0, reg, value};
+	ioctl(ep, VCL_MMIO_IOCTL_WRREG, &r);
+}
+
+static double seconds(clk::duration d) {
+	return std::chrono::duration<double>(d).count();
+}
+
+static int stream(int ep, int rx, int tx, size_t bufsize) {
+	vector<uint32_t> wr_buf(bufsize / 4), rd_buf(bufsize / 4);
+	for(size_t i = 0; i < wr_buf.size(); ++i) {
+		wr_buf[i] = i;
+	}
+
+	write_reg(ep, TRAFFIC_CTRL, TRAFFIC_STREAM);
+
+	size_t bytes_written = 0, bytes_read = 0;
+	double write_time = 0, read_time = 0;
+	auto start = clk::now();
+	while(bytes_written < bufsize || bytes_read < bufsize) {
+		struct pollfd polls[2];
+		size_t requests = 0;
+		if(bytes_written < bufsize) {
+			polls[requests].fd = rx;
+			polls[requests].events = POLLOUT;
+			requests++;
+		}
+		if(bytes_read < bufsize) {
+			polls[requests].fd = tx;
+			polls[requests].events = POLLIN;
+			requests++;
+		}
+
+		if(!poll(polls, requests, 1000)) {
+			fprintf(stderr, "Poll timed out.\n");
+			break;
+		}
+		for(size_t i = 0; i < requests; ++i) {
+			if(polls[i].revents & POLLOUT) {
+				int ret = write(rx, reinterpret_cast<char*>(wr_buf.data()) + bytes_written,
+				                bufsize - bytes_written);
+				if(ret < 0) {
+					perror("Failed to write channel");
+					return 1;
+				}
+				bytes_written += ret;
+				if(bytes_written == bufsize) {
+					write_time = seconds(clk::now() - start);
+				}
+			}
+			if(polls[i].revents & POLLIN) {
+				int ret = read(tx, reinterpret_cast<char*>(rd_buf.data()) + bytes_read,
+				               bufsize - bytes_read);
+				if(ret < 0) {
+					perror("Failed to read channel");
+					return 1;
+				}
+				bytes_read += ret;
+				if(bytes_read == bufsize) {
+					read_time = seconds(clk::now() - start);
+				}
+			}
+		}
+	}
+
+	// stops the generator, the rest of the stream ends with the next buffer
+	write_reg(ep, TRAFFIC_CTRL, TRAFFIC_OFF);
+	vector<char> drain(1 << 20);
+	struct pollfd tx_poll = {tx, POLLIN, 0};
+	while(poll(&tx_poll, 1, 100) > 0 && read(tx, drain.data(), drain.size()) > 0);
+
+	size_t rd_errors = 0;
+	for(size_t i = 0; i < bytes_read / 4; ++i) {
+		if(rd_buf[i] != static_cast<uint32_t>(i)) {
+			rd_errors++;
+		}
+	}
+
+	printf("FPGA->host: %zu bytes, %.1f MB/s, %zu errors\n",
+		bytes_read, bytes_read / read_time / 1e6, rd_errors);
+	printf("host->FPGA: %zu bytes, %.1f MB/s, %u of %u DWords wrong\n",
+		bytes_written, bytes_written / write_time / 1e6,
+		read_reg(ep, TRAFFIC_ERRORS), read_reg(ep, TRAFFIC_DWORDS));
+	return 0;
+}
+
+// counter attribute of the channel device opened as fd
+static uint64_t channel_counter(int fd, const char *name) {
+	struct stat st;
+	if(fstat(fd, &st)) {
+		return 0;
+	}
+	std::string path = "/sys/dev/char/" + std::to_string(major(st.st_rdev)) + ":" +
+		std::to_string(minor(st.st_rdev)) + "/" + name;
+	unsigned long long value = 0;
+	FILE *f = fopen(path.c_str(), "r");
+	if(f) {
+		if(fscanf(f, "%llu", &value) != 1) {
+			value = 0;
+		}
+		fclose(f);
+	}
+	return value;
+}
+
+// Moves bytes through the channel fd in segments of the given size, with
+// a system call per segment or per IOV_MAX segments. Returns the calls.
+static ssize_t transfer(int fd, char *data, size_t bytes, size_t segment, bool out, bool vectored) {
+	vector<struct iovec> iov;
+	size_t done = 0, calls = 0;
+	while(done < bytes) {
+		ssize_t ret;
+		if(vectored) {
+			iov.clear();
+			for(size_t pos = done; pos < bytes && iov.size() < IOV_MAX; pos += segment) {
+				iov.push_back({data + pos, std::min(segment, bytes - pos)});
+			}
+			ret = out ? writev(fd, iov.data(), iov.size()) : readv(fd, iov.data(), iov.size());
+		} else {
+			size_t len = std::min(segment, bytes - done);
+			ret = out ? write(fd, data + done, len) : read(fd, data + done, len);
+		}
+		if(ret < 0) {
+			perror(out ? "Failed to write channel" : "Failed to read channel");
+			return -1;
+		}
+		done += ret;
+		calls++;
+	}
+	return calls;
+}
+
+static int iov(int ep, int rx, int tx, size_t bytes, size_t segment) {
+	vector<uint32_t> wr_buf(bytes / 4), rd_buf(bytes / 4);
+	size_t rd_errors = 0;
+	double mb = bytes / 1e6;
+
+	write_reg(ep, TRAFFIC_CTRL, TRAFFIC_STREAM);
+
+	// the pattern continues from one pass to the next
+	for(int pass = 0; pass < 2; ++pass) {
+		bool vectored = pass == 1;
+		for(size_t i = 0; i < wr_buf.size(); ++i) {
+			wr_buf[i] = pass * wr_buf.size() + i;
+		}
+
+		for(int out = 1; out >= 0; --out) {
+			int fd = out ? rx : tx;
+			char *data = reinterpret_cast<char*>(out ? wr_buf.data() : rd_buf.data());
+			uint64_t irqs = channel_counter(fd, "interrupts");
+			uint64_t bufs = channel_counter(fd, "submitted_bufs");
+
+			auto start = clk::now();
+			ssize_t calls = transfer(fd, data, bytes, segment, out, vectored);
+			double time = seconds(clk::now() - start);
+			if(calls < 0) {
+				return 1;
+			}
+
+			irqs = channel_counter(fd, "interrupts") - irqs;
+			bufs = channel_counter(fd, "submitted_bufs") - bufs;
+			printf("%-6s %8.1f calls/MB %8.1f interrupts/MB %8.1f buffers/MB %8.1f MB/s\n",
+				vectored ? (out ? "writev" : "readv") : (out ? "write" : "read"),
+				calls / mb, irqs / mb, bufs / mb, mb / time);
+		}
+
+		for(size_t i = 0; i < rd_buf.size(); ++i) {
+			if(rd_buf[i] != static_cast<uint32_t>(pass * rd_buf.size() + i)) {
+				rd_errors++;
+			}
+		}
+	}
+
+	write_reg(ep, TRAFFIC_CTRL, TRAFFIC_OFF);
+	vector<char> drain(1 << 20);
+	struct pollfd tx_poll = {tx, POLLIN, 0};
+	while(poll(&tx_poll, 1, 100) > 0 && read(tx, drain.data(), drain.size()) > 0);
+
+	printf("segments of %zu bytes, FPGA->host %zu errors, host->FPGA %u of %u DWords wrong\n",
+		segment, rd_errors, read_reg(ep, TRAFFIC_ERRORS), read_reg(ep, TRAFFIC_DWORDS));
+	return 0;
+}
+
+static int ping(int ep, int rx, int tx, size_t bytes, size_t count) {
+	vector<uint32_t> msg(bytes / 4), echo(bytes / 4);
+	vector<double> rtt;
+
+	write_reg(ep, TRAFFIC_CTRL, TRAFFIC_PING);
+
+	for(size_t n = 0; n < count; ++n) {
+		std::fill(msg.begin(), msg.end(), n);
+
+		auto start = clk::now();
+		if(write(rx, msg.data(), bytes) != static_cast<ssize_t>(bytes)) {
+			perror("Failed to write channel");
+			return 1;
+		}
+		size_t received = 0;
+		while(received < bytes) {
+			int ret = read(tx, reinterpret_cast<char*>(echo.data()) + received, bytes - received);
+			if(ret < 0) {
+				perror("Failed to read channel");
+				return 1;
+			}
+			received += ret;
+		}
+		rtt.push_back(seconds(clk::now() - start) * 1e6);
+
+		if(memcmp(msg.data(), echo.data(), bytes)) {
+			fprintf(stderr, "Echo %zu differs from the message\n", n);
+		}
+	}
+
+	write_reg(ep, TRAFFIC_CTRL, TRAFFIC_OFF);
+
+	std::sort(rtt.begin(), rtt.end());
+	double sum = 0;
+	for(double t: rtt) {
+		sum += t;
+	}
+	printf("%zu messages of %zu bytes, round trip min %.2f us, median %.2f us, "
+	       "mean %.2f us, max %.2f us\n",
+		count, bytes, rtt.front(), rtt[rtt.size() / 2], sum / count, rtt.back());
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if(argc < 2 || (strcmp(argv[1], "stream") && strcmp(argv[1], "ping") && strcmp(argv[1], "iov"))) {
+		fprintf(stderr, "Usage: %s stream [MiB] | ping [bytes] [count] | iov [MiB] [segment bytes]\n", argv[0]);
+		return 1;
+	}
+
+	int rx = open("/dev/fpga_1_rx_1", O_WRONLY);
+	int tx = open("/dev/fpga_1_tx_2", O_RDONLY);
+	int ep = open("/dev/fpga_1", O_RDWR);
+	if(rx == -1 || tx == -1 || ep == -1) {
+		perror("Failed to open the device files");
+		return 1;
+	}
+
+	int ret;
+	if(!strcmp(argv[1], "stream")) {
+		size_t mib = argc > 2 ? strtoul(argv[2], nullptr, 0) : 256;
+		ret = stream(ep, rx, tx, mib << 20);
+	} else if(!strcmp(argv[1], "iov")) {
+		size_t mib = argc > 2 ? strtoul(argv[2], nullptr, 0) : 16;
+		size_t segment = argc > 3 ? strtoul(argv[3], nullptr, 0) : 256;
+		ret = iov(ep, rx, tx, std::max<size_t>(mib, 1) << 20, std::max<size_t>(segment & ~size_t(3), 4));
+	} else {
+		size_t bytes = argc > 2 ? strtoul(argv[2], nullptr, 0) : 64;
+		size_t count = argc > 3 ? strtoul(argv[3], nullptr, 0) : 1000;
+		ret = ping(ep, rx, tx, std::max<size_t>(bytes & ~size_t(3), 4), std::max<size_t>(count, 1));
+	}
+
+	close(ep);
+	close(rx);
+	close(tx);
+	return ret;
+}
@@ -15,9 +15,13 @@ package channel_types is
 		id: unsigned(7 downto 0);
 		dir: channel_info_dir;
 		kind: channel_info_kind;
+		queue_depth: unsigned(3 downto 0);  -- buffers the channel accepts in advance
+		abort: std_logic;                   -- transfers can be aborted by the host
+		deadline: std_logic;                -- transfers complete after a deadline
 	end record;
 
-	function new_host_channel_info(id: natural range 0 to 2**8; dir: channel_info_dir)
+	function new_host_channel_info(id: natural range 0 to 2**8; dir: channel_info_dir;
+		queue_depth: natural range 0 to 15 := 0)
 		return channel_info_t;
 	function new_fpga_channel_info(id: natural range 0 to 2**8; dir: channel_info_dir)
 		return channel_info_t;
@@ -32,13 +36,22 @@ end package;
 
 
 package body channel_types is
-	function new_host_channel_info(id: natural range 0 to 2**8; dir: channel_info_dir)
+	function new_host_channel_info(id: natural range 0 to 2**8; dir: channel_info_dir;
+		queue_depth: natural range 0 to 15 := 0)
 	return channel_info_t is
+		variable deadline: std_logic := '0';
 	begin
+		-- only FPGA-Host transfers wait for data of the user logic
+		if dir = channel_dir_tx then
+			deadline := '1';
+		end if;
 		return channel_info_t'(
 			id => to_unsigned(id, 8),
 			dir => dir,
-			kind => channel_kind_host
+			kind => channel_kind_host,
+			queue_depth => to_unsigned(queue_depth, 4),
+			abort => '1',
+			deadline => deadline
 		);
 	end new_host_channel_info;
 
@@ -48,7 +61,10 @@ package body channel_types is
 		return channel_info_t'(
 			id => to_unsigned(id, 8),
 			dir => dir,
-			kind => channel_kind_fpga
+			kind => channel_kind_fpga,
+			queue_depth => (others => '0'),
+			abort => '0',
+			deadline => '0'
 		);
 	end new_fpga_channel_info;
 
@@ -96,6 +112,9 @@ package body channel_types is
 			 7 downto  0 => std_logic_vector(info.id),
 			 9 downto  8 => slv(info.dir),
 			13 downto 10 => slv(info.kind),
+			19 downto 16 => std_logic_vector(info.queue_depth),
+			20           => info.abort,
+			21           => info.deadline,
 			others      => '0'
 		);
 	end to_dw;
@@ -19,6 +19,7 @@ package tlp_types is
 	type tlp_dw0 is record
 		length   : std_logic_vector(9 downto 0);
 		attr     : std_logic_vector(1 downto 0);
+		th       : std_logic;
 		ep       : std_logic;
 		td       : std_logic;
 		tc       : std_logic_vector(2 downto 0);
@@ -126,6 +127,7 @@ package body tlp_types is
 	begin
 		dw.length    := data(9 downto 0);
 		dw.attr      := data(13 downto 12);
+		dw.th        := data(16);
 		dw.ep        := data(14);
 		dw.td        := data(15);
 		dw.tc        := data(22 downto 20);
@@ -184,6 +186,7 @@ package body tlp_types is
 		 dw(13 downto 12) := data.attr;
 		 dw(14)           := data.ep;
 		 dw(15)           := data.td;
+		 dw(16)           := data.th;
 		 dw(22 downto 20) := data.tc;
 		 dw(30 downto 24) := data.fmt_type;
 		return dw;
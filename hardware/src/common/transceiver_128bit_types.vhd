@@ -18,8 +18,15 @@ package transceiver_128bit_types is
 	constant CplD_desc   : descriptor_t := "0010";
 	constant MSIX_desc   : descriptor_t := "1100";
 
+	-- TLP attribute bits of memory requests, (1) relaxed ordering, (0) no snoop
+	subtype  tlp_attr_t   is std_logic_vector(1 downto 0);
+	constant ATTR_DEFAULT : tlp_attr_t := "00";
+	constant ATTR_NS      : tlp_attr_t := "01";
+	constant ATTR_RO      : tlp_attr_t := "10";
+
 	type common_dw0 is record
 		desc   : descriptor_t;
+		attr   : tlp_attr_t;
 		length : std_logic_vector(9 downto 0);
 		tag    : std_logic_vector(7 downto 0);
 		chn_id : std_logic_vector(7 downto 0);
@@ -29,6 +36,9 @@ package transceiver_128bit_types is
 		requester_id : std_logic_vector(15 downto 0);
 		first_be     : std_logic_vector( 3 downto 0);
 		last_be      : std_logic_vector( 3 downto 0);
+		-- TLP processing hints present, for MWr the steering tag is carried
+		-- in the tag field and the processing hint in address(1 downto 0)
+		th           : std_logic;
 	end record;
 
 	subtype tlp_addr_lo is std_logic_vector(31 downto 0);
@@ -47,6 +57,9 @@ package transceiver_128bit_types is
 	type cpld_dw1 is record
 		completer_id : std_logic_vector(15 downto 0);
 		byte_count   : std_logic_vector(11 downto 0);
+		-- valid bytes in the last DWORD of the request, 0 means all four.
+		-- byte_count itself is rounded up to whole DWORDs.
+		last_bytes   : std_logic_vector(1 downto 0);
 	end record;
 
 	type cpld_dw2 is record
@@ -135,22 +148,32 @@ package transceiver_128bit_types is
 
 	function make_wr_rqst32(
 		length, chn_id: natural;
-		address: dword
+		address: dword;
+		attr: tlp_attr_t := ATTR_DEFAULT;
+		th: std_logic := '0';
+		ph: std_logic_vector(1 downto 0) := "00";
+		st: std_logic_vector(7 downto 0) := x"00"
 	) return rqst32;
 
 	function make_wr_rqst64(
 		length, chn_id:   natural;
-		addr_lo, addr_hi: dword
+		addr_lo, addr_hi: dword;
+		attr: tlp_attr_t := ATTR_DEFAULT;
+		th: std_logic := '0';
+		ph: std_logic_vector(1 downto 0) := "00";
+		st: std_logic_vector(7 downto 0) := x"00"
 	) return rqst64;
 
 	function make_rd_rqst32(
 		length, chn_id, tag: natural;
-		address: dword
+		address: dword;
+		attr: tlp_attr_t := ATTR_DEFAULT
 	) return rqst32;
 
 	function make_rd_rqst64(
 		length, chn_id, tag: natural;
-		addr_lo, addr_hi: dword
+		addr_lo, addr_hi: dword;
+		attr: tlp_attr_t := ATTR_DEFAULT
 	) return rqst64;
 
 	function make_cpld(
@@ -168,6 +191,7 @@ package body transceiver_128bit_types is
 		variable data : common_dw0;
 	begin
 		data.desc   := MRd32_desc;
+		data.attr   := ATTR_DEFAULT;
 		data.length := (others => '0');
 		data.tag    := (others => '0');
 		data.chn_id := (others => '0');
@@ -180,6 +204,7 @@ package body transceiver_128bit_types is
 		data.first_be := (others => '0');
 		data.last_be  := (others => '0');
 		data.requester_id      := (others => '0');
+		data.th       := '0';
 		return data;
 	end init_rqst_dw1;
 
@@ -210,6 +235,7 @@ package body transceiver_128bit_types is
 	begin
 		data.completer_id := (others => '0');
 		data.byte_count   := (others => '0');
+		data.last_bytes   := (others => '0');
 		return data;
 	end init_cpld_dw1;
 
@@ -226,6 +252,7 @@ package body transceiver_128bit_types is
 		variable ret : common_dw0 := init_common_dw0;
 	begin
 		ret.desc   := data( 3 downto  0);
+		ret.attr   := data( 5 downto  4);
 		ret.length := data(15 downto  6);
 		ret.tag    := data(23 downto 16);
 		ret.chn_id := data(31 downto 24);
@@ -238,6 +265,7 @@ package body transceiver_128bit_types is
 		ret.requester_id := data(15 downto  0);
 		ret.first_be     := data(19 downto 16);
 		ret.last_be      := data(23 downto 20);
+		ret.th           := data(24);
 		return ret;
 	end to_rqst_dw1;
 
@@ -267,6 +295,7 @@ package body transceiver_128bit_types is
 	begin
 		ret.completer_id := data(15 downto  0);
 		ret.byte_count   := data(27 downto 16);
+		ret.last_bytes   := data(29 downto 28);
 		return ret;
 	end to_cpld_dw1;
 
@@ -281,6 +310,7 @@ package body transceiver_128bit_types is
 		variable ret : dword := (others => '0');
 	begin
 		ret( 3 downto  0) := data.desc;
+		ret( 5 downto  4) := data.attr;
 		ret(15 downto  6) := data.length;
 		ret(23 downto 16) := data.tag;
 		ret(31 downto 24) := data.chn_id;
@@ -293,6 +323,7 @@ package body transceiver_128bit_types is
 		ret(15 downto  0) := data.requester_id;
 		ret(19 downto 16) := data.first_be;
 		ret(23 downto 20) := data.last_be;
+		ret(24)           := data.th;
 		return ret;
 	end to_dword;
 
@@ -323,6 +354,7 @@ package body transceiver_128bit_types is
 		ret := (others => '0');
 		ret(15 downto  0) := data.completer_id;
 		ret(27 downto 16) := data.byte_count;
+		ret(29 downto 28) := data.last_bytes;
 		return ret;
 	end to_dword;
 
@@ -553,13 +585,18 @@ package body transceiver_128bit_types is
 
 	function make_wr_rqst32(
 		length, chn_id: natural;
-		address: dword
+		address: dword;
+		attr: tlp_attr_t := ATTR_DEFAULT;
+		th: std_logic := '0';
+		ph: std_logic_vector(1 downto 0) := "00";
+		st: std_logic_vector(7 downto 0) := x"00"
 	) return rqst32 is
 		variable ret: rqst32 := init_rqst32;
 	begin
 		assert length >= 1 report "Length for write requests has to be non-zero"
 			severity failure;
 		ret.dw0.desc   := MWr32_desc;
+		ret.dw0.attr   := attr;
 		ret.dw0.length := std_logic_vector(to_unsigned(length, ret.dw0.length'length));
 		ret.dw0.chn_id := std_logic_vector(to_unsigned(chn_id, ret.dw0.chn_id'length));
 
@@ -573,12 +610,22 @@ package body transceiver_128bit_types is
 		end if;
 
 		ret.dw2.address := address;
+
+		if th = '1' then
+			ret.dw0.tag := st;
+			ret.dw1.th  := '1';
+			ret.dw2.address(1 downto 0) := ph;
+		end if;
 		return ret;
 	end make_wr_rqst32;
 
 	function make_wr_rqst64(
 		length, chn_id: natural;
-		addr_lo, addr_hi: dword
+		addr_lo, addr_hi: dword;
+		attr: tlp_attr_t := ATTR_DEFAULT;
+		th: std_logic := '0';
+		ph: std_logic_vector(1 downto 0) := "00";
+		st: std_logic_vector(7 downto 0) := x"00"
 	) return rqst64 is
 		variable ret: rqst64 := init_rqst64;
 	begin
@@ -586,6 +633,7 @@ package body transceiver_128bit_types is
 			severity failure;
 
 		ret.dw0.desc   := MWr64_desc;
+		ret.dw0.attr   := attr;
 		ret.dw0.length := std_logic_vector(to_unsigned(length, ret.dw0.length'length));
 		ret.dw0.chn_id := std_logic_vector(to_unsigned(chn_id, ret.dw0.chn_id'length));
 
@@ -600,16 +648,24 @@ package body transceiver_128bit_types is
 
 		ret.dw2.address_hi := addr_hi;
 		ret.dw3.address_lo := addr_lo;
+
+		if th = '1' then
+			ret.dw0.tag := st;
+			ret.dw1.th  := '1';
+			ret.dw3.address_lo(1 downto 0) := ph;
+		end if;
 		return ret;
 	end make_wr_rqst64;
 
 	function make_rd_rqst32(
 		length, chn_id, tag: natural;
-		address: dword
+		address: dword;
+		attr: tlp_attr_t := ATTR_DEFAULT
 	) return rqst32 is
 		variable ret: rqst32 := init_rqst32;
 	begin
 		ret.dw0.desc   := MRd32_desc;
+		ret.dw0.attr   := attr;
 		ret.dw0.length := std_logic_vector(to_unsigned(length, ret.dw0.length'length));
 		ret.dw0.tag    := std_logic_vector(to_unsigned(tag, ret.dw0.tag'length));
 		ret.dw0.chn_id := std_logic_vector(to_unsigned(chn_id, ret.dw0.chn_id'length));
@@ -628,11 +684,13 @@ package body transceiver_128bit_types is
 
 	function make_rd_rqst64(
 		length, chn_id, tag: natural;
-		addr_lo, addr_hi: dword
+		addr_lo, addr_hi: dword;
+		attr: tlp_attr_t := ATTR_DEFAULT
 	) return rqst64 is
 		variable ret: rqst64 := init_rqst64;
 	begin
 		ret.dw0.desc   := MRd32_desc;
+		ret.dw0.attr   := attr;
 		ret.dw0.length := std_logic_vector(to_unsigned(length, ret.dw0.length'length));
 		ret.dw0.tag    := std_logic_vector(to_unsigned(tag, ret.dw0.tag'length));
 		ret.dw0.chn_id := std_logic_vector(to_unsigned(chn_id, ret.dw0.chn_id'length));
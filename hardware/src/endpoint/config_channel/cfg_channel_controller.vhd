@@ -37,6 +37,7 @@ entity cfg_channel_controller is
 		mem_wr_en    : out std_ulogic := '0';
 		mem_rd_data  : in  std_ulogic_vector(31 downto 0) := (others => '0');
 		mem_rd_en    : out std_ulogic := '0';
+		mem_rd_start : out std_ulogic := '0';
 
 		-- completer output ports
 		cpld_payload : out std_ulogic_vector(31 downto 0);
@@ -64,8 +65,11 @@ cpld_payload <= mem_rd_data;
 
 mem_addr    <= op_addr;
 mem_wr_data <= op_data;
-mem_wr_en   <= '1' when op_code = WR_REG or op_code = INSTR else '0';
+-- op_code/op_addr follow every BAR0 packet, including the ones for other
+-- channels, so only write on a valid operation for the config channel
+mem_wr_en   <= '1' when op_vld = '1' and (op_code = WR_REG or op_code = INSTR) else '0';
 mem_rd_en   <= '1' when op_code = RD_REG else '0';
+mem_rd_start <= '1' when op_vld = '1' and op_code = RD_REG and state = IDLE else '0';
 
 -- disable output register of decoder if host wants to read a register while
 -- FSM is busy with a previous read instruction.
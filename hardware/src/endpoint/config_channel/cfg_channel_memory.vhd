@@ -12,6 +12,7 @@ library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
 use work.host_types.all;
+use work.pcie.all;
 use work.transceiver_128bit_types.all;
 use work.cfg_channel_types.all;
 
@@ -32,7 +33,25 @@ entity cfg_channel_memory is
 		wr_data  : in  std_ulogic_vector(31 downto 0) := (others => '0');
 		wr_en    : in  std_ulogic := '0';
 		rd_data  : out std_ulogic_vector(31 downto 0) := (others => '0');
-		rd_en    : in  std_ulogic := '0'
+		rd_en    : in  std_ulogic := '0';
+		-- first cycle of a read, rd_en stays set until the next operation
+		rd_start : in  std_ulogic := '0';
+
+		timestamp : in unsigned(63 downto 0) := (others => '0');
+
+		-- arbitration settings of channels 1 to n, see qos_config_t
+		qos      : out qos_config_vector(num_rx_host_cnl_c + num_tx_host_cnl_c +
+		                                 num_rx_fpga_cnl_c + num_tx_fpga_cnl_c downto 1)
+		             := (others => default_qos_config);
+		int_prio : out int_prio_t := INT_PRIO_ALTERNATE;
+
+		-- settings and counters of the traffic generator
+		traffic_ctrl   : out traffic_control := default_traffic_control;
+		traffic_status : in  traffic_counters := default_traffic_counters;
+
+		-- TLP trace buffer
+		trace_ctrl   : out trace_control := default_trace_control;
+		trace_status : in  trace_state := default_trace_state
 	);
 end cfg_channel_memory;
 
@@ -41,15 +60,31 @@ architecture arch of cfg_channel_memory is
 	type ram_8_t is array (0 to 7) of std_logic_vector(7 downto 0);
 	signal cfg_ram_8 : ram_8_t := (others => (others => '0'));
 
+	-- the counter is sampled once per read of the lower half, so a
+	-- lo/hi read sequence returns a consistent value
+	signal ts_snapshot : unsigned(63 downto 0) := (others => '0');
+	signal ts_sampled  : std_ulogic := '0';
+
+	constant channels : natural := num_rx_host_cnl_c + num_tx_host_cnl_c +
+	                               num_rx_fpga_cnl_c + num_tx_fpga_cnl_c;
+
+	signal qos_sel : unsigned(7 downto 0) := (others => '0');
+
+	-- entry word returned by the current TRACE_DATA read
+	signal trace_word : std_ulogic_vector(31 downto 0) := (others => '0');
+
 begin
 
 main: process
 begin
 	wait until rising_edge(clk);
 	rd_data <= (others => '0');
+	trace_ctrl.arm  <= '0';
+	trace_ctrl.stop <= '0';
+	trace_ctrl.read <= '0';
 
 	case addr is
-	when 0 to 7 =>
+	when HOST_INSTR =>
 		if wr_en = '1' then
 			cfg_ram_8(addr) <= wr_data(7 downto 0);
 		elsif rd_en = '1' then
@@ -65,11 +100,93 @@ begin
 	                               std_ulogic_vector(to_unsigned(num_tx_host_cnl_c, 8)) &
 	                               std_ulogic_vector(to_unsigned(num_rx_host_cnl_c, 8));
 
+	when TIMESTAMP_LO =>
+		if rd_en = '1' and ts_sampled = '0' then
+			ts_snapshot <= timestamp;
+			ts_sampled  <= '1';
+			rd_data     <= std_ulogic_vector(timestamp(31 downto 0));
+		else
+			rd_data     <= std_ulogic_vector(ts_snapshot(31 downto 0));
+		end if;
+	when TIMESTAMP_HI => rd_data <= std_ulogic_vector(ts_snapshot(63 downto 32));
+
+	when TRAFFIC_CTRL =>
+		if wr_en = '1' then
+			traffic_ctrl.mode <= to_traffic_mode(wr_data(1 downto 0));
+		elsif rd_en = '1' then
+			rd_data(1 downto 0) <= to_bits(traffic_ctrl.mode);
+		end if;
+	when TRACE_CTRL =>
+		if wr_en = '1' then
+			trace_ctrl.arm  <= wr_data(0);
+			trace_ctrl.stop <= wr_data(1);
+			trace_ctrl.post <= unsigned(wr_data(31 downto 16));
+		elsif rd_en = '1' then
+			rd_data <= to_dword(trace_status);
+		end if;
+	when TRACE_FILTER =>
+		if wr_en = '1' then
+			trace_ctrl.filter <= wr_data;
+		elsif rd_en = '1' then
+			rd_data <= trace_ctrl.filter;
+		end if;
+	when TRACE_TRIGGER =>
+		if wr_en = '1' then
+			trace_ctrl.trigger <= wr_data;
+		elsif rd_en = '1' then
+			rd_data <= trace_ctrl.trigger;
+		end if;
+	-- every read takes the next word of the buffer
+	when TRACE_DATA =>
+		if rd_start = '1' then
+			trace_word      <= trace_status.data;
+			trace_ctrl.read <= '1';
+			rd_data         <= trace_status.data;
+		elsif rd_en = '1' then
+			rd_data         <= trace_word;
+		end if;
+
+	when TRAFFIC_DWORDS => rd_data <= std_ulogic_vector(traffic_status.dwords);
+	when TRAFFIC_ERRORS => rd_data <= std_ulogic_vector(traffic_status.errors);
+
+	when QOS_SELECT =>
+		if wr_en = '1' then
+			qos_sel <= unsigned(wr_data(7 downto 0));
+		elsif rd_en = '1' then
+			rd_data(7 downto 0) <= std_ulogic_vector(qos_sel);
+		end if;
+
+	-- unknown channel ids are ignored and read as zero
+	when QOS_CONFIG =>
+		if qos_sel >= 1 and qos_sel <= channels then
+			if wr_en = '1' then
+				qos(to_integer(qos_sel)) <= to_qos_config(wr_data);
+			elsif rd_en = '1' then
+				rd_data <= to_dword(qos(to_integer(qos_sel)));
+			end if;
+		end if;
+
+	when QOS_CTRL =>
+		if wr_en = '1' then
+			int_prio <= wr_data(1 downto 0);
+		elsif rd_en = '1' then
+			rd_data(1 downto 0) <= int_prio;
+		end if;
+
 	when others => rd_data <= (others => '0');
 	end case;
 
+	if rd_en = '0' or addr /= TIMESTAMP_LO then
+		ts_sampled <= '0';
+	end if;
+
 	if rst = '1' then
-		rd_data <= (others => '0');
+		rd_data  <= (others => '0');
+		qos_sel  <= (others => '0');
+		qos      <= (others => default_qos_config);
+		int_prio <= INT_PRIO_ALTERNATE;
+		traffic_ctrl <= default_traffic_control;
+		trace_ctrl   <= default_trace_control;
 	end if;
 end process;
 
@@ -11,6 +11,7 @@ library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
 
+use work.pcie.all;
 use work.transceiver_128bit_types.all;
 
 package cfg_channel_types is
@@ -18,23 +19,23 @@ package cfg_channel_types is
 	subtype cfg_reg_addr_t is natural range 0 to 15;
 	-- BAR-address encoding:
 	-- registers 0 to 7 are the same for every channel
-	constant MSG_BUFFER_ADDR_LOW    : cfg_reg_addr_t := 0;
-	constant MSG_BUFFER_ADDR_HIGH   : cfg_reg_addr_t := 1;
-	constant MSG_BUFFER_SIZE        : cfg_reg_addr_t := 2;
-	constant ADDR_3_UNUSED          : cfg_reg_addr_t := 3;
-	constant MSG_BUFFER_TRANSFERRED : cfg_reg_addr_t := 4;
-	constant ADDR_5_UNUSED          : cfg_reg_addr_t := 5;
-	constant ADDR_6_UNUSED          : cfg_reg_addr_t := 6;
+	constant TRACE_CTRL             : cfg_reg_addr_t := 0;
+	constant TRACE_FILTER           : cfg_reg_addr_t := 1;
+	constant TRACE_TRIGGER          : cfg_reg_addr_t := 2;
+	constant TRAFFIC_CTRL           : cfg_reg_addr_t := 3;
+	constant TRACE_DATA             : cfg_reg_addr_t := 4;
+	constant TRAFFIC_DWORDS         : cfg_reg_addr_t := 5;
+	constant TRAFFIC_ERRORS         : cfg_reg_addr_t := 6;
 	constant HOST_INSTR             : cfg_reg_addr_t := 7;
 	-- registers 8 to 15 are channel specific
 	constant FPGA_ID                : cfg_reg_addr_t := 8;
 	constant CORE_ID                : cfg_reg_addr_t := 9;
 	constant NUM_CHANNEL            : cfg_reg_addr_t := 10;
-	constant ADDR_11_UNUSED         : cfg_reg_addr_t := 11;
-	constant ADDR_12_UNUSED         : cfg_reg_addr_t := 12;
-	constant ADDR_13_UNUSED         : cfg_reg_addr_t := 13;
-	constant ADDR_14_UNUSED         : cfg_reg_addr_t := 14;
-	constant ADDR_15_UNUSED         : cfg_reg_addr_t := 15;
+	constant TIMESTAMP_LO           : cfg_reg_addr_t := 11;
+	constant TIMESTAMP_HI           : cfg_reg_addr_t := 12;
+	constant QOS_SELECT             : cfg_reg_addr_t := 13;
+	constant QOS_CONFIG             : cfg_reg_addr_t := 14;
+	constant QOS_CTRL               : cfg_reg_addr_t := 15;
 
 	-- host instructions are encoded with an one-hot scheme in MWr-payload (DW3),
 	-- if host writes to register HOST_INSTR
@@ -44,8 +45,163 @@ package cfg_channel_types is
 	constant RESET_FPGA_CHANNEL : host_instr_idx_t := 2;
 
 	type op_code_t is (RD_REG, WR_REG, INSTR, INVALID);
+
+	-- Per-channel arbitration settings, accessed indirectly by writing the
+	-- channel id to QOS_SELECT and reading/writing QOS_CONFIG.
+	-- QOS_CONFIG layout:
+	--   bit      0: high priority class, served strictly before the default class
+	--   bits  7: 4: weight, packets the channel may send in a row (weight + 1)
+	--   bits 19: 8: token bucket size in DWORDs, 0 disables the rate limit
+	--   bits 31:20: token rate in 1/256 DWORDs per clock cycle
+	type qos_config_t is record
+		high_prio : std_ulogic;
+		weight    : unsigned(3 downto 0);
+		burst     : unsigned(11 downto 0);
+		rate      : unsigned(11 downto 0);
+	end record;
+
+	constant default_qos_config : qos_config_t := (
+		high_prio => '0',
+		weight    => (others => '0'),
+		burst     => (others => '0'),
+		rate      => (others => '0')
+	);
+
+	type qos_config_vector is array (natural range <>) of qos_config_t;
+
+	function to_qos_config(data: std_ulogic_vector(31 downto 0)) return qos_config_t;
+	function to_dword(qos: qos_config_t) return std_ulogic_vector;
+
+	-- QOS_CTRL bits 1:0, priority of the host channel interrupts in tx_interrupt_mux
+	subtype int_prio_t is std_ulogic_vector(1 downto 0);
+	constant INT_PRIO_ALTERNATE : int_prio_t := "00";
+	constant INT_PRIO_RX        : int_prio_t := "01";
+	constant INT_PRIO_TX        : int_prio_t := "10";
+
+	-- TRAFFIC_CTRL bits 1:0, mode of the traffic generator:
+	--   0: off, 1: stream pattern data, 2: echo messages (ping), 3: off
+	-- TRAFFIC_DWORDS and TRAFFIC_ERRORS are the read only counters
+	function to_traffic_mode(data: std_ulogic_vector(1 downto 0)) return traffic_mode;
+	function to_bits(mode: traffic_mode) return std_ulogic_vector;
+
+	-- TLP trace buffer of the endpoint, see tlp_trace. TRACE_CTRL and
+	-- TRACE_DATA read as zero if the endpoint has no trace buffer.
+	-- TRACE_CTRL on write:
+	--   bit      0: arm, clear the buffer and start recording
+	--   bit      1: stop recording
+	--   bits 31:16: entries recorded after the trigger before recording stops
+	-- TRACE_CTRL on read:
+	--   bit      0: recording
+	--   bit      1: triggered
+	--   bit      2: wrapped, the oldest entries were overwritten
+	--   bit      3: lost, entries were dropped because both directions
+	--              started TLPs in consecutive cycles
+	--   bits 12: 8: log2 of the buffer depth in entries
+	--   bits 31:16: entries in the buffer
+	-- TRACE_FILTER, the TLPs which are recorded:
+	--   bit      0: host to FPGA TLPs
+	--   bit      1: FPGA to host TLPs
+	--   bit      2: only TLPs of the channel in bits 15:8
+	--   bits 31:16: one bit per TLP descriptor, see transceiver_128bit_types
+	-- TRACE_TRIGGER, the TLP which ends an armed recording after the
+	-- post trigger entries, no trigger if bits 1:0 are zero:
+	--   bit      0: host to FPGA TLPs
+	--   bit      1: FPGA to host TLPs
+	--   bit      2: only TLPs of the channel in bits 15:8
+	--   bit      3: only TLPs with the descriptor in bits 19:16
+	-- TRACE_DATA returns the recorded entries from the oldest to the
+	-- newest while recording is stopped, four DWords per entry.
+	type trace_control is record
+		arm     : std_ulogic;
+		stop    : std_ulogic;
+		read    : std_ulogic;
+		post    : unsigned(15 downto 0);
+		filter  : std_ulogic_vector(31 downto 0);
+		trigger : std_ulogic_vector(31 downto 0);
+	end record;
+
+	constant default_trace_control : trace_control := (
+		arm     => '0',
+		stop    => '0',
+		read    => '0',
+		post    => (others => '0'),
+		filter  => x"FFFF0003",
+		trigger => (others => '0')
+	);
+
+	type trace_state is record
+		recording  : std_ulogic;
+		triggered  : std_ulogic;
+		wrapped    : std_ulogic;
+		lost       : std_ulogic;
+		depth_log2 : unsigned(4 downto 0);
+		entries    : unsigned(15 downto 0);
+		data       : std_ulogic_vector(31 downto 0);
+	end record;
+
+	constant default_trace_state : trace_state := (
+		recording  => '0',
+		triggered  => '0',
+		wrapped    => '0',
+		lost       => '0',
+		depth_log2 => (others => '0'),
+		entries    => (others => '0'),
+		data       => (others => '0')
+	);
+
+	function to_dword(status: trace_state) return std_ulogic_vector;
 end package cfg_channel_types;
 
 package body cfg_channel_types is
 
+	function to_qos_config(data: std_ulogic_vector(31 downto 0)) return qos_config_t is
+		variable ret: qos_config_t;
+	begin
+		ret.high_prio := data(0);
+		ret.weight    := unsigned(data( 7 downto  4));
+		ret.burst     := unsigned(data(19 downto  8));
+		ret.rate      := unsigned(data(31 downto 20));
+		return ret;
+	end to_qos_config;
+
+	function to_dword(qos: qos_config_t) return std_ulogic_vector is
+		variable ret: std_ulogic_vector(31 downto 0) := (others => '0');
+	begin
+		ret(0)            := qos.high_prio;
+		ret( 7 downto  4) := std_ulogic_vector(qos.weight);
+		ret(19 downto  8) := std_ulogic_vector(qos.burst);
+		ret(31 downto 20) := std_ulogic_vector(qos.rate);
+		return ret;
+	end to_dword;
+
+	function to_traffic_mode(data: std_ulogic_vector(1 downto 0)) return traffic_mode is
+	begin
+		case data is
+		when "01"   => return TRAFFIC_STREAM;
+		when "10"   => return TRAFFIC_PING;
+		when others => return TRAFFIC_OFF;
+		end case;
+	end to_traffic_mode;
+
+	function to_bits(mode: traffic_mode) return std_ulogic_vector is
+	begin
+		case mode is
+		when TRAFFIC_STREAM => return "01";
+		when TRAFFIC_PING   => return "10";
+		when others         => return "00";
+		end case;
+	end to_bits;
+
+	function to_dword(status: trace_state) return std_ulogic_vector is
+		variable ret: std_ulogic_vector(31 downto 0) := (others => '0');
+	begin
+		ret(0)            := status.recording;
+		ret(1)            := status.triggered;
+		ret(2)            := status.wrapped;
+		ret(3)            := status.lost;
+		ret(12 downto  8) := std_ulogic_vector(status.depth_log2);
+		ret(31 downto 16) := std_ulogic_vector(status.entries);
+		return ret;
+	end to_dword;
+
 end package body cfg_channel_types;
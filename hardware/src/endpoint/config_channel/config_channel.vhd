@@ -34,6 +34,22 @@ entity config_channel is
 		rst_fpga_channel : out std_ulogic := '0';
 		rst_endpoint     : out std_ulogic := '0';
 
+		-- endpoint cycle counter, readable by the host
+		timestamp        : in  unsigned(63 downto 0) := (others => '0');
+
+		-- runtime arbitration settings for the endpoint, see cfg_channel_types
+		qos      : out qos_config_vector(num_rx_host_cnl + num_tx_host_cnl +
+		                                 num_rx_fpga_cnl + num_tx_fpga_cnl downto 1);
+		int_prio : out int_prio_t;
+
+		-- traffic generator settings and counters, see cfg_channel_types
+		traffic_ctrl   : out traffic_control;
+		traffic_status : in  traffic_counters := default_traffic_counters;
+
+		-- TLP trace buffer settings and data, see cfg_channel_types
+		trace_ctrl   : out trace_control;
+		trace_status : in  trace_state := default_trace_state;
+
 		-- input ports
 		i     : in  fragment;
 		i_vld : in  std_ulogic;
@@ -55,6 +71,7 @@ architecture arch of config_channel is
 	signal mem_addr : cfg_reg_addr_t;
 	signal mem_rd_data : std_ulogic_vector(31 downto 0);
 	signal mem_rd_en : std_ulogic;
+	signal mem_rd_start : std_ulogic;
 	signal mem_wr_data : std_ulogic_vector(31 downto 0);
 	signal mem_wr_en : std_ulogic;
 	signal op_addr : cfg_reg_addr_t;
@@ -98,6 +115,7 @@ ctrl: entity work.cfg_channel_controller
 		mem_wr_en        => mem_wr_en,
 		mem_rd_data      => mem_rd_data,
 		mem_rd_en        => mem_rd_en,
+		mem_rd_start     => mem_rd_start,
 		cpld_payload     => cpld_payload,
 		cpld_lo_addr     => cpld_lo_addr,
 		cpld_tag         => cpld_tag,
@@ -121,7 +139,15 @@ mem: entity work.cfg_channel_memory
 		wr_data => mem_wr_data,
 		wr_en   => mem_wr_en,
 		rd_data => mem_rd_data,
-		rd_en   => mem_rd_en
+		rd_en   => mem_rd_en,
+		rd_start => mem_rd_start,
+		timestamp => timestamp,
+		qos       => qos,
+		int_prio  => int_prio,
+		traffic_ctrl   => traffic_ctrl,
+		traffic_status => traffic_status,
+		trace_ctrl     => trace_ctrl,
+		trace_status   => trace_status
 	);
 
 cpld: entity work.cfg_channel_completer
@@ -9,6 +9,7 @@ use work.host_types.all;
 use work.pcie.all;
 use work.transceiver_128bit_types.all;
 use work.tlp_types.all;
+use work.cfg_channel_types.all;
 
 entity endpoint_core is
 	generic(config     : transceiver_configuration);
@@ -56,7 +57,23 @@ entity endpoint_core is
 		-- tx_channel output
 		to_tx_vld   : out std_logic := '0';
 		to_tx_req   : in  std_logic;
-		to_tx       : out fragment
+		to_tx       : out fragment;
+
+		-- free running cycle counter, distributed to the channels
+		-- for transaction timestamps
+		timestamp   : out unsigned(63 downto 0);
+
+		-- arbitration settings of the channels, set by the host through
+		-- the config channel (index = channel id)
+		qos         : out qos_config_vector(channel_count(config) downto 1);
+
+		-- tag quota of the rx channels, a channel may send another read
+		-- request while its bit is set (index = channel id)
+		rd_grant    : out std_logic_vector(rx_count(config) downto 1);
+
+		-- settings and counters of an optional traffic generator
+		traffic_ctrl   : out traffic_control;
+		traffic_status : in  traffic_counters := default_traffic_counters
 	);
 end endpoint_core;
 
@@ -98,9 +115,23 @@ architecture arch of endpoint_core is
 	signal tx_tlptag_tlpmux : fragment;             
 	signal tx_tlptag_tlpmux_vld : std_ulogic;     
 	signal tx_tlptag_tlpmux_req : std_ulogic;     
+	signal cycle_counter : unsigned(63 downto 0) := (others => '0');
+	signal int_prio : int_prio_t;
+	signal trace_ctrl : trace_control;
+	signal trace_status : trace_state := default_trace_state;
+	signal tx_waiting : std_ulogic_vector(3 downto 0);
 	
 
 begin
+	-- never reset, so timestamps stay monotonic across channel resets
+	cycle_count: process
+	begin
+		wait until rising_edge(clk);
+		cycle_counter <= cycle_counter + 1;
+	end process;
+
+	timestamp <= cycle_counter;
+
 		-- converts axis to costum handshake protocol and destraddles data stream
 	rx_converter: entity work.rx_axi_converter
 		port map(
@@ -146,6 +177,13 @@ begin
 			rst_host_channel => rst,
 			rst_fpga_channel => open,
 			rst_endpoint     => rst_endpoint,
+			timestamp        => cycle_counter,
+			qos              => qos,
+			int_prio         => int_prio,
+			traffic_ctrl     => traffic_ctrl,
+			traffic_status   => traffic_status,
+			trace_ctrl       => trace_ctrl,
+			trace_status     => trace_status,
 			i     => demux_bar0_data,
 			i_vld => demux_bar0_vld,
 			i_req => demux_cfgchannel_req,
@@ -167,6 +205,9 @@ begin
 		);
 
 	tlp_tag_translator: entity work.tlp_tag_mapper
+		generic map(
+			config => config
+		)
 		port map(
 			clk      => clk,
 			rst      => rst_endpoint,
@@ -181,7 +222,8 @@ begin
 			tx_i_req => from_rx_tlpmux_req,
 			tx_o     => tx_tlptag_tlpmux,
 			tx_o_vld => tx_tlptag_tlpmux_vld,
-			tx_o_req => tx_tlptag_tlpmux_req
+			tx_o_req => tx_tlptag_tlpmux_req,
+			rd_grant => rd_grant
 		);
 
 	to_rx     <= rx_tlptag_out;
@@ -222,7 +264,8 @@ begin
 			host_tx      => from_tx,
 			o_vld  => intmux_msix_vld,
 			o_req  => intmux_msix_req,
-			o      => intmux_msix_data
+			o      => intmux_msix_data,
+			mode   => int_prio
 		);
 
 	tx_tlp_mux: entity work.tx_tlp_mux
@@ -262,6 +305,30 @@ begin
 			axis_tx_ready => axis_tx_ready
 		);
 
+	-- records the TLPs on both sides of the endpoint for the host
+	trace_gen: if trace_depth(config) > 0 generate
+		tx_waiting <= (msix_tlpmux_vld, cfgchannel_tlpmux_vld, tx_tlptag_tlpmux_vld, from_tx_vld);
+
+		trace: entity work.tlp_trace
+			generic map(
+				depth => trace_depth(config)
+			)
+			port map(
+				clk        => clk,
+				rst        => rst_endpoint,
+				timestamp  => cycle_counter,
+				rx         => demux_bar0_data,
+				rx_vld     => demux_bar0_vld,
+				rx_req     => demux_bar0_req,
+				tx         => tlpmux_converter_data,
+				tx_vld     => tlpmux_converter_vld,
+				tx_req     => tlpmux_converter_req,
+				tx_waiting => tx_waiting,
+				ctrl       => trace_ctrl,
+				status     => trace_status
+			);
+	end generate;
+
 	from_rx_req <= from_rx_intmux_req and from_rx_tlpmux_req;
 	from_tx_req <= from_tx_intmux_req and from_tx_tlpmux_req;
 
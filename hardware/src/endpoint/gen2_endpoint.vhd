@@ -8,6 +8,7 @@ use unisim.vcomponents.all;
 use work.pcie.all;
 use work.host_types.all;
 use work.transceiver_128bit_types.all;
+use work.cfg_channel_types.all;
 
 entity gen2_endpoint is
 	generic(config: transceiver_configuration);
@@ -47,7 +48,14 @@ entity gen2_endpoint is
 		-- tx_host_channel output
 		to_tx_vld   : out std_ulogic_vector(tx_count(config)-1 downto 0) := (others => '0');
 		to_tx_req   : in  std_ulogic_vector(tx_count(config)-1 downto 0);
-		to_tx       : out fragment_vector(tx_count(config)-1 downto 0)
+		to_tx       : out fragment_vector(tx_count(config)-1 downto 0);
+
+		-- free running cycle counter for channel timestamps
+		timestamp   : out unsigned(63 downto 0);
+
+		-- settings and counters of an optional traffic generator
+		traffic_ctrl   : out traffic_control;
+		traffic_status : in  traffic_counters := default_traffic_counters
 	);
 end gen2_endpoint;
 
@@ -202,6 +210,9 @@ constant C_DATA_WIDTH : integer range 64 to 128 := 128;
 	signal to_tx_req_multi : std_logic;
 	signal to_tx_multi     : fragment;
 
+	signal qos : qos_config_vector(channel_count(config) downto 1);
+	signal rd_grant : std_logic_vector(rx_count(config) downto 1);
+
 begin
 	clk <= user_clk;
 
@@ -347,7 +358,12 @@ ep: entity work.endpoint_core
 		from_tx => tx_arb_ep,
 		to_tx_vld => to_tx_vld_multi,
 		to_tx_req => to_tx_req_multi,
-		to_tx => to_tx_multi
+		to_tx => to_tx_multi,
+		timestamp => timestamp,
+		qos => qos,
+		rd_grant => rd_grant,
+		traffic_ctrl => traffic_ctrl,
+		traffic_status => traffic_status
 	);
 	
 rx_loop: for i in 0 to config.host_rx_channels+config.fpga_rx_channels-1 generate
@@ -374,7 +390,9 @@ rx_arbiter: entity work.packet_arbiter
 		i      => from_rx,    
 		o_req  => rx_arb_ep_req,
 		o_vld  => rx_arb_ep_vld,
-		o      => rx_arb_ep
+		o      => rx_arb_ep,
+		qos    => qos(rx_count(config) downto 1),
+		rd_grant => rd_grant
 	);
 
 tx_arbiter: entity work.packet_arbiter
@@ -389,7 +407,8 @@ tx_arbiter: entity work.packet_arbiter
 		i      => from_tx,    
 		o_req  => tx_arb_ep_req,
 		o_vld  => tx_arb_ep_vld,
-		o      => tx_arb_ep
+		o      => tx_arb_ep,
+		qos    => qos(channel_count(config) downto rx_count(config)+1)
 	);
 
 end architecture;
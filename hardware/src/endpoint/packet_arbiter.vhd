@@ -4,6 +4,15 @@
 -- Author:	Oguzhan Sezenlik,	University Bonn
 --
 --	Arbiter selects
+--
+--	Packets are arbitrated round robin. The optional qos settings
+--	(see cfg_channel_types) add a strict high priority class, a weight
+--	that lets a port send several packets in a row and a token bucket
+--	rate limit per port. With the default settings the arbiter behaves
+--	like a plain round robin arbiter.
+--
+--	A port whose next packet is a read request is skipped while its
+--	rd_grant is not set, the tag quota of the rx channels uses this.
 ----------------------------------------------------------------------------
 
 library ieee;
@@ -11,6 +20,8 @@ use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
 use work.pcie.all;
 use work.transceiver_128bit_types.all;
+use work.cfg_channel_types.all;
+use work.utils.all;
 
 entity packet_arbiter is
 	generic(
@@ -27,7 +38,11 @@ entity packet_arbiter is
 		-- Output Port "o":
 		o_req   : in  std_logic;
 		o_vld   : out std_logic := '0';
-		o       : out fragment := default_fragment
+		o       : out fragment := default_fragment;
+		-- runtime arbitration settings
+		qos     : in  qos_config_vector(ports-1 downto 0) := (others => default_qos_config);
+		-- read requests of a port are only taken while its bit is set
+		rd_grant: in  std_logic_vector(ports-1 downto 0) := (others => '1')
 	);
 end packet_arbiter;
 
@@ -47,28 +62,53 @@ architecture Behavioral of packet_arbiter is
 
 	signal current_is_eof : std_logic := '0';
 
+	-- candidates for the next packet: valid, within their rate limit and
+	-- in the highest priority class that has a valid port
+	signal cand, cand_all, cand_high : std_logic_vector(ports-1 downto 0) := (others => '0');
+	signal high_prio, rate_ok : std_logic_vector(ports-1 downto 0) := (others => '0');
+
+	-- packets sent in a row by current_input
+	signal burst_cnt : unsigned(3 downto 0) := (others => '0');
+
+	-- i_vld without the read requests which are not granted, these are
+	-- single word packets and treated as not valid until granted
+	signal vld, rd_ok : std_logic_vector(ports-1 downto 0) := (others => '0');
+
 begin
 
+	rd_logic: for p in 0 to ports-1 generate
+		rd_ok(p) <= '0' when i(p).sof = '1' and is_read_rqst(i(p)) and rd_grant(p) = '0' else '1';
+	end generate;
+	vld <= i_vld and rd_ok;
+
 	req_logic: for i in 0 to ports-1 generate
-		i_req(i) <= (i_req_reg(i) and o_req) or not i_vld(i);
+		i_req(i) <= (i_req_reg(i) and o_req and rd_ok(i)) or not i_vld(i);
 	end generate;
 
-	vld_masked <= i_vld and (mask & '0');
+	qos_flags: for p in 0 to ports-1 generate
+		high_prio(p) <= qos(p).high_prio;
+	end generate;
+
+	cand_all  <= vld and rate_ok;
+	cand_high <= cand_all and high_prio;
+	cand      <= cand_high when unsigned(cand_high) /= 0 else cand_all;
+
+	vld_masked <= cand and (mask & '0');
 
 	-- priority encoder with thermometer encoding, used as the mask.
 	-- example: 00010110 => 11111110;
 	prio_enc_masked   <= vld_masked or std_logic_vector(unsigned(not vld_masked) +1);
-	prio_enc_unmasked <= i_vld      or std_logic_vector(unsigned(not i_vld) +1);
+	prio_enc_unmasked <= cand       or std_logic_vector(unsigned(not cand) +1);
 
 	-- priority encoder with one_hot encoding, used as input for the binary encoder and cont logic.
 	-- example: 00010110 => 00000010;
 	one_hot_masked   <= vld_masked and std_logic_vector(unsigned(not vld_masked) +1);
-	one_hot_unmasked <= i_vld      and std_logic_vector(unsigned(not i_vld) +1);
+	one_hot_unmasked <= cand       and std_logic_vector(unsigned(not cand) +1);
 
 	prio_enc_mux <= prio_enc_unmasked when unsigned(vld_masked) = 0 else prio_enc_masked;
 	one_hot      <= one_hot_unmasked  when unsigned(vld_masked) = 0 else one_hot_masked;
 
-	current_is_eof <= i(current_input).eof and i_vld(current_input);
+	current_is_eof <= i(current_input).eof and vld(current_input);
 
 	fsm: process
 	begin
@@ -79,7 +119,7 @@ begin
 				state <= PREVIOUS_WAS_EOF;
 			end if;
 		when PREVIOUS_WAS_EOF =>
-			if i_vld(current_input) = '1' and i(current_input).eof = '0' then
+			if vld(current_input) = '1' and i(current_input).eof = '0' then
 				state <= WAIT_FOR_EOF;
 			end if;
 		end case;
@@ -94,38 +134,46 @@ begin
 	begin
 		wait until rising_edge(clk) and o_req = '1';
 		
-		if (state = PREVIOUS_WAS_EOF and i_vld(current_input) = '0') or 
+		if (state = PREVIOUS_WAS_EOF and vld(current_input) = '0') or 
 		   (current_is_eof = '1') or unsigned(i_req_reg) = 0 then
 
-			-- update mask to blend out already used inputs
-			mask <= prio_enc_mux(ports-2 downto 0);
+			burst_cnt <= (others => '0');
 
-			-- generic priority encoder with binary encoding, used as multiplexer control signal
-			index := 0;
-			for i in ports-1 downto 0 loop
-				if i_vld(i) = '1' then
-					index := i;
-				end if;
-			end loop;
+			-- let the current input send up to weight more packets
+			if cand(current_input) = '1' and i_req_reg(current_input) = '1' and
+			   burst_cnt < qos(current_input).weight then
+				burst_cnt <= burst_cnt + 1;
+			else
 
-			index_masked := 0;
-			for i in ports-1 downto 0 loop
-				if vld_masked(i) = '1' then
-					index_masked := i;
+				-- update mask to blend out already used inputs
+				mask <= prio_enc_mux(ports-2 downto 0);
+
+				-- generic priority encoder with binary encoding, used as multiplexer control signal
+				index := 0;
+				for i in ports-1 downto 0 loop
+					if cand(i) = '1' then
+						index := i;
+					end if;
+				end loop;
+
+				index_masked := 0;
+				for i in ports-1 downto 0 loop
+					if vld_masked(i) = '1' then
+						index_masked := i;
+					end if;
+				end loop;
+
+				if unsigned(vld_masked) = 0 then
+					current_input <= index;
+				else
+					current_input <= index_masked;
 				end if;
-			end loop;
-
-			if unsigned(vld_masked) = 0 then
-				current_input <= index;
-			else
-				current_input <= index_masked;
+				i_req_reg <= one_hot;
 			end if;
-			i_req_reg <= one_hot;
-
 		end if;
 
 		o <= i(current_input);
-		o_vld  <= i_vld(current_input) and i_req_reg(current_input);
+		o_vld  <= vld(current_input) and i_req_reg(current_input);
 		
 		if rst = '1' then
 			i_req_reg <= (others => '0');
@@ -133,7 +181,39 @@ begin
 			current_input <= 0;
 			o <= default_fragment;
 			o_vld <= '0';
+			burst_cnt <= (others => '0');
 		end if;
 	end process;
 
+	-- token bucket per port, in 1/256 DWORDs. Tokens are taken for every
+	-- DWORD that is accepted from a port, the bucket may run negative to
+	-- finish a started packet. A port is only selected with a non-negative
+	-- bucket.
+	rate_limit: for p in 0 to ports-1 generate
+		signal tokens : signed(21 downto 0) := (others => '0');
+	begin
+		rate_ok(p) <= '1' when qos(p).burst = 0 or tokens >= 0 else '0';
+
+		bucket: process
+			variable nxt : signed(21 downto 0);
+		begin
+			wait until rising_edge(clk);
+
+			nxt := tokens + signed(resize(qos(p).rate, nxt'length));
+			if nxt > signed(resize(qos(p).burst & x"00", nxt'length)) then
+				nxt := signed(resize(qos(p).burst & x"00", nxt'length));
+			end if;
+
+			if vld(p) = '1' and i_req_reg(p) = '1' and o_req = '1' then
+				nxt := nxt - signed(resize(keep2cnt(i(p).keep) & x"00", nxt'length));
+			end if;
+
+			tokens <= nxt;
+
+			if rst = '1' or qos(p).burst = 0 then
+				tokens <= (others => '0');
+			end if;
+		end process;
+	end generate;
+
 end Behavioral;
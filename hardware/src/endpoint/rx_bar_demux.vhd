@@ -64,7 +64,10 @@ architecture arch of rx_bar_demux is
         ret.dw0.desc          := fmtType_to_desc(data.dw0.fmt_type);
         ret.dw0.length        := data.dw0.length;
         ret.dw0.chn_id        := (others => '0'); -- will be replaced by another module -- "00000" & data.dw2.tag(7 downto 5);  -- TODO
-        ret.dw1.byte_count    := data.dw1.byte_count;
+        -- the channels work on whole DWORDs, the bytes of a partial last
+        -- DWORD are passed on separately
+        ret.dw1.byte_count    := std_logic_vector(unsigned(data.dw1.byte_count) + 3) and x"FFC";
+        ret.dw1.last_bytes    := data.dw1.byte_count(1 downto 0);
         ret.dw1.completer_id  := data.dw1.completer_id;
         ret.dw2.lower_addr    := data.dw2.lower_address;
         ret.dw0.tag           := data.dw2.tag;
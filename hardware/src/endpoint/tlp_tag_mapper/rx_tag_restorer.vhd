@@ -23,6 +23,7 @@ entity rx_tag_restorer is
 		
 		tag     : out std_logic_vector(7 downto 0);
 		tag_rst : out std_logic;
+		tag_chn : out std_logic_vector(7 downto 0);
 		
 		mem_addr   : out std_logic_vector(7 downto 0);
 		mem_chn_id : in  std_logic_vector(7 downto 0);
@@ -74,6 +75,7 @@ begin
 		if buf_temp_dw0.length = buf_temp_dw1.byte_count(11 downto 2) then
 			tag     <= buf_temp_dw0.tag;
 			tag_rst <= '1';
+			tag_chn <= mem_chn_id;
 		end if;
 		
 		buf_temp_dw0.chn_id := mem_chn_id;
@@ -15,6 +15,9 @@ use work.transceiver_128bit_types.all;
 use work.cfg_channel_types.all;
 
 entity tlp_tag_mapper is
+	generic(
+		config : transceiver_configuration
+	);
 	port(
 		clk      : in  std_logic;
 		rst      : in  std_logic;
@@ -33,7 +36,10 @@ entity tlp_tag_mapper is
 
 		tx_o     : out fragment;
 		tx_o_vld : out std_logic := '0';
-		tx_o_req : in  std_logic
+		tx_o_req : in  std_logic;
+
+		-- a rx channel may send another MRd, index = channel id
+		rd_grant : out std_logic_vector(rx_count(config) downto 1)
 	);
 end tlp_tag_mapper;
 
@@ -50,8 +56,25 @@ architecture struct of tlp_tag_mapper is
 	signal tlp_tag_rd_en : std_logic;
 	signal tlp_tag_i : std_logic_vector(7 downto 0);
 	signal tlp_tag_wr_en : std_logic;
+	signal tlp_tag_chn_id : std_logic_vector(7 downto 0);
+
+	signal quota_chn_id : std_logic_vector(7 downto 0);
+	signal quota_grant : std_logic_vector(host_rx_count(config) downto 0);
 begin
 
+-- the quota is applied by the rx arbiter, a MRd reaching the replacer only
+-- waits for the shared pool
+quota_chn_id <= to_common_dw0(get_dword(tx_i, 0)).chn_id;
+
+grants: for id in 1 to rx_count(config) generate
+	host: if id <= host_rx_count(config) generate
+		rd_grant(id) <= quota_grant(id);
+	end generate;
+	other: if id > host_rx_count(config) generate
+		rd_grant(id) <= quota_grant(0);
+	end generate;
+end generate;
+
 replacer: entity work.tx_tag_replacer
 	port map(
 		clk        => clk,
@@ -77,6 +100,7 @@ restorer: entity work.rx_tag_restorer
 		rst        => rst,
 		tag        => tlp_tag_i,
 		tag_rst    => tlp_tag_wr_en,
+		tag_chn    => tlp_tag_chn_id,
 		mem_addr   => rd_addr,
 		mem_chn_id => rd_chn_id,
 		mem_tag    => rd_tag,
@@ -112,4 +136,19 @@ tlp_tag_mem: entity work.tlp_tag_memory
 		avail => tlp_tag_avail
 	);
 
+tag_quota: entity work.tlp_tag_quota
+	generic map(
+		channels => host_rx_count(config),
+		tags_min => rx_tags_min(config)
+	)
+	port map(
+		clk         => clk,
+		rst         => rst,
+		grant       => quota_grant,
+		take        => tlp_tag_rd_en,
+		rqst_chn_id => quota_chn_id,
+		give        => tlp_tag_wr_en,
+		give_chn_id => tlp_tag_chn_id
+	);
+
 end architecture struct;
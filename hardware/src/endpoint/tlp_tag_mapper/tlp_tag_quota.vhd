@@ -0,0 +1,112 @@
+---------------------------------------------------------------------------------------------------
+-- Description: keeps track of the in-flight MRd tags of every host rx channel and
+--              decides if a channel may borrow another tag from the shared pool.
+--              A channel always gets a tag while it has less than `tags_min` in
+--              flight, above that only if enough tags are left to serve the
+--              minimum of all other channels.
+--              The upper bound `tags_max` is given by the tag range of the
+--              channel's rx_dma_buffer and thus not checked here.
+--              Host rx channels have the ids 1 to `channels`, every other
+--              id (FPGA rx channels) shares bucket 0 without reservation;
+--              host_rx_channel asserts this.
+--              The grants are used by the rx arbiter to skip channels whose
+--              next MRd would exceed their quota. They only count MRds which
+--              took their tag yet, the MRd in the output register of the
+--              arbiter may thus borrow one tag too many.
+---------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity tlp_tag_quota is
+	generic(
+		channels : natural;  -- number of host rx channels, ids 1 to channels
+		tags     : positive := 256;
+		tags_min : natural
+	);
+	port(
+		clk : in  std_logic;
+		rst : in  std_logic;
+
+		-- a channel may take another tag, index = channel id, index 0
+		-- for every channel which is no host rx channel
+		grant       : out std_logic_vector(channels downto 0);
+
+		-- a tag was handed out to rqst_chn_id
+		take        : in  std_logic;
+		rqst_chn_id : in  std_logic_vector(7 downto 0);
+
+		-- the last completion of a MRd of give_chn_id was received
+		give        : in  std_logic;
+		give_chn_id : in  std_logic_vector(7 downto 0)
+	);
+end tlp_tag_quota;
+
+architecture arch of tlp_tag_quota is
+
+	subtype count_t is unsigned(8 downto 0);
+	type count_vector_t is array (0 to channels) of count_t;
+
+	signal in_flight : count_vector_t := (others => (others => '0'));
+	signal free      : count_t := to_unsigned(tags, count_t'length);
+	-- sum over all channels of max(0, tags_min - in_flight)
+	signal reserved  : count_t := to_unsigned(channels * tags_min, count_t'length);
+
+	-- channel 0 collects all channels which are not host rx channels,
+	-- they have no reservation
+	function index(chn_id: std_logic_vector(7 downto 0)) return natural is
+	begin
+		if to_integer(unsigned(chn_id)) <= channels then
+			return to_integer(unsigned(chn_id));
+		end if;
+		return 0;
+	end index;
+
+begin
+
+grants: for c in 0 to channels generate
+	grant(c) <= '1' when free > reserved or (c /= 0 and in_flight(c) < tags_min) else '0';
+end generate;
+
+main: process
+	variable nxt_free, nxt_reserved : count_t;
+begin
+	wait until rising_edge(clk);
+
+	nxt_free     := free;
+	nxt_reserved := reserved;
+
+	if take = '1' then
+		in_flight(index(rqst_chn_id)) <= in_flight(index(rqst_chn_id)) + 1;
+		nxt_free := nxt_free - 1;
+		if index(rqst_chn_id) /= 0 and in_flight(index(rqst_chn_id)) < tags_min then
+			nxt_reserved := nxt_reserved - 1;
+		end if;
+	end if;
+
+	if give = '1' then
+		in_flight(index(give_chn_id)) <= in_flight(index(give_chn_id)) - 1;
+		nxt_free := nxt_free + 1;
+		if index(give_chn_id) /= 0 and in_flight(index(give_chn_id)) <= tags_min then
+			nxt_reserved := nxt_reserved + 1;
+		end if;
+	end if;
+
+	-- same channel takes and gives a tag in the same cycle
+	if take = '1' and give = '1' and index(rqst_chn_id) = index(give_chn_id) then
+		in_flight(index(give_chn_id)) <= in_flight(index(give_chn_id));
+		nxt_reserved := reserved;
+	end if;
+
+	free     <= nxt_free;
+	reserved <= nxt_reserved;
+
+	if rst = '1' then
+		in_flight <= (others => (others => '0'));
+		free      <= to_unsigned(tags, count_t'length);
+		reserved  <= to_unsigned(channels * tags_min, count_t'length);
+	end if;
+end process;
+
+end architecture;
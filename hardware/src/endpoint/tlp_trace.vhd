@@ -0,0 +1,247 @@
+-- Ring buffer recording the TLP headers passing the endpoint core, read by
+-- the host through the config channel (see cfg_channel_types).
+--
+-- Every entry holds four DWords:
+--   DW 0: timestamp, bits 31:0
+--   DW 1: bits 15:0 timestamp bits 47:32, bits 27:24 inputs of the
+--         tx_tlp_mux waiting when an FPGA to host TLP was sent
+--         (int, cfg, rx, tx from bit 27 down), bits 31:30 direction
+--         (01 host to FPGA, 10 FPGA to host)
+--   DW 2: header DWord 0 (descriptor, length, tag, channel id)
+--   DW 3: header DWord 1 of completions (byte count), the lower address
+--         DWord of requests
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.pcie.all;
+use work.transceiver_128bit_types.all;
+use work.cfg_channel_types.all;
+
+entity tlp_trace is
+	generic(depth: positive := 1024);
+	port(
+		clk : in  std_ulogic;
+		rst : in  std_ulogic;
+
+		timestamp : in unsigned(63 downto 0);
+
+		-- observed TLPs from the host
+		rx     : in fragment;
+		rx_vld : in std_ulogic;
+		rx_req : in std_ulogic;
+
+		-- observed TLPs to the host and the inputs waiting for the tx_tlp_mux
+		tx         : in fragment;
+		tx_vld     : in std_ulogic;
+		tx_req     : in std_ulogic;
+		tx_waiting : in std_ulogic_vector(3 downto 0);
+
+		ctrl   : in  trace_control;
+		status : out trace_state := default_trace_state
+	);
+end tlp_trace;
+
+architecture arch of tlp_trace is
+	function log2(n: positive) return natural is
+		variable ret: natural := 0;
+	begin
+		while 2**ret < n loop
+			ret := ret + 1;
+		end loop;
+		return ret;
+	end function;
+
+	subtype entry_t is std_ulogic_vector(127 downto 0);
+	type entry_vector is array (0 to depth-1) of entry_t;
+	signal mem : entry_vector;
+
+	signal wr      : unsigned(log2(depth)-1 downto 0) := (others => '0');
+	signal entries : natural range 0 to depth := 0;
+	signal held    : entry_t;
+	signal held_vld : std_ulogic := '0';
+	signal post_left : unsigned(15 downto 0) := (others => '0');
+
+	-- read position relative to the oldest entry and DWord of the entry
+	signal rd    : natural range 0 to depth-1 := 0;
+	signal rd_dw : natural range 0 to 3 := 0;
+	signal word  : entry_t;
+
+	function make_entry(
+		dir: std_ulogic_vector(1 downto 0); ts: unsigned(63 downto 0);
+		pkt: fragment; waiting: std_ulogic_vector(3 downto 0)
+	) return entry_t is
+		variable ret: entry_t := (others => '0');
+	begin
+		ret( 31 downto   0) := std_ulogic_vector(ts(31 downto 0));
+		ret( 47 downto  32) := std_ulogic_vector(ts(47 downto 32));
+		ret( 59 downto  56) := waiting;
+		ret( 63 downto  62) := dir;
+		ret( 95 downto  64) := get_dword(pkt, 0);
+		if get_type(pkt) = CplD_desc then
+			ret(127 downto 96) := get_dword(pkt, 1);
+		elsif is_64bit_rqst(pkt) then
+			ret(127 downto 96) := get_dword(pkt, 3);
+		else
+			ret(127 downto 96) := get_dword(pkt, 2);
+		end if;
+		return ret;
+	end function;
+
+	-- filter and trigger share the layout of the lower 16 bits
+	function selects(
+		sel: std_ulogic_vector(31 downto 0); dir: natural; pkt: fragment
+	) return boolean is
+	begin
+		return sel(dir) = '1' and
+		       (sel(2) = '0' or to_common_dw0(get_dword(pkt, 0)).chn_id = sel(15 downto 8));
+	end function;
+
+	function recorded(filter: std_ulogic_vector(31 downto 0); dir: natural; pkt: fragment) return boolean is
+	begin
+		return selects(filter, dir, pkt) and
+		       filter(16 + to_integer(unsigned(get_type(pkt)))) = '1';
+	end function;
+
+	function triggers(trigger: std_ulogic_vector(31 downto 0); dir: natural; pkt: fragment) return boolean is
+	begin
+		return selects(trigger, dir, pkt) and
+		       (trigger(3) = '0' or get_type(pkt) = trigger(19 downto 16));
+	end function;
+
+begin
+
+assert 2**log2(depth) = depth and depth <= 32768
+	report "tlp_trace depth has to be a power of two up to 32768"
+	severity failure;
+
+status.depth_log2 <= to_unsigned(log2(depth), 5);
+status.entries    <= to_unsigned(entries, 16);
+
+main: process
+	variable rx_hit, tx_hit, trig, write: boolean;
+	variable rx_entry, tx_entry, entry: entry_t;
+	variable oldest: unsigned(wr'range);
+begin
+	wait until rising_edge(clk);
+
+	rx_hit := rx_vld = '1' and rx_req = '1' and rx.sof = '1';
+	tx_hit := tx_vld = '1' and tx_req = '1' and tx.sof = '1';
+	trig := (rx_hit and triggers(ctrl.trigger, 0, rx)) or
+	        (tx_hit and triggers(ctrl.trigger, 1, tx));
+	rx_hit := rx_hit and recorded(ctrl.filter, 0, rx);
+	tx_hit := tx_hit and recorded(ctrl.filter, 1, tx);
+	rx_entry := make_entry("01", timestamp, rx, "0000");
+	tx_entry := make_entry("10", timestamp, tx, tx_waiting);
+
+	-- one entry is written per cycle, the next one is held back and a
+	-- third one is lost
+	write := false;
+	if status.recording = '1' and not (status.triggered = '1' and post_left = 0) then
+		if held_vld = '1' then
+			entry := held;
+			write := true;
+			held_vld <= '0';
+			if rx_hit then
+				held <= rx_entry;
+				held_vld <= '1';
+			end if;
+			if tx_hit then
+				if rx_hit then
+					status.lost <= '1';
+				else
+					held <= tx_entry;
+					held_vld <= '1';
+				end if;
+			end if;
+		elsif rx_hit then
+			entry := rx_entry;
+			write := true;
+			if tx_hit then
+				held <= tx_entry;
+				held_vld <= '1';
+			end if;
+		elsif tx_hit then
+			entry := tx_entry;
+			write := true;
+		end if;
+
+		if trig and status.triggered = '0' then
+			status.triggered <= '1';
+			post_left <= ctrl.post;
+		end if;
+	end if;
+
+	if write then
+		mem(to_integer(wr)) <= entry;
+		wr <= wr + 1;
+		if entries = depth then
+			status.wrapped <= '1';
+		else
+			entries <= entries + 1;
+		end if;
+		if status.triggered = '1' then
+			post_left <= post_left - 1;
+		end if;
+	end if;
+
+	-- the entry of the trigger is followed by ctrl.post entries
+	if status.triggered = '1' and (post_left = 0 or (write and post_left = 1)) then
+		status.recording <= '0';
+		held_vld <= '0';
+	end if;
+
+	-- reading, only while stopped
+	oldest := wr - to_unsigned(entries mod depth, wr'length);
+	word <= mem(to_integer(oldest + rd));
+	status.data <= word(32*rd_dw+31 downto 32*rd_dw);
+	if status.recording = '1' then
+		status.data <= (others => '0');
+	end if;
+
+	if ctrl.read = '1' and status.recording = '0' then
+		if rd_dw = 3 then
+			rd_dw <= 0;
+			if rd + 1 >= entries then
+				rd <= 0;
+			else
+				rd <= rd + 1;
+			end if;
+		else
+			rd_dw <= rd_dw + 1;
+		end if;
+	end if;
+
+	if ctrl.stop = '1' then
+		status.recording <= '0';
+		held_vld <= '0';
+		rd <= 0;
+		rd_dw <= 0;
+	end if;
+
+	if ctrl.arm = '1' then
+		status.recording <= '1';
+		status.triggered <= '0';
+		status.wrapped <= '0';
+		status.lost <= '0';
+		held_vld <= '0';
+		wr <= (others => '0');
+		entries <= 0;
+		rd <= 0;
+		rd_dw <= 0;
+	end if;
+
+	if rst = '1' then
+		status.recording <= '0';
+		status.triggered <= '0';
+		status.wrapped <= '0';
+		status.lost <= '0';
+		held_vld <= '0';
+		wr <= (others => '0');
+		entries <= 0;
+		rd <= 0;
+		rd_dw <= 0;
+	end if;
+end process;
+
+end architecture;
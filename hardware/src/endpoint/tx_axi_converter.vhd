@@ -51,6 +51,8 @@ architecture arch of tx_axi_converter is
 	begin
 		ret.dw0.fmt_type          := desc_to_fmtType(data.dw0.desc);
 		ret.dw0.length            := data.dw0.length;
+		ret.dw0.attr              := data.dw0.attr;
+		ret.dw0.th                := data.dw1.th;
 		ret.dw1.first_byte_enable := data.dw1.first_be;
 		ret.dw1.last_byte_enable  := data.dw1.last_be;
 		ret.dw1.requester_id      := Core_ID;
@@ -66,6 +68,8 @@ architecture arch of tx_axi_converter is
 	begin
 		ret.dw0.fmt_type      := desc_to_fmtType(data.dw0.desc);
 		ret.dw0.length        := data.dw0.length;
+		ret.dw0.attr          := ATTR_DEFAULT;
+		ret.dw0.th            := '0';
 		ret.dw1.byte_count    := data.dw1.byte_count;
 		ret.dw1.completer_id  := Core_ID;
 		ret.dw2.lower_address := data.dw2.lower_addr;
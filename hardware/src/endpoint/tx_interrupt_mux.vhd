@@ -3,6 +3,7 @@ use IEEE.std_logic_1164.ALL;
 use IEEE.NUMERIC_STD.ALL;
 use work.pcie.all;
 use work.transceiver_128bit_types.all;
+use work.cfg_channel_types.all;
 
 entity tx_interrupt_mux is
 	port(
@@ -22,7 +23,11 @@ entity tx_interrupt_mux is
 		-- output port "o"
 		o_vld  : out std_logic := '0';
 		o_req  : in  std_logic;
-		o      : out fragment := default_fragment
+		o      : out fragment := default_fragment;
+
+		-- INT_PRIO_ALTERNATE alternates the priority after every interrupt,
+		-- INT_PRIO_RX/INT_PRIO_TX always prefer one direction
+		mode   : in  int_prio_t := INT_PRIO_ALTERNATE
 	);
 end tx_interrupt_mux;
 
@@ -30,14 +35,19 @@ architecture arch of tx_interrupt_mux is
 
 	type state_t is (PRIORITY_RX, PRIORITY_TX);
 	signal state : state_t := PRIORITY_RX;
+	signal prio  : state_t;
 
 begin
 
+	prio <= PRIORITY_RX when mode = INT_PRIO_RX else
+	        PRIORITY_TX when mode = INT_PRIO_TX else
+	        state;
+
 	host_rx_req <= '1' when host_rx.sof = '0' or host_rx_vld = '0' or get_type(host_rx) /= MSIX_desc else
-			 '0' when state = PRIORITY_TX and host_tx.sof = '1' and host_tx_vld = '1' and get_type(host_tx) = MSIX_desc else o_req;
+			 '0' when prio = PRIORITY_TX and host_tx.sof = '1' and host_tx_vld = '1' and get_type(host_tx) = MSIX_desc else o_req;
 
 	host_tx_req <= '1' when host_tx.sof = '0' or host_tx_vld = '0' or get_type(host_tx) /= MSIX_desc else
-			 '0' when state = PRIORITY_RX and host_rx.sof = '1' and host_rx_vld = '1' and get_type(host_rx) = MSIX_desc else o_req;
+			 '0' when prio = PRIORITY_RX and host_rx.sof = '1' and host_rx_vld = '1' and get_type(host_rx) = MSIX_desc else o_req;
 
 	process(clk)
 	begin
@@ -45,7 +55,7 @@ begin
 
 			if o_req = '1' then
 
-				case state is
+				case prio is
 
 				when PRIORITY_RX =>
 
@@ -11,7 +11,6 @@ use work.pcie.all;
 
 use work.fpga_filter_pkg.all;
 use work.fpga_rx_cfg_ctrl_types.all;
-use work.fpga_rx_tag_types.all;
 
 use work.utils.all;
 
@@ -19,7 +18,10 @@ entity fpga_rx_channel is
 	generic(
 		config         : transceiver_configuration;
 		id             : positive;
-		fifo_addr_bits : positive := 9
+		fifo_addr_bits : positive := 9;
+		-- granularity of the FIFO space granted to the sender, 0 selects
+		-- a quarter of the FIFO but at least one max. payload
+		credit_bytes   : natural := 0
 	);
 	port(
 		clk         : in  std_logic;
@@ -38,6 +40,14 @@ end entity;
 
 
 architecture arch of fpga_rx_channel is
+	function credit_size return positive is
+	begin
+		if credit_bytes /= 0 then
+			return credit_bytes;
+		end if;
+		return maximum(config.max_payload_bytes, (2**fifo_addr_bits)*16/4);
+	end function;
+
 	signal cfg: filter_packet;
 	signal cfg_vld: std_logic;
 
@@ -46,8 +56,8 @@ architecture arch of fpga_rx_channel is
 
 	signal fpga_rx_config: fpga_rx_config_t;
 
-	signal tag: rqst_tag_t;
-	signal tag_req, tag_vld: std_logic;
+	signal credit: u32;
+	signal credit_req, credit_vld: std_logic;
 
 	signal fifo_rst: std_logic := '0';
 	
@@ -78,37 +88,37 @@ port map(
 
 write_rqst: entity work.fpga_rx_rqst
 generic map(
-	id             => id,
-	fifo_addr_bits => fifo_addr_bits
+	id => id
 )
 port map(
-	clk     => clk,
-	cfg     => fpga_rx_config,
-	o       => to_ep,
-	o_vld   => to_ep_vld,
-	o_req   => to_ep_req,
-	tag     => tag,
-	tag_vld => tag_vld,
-	tag_req => tag_req
+	clk        => clk,
+	cfg        => fpga_rx_config,
+	o          => to_ep,
+	o_vld      => to_ep_vld,
+	o_req      => to_ep_req,
+	credit     => credit,
+	credit_vld => credit_vld,
+	credit_req => credit_req
 );
 
 fifo: entity work.fpga_rx_fifo
 generic map(
-	fifo_addr_bits => fifo_addr_bits
+	fifo_addr_bits => fifo_addr_bits,
+	credit_bytes   => credit_size
 )
 port map(
-	clk     => clk,
-	rst     => fifo_rst,
-	i       => data,
-	i_vld   => data_vld,
-	i_req   => data_req,
-	o       => o.payload,
-	o_keep  => keep_to_cnt,
-	o_vld   => o_vld,
-	o_req   => o_req,
-	tag     => tag,
-	tag_vld => tag_vld,
-	tag_req => tag_req
+	clk        => clk,
+	rst        => fifo_rst,
+	i          => data,
+	i_vld      => data_vld,
+	i_req      => data_req,
+	o          => o.payload,
+	o_keep     => keep_to_cnt,
+	o_vld      => o_vld,
+	o_req      => o_req,
+	credit     => credit,
+	credit_vld => credit_vld,
+	credit_req => credit_req
 );
 
 fifo_rst <= '1' when fpga_rx_config.target /= TARGET_FPGA else '0';
@@ -17,7 +17,8 @@ entity fpga_tx_channel is
 	generic(
 		config         : transceiver_configuration;
 		id             : positive;
-		fifo_addr_bits : positive := 9
+		fifo_addr_bits : positive := 9;
+		max_peers      : positive := 1
 	);
 	port(
 		clk         : in  std_logic;
@@ -73,7 +74,8 @@ port map(
 ctrl: entity work.fpga_tx_ctrl
 generic map(
 	max_payload_bytes => config.max_payload_bytes,
-	id => id)
+	id => id,
+	max_peers => max_peers)
 port map(
 	clk      => clk,
 	cfg      => filtered,
@@ -1,10 +1,6 @@
--- Buffer data and generate read tags
+-- Buffer data and grant its free space to the sender
 -- Author: Sebastian Schüller <schuell1@cs.uni-bonn.de>
 
-package fpga_rx_tag_types is
-	type rqst_tag_t is (READ_FULL, READ_HALF);
-end package;
-
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
@@ -13,10 +9,12 @@ use work.pcie.all;
 use work.transceiver_128bit_types.all;
 use work.host_types.all;
 
-use work.fpga_rx_tag_types.all;
-
 entity fpga_rx_fifo is
-generic(fifo_addr_bits: positive);
+generic(
+	fifo_addr_bits: positive;
+	-- space freed by the user logic is granted in multiples of this,
+	-- must be a multiple of 16
+	credit_bytes: positive);
 port(
 	clk: in std_logic;
 	rst: in std_logic;
@@ -30,9 +28,11 @@ port(
 	o_vld:  out std_logic := '0';
 	o_req:  in  std_logic;
 
-	tag:     out rqst_tag_t := READ_FULL;
-	tag_vld: out std_logic := '0';
-	tag_req: in  std_logic);
+	-- bytes the sender may write in addition to the ones granted before,
+	-- the whole FIFO after a reset
+	credit:     out u32 := (others => '0');
+	credit_vld: out std_logic := '0';
+	credit_req: in  std_logic);
 end entity;
 
 
@@ -41,30 +41,48 @@ architecture arch of fpga_rx_fifo is
 	signal packed_keep: nibble := (others => '0');
 	signal packed_vld, packed_req:  std_logic;
 
+	constant fifo_bytes: positive := (2**fifo_addr_bits)*16;
+
+	-- a chunk of credit_bytes was read by the user logic
 	signal overflow: std_logic := '0';
-	signal full_tag, half_tag: boolean := false;
+
+	-- chunks freed but not granted yet, they add up while a grant waits
+	-- for the link, so no space is lost and the grants stay large
+	signal pending: natural range 0 to fifo_bytes/credit_bytes := 0;
+	signal initial: boolean := true;
 begin
 
+assert credit_bytes mod 16 = 0 and credit_bytes <= fifo_bytes/2
+	report "credit_bytes must be a multiple of 16 and at most half the FIFO"
+	severity failure;
 
-tag_gen: process
+credit_gen: process
+	variable chunks: natural range 0 to fifo_bytes/credit_bytes;
 begin
 	wait until rising_edge(clk);
 
-	half_tag <= true when overflow;
-
-	if tag_req then
-		tag <= READ_FULL when full_tag else
-		       READ_HALF;
-		tag_vld <= '1' when full_tag or half_tag else
-		           '0';
-		half_tag <= false when half_tag and not full_tag;
-		full_tag <= false;
+	chunks := pending + 1 when overflow else pending;
+
+	if credit_req then
+		credit_vld <= '0';
+		if initial then
+			-- one entry is kept free for the data in the repacker
+			credit     <= to_unsigned(fifo_bytes - 16, 32);
+			credit_vld <= '1';
+			initial    <= false;
+		elsif chunks /= 0 then
+			credit     <= to_unsigned(chunks * credit_bytes, 32);
+			credit_vld <= '1';
+			chunks     := 0;
+		end if;
 	end if;
 
+	pending <= chunks;
+
 	if rst then
-		tag_vld <= '0';
-		half_tag <= false;
-		full_tag <= true;
+		credit_vld <= '0';
+		pending    <= 0;
+		initial    <= true;
 	end if;
 end process;
 
@@ -99,7 +117,7 @@ port map(
 
 cnt: entity work.receiver_output_count
 generic map(
-	max_count => ((2**fifo_addr_bits)/2)
+	max_count => credit_bytes/16
 )
 port map(
 	clk      => clk,
@@ -9,13 +9,13 @@ use work.pcie.all;
 use work.transceiver_128bit_types.all;
 use work.host_types.all;
 use work.fpga_rx_cfg_ctrl_types.all;
-use work.fpga_rx_tag_types.all;
 
 
+-- Grants FIFO space to the sender with a posted write of the credit to
+-- the sender's size register, the sender adds up the grants.
 entity fpga_rx_rqst is
 generic(
-	id: natural;
-	fifo_addr_bits: positive
+	id: natural
 );
 port(
 	clk: in std_logic;
@@ -26,22 +26,16 @@ port(
 	o_vld: out std_logic := '0';
 	o_req: in  std_logic;
 
-	tag:     in  rqst_tag_t;
-	tag_vld: in  std_logic;
-	tag_req: out std_logic);
+	credit:     in  u32;
+	credit_vld: in  std_logic;
+	credit_req: out std_logic);
 end entity;
 
 
 architecture arch of fpga_rx_rqst is
-	constant fifo_size: positive := 2**fifo_addr_bits;
-
-	signal size: u32 := (others => '0');
 begin
 
-size <= to_unsigned((fifo_size*16),32) - 16 when tag = READ_FULL else
-        to_unsigned(((fifo_size/2)*16),32) when tag = READ_HALF;
-
-tag_req <= not tag_vld or o_req;
+credit_req <= not credit_vld or o_req;
 
 process
 begin
@@ -50,14 +44,14 @@ begin
 	if o_req then
 		o_vld <= '0';
 		reset(o);
-		if tag_vld = '1' and cfg.target = TARGET_FPGA then
+		if credit_vld = '1' and cfg.target = TARGET_FPGA then
 			o_vld <= '1';
 			set_rqst32_header(o, make_wr_rqst32(
 				length => 1,
 				chn_id => id,
 				address => std_logic_vector(cfg.addr)
 			));
-			set_dw(o, 3, std_logic_vector(size));
+			set_dw(o, 3, std_logic_vector(credit));
 		end if;
 	end if;
 
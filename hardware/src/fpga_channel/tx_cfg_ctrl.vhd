@@ -10,6 +10,7 @@ use work.fpga_filter_pkg.all;
 use work.sender_cfg_ctrl_types.all;
 
 entity sender_cfg_ctrl is
+generic(max_peers: positive range 1 to max_fpga_peers := 1);
 port(
 	clk: in std_logic;
 
@@ -20,12 +21,32 @@ port(
 	cfg: out fpga_tx_config_t := init_config);
 end entity;
 
+-- Registers (offset in the channel's BAR0 window):
+--   0: address of the peer selected in 6, peer 0 is also the target of
+--      unicast transfers
+--   1: upper address half, host targets only
+--   2: granted bytes of peer 0, the same as 8
+--   3: target mode, 0 host, 1 FPGA
+--   4: read to request the number of transferred bytes
+--   5: number of peers, more than one enables multicast
+--   6: peer selected for register 0
+--   8 to 15: granted bytes of peer 0 to 7
 architecture arch of sender_cfg_ctrl is
+	type credit_vector is array (0 to max_peers-1) of u32;
+
+	-- bytes granted by every peer and passed on to the sender since the
+	-- peers were set, a multicast only sends what all peers granted
+	signal granted: credit_vector := (others => (others => '0'));
+	signal released: u32 := (others => '0');
+
+	signal peer_sel: natural range 0 to max_peers-1 := 0;
 begin
 
 
 i_req <= '1';
 process
+	variable peer: natural range 0 to 15;
+	variable avail, min_avail: u32;
 begin
 	wait until rising_edge(clk);
 
@@ -33,16 +54,37 @@ begin
 	cfg.size_bytes   <= resize("0", 32);
 	cfg.trigger_cpld <= false;
 
+	if cfg.peers > 1 then
+		min_avail := granted(0) - released;
+		for idx in 1 to max_peers-1 loop
+			avail := granted(idx) - released;
+			if idx < cfg.peers and avail < min_avail then
+				min_avail := avail;
+			end if;
+		end loop;
+		cfg.size_bytes <= min_avail;
+		released       <= released + min_avail;
+	end if;
+
 	if i_vld = '1' then
+		peer := to_integer(i.address(2 downto 0)) when i.address(3) = '1' else 0;
+
 		case i.address is
 		when x"0" =>
-			cfg.addr(31 downto 0) <= i.payload;
-			cfg.addr_mode <= ADDR_32BIT;
+			cfg.peer_addr(peer_sel) <= i.payload;
+			if peer_sel = 0 then
+				cfg.addr(31 downto 0) <= i.payload;
+				cfg.addr_mode <= ADDR_32BIT;
+			end if;
 		when x"1" =>
 			cfg.addr(63 downto 32) <= i.payload;
 			cfg.addr_mode <= ADDR_64BIT;
-		when x"2" =>
-			cfg.size_bytes <= i.payload;
+		when x"2" | x"8" =>
+			if cfg.peers > 1 then
+				granted(0) <= granted(0) + i.payload;
+			else
+				cfg.size_bytes <= i.payload;
+			end if;
 		when x"3" =>
 			cfg.target    <= TARGET_FPGA when i.payload /= 0 else
 			                 TARGET_HOST;
@@ -51,7 +93,19 @@ begin
 			cfg.trigger_cpld <= true;
 			cfg.cpld_tag     <= i.payload(7 downto 0);
 			cfg.cpld_offs    <= to_unsigned(4, 8);
-		when others => null;
+		when x"5" =>
+			cfg.peers <= max_peers when i.payload > max_peers else
+			             to_integer(i.payload);
+			granted   <= (others => (others => '0'));
+			released  <= (others => '0');
+		when x"6" =>
+			if i.payload < max_peers then
+				peer_sel <= to_integer(i.payload);
+			end if;
+		when others =>
+			if i.address(3) = '1' and peer < max_peers then
+				granted(peer) <= granted(peer) + i.payload;
+			end if;
 		end case;
 	end if;
 end process;
@@ -10,6 +10,10 @@ package sender_cfg_ctrl_types is
 	type target_mode_t is (TARGET_FPGA, TARGET_HOST);
 	type addr_mode_t is (ADDR_32BIT, ADDR_64BIT);
 
+	-- upper bound of peers a channel can multicast to, see sender_cfg_ctrl
+	constant max_fpga_peers: positive := 8;
+	type peer_addr_vector is array (0 to max_fpga_peers-1) of u32;
+
 	type fpga_tx_config_t is record
 		target: target_mode_t;
 		trigger_cpld: boolean;
@@ -18,6 +22,9 @@ package sender_cfg_ctrl_types is
 		size_bytes: u32;
 		cpld_tag: u8;
 		cpld_offs: u8;
+		-- multicast if more than one, peer 0 is addr
+		peers: natural range 0 to max_fpga_peers;
+		peer_addr: peer_addr_vector;
 	end record;
 	constant init_config: fpga_tx_config_t := (
 		target => TARGET_HOST,
@@ -26,7 +33,9 @@ package sender_cfg_ctrl_types is
 		addr => (others => '0'),
 		size_bytes => (others => '0'),
 		cpld_tag => (others => '0'),
-		cpld_offs => (others => '0')
+		cpld_offs => (others => '0'),
+		peers => 0,
+		peer_addr => (others => (others => '0'))
 	);
 end package;
 
@@ -17,7 +17,8 @@ use work.sender_cfg_ctrl_types.all;
 entity fpga_tx_ctrl is
 generic(
 	max_payload_bytes: positive := 256;
-	id: positive := 1);
+	id: positive := 1;
+	max_peers: positive := 1);
 port(
 	clk: in std_logic;
 
@@ -40,9 +41,9 @@ architecture arch of fpga_tx_ctrl is
 
 	signal config: fpga_tx_config_t := init_config;
 
-	signal cpld_packet, data_packet: fragment := default_fragment;
-	signal cpld_vld, data_vld: std_logic := '0';
-	signal cpld_req, data_req: std_logic := '1';
+	signal cpld_packet, data_packet, packed: fragment := default_fragment;
+	signal cpld_vld, data_vld, packed_vld: std_logic := '0';
+	signal cpld_req, data_req, packed_req: std_logic := '1';
 
 	signal transferred_bytes: u32 := (others => '0');
 begin
@@ -61,6 +62,7 @@ begin
 	end process;
 
 	ctrl: entity work.sender_cfg_ctrl
+	generic map(max_peers => max_peers)
 	port map(
 		clk => clk,
 		i     => cfg,
@@ -91,10 +93,33 @@ begin
 		status => status,
 		cfg => config,
 
-		o => data_packet,
-		o_vld => data_vld,
-		o_req => data_req,
+		o => packed,
+		o_vld => packed_vld,
+		o_req => packed_req,
 
 		transferred => transferred_bytes
 	);
+
+	unicast: if max_peers = 1 generate
+		data_packet <= packed;
+		data_vld    <= packed_vld;
+		packed_req  <= data_req;
+	end generate;
+
+	multicast: if max_peers > 1 generate
+		replicate: entity work.fpga_tx_multicast
+		generic map(max_payload_bytes => max_payload_bytes)
+		port map(
+			clk => clk,
+			cfg => config,
+
+			i => packed,
+			i_vld => packed_vld,
+			i_req => packed_req,
+
+			o => data_packet,
+			o_vld => data_vld,
+			o_req => data_req
+		);
+	end generate;
 end architecture;
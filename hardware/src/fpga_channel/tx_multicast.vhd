@@ -0,0 +1,94 @@
+-- Replicate write requests to all peers of a multicast
+--
+-- Each TLP of the sender is stored and sent once per peer, the address of
+-- every copy is replaced by the address of its peer. With less than two
+-- peers the TLPs are passed through.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+use work.pcie.all;
+use work.transceiver_128bit_types.all;
+use work.sender_cfg_ctrl_types.all;
+
+entity fpga_tx_multicast is
+generic(max_payload_bytes: positive := 256);
+port(
+	clk: in std_logic;
+
+	cfg: in fpga_tx_config_t;
+
+	i:     in  fragment;
+	i_vld: in  std_logic;
+	i_req: out std_logic := '1';
+
+	o:     out fragment;
+	o_vld: out std_logic := '0';
+	o_req: in  std_logic);
+end entity;
+
+
+architecture arch of fpga_tx_multicast is
+	-- header and payload of the largest write request
+	constant depth: positive := max_payload_bytes/16 + 1;
+	type mem_t is array (0 to depth-1) of fragment;
+	signal mem: mem_t;
+
+	type state_t is (FILL, SEND);
+	signal state: state_t := FILL;
+
+	signal wr_ptr, rd_ptr, last: natural range 0 to depth-1 := 0;
+	signal copy: natural range 0 to max_fpga_peers-1 := 0;
+begin
+
+output: process(cfg, i, i_vld, o_req, mem, rd_ptr, copy, state)
+begin
+	if cfg.peers <= 1 then
+		o     <= i;
+		o_vld <= i_vld;
+		i_req <= o_req;
+	else
+		o <= mem(rd_ptr);
+		if rd_ptr = 0 then
+			o.data(95 downto 64) <= std_logic_vector(cfg.peer_addr(copy));
+		end if;
+		o_vld <= '1' when state = SEND else '0';
+		i_req <= '1' when state = FILL else '0';
+	end if;
+end process;
+
+main: process
+begin
+	wait until rising_edge(clk);
+
+	case state is
+	when FILL =>
+		if cfg.peers > 1 and i_vld = '1' then
+			mem(wr_ptr) <= i;
+			if i.eof = '1' then
+				wr_ptr <= 0;
+				last   <= wr_ptr;
+				rd_ptr <= 0;
+				copy   <= 0;
+				state  <= SEND;
+			else
+				wr_ptr <= wr_ptr + 1;
+			end if;
+		end if;
+
+	when SEND =>
+		if o_req = '1' then
+			if rd_ptr /= last then
+				rd_ptr <= rd_ptr + 1;
+			elsif copy < cfg.peers - 1 then
+				rd_ptr <= 0;
+				copy   <= copy + 1;
+			else
+				state  <= FILL;
+			end if;
+		end if;
+	end case;
+end process;
+
+end architecture;
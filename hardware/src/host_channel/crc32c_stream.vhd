@@ -0,0 +1,85 @@
+---------------------------------------------------------------------------------------------------
+-- Description: CRC32C (Castagnoli) over the valid bytes of a stream of 128 bit words.
+--              Bytes are taken in host memory order, starting with the lowest byte of
+--              DWORD 0. A word carries `cnt` DWORDs, the last one only `last_bytes`
+--              bytes if `last_bytes` is not 0 (see tx_stream / rx_stream).
+--              `clear` starts a new checksum, `bytes` counts the bytes since then.
+---------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity crc32c_stream is
+	port(
+		clk : in  std_logic;
+
+		clear : in  std_logic;
+
+		-- word is consumed by the stream sink
+		i_vld        : in  std_logic;
+		i_data       : in  std_ulogic_vector(127 downto 0);
+		i_cnt        : in  unsigned(2 downto 0);
+		i_last_bytes : in  unsigned(1 downto 0);
+
+		crc   : out std_logic_vector(31 downto 0);
+		bytes : out unsigned(31 downto 0) := (others => '0')
+	);
+end crc32c_stream;
+
+architecture arch of crc32c_stream is
+
+	-- reflected polynomial 0x1EDC6F41
+	constant POLY : std_logic_vector(31 downto 0) := x"82F63B78";
+
+	function crc_byte(crc_in: std_logic_vector(31 downto 0); data: std_ulogic_vector(7 downto 0))
+		return std_logic_vector is
+		variable ret : std_logic_vector(31 downto 0) := crc_in;
+	begin
+		ret(7 downto 0) := ret(7 downto 0) xor data;
+		for i in 0 to 7 loop
+			if ret(0) = '1' then
+				ret := ('0' & ret(31 downto 1)) xor POLY;
+			else
+				ret := '0' & ret(31 downto 1);
+			end if;
+		end loop;
+		return ret;
+	end crc_byte;
+
+	signal state : std_logic_vector(31 downto 0) := (others => '1');
+
+begin
+
+crc <= not state;
+
+main: process
+	variable next_state : std_logic_vector(31 downto 0);
+	variable valid      : unsigned(4 downto 0);
+begin
+	wait until rising_edge(clk);
+
+	if i_vld = '1' then
+		valid := i_cnt & "00";
+		if i_cnt /= 0 and i_last_bytes /= 0 then
+			valid := valid - 4 + i_last_bytes;
+		end if;
+
+		next_state := state;
+		for b in 0 to 15 loop
+			if b < valid then
+				next_state := crc_byte(next_state, i_data(8*b+7 downto 8*b));
+			end if;
+		end loop;
+
+		state <= next_state;
+		bytes <= bytes + valid;
+	end if;
+
+	if clear = '1' then
+		state <= (others => '1');
+		bytes <= (others => '0');
+	end if;
+end process;
+
+end architecture;
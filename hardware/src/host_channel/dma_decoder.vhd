@@ -7,7 +7,8 @@ use work.host_channel_types.all;
 
 entity dma_decoder is
 	generic(
-		CHANNEL_ID : natural := 1
+		CHANNEL_ID  : natural := 1;
+		QUEUE_DEPTH : positive := 1
 	);
 	port(
 		-- control signals
@@ -25,13 +26,22 @@ entity dma_decoder is
 		cpl     : out fragment;
 		
 		-- output for decoded instructions
-		-- to requester
+		-- to requester, a transfer is offered once the interrupt handler took
+		-- it and stays queued until the requester takes it as well
 		rq_instr_vld  : out std_logic := '0';
+		rq_instr_req  : in  std_logic;
 		rq_instr      : out requester_instr_t;
 		
 		-- to interrupt_handler
+		-- xfer_vld/xfer_req: next queued transfer, its size and checksum
+		-- setting are held in int_instr until the next one is taken
 		int_instr_vld : out std_logic := '0';
-		int_instr     : out interrupt_instr_t
+		int_instr     : out interrupt_instr_t;
+		xfer_vld      : out std_logic;
+		xfer_req      : in  std_logic;
+
+		-- host aborted the current transfer, the queued ones are dropped
+		abort         : out std_logic
 	);
 end entity dma_decoder;
 
@@ -41,6 +51,21 @@ architecture RTL of dma_decoder is
 	signal rq_tag     : unsigned(7 downto 0);
 	signal rq_type    : request_t;
 	signal rq_vld     : std_logic;
+
+	signal desc_vld   : std_logic;
+	signal desc       : requester_instr_t;
+	signal head_vld   : std_logic;
+	signal head       : requester_instr_t;
+	signal instr      : interrupt_instr_t;
+	signal dma_size   : unsigned(31 downto 0) := (others => '0');
+	signal crc_en     : std_logic := '0';
+	signal queue_full : std_logic;
+	signal overflow   : std_logic;
+	signal abort_i    : std_logic;
+	signal queue_rst  : std_logic;
+	-- the head was handed to the interrupt handler, not to the requester yet
+	signal handed     : std_logic := '0';
+	signal head_req   : std_logic;
 begin
 	
 filter: entity work.dma_decoder_filter
@@ -75,10 +100,64 @@ instructor: entity work.dma_decoder_instructor
 		rq_tag        => rq_tag,
 		rq_payload    => rq_payload,
 		rq_addr       => rq_addr,
-		rq_instr_vld  => rq_instr_vld,
-		rq_instr      => rq_instr,
+		rq_instr_vld  => desc_vld,
+		rq_instr      => desc,
 		int_instr_vld => int_instr_vld,
-		int_instr     => int_instr 
+		int_instr     => instr,
+		abort         => abort_i
 	);
 
+abort     <= abort_i;
+queue_rst <= rst_in or abort_i;
+
+queue: entity work.dma_descriptor_queue
+	generic map(
+		depth => QUEUE_DEPTH
+	)
+	port map(
+		clk      => clk,
+		rst      => queue_rst,
+		i_vld    => desc_vld,
+		i        => desc,
+		full     => queue_full,
+		overflow => overflow,
+		o_vld    => head_vld,
+		o_req    => head_req,
+		o        => head
+	);
+
+xfer_vld     <= head_vld and not handed;
+rq_instr_vld <= head_vld and handed;
+rq_instr     <= head;
+head_req     <= handed and rq_instr_req;
+
+int_instr <= (
+	instr       => instr.instr,
+	dma_size    => dma_size,
+	cpl_tag     => instr.cpl_tag,
+	cpl_lo_addr => instr.cpl_lo_addr,
+	crc_en      => crc_en,
+	deadline    => instr.deadline,
+	queue_full     => queue_full,
+	queue_overflow => overflow
+);
+
+current: process
+begin
+	wait until rising_edge(clk);
+	if head_vld = '1' and handed = '0' and xfer_req = '1' then
+		dma_size <= head.dma_size;
+		crc_en   <= head.crc_en;
+		handed   <= '1';
+	end if;
+	if head_vld = '1' and handed = '1' and rq_instr_req = '1' then
+		handed   <= '0';
+	end if;
+
+	-- the queue is dropped with the head
+	if queue_rst = '1' then
+		handed   <= '0';
+	end if;
+end process;
+
 end architecture RTL;
@@ -3,7 +3,9 @@
 -- Company:		University Bonn
 
 -- Date:
--- Description: decodes host instructions from parsed memory requests
+-- Description: decodes host instructions from parsed memory requests,
+--              transfers go to the requester (through the descriptor queue),
+--              register reads to the interrupt handler
 -- Version: 	0.1
 ---------------------------------------------------------------------------------------------------
 
@@ -37,7 +39,10 @@ entity dma_decoder_instructor is
 
 		-- to interrupt_handler
 		int_instr_vld : out std_logic := '0';
-		int_instr     : out interrupt_instr_t
+		int_instr     : out interrupt_instr_t;
+
+		-- host wrote ABORT_REG, active for one clock cycle
+		abort         : out std_logic := '0'
 	);
 end entity dma_decoder_instructor;
 
@@ -50,28 +55,41 @@ signal dma_addr    : unsigned(63 downto 0) := (others => '0');
 signal dma_size    : unsigned(31 downto 0) := (others => '0');
 signal cpl_tag     : unsigned( 7 downto 0) := (others => '0');
 signal cpl_lo_addr : std_logic_vector(6 downto 0) := (others => '0');
+signal options     : tlp_options_t := default_tlp_options;
+signal max_bytes   : tlp_bytes_t := (others => '0');
+signal crc_en      : std_logic := '0';
+signal deadline    : unsigned(31 downto 0) := (others => '0');
 
 signal instr_vld   : std_logic := '0';
 
 begin
 
-rq_instr_vld  <= instr_vld;
-int_instr_vld <= instr_vld;
+rq_instr_vld  <= instr_vld when instruction = TRANSFER_DMA32 or instruction = TRANSFER_DMA64 else '0';
+int_instr_vld <= instr_vld when instruction /= TRANSFER_DMA32 and instruction /= TRANSFER_DMA64 else '0';
 
 rq_instr.instr    <= instruction;
 rq_instr.dma_addr <= dma_addr;
 rq_instr.dma_size <= dma_size;
+rq_instr.options  <= options;
+rq_instr.max_bytes <= max_bytes;
+rq_instr.crc_en   <= crc_en;
 
 int_instr.instr       <= instruction;
 int_instr.dma_size    <= dma_size;
 int_instr.cpl_tag     <= cpl_tag;
 int_instr.cpl_lo_addr <= cpl_lo_addr;
+int_instr.crc_en      <= crc_en;
+int_instr.deadline    <= deadline;
+-- set by dma_decoder, which holds the descriptor queue
+int_instr.queue_full     <= '0';
+int_instr.queue_overflow <= '0';
 
 decode: process
 begin
 	wait until rising_edge(clk);
 
 	instr_vld <= '0';
+	abort     <= '0';
 
 	if rq_vld = '1' then
 		case rq_type is
@@ -89,6 +107,16 @@ begin
 			when BUFFER_SIZE =>
 				dma_size  <= unsigned(rq_payload);
 				instr_vld <= '1';
+			when TLP_ATTR_REG =>
+				options   <= to_tlp_options(rq_payload);
+			when MAX_TLP_REG =>
+				max_bytes <= to_tlp_bytes(rq_payload);
+			when CRC_REG =>
+				crc_en    <= rq_payload(0);
+			when ABORT_REG =>
+				abort     <= '1';
+			when DEADLINE_REG =>
+				deadline  <= unsigned(rq_payload);
 			when others => null;
 			end case;
 
@@ -107,6 +135,36 @@ begin
 				cpl_tag     <= rq_tag;
 				instr_vld   <= '1';
 				cpl_lo_addr <= CHANNEL_ID_SLV(0) & std_logic_vector(rq_addr) & "00";
+			when TS_DOORBELL_REG =>
+				instruction <= GET_TS_DOORBELL;
+				cpl_tag     <= rq_tag;
+				instr_vld   <= '1';
+				cpl_lo_addr <= CHANNEL_ID_SLV(0) & std_logic_vector(rq_addr) & "00";
+			when TS_FIRST_TLP_REG =>
+				instruction <= GET_TS_FIRST_TLP;
+				cpl_tag     <= rq_tag;
+				instr_vld   <= '1';
+				cpl_lo_addr <= CHANNEL_ID_SLV(0) & std_logic_vector(rq_addr) & "00";
+			when TS_LAST_TLP_REG =>
+				instruction <= GET_TS_LAST_TLP;
+				cpl_tag     <= rq_tag;
+				instr_vld   <= '1';
+				cpl_lo_addr <= CHANNEL_ID_SLV(0) & std_logic_vector(rq_addr) & "00";
+			when CRC_REG =>
+				instruction <= GET_CRC;
+				cpl_tag     <= rq_tag;
+				instr_vld   <= '1';
+				cpl_lo_addr <= CHANNEL_ID_SLV(0) & std_logic_vector(rq_addr) & "00";
+			when QUEUE_REG =>
+				instruction <= GET_QUEUE;
+				cpl_tag     <= rq_tag;
+				instr_vld   <= '1';
+				cpl_lo_addr <= CHANNEL_ID_SLV(0) & std_logic_vector(rq_addr) & "00";
+			when ABORT_REG =>
+				instruction <= GET_ABORT;
+				cpl_tag     <= rq_tag;
+				instr_vld   <= '1';
+				cpl_lo_addr <= CHANNEL_ID_SLV(0) & std_logic_vector(rq_addr) & "00";
 			when others => null;
 			end case;
 		end case;
@@ -114,6 +172,11 @@ begin
 
 	if rst = '1' then
 		instr_vld <= '0';
+		abort     <= '0';
+		options   <= default_tlp_options;
+		max_bytes <= (others => '0');
+		crc_en    <= '0';
+		deadline  <= (others => '0');
 	end if;
 end process;
 
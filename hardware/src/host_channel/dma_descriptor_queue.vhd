@@ -0,0 +1,91 @@
+---------------------------------------------------------------------------------------------------
+-- Description: holds the transfers the driver queued in advance.
+--              The head is offered to the channel, which takes it as soon as
+--              the previous transfer is complete, so buffers are chained
+--              without waiting for the driver after each interrupt.
+--              Registers can be written from user space directly, so a
+--              transfer queued while all `depth` entries are taken is
+--              dropped and reported through `overflow` instead.
+---------------------------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.host_channel_types.all;
+
+entity dma_descriptor_queue is
+	generic(
+		depth : positive := 4
+	);
+	port(
+		clk : in std_logic;
+		rst : in std_logic;
+
+		-- new transfer from dma_decoder_instructor
+		-- no req signal: the host can't be stalled, transfers arriving
+		-- while the queue is full are dropped
+		i_vld : in std_logic;
+		i     : in requester_instr_t;
+
+		-- full: all `depth` entries are taken,
+		-- overflow: a transfer was dropped since the reset
+		full     : out std_logic;
+		overflow : out std_logic := '0';
+
+		-- oldest queued transfer
+		o_vld : out std_logic;
+		o_req : in  std_logic;
+		o     : out requester_instr_t
+	);
+end dma_descriptor_queue;
+
+architecture arch of dma_descriptor_queue is
+
+	type mem_t is array (0 to depth-1) of requester_instr_t;
+	signal mem : mem_t;
+
+	signal wr_ptr, rd_ptr : natural range 0 to depth-1 := 0;
+	signal count : natural range 0 to depth := 0;
+
+begin
+
+o_vld <= '1' when count /= 0 else '0';
+full  <= '1' when count = depth else '0';
+o     <= mem(rd_ptr);
+
+main: process
+	variable push, pop : boolean;
+begin
+	wait until rising_edge(clk);
+
+	push := i_vld = '1' and count /= depth;
+	pop  := count /= 0 and o_req = '1';
+
+	if i_vld = '1' and not push then
+		overflow <= '1';
+	end if;
+
+	if push then
+		mem(wr_ptr) <= i;
+		wr_ptr <= (wr_ptr + 1) mod depth;
+	end if;
+
+	if pop then
+		rd_ptr <= (rd_ptr + 1) mod depth;
+	end if;
+
+	if push and not pop then
+		count <= count + 1;
+	elsif pop and not push then
+		count <= count - 1;
+	end if;
+
+	if rst = '1' then
+		wr_ptr <= 0;
+		rd_ptr <= 0;
+		count  <= 0;
+		overflow <= '0';
+	end if;
+end process;
+
+end architecture;
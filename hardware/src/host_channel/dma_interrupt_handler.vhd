@@ -23,7 +23,11 @@ entity dma_interrupt_handler is
 		-- This probably shouldn't be done in the interrupt handler in the first place.
 		-- However, this is for now the only place where we actually generate completions
 		-- for read requests from the host, so for now it lives here.
-		direction: string
+		direction: string;
+
+		-- number of transfers the driver may queue, results of completed
+		-- transfers are kept until the driver read them
+		QUEUE_DEPTH: positive := 1
 	);
 	port (
 		clk : in std_logic;
@@ -39,13 +43,44 @@ entity dma_interrupt_handler is
 		instr_vld : in std_logic;
 		instr     : in interrupt_instr_t;
 
+		-- next queued transfer, taken once the previous one is complete
+		xfer_vld  : in  std_logic := '0';
+		xfer_req  : out std_logic;
+
+		-- abort of the current transfer by the host: the requester is halted
+		-- until the requests it sent are complete (rq_pending: a request not
+		-- taken by the writer yet, drained: no request of the channel is in
+		-- progress), then the transfer ends like a completed one
+		abort      : in  std_logic := '0';
+		halt       : out std_logic;
+		rq_pending : in  std_logic := '0';
+		drained    : in  std_logic := '1';
+
+		-- completion deadline of FPGA-Host transfers (instr.deadline cycles):
+		-- counted once the transfer has data (data_pending or a TLP sent), on
+		-- expiry the writer is told to flush the data it holds (flushed: the
+		-- writer sent it and starts no further request), then the transfer
+		-- ends like an aborted one
+		data_pending : in  std_logic := '0';
+		flush        : out std_logic;
+		flushed      : in  std_logic := '1';
+
 		-- input ports for data stream to be observed, only length field in header is relevant.
 		-- no req signal needed: never interferes with observed data stream.
+		-- transfer_unused: bytes of the last DWORD which are not part of the transfer
 		transfer_vld    : in std_logic;
 		transfer_length : in unsigned(9 downto 0);
+		transfer_unused : in unsigned(1 downto 0) := "00";
 		transfer_eot    : in std_logic := '0';
 		transfer_eof    : in std_logic := '0';
 
+		-- free running cycle counter of the endpoint, used to timestamp
+		-- the doorbell, the first and the last data TLP of a transaction
+		timestamp       : in unsigned(63 downto 0) := (others => '0');
+
+		-- CRC32C of the user data of the current transaction, see crc32c_stream
+		crc             : in std_logic_vector(31 downto 0) := (others => '0');
+
 		-- output port "writer" to writer
 		writer_vld     : out std_logic := '0';
 		writer_req     : in  std_logic;
@@ -56,23 +91,74 @@ end entity dma_interrupt_handler;
 
 architecture RTL of dma_interrupt_handler is
 
-	type state_t is (WAIT_FOR_INSTR, WAIT_FOR_DMA_TRANSFER_DONE, TRIG_INTERRUPT, WAIT_FOR_EOF);
+	type state_t is (WAIT_FOR_INSTR, WAIT_FOR_DMA_TRANSFER_DONE, TRIG_INTERRUPT, WAIT_FOR_EOF, ABORT_DRAIN, FLUSH);
 	signal state : state_t := WAIT_FOR_INSTR;
 
 	constant channel_info: channel_info_t := new_host_channel_info(
 		id => CHANNEL_ID,
-		dir => from_string(direction)
+		dir => from_string(direction),
+		queue_depth => QUEUE_DEPTH
 	);
 
-	signal transferred_dwords : unsigned(29 downto 0) := (others => '0');
-	signal stored_transferred_dwords : unsigned(29 downto 0) := (others => '0');
+	signal transferred_bytes : unsigned(31 downto 0) := (others => '0');
+
+	signal first_tlp_seen : std_logic := '0';
+
+	-- cycles the transfer has had data for and the deadline being hit
+	signal waited       : unsigned(31 downto 0) := (others => '0');
+	signal deadline_hit : std_logic;
+	signal closing      : std_logic := '0';
+	signal ts_doorbell  : unsigned(31 downto 0) := (others => '0');
+	signal ts_first_tlp : unsigned(31 downto 0) := (others => '0');
+	signal ts_last_tlp  : unsigned(31 downto 0) := (others => '0');
+
+	-- results of completed transfers, in order of completion
+	type result_t is record
+		bytes        : unsigned(31 downto 0);
+		ts_doorbell  : unsigned(31 downto 0);
+		ts_first_tlp : unsigned(31 downto 0);
+		ts_last_tlp  : unsigned(31 downto 0);
+		crc          : std_logic_vector(31 downto 0);
+	end record;
+	constant empty_result : result_t := (
+		bytes        => (others => '0'),
+		ts_doorbell  => (others => '0'),
+		ts_first_tlp => (others => '0'),
+		ts_last_tlp  => (others => '0'),
+		crc          => (others => '0')
+	);
+	type result_vector_t is array (0 to QUEUE_DEPTH-1) of result_t;
+
+	signal results : result_vector_t := (others => empty_result);
+	signal res_wr, res_rd : natural range 0 to QUEUE_DEPTH-1 := 0;
+	signal res_cnt : natural range 0 to QUEUE_DEPTH := 0;
+	-- a result was dropped because the driver did not read the older ones
+	signal res_overflow : std_logic := '0';
+
+	-- result last read from TRANSFERRED_REG, the other registers refer to it
+	signal stored : result_t := empty_result;
+
+	-- pending completion of a register read and interrupt
+	signal cpl_pending : std_logic := '0';
+	signal cpl_payload : std_logic_vector(31 downto 0) := (others => '0');
+	signal int_pending : std_logic := '0';
 begin
 
 writer.length      <= to_unsigned(1, 10);
 writer.tag         <= instr.cpl_tag;
 writer.cpl_lo_addr <= instr.cpl_lo_addr;
+writer.options     <= default_tlp_options;
+writer.last_bytes  <= "00";
+
+xfer_req <= '1' when state = WAIT_FOR_INSTR else '0';
+halt     <= '1' when state = ABORT_DRAIN else '0';
+flush    <= closing;
+
+deadline_hit <= '1' when channel_info.deadline = '1' and instr.deadline /= 0 and waited >= instr.deadline else '0';
 
 observe: process
+	variable push, pop : boolean;
+	variable result    : result_t;
 begin
 	wait until rising_edge(clk);
 	ctrl_rst <= '0';
@@ -81,29 +167,53 @@ begin
 		writer_vld <= '0';
 	end if;
 
+	push := false;
+	pop  := false;
+
 	case state is
 	when WAIT_FOR_INSTR =>
 
-		if instr_vld = '1' then
-			case instr.instr is
-			when TRANSFER_DMA32 | TRANSFER_DMA64 =>
-				state <= WAIT_FOR_DMA_TRANSFER_DONE;
-			when GET_TRANSFERRED_BYTES =>
-				writer_vld  <= '1';
-				writer.desc <= CplD_desc;
-				writer_payload <= std_logic_vector(stored_transferred_dwords) & "00";
-			when GET_CHANNEL_INFO =>
-				writer_vld <= '1';
-				writer.desc <= CplD_desc;
-				writer_payload <= to_dw(channel_info);
-			end case;
+		if xfer_vld = '1' then
+			state <= WAIT_FOR_DMA_TRANSFER_DONE;
+			ts_doorbell    <= timestamp(31 downto 0);
+			first_tlp_seen <= '0';
+			waited         <= (others => '0');
+
+			-- taken in the same cycle the queue is dropped
+			if abort = '1' then
+				state <= ABORT_DRAIN;
+			end if;
 		end if;
 
 	when WAIT_FOR_DMA_TRANSFER_DONE =>
 
 		-- trigger interrupt if dma transfer is finished
-		if instr.dma_size = (transferred_dwords & "00") then
+		if instr.dma_size = transferred_bytes then
+			state <= WAIT_FOR_EOF;
+		elsif abort = '1' then
+			state <= ABORT_DRAIN;
+		elsif deadline_hit = '1' then
+			state   <= FLUSH;
+			closing <= '1';
+		end if;
+
+		if (first_tlp_seen = '1' or data_pending = '1') and waited /= x"FFFFFFFF" then
+			waited <= waited + 1;
+		end if;
+
+	when FLUSH =>
+		-- the data held by the writer is sent with the requests already
+		-- made, no new request is started after it
+		if instr.dma_size = transferred_bytes then
 			state <= WAIT_FOR_EOF;
+		elsif flushed = '1' or abort = '1' then
+			state <= ABORT_DRAIN;
+		end if;
+
+	when ABORT_DRAIN =>
+		-- no TLP is cut, the transfer ends with the data already requested
+		if rq_pending = '0' and drained = '1' then
+			state <= TRIG_INTERRUPT;
 		end if;
 
 	when WAIT_FOR_EOF =>
@@ -116,22 +226,106 @@ begin
 
 	when TRIG_INTERRUPT =>
 		ctrl_rst <= '0';
+		closing  <= '0';
 
-		-- save current transferred dword count for writer
+		-- save the result of the transfer for the driver
 		-- and reset internal data counter
-		transferred_dwords <= (others => '0');
-		stored_transferred_dwords <= transferred_dwords;
+		transferred_bytes <= (others => '0');
+		result.bytes        := transferred_bytes;
+		result.ts_doorbell  := ts_doorbell;
+		result.ts_first_tlp := ts_first_tlp;
+		result.ts_last_tlp  := ts_last_tlp;
+		result.crc          := crc when instr.crc_en = '1' else (others => '0');
+		push := true;
 
 		-- generate a msix packet (interrupt)
-		writer_vld  <= '1';
-		writer.desc <= MSIX_desc;
+		int_pending <= '1';
 
 		state    <= WAIT_FOR_INSTR;
 	end case;
 
-	-- observe data stream and count transferred dwords
+	-- send register completions before interrupts
+	if writer_vld = '0' or writer_req = '1' then
+		if cpl_pending = '1' then
+			writer_vld     <= '1';
+			writer.desc    <= CplD_desc;
+			writer_payload <= cpl_payload;
+			cpl_pending    <= '0';
+		elsif int_pending = '1' then
+			writer_vld     <= '1';
+			writer.desc    <= MSIX_desc;
+			int_pending    <= '0';
+		end if;
+	end if;
+
+	-- register reads are answered in every state
+	if instr_vld = '1' then
+		cpl_pending <= '1';
+
+		case instr.instr is
+		when GET_TRANSFERRED_BYTES =>
+			if res_cnt /= 0 then
+				stored      <= results(res_rd);
+				cpl_payload <= std_logic_vector(results(res_rd).bytes);
+				pop := true;
+			else
+				cpl_payload <= std_logic_vector(stored.bytes);
+			end if;
+		when GET_CHANNEL_INFO =>
+			cpl_payload <= to_dw(channel_info);
+		when GET_TS_DOORBELL =>
+			cpl_payload <= std_logic_vector(stored.ts_doorbell);
+		when GET_TS_FIRST_TLP =>
+			cpl_payload <= std_logic_vector(stored.ts_first_tlp);
+		when GET_TS_LAST_TLP =>
+			cpl_payload <= std_logic_vector(stored.ts_last_tlp);
+		when GET_CRC =>
+			cpl_payload <= stored.crc;
+		when GET_QUEUE =>
+			cpl_payload <= std_logic_vector(to_unsigned(res_cnt, 32));
+			cpl_payload(31) <= instr.queue_full;
+			cpl_payload(30) <= instr.queue_overflow;
+			cpl_payload(29) <= res_overflow;
+		when GET_ABORT =>
+			cpl_payload <= (others => '0');
+			if state = ABORT_DRAIN then
+				cpl_payload(0) <= '1';
+			end if;
+		when TRANSFER_DMA32 | TRANSFER_DMA64 =>
+			-- transfers arrive through xfer_vld
+			cpl_pending <= '0';
+		end case;
+	end if;
+
+	-- registers can be written from user space directly, so more transfers
+	-- may complete than results are kept, the newest result is dropped then
+	if push and res_cnt = QUEUE_DEPTH and not pop then
+		push := false;
+		res_overflow <= '1';
+	end if;
+
+	if push then
+		results(res_wr) <= result;
+		res_wr <= (res_wr + 1) mod QUEUE_DEPTH;
+	end if;
+	if pop then
+		res_rd <= (res_rd + 1) mod QUEUE_DEPTH;
+	end if;
+	if push and not pop then
+		res_cnt <= res_cnt + 1;
+	elsif pop and not push then
+		res_cnt <= res_cnt - 1;
+	end if;
+
+	-- observe data stream and count transferred bytes
 	if transfer_vld = '1' then
-		transferred_dwords <= transferred_dwords + transfer_length;
+		transferred_bytes <= transferred_bytes + (transfer_length & "00") - transfer_unused;
+
+		if first_tlp_seen = '0' then
+			ts_first_tlp   <= timestamp(31 downto 0);
+			first_tlp_seen <= '1';
+		end if;
+		ts_last_tlp <= timestamp(31 downto 0);
 
 		-- only in tx_upstream_channel:
 		-- trigger an interrupt if user core is finished with transferring data
@@ -142,8 +336,18 @@ begin
 
 	if rst = '1' then
 		state <= WAIT_FOR_INSTR;
-		transferred_dwords <= (others => '0');
+		transferred_bytes <= (others => '0');
+		first_tlp_seen <= '0';
+		closing <= '0';
 		writer_vld <= '0';
+		cpl_pending <= '0';
+		int_pending <= '0';
+		res_wr  <= 0;
+		res_rd  <= 0;
+		res_cnt <= 0;
+	end if;
+	if rst = '1' or abort = '1' then
+		res_overflow <= '0';
 	end if;
 end process;
 
@@ -154,13 +358,15 @@ begin
 	             "01" when state = WAIT_FOR_DMA_TRANSFER_DONE else
 	             "10" when state = TRIG_INTERRUPT else
 	             "11" when state = WAIT_FOR_EOF else
+	             "01" when state = ABORT_DRAIN else
+	             "01" when state = FLUSH else
 				 "00";
 
 	dbg_mon: entity work.dbg_dma_interrupt_handler
 	port map(
 		state                     => dbg_state,
-		transferred_dwords        => transferred_dwords,
-		stored_transferred_dwords => stored_transferred_dwords
+		transferred_dwords        => transferred_bytes(31 downto 2),
+		stored_transferred_dwords => stored.bytes(31 downto 2)
 	);
 end generate;
 
@@ -20,10 +20,15 @@ entity dma_requester is
 		clk     : in  std_logic;
 
 		-- input for instructions from rq_decoder or sg_buffer
+		-- an instruction is taken on an edge with instr_vld and instr_req
 		instr_vld : in  std_logic := '0';
 		instr_req : out std_logic;
 		instr     : in  requester_instr_t;
 
+		-- the transfer is aborted: no further requests are sent, a pending
+		-- MWr is dropped, a pending MRd is still handed to the writer
+		halt      : in  std_logic := '0';
+
 		-- input port "tag" from rx_dma_buffer
 		tag_vld : in  std_logic;
 		tag_req : out std_logic := '0';
@@ -43,7 +48,6 @@ constant MRS_DWORDS_WIDTH : positive := repr(MRS_DWORDS);
 
 type req_state_t is (REQUEST, HOLD);
 signal tag_req_state   : req_state_t := HOLD;
-signal instr_req_state : req_state_t := REQUEST;
 
 type state_t is (GET_BUFFER_AND_CALC_FIRST_MRQ,
 				 CHECK_IF_MRQ_IS_LAST_AND_SEND,
@@ -52,7 +56,11 @@ signal state : state_t;
 
 signal MRd_addr64 : unsigned(63 downto 0);
 signal MRd_size : unsigned(MRS_DWORDS_WIDTH-1 downto 0);
+-- request size used at runtime, a power of two not above MRS_DWORDS
+signal MRS_dw   : unsigned(MRS_DWORDS_WIDTH-1 downto 0) := to_unsigned(MRS_DWORDS, MRS_DWORDS_WIDTH);
 signal transfer_size : unsigned(29 downto 0);
+-- valid bytes in the last DWORD of the buffer, 0 means all four
+signal last_bytes    : unsigned(1 downto 0) := "00";
 
 begin
 
@@ -63,10 +71,12 @@ writer.length(9 downto MRS_DWORDS_WIDTH)   <= (others => '0');
 writer.length(MRS_DWORDS_WIDTH-1 downto 0) <= MRd_size;
 
 tag_req   <= '1' when tag_req_state   = REQUEST or tag_vld   = '0' else '0';
-instr_req <= '1' when instr_req_state = REQUEST or instr_vld = '0' else '0';
+-- a halt or reset on the same edge would drop the instruction
+instr_req <= '1' when state = GET_BUFFER_AND_CALC_FIRST_MRQ and writer_req = '1' and
+                      halt = '0' and rst = '0' else '0';
 
 main: process
-
+	variable mrs : unsigned(MRS_DWORDS_WIDTH-1 downto 0);
 begin
 	wait until rising_edge(clk);
 
@@ -74,11 +84,8 @@ begin
 	when GET_BUFFER_AND_CALC_FIRST_MRQ =>
 
 		tag_req_state   <= HOLD;
-		instr_req_state <= HOLD;
 
 		if writer_req = '1' then
-			instr_req_state <= REQUEST;
-
 			-- only TRANSFER instructions are relevant for this FSM
 			case instr.instr is
 			when TRANSFER_DMA32 =>
@@ -90,13 +97,29 @@ begin
 			when others =>
 			end case;
 
+			writer.options    <= instr.options;
+			writer.last_bytes <= "00";
+
+			-- request size programmed by the driver, limited to the synthesized maximum
+			if instr.max_bytes = 0 or instr.max_bytes >= MAX_REQUEST_SIZE then
+				mrs := to_unsigned(MRS_DWORDS, MRS_DWORDS_WIDTH);
+			else
+				mrs := resize(instr.max_bytes(12 downto 2), MRS_DWORDS_WIDTH);
+			end if;
+			MRS_dw <= mrs;
+
 			-- generate first MRd:
 			-- save address
 			MRd_addr64    <= instr.dma_addr;
 			-- align first MRd to the size of MRS -> no need to check for memory page boundaries of 4KB
-			MRd_size      <= to_unsigned(MRS_DWORDS, MRS_DWORDS_WIDTH) - ('0' & instr.dma_addr(MRS_DWORDS_WIDTH downto 2));
-			-- save size of dma buffer in DWORDS
+			MRd_size      <= mrs - (('0' & instr.dma_addr(MRS_DWORDS_WIDTH downto 2)) and (mrs - 1));
+			-- save size of dma buffer in DWORDS, a partial last DWORD is requested
+			-- with its byte enables
 			transfer_size <= instr.dma_size(31 downto 2);
+			if instr.dma_size(1 downto 0) /= 0 then
+				transfer_size <= instr.dma_size(31 downto 2) + 1;
+			end if;
+			last_bytes    <= instr.dma_size(1 downto 0);
 
 			writer_vld <= '0';
 
@@ -121,6 +144,7 @@ begin
 			if transfer_size <= to_integer(MRd_size) then
 				state    <= GET_BUFFER_AND_CALC_FIRST_MRQ;
 				MRd_size <= transfer_size(MRS_DWORDS_WIDTH-1 downto 0);
+				writer.last_bytes <= last_bytes;
 			end if;
 		end if;
 
@@ -135,15 +159,26 @@ begin
 			-- calculate address and length of next MRd
 			transfer_size <= transfer_size - to_integer(MRd_size);
 			MRd_addr64    <= MRd_addr64 + to_integer(MRd_size(MRS_DWORDS_WIDTH-1 downto 0) & "00");  -- addresses are in bytes
-			MRd_size      <= to_unsigned(MRS_DWORDS, MRS_DWORDS_WIDTH);
+			MRd_size      <= MRS_dw;
 		end if;
 
 	end case;
 
+	-- a request made in CHECK_IF_MRQ_IS_LAST_AND_SEND on this edge has no
+	-- tag yet and is dropped. A MRd pending in the other states took its
+	-- tag already, it stays valid until the writer takes it, else its
+	-- completion would never arrive.
+	if halt = '1' then
+		state         <= GET_BUFFER_AND_CALC_FIRST_MRQ;
+		tag_req_state <= HOLD;
+		if state = CHECK_IF_MRQ_IS_LAST_AND_SEND or (TRANSFER_DIR = "UPSTREAM" and writer_req = '0') then
+			writer_vld <= '0';
+		end if;
+	end if;
+
 	if rst = '1' then
 		writer_vld      <= '0';
 
-		instr_req_state <= HOLD;
 		tag_req_state   <= HOLD;
 		state           <= GET_BUFFER_AND_CALC_FIRST_MRQ;
 	end if;
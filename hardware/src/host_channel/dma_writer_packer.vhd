@@ -36,6 +36,14 @@ entity dma_writer_packer is
 		payload     : in  tx_stream;
 		payload_cnt : in  unsigned(11 downto 0);
 		payload_eot : in  std_logic := '0';
+		-- valid bytes in the last DWORD of the transfer, valid with payload_eot
+		payload_eot_bytes : in unsigned(1 downto 0) := "00";
+
+		-- flush: the data held is sent like at the end of a transfer, with
+		-- at most one MWr. flushed: it is sent (or there was none) and no
+		-- further MWr is started until flush is released
+		flush   : in  std_logic := '0';
+		flushed : out std_logic := '0';
 
 		-- output
 		o     : out fragment := default_fragment;
@@ -55,6 +63,7 @@ signal mwr_req_state, i_req_state : req_state_t := REQUEST;
 
 signal payload_counter : unsigned(9 downto 0) := (others => '0');
 signal payload_req_cnt : unsigned(2 downto 0) := (others => '0');
+signal flush_done      : std_logic := '0';
 
 begin
 assert (TRANSFER_DIR = "DOWNSTREAM" or TRANSFER_DIR = "UPSTREAM") report "invalid TRANSFER_DIR generic";
@@ -63,9 +72,11 @@ payload_req <= payload_req_cnt when o_req = '1' else "000";
 
 mwr_req <= '1' when mwr_req_state = REQUEST or mwr_vld = '0' else '0';
 i_req   <= o_req when   i_req_state = REQUEST or   i_vld = '0' else '0';
+flushed <= flush_done;
 
 generate_packet: process
 	variable MWr_length : unsigned(9 downto 0) := (others => '0');
+	variable MWr_header : tlp_header_info_t;
 	variable cnt_temp   : unsigned(3 downto 0) := (others => '0');
 begin
 	wait until rising_edge(clk);
@@ -87,32 +98,37 @@ begin
 
 		-- this path is only active if packer is used for FPGA to host transfers
 		-- MWr has less priority than MRd, Interrupt or CplD
-		if i_vld = '0' and mwr_vld = '1' and o_req = '1' and TRANSFER_DIR = "UPSTREAM" then
+		if i_vld = '0' and mwr_vld = '1' and o_req = '1' and TRANSFER_DIR = "UPSTREAM" and flush_done = '0' then
 
 			-- defaults
-			o     <= make_packet(mwr, CHANNEL_ID, i_payload);
 			o_vld <= '0';
+			MWr_header := mwr;
 
-			-- in case of an active EndOfTransfer flag, update length with min(mwr.length, fifo_data_cnt)
+			-- in case of an active EndOfTransfer or flush flag, update length with min(mwr.length, fifo_data_cnt)
 			MWr_length := mwr.length;
-			if payload_eot = '1' and mwr.length > to_integer(payload_cnt) then
+			if (payload_eot = '1' or flush = '1') and mwr.length > to_integer(payload_cnt) then
 				MWr_length := payload_cnt(9 downto 0);
 			end if;
 
+			-- the last MWr of a transfer ends with the bytes of the last DWORD
 			if mwr.length >= to_integer(payload_cnt) then
 				o_eot <= payload_eot;
+				if payload_eot = '1' then
+					MWr_header.last_bytes := payload_eot_bytes;
+				end if;
 			end if;
 
 			-- initialize payload counter with MWr_length
 			payload_counter <= MWr_length;
 
 			-- overwrite length of MWr with calculated length
-			set_length(o, std_logic_vector(MWr_length));
+			MWr_header.length := MWr_length;
+			o <= make_packet(MWr_header, CHANNEL_ID, i_payload);
 
 			-- start to send MWr if enough data is available in fifo or EndOfTransfer flag is set
 			-- assumption: data count coming from previous module is always consistent with input data ->
 			-- as soon as condition is met, there is enough data available at input
-			if (mwr.length <= to_integer(payload_cnt)) or (payload_eot = '1' and to_integer(payload_cnt) > 0)  then
+			if (mwr.length <= to_integer(payload_cnt)) or ((payload_eot = '1' or flush = '1') and to_integer(payload_cnt) > 0)  then
 				-- set states: hold header information from input i (MRd, CplDs, Ints)
 				-- a MWr is being built -> request new MWr header information for next MWr
 				i_req_state   <= HOLD;
@@ -130,6 +146,11 @@ begin
 					state           <= MWR_PAYLOAD;
 					payload_req_cnt <= "100";
 				end if;
+
+				flush_done <= flush;
+			elsif flush = '1' then
+				-- nothing to flush
+				flush_done <= '1';
 			end if;
 		end if;
 
@@ -177,8 +198,13 @@ begin
 		end if;
 	end case;
 
+	if flush = '0' then
+		flush_done <= '0';
+	end if;
+
 	if rst = '1' then
 		o_vld <= '0';
+		flush_done <= '0';
 		state <= HEADER;
 		i_req_state <= REQUEST;
 		mwr_req_state <= HOLD;
@@ -20,12 +20,65 @@ package host_channel_types is
 	subtype reg_addr_t is unsigned(3 downto 0);
 	constant ADDR_LO_REG      : reg_addr_t := x"0";
 	constant ADDR_HI_REG      : reg_addr_t := x"1";
+	-- writing the size queues the buffer, see dma_descriptor_queue
 	constant BUFFER_SIZE      : reg_addr_t := x"2";
+	-- read: transferred bytes of the oldest completed transaction not read yet,
+	-- the timestamp and CRC registers then belong to this transaction
 	constant TRANSFERRED_REG  : reg_addr_t := x"4";
 	constant CHANNEL_INFO_REG : reg_addr_t := x"5";
+	-- low 32 bit of the endpoint cycle counter, captured for the transaction
+	constant TS_DOORBELL_REG  : reg_addr_t := x"6";
+	constant TS_FIRST_TLP_REG : reg_addr_t := x"7";
+	constant TS_LAST_TLP_REG  : reg_addr_t := x"8";
+	-- TLP attributes and processing hints of the DMA requests, see to_tlp_options
+	constant TLP_ATTR_REG     : reg_addr_t := x"9";
+	-- runtime limit of the DMA request size in bytes (MRRS for Host-FPGA,
+	-- MPS for FPGA-Host channels), 0 selects the synthesized maximum
+	constant MAX_TLP_REG      : reg_addr_t := x"A";
+	-- write: bit 0 enables the inline CRC32C of the user data,
+	-- read: CRC32C of the last transaction (0 if disabled)
+	constant CRC_REG          : reg_addr_t := x"B";
+	-- read: number of completed transactions not read from TRANSFERRED_REG yet
+	-- in bits 15:0, bit 31 is set while the descriptor queue is full, bit 30
+	-- once a buffer was dropped because of that and bit 29 once a result was
+	-- dropped because QUEUE_DEPTH results were not read (cleared by an abort)
+	constant QUEUE_REG        : reg_addr_t := x"C";
+	-- write: abort the current transfer and drop the queued ones, the aborted
+	-- transfer completes with the bytes transferred so far,
+	-- read: 1 while the requests already sent are drained
+	constant ABORT_REG        : reg_addr_t := x"D";
+	-- write: cycles a FPGA-Host transaction may wait for further data once
+	-- it has data, then it completes with the bytes written so far, 0 waits
+	-- until the buffer is full or the user logic ends the transfer
+	constant DEADLINE_REG     : reg_addr_t := x"E";
+
+	-- relaxed ordering and no snoop are set on all DMA requests (MRd and MWr),
+	-- processing hints only on MWr. Interrupts and completions always use the
+	-- default attributes, so an interrupt can't pass the data of its transfer.
+	type tlp_options_t is record
+		attr : tlp_attr_t;
+		th   : std_logic;
+		ph   : std_logic_vector(1 downto 0);
+		st   : std_logic_vector(7 downto 0);
+	end record;
+	constant default_tlp_options : tlp_options_t := (
+		attr => ATTR_DEFAULT,
+		th   => '0',
+		ph   => "00",
+		st   => (others => '0')
+	);
+	-- TLP_ATTR_REG: bit 0 no snoop, bit 1 relaxed ordering, bit 4 TPH enable,
+	-- bits 9:8 processing hint, bits 23:16 steering tag
+	function to_tlp_options(data: dword) return tlp_options_t;
+
+	subtype tlp_bytes_t is unsigned(12 downto 0);
+	-- only the PCIe sizes 128 to 4096 bytes are accepted, everything else is 0
+	function to_tlp_bytes(data: dword) return tlp_bytes_t;
 
 	type request_t     is (MWr, MRd);
-	type instruction_t is (TRANSFER_DMA32, TRANSFER_DMA64, GET_TRANSFERRED_BYTES, GET_CHANNEL_INFO);
+	type instruction_t is (TRANSFER_DMA32, TRANSFER_DMA64, GET_TRANSFERRED_BYTES, GET_CHANNEL_INFO,
+	                       GET_TS_DOORBELL, GET_TS_FIRST_TLP, GET_TS_LAST_TLP, GET_CRC,
+	                       GET_QUEUE, GET_ABORT);
 	
 	type tlp_header_info_t is record
 		desc        : descriptor_t;
@@ -33,6 +86,9 @@ package host_channel_types is
 		tag         : unsigned(7 downto 0);
 		mrq_address : std_logic_vector(63 downto 0);
 		cpl_lo_addr : std_logic_vector(6 downto 0);
+		options     : tlp_options_t;
+		-- valid bytes in the last DWORD of a MRd/MWr, 0 means all four
+		last_bytes  : unsigned(1 downto 0);
 	end record;
 	function init_tlp_header_info return tlp_header_info_t;
 	
@@ -40,6 +96,9 @@ package host_channel_types is
 		instr       : instruction_t;
 		dma_addr    : unsigned(63 downto 0);
 		dma_size    : unsigned(31 downto 0);	
+		options     : tlp_options_t;
+		max_bytes   : tlp_bytes_t;
+		crc_en      : std_logic;
 	end record;
 	
 	type interrupt_instr_t is record
@@ -47,6 +106,11 @@ package host_channel_types is
 		dma_size    : unsigned(31 downto 0);
 		cpl_tag     : unsigned(7 downto 0);
 		cpl_lo_addr : std_logic_vector(6 downto 0);
+		crc_en      : std_logic;
+		deadline    : unsigned(31 downto 0);
+		-- state of the descriptor queue, see QUEUE_REG
+		queue_full     : std_logic;
+		queue_overflow : std_logic;
 	end record;
 	
 
@@ -55,6 +119,11 @@ package host_channel_types is
 	function cnt2keep(cnt : unsigned(2 downto 0)) return std_logic_vector;
 	function keep2cnt(keep : std_logic_vector(3 downto 0)) return unsigned;
 
+	-- byte enables of the last DWORD with `bytes` valid bytes (0 means all four)
+	-- and the number of disabled bytes at the end of a DWORD with byte enables `be`
+	function bytes2be(bytes : unsigned(1 downto 0)) return std_logic_vector;
+	function be2unused(be : std_logic_vector(3 downto 0)) return unsigned;
+
 end package host_channel_types;
 
 package body host_channel_types is
@@ -65,17 +134,32 @@ function make_packet(header_info: tlp_header_info_t; chn_id: natural; payload: d
 	variable dw1_cpld: cpld_dw1 := init_cpld_dw1;
 	variable dw2_cpld: cpld_dw2 := init_cpld_dw2;
 	variable dw1_rqst: rqst_dw1 := init_rqst_dw1;
+	variable address: std_logic_vector(63 downto 0) := header_info.mrq_address;
 begin
 	dw0.desc   := header_info.desc;
 	dw0.length := std_logic_vector(header_info.length);
 	dw0.tag    := std_logic_vector(header_info.tag);
 	dw0.chn_id := std_logic_vector(to_unsigned(chn_id, dw0.chn_id'length));
 	
+	if header_info.desc /= CplD_desc and header_info.desc /= MSIX_desc then
+		dw0.attr := header_info.options.attr;
+	end if;
+	
+	-- processing hints of a MWr: steering tag in the otherwise unused tag field,
+	-- hint in the lowest two address bits which are always zero for DWORD addresses
+	if (header_info.desc = MWr32_desc or header_info.desc = MWr64_desc) and header_info.options.th = '1' then
+		dw0.tag     := header_info.options.st;
+		dw1_rqst.th := '1';
+		address(1 downto 0) := header_info.options.ph;
+	end if;
+	
+	-- a single DWORD request carries its byte enables in first_be
 	dw1_rqst.first_be := (others => '1');
 	if header_info.length = 1 then
-		dw1_rqst.last_be := (others => '0');
+		dw1_rqst.first_be := bytes2be(header_info.last_bytes);
+		dw1_rqst.last_be  := (others => '0');
 	else
-		dw1_rqst.last_be := (others => '1');
+		dw1_rqst.last_be  := bytes2be(header_info.last_bytes);
 	end if;
 	
 	dw1_cpld.byte_count := std_logic_vector(header_info.length & "00");
@@ -98,10 +182,10 @@ begin
 	case header_info.desc is
 	when MRd32_desc | MWr32_desc =>
 		ret.data( 63 downto 32) := to_dword(dw1_rqst);
-		ret.data(127 downto 64) := payload & header_info.mrq_address(31 downto 0);
+		ret.data(127 downto 64) := payload & address(31 downto 0);
 	when MRd64_desc | MWr64_desc =>
-		ret.data(127 downto 32) := header_info.mrq_address(31 downto 0) & 
-		                           header_info.mrq_address(63 downto 32) & 
+		ret.data(127 downto 32) := address(31 downto 0) & 
+		                           address(63 downto 32) & 
 		                           to_dword(dw1_rqst);
 	when CplD_desc =>
 		ret.data( 63 downto 32) := to_dword(dw1_cpld);
@@ -145,6 +229,26 @@ begin
 	end case;
 end function;
 
+function bytes2be(bytes : unsigned(1 downto 0)) return std_logic_vector is
+begin
+	case bytes is
+		when "01"   => return "0001";
+		when "10"   => return "0011";
+		when "11"   => return "0111";
+		when others => return "1111";
+	end case;
+end function;
+
+function be2unused(be : std_logic_vector(3 downto 0)) return unsigned is
+begin
+	case be is
+		when "0001" => return "11";
+		when "0011" => return "10";
+		when "0111" => return "01";
+		when others => return "00";
+	end case;
+end function;
+
 
 function init_tlp_header_info return tlp_header_info_t is
 	variable ret : tlp_header_info_t;
@@ -154,8 +258,30 @@ begin
 	ret.mrq_address := (others => '0');
 	ret.tag         := (others => '0');
 	ret.cpl_lo_addr := (others => '0');
+	ret.options     := default_tlp_options;
+	ret.last_bytes  := (others => '0');
 	return ret;
 end init_tlp_header_info;
 
+function to_tlp_options(data: dword) return tlp_options_t is
+	variable ret : tlp_options_t;
+begin
+	ret.attr := data(1 downto 0);
+	ret.th   := data(4);
+	ret.ph   := data(9 downto 8);
+	ret.st   := data(23 downto 16);
+	return ret;
+end to_tlp_options;
+
+function to_tlp_bytes(data: dword) return tlp_bytes_t is
+begin
+	for i in 7 to 12 loop
+		if unsigned(data) = shift_left(to_unsigned(1, 32), i) then
+			return to_unsigned(2**i, tlp_bytes_t'length);
+		end if;
+	end loop;
+	return (others => '0');
+end to_tlp_bytes;
+
 end package body host_channel_types;
 
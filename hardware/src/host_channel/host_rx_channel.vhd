@@ -22,7 +22,8 @@ entity host_rx_channel is
 		to_ep_req   : in  std_ulogic;
 		o           : out rx_stream := default_rx_stream;
 		o_vld       : out std_ulogic := '0';
-		o_req       : in  std_ulogic
+		o_req       : in  std_ulogic;
+		timestamp   : in  unsigned(63 downto 0) := (others => '0')
 	);
 end entity host_rx_channel;
 
@@ -30,10 +31,17 @@ architecture STRUCT of host_rx_channel is
 	signal rst_channel : std_logic;
 
 	signal rq_instr_vld : std_logic;
+	signal rq_instr_req : std_logic;
+	signal rq_instr_taken : std_logic;
 	signal rq_instr : requester_instr_t;
 
 	signal int_instr_vld : std_logic;
+	signal xfer_vld : std_logic;
+	signal xfer_req : std_logic;
 	signal int_instr : interrupt_instr_t;
+	signal abort : std_logic;
+	signal halt : std_logic;
+	signal mrd_taken : std_logic;
 
 	signal cpl : fragment;
 	signal cpl_vld : std_logic;
@@ -47,7 +55,7 @@ architecture STRUCT of host_rx_channel is
 	signal req_writer_req : std_logic;
 	signal req_writer : tlp_header_info_t;
 
-	signal tag : std_logic_vector(4 downto 0);
+	signal tag : std_logic_vector(rx_tag_bits(config)-1 downto 0);
 	signal tag_vld : std_logic;
 	signal tag_req : std_logic;
 	signal pipe : fragment;
@@ -56,12 +64,20 @@ architecture STRUCT of host_rx_channel is
 
 begin
 
+-- tlp_tag_quota treats every id above host_rx_count as a channel
+-- without reserved tags
+assert id <= host_rx_count(config)
+	report "host_rx_channel ids must be in [1, host_rx_count(config)]"
+	severity failure;
+
+rq_instr_taken <= rq_instr_vld and rq_instr_req;
+
 dbg: if debug generate
 	mon: entity work.host_rx_monitor_dbg
 		port map(
 			clk            => clk,
 			rst            => rst,
-			rq_instr_vld   => rq_instr_vld,
+			rq_instr_vld   => rq_instr_taken,
 			rq_instr       => rq_instr,
 			int_instr_vld  => int_instr_vld,
 			int_instr      => int_instr,
@@ -80,7 +96,8 @@ end generate;
 
 decoder: entity work.dma_decoder
 	generic map(
-		CHANNEL_ID => id
+		CHANNEL_ID  => id,
+		QUEUE_DEPTH => desc_queue_depth(config)
 	)
 	port map(
 		rst_in        => rst,
@@ -92,24 +109,29 @@ decoder: entity work.dma_decoder
 		cpl_vld       => cpl_vld,
 		cpl           => cpl,
 		rq_instr_vld  => rq_instr_vld,
+		rq_instr_req  => rq_instr_req,
 		rq_instr      => rq_instr,
 		int_instr_vld => int_instr_vld,
-		int_instr     => int_instr
+		int_instr     => int_instr,
+		xfer_vld      => xfer_vld,
+		xfer_req      => xfer_req,
+		abort         => abort
 	);
 
 requester: entity work.dma_requester
 	generic map(
 		debug            => debug,
 		MAX_REQUEST_SIZE => config.max_request_bytes,
-		TAG_BITS         => 5,
+		TAG_BITS         => rx_tag_bits(config),
 		TRANSFER_DIR     => "DOWNSTREAM"
 	)
 	port map(
 		rst        => rst_channel,
 		clk        => clk,
 		instr_vld  => rq_instr_vld,
-		instr_req  => open,
+		instr_req  => rq_instr_req,
 		instr      => rq_instr,
+		halt       => halt,
 		tag_vld    => tag_vld,
 		tag_req    => tag_req,
 		tag        => tag,
@@ -120,8 +142,9 @@ requester: entity work.dma_requester
 
 interrupt_handler: entity work.rx_dma_interrupt_handler
 	generic map(
-		debug      => debug,
-		CHANNEL_ID => id
+		debug       => debug,
+		QUEUE_DEPTH => desc_queue_depth(config),
+		CHANNEL_ID  => id
 	)
 	port map(
 		clk            => clk,
@@ -129,14 +152,27 @@ interrupt_handler: entity work.rx_dma_interrupt_handler
 		ctrl_rst       => open,
 		instr_vld      => int_instr_vld,
 		instr          => int_instr,
+		xfer_vld       => xfer_vld,
+		xfer_req       => xfer_req,
+		abort          => abort,
+		halt           => halt,
+		rq_pending     => req_writer_vld,
+		rq_vld         => mrd_taken,
+		rq_length      => req_writer.length,
 		cpl_vld        => cpl_vld,
 		cpl            => cpl,
+		user_vld       => o_vld,
+		user_req       => o_req,
+		user           => o,
+		timestamp      => timestamp,
 		writer_vld     => int_writer_vld,
 		writer_req     => int_writer_req,
 		writer         => int_writer,
 		writer_payload => int_writer_payload
 	);
 
+mrd_taken <= req_writer_vld and req_writer_req;
+
 writer: entity work.rx_dma_writer
 	generic map(
 		CHANNEL_ID   => id
@@ -169,7 +205,7 @@ out_req_pipe: entity work.pipe_register
 
 dma_buffer: entity work.rx_dma_buffer
 	generic map(
-		tag_bits => 5,
+		tag_bits => rx_tag_bits(config),
 		MRS      => config.max_request_bytes
 	)
 	port map(
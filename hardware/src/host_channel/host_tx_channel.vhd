@@ -23,16 +23,23 @@ entity host_tx_channel is
 		from_ep     : in  fragment;
 		to_ep_vld   : out std_logic;
 		to_ep_req   : in  std_logic;
-		to_ep       : out fragment
+		to_ep       : out fragment;
+		timestamp   : in  unsigned(63 downto 0) := (others => '0')
 	);
 end entity host_tx_channel;
 
 architecture RTL of host_tx_channel is
 	signal rst_channel : std_logic;
 	signal rq_instr_vld : std_logic;
+	signal rq_instr_req : std_logic;
+	signal rq_instr_taken : std_logic;
 	signal rq_instr : requester_instr_t;
 	signal int_instr : interrupt_instr_t;
 	signal int_instr_vld : std_logic;
+	signal xfer_vld : std_logic;
+	signal xfer_req : std_logic;
+	signal abort : std_logic;
+	signal halt : std_logic;
 	signal req_writer_vld : std_logic := '0';
 	signal req_writer_req : std_logic;
 	signal req_writer : tlp_header_info_t;
@@ -48,7 +55,11 @@ architecture RTL of host_tx_channel is
 	signal fifo_req : std_logic;
 	signal fifo_data : tx_stream;
 	signal fifo_eot : std_logic;
+	signal fifo_eot_bytes : unsigned(1 downto 0);
 	signal fifo_data_cnt : unsigned(11 downto 0);
+	signal data_pending : std_logic;
+	signal flush : std_logic;
+	signal flushed : std_logic;
 
 	signal shift : fragment;
 	signal shift_vld : std_logic;
@@ -57,12 +68,14 @@ architecture RTL of host_tx_channel is
 	signal tx_rst, ctrl_rst: std_logic := '0';
 begin
 
+	rq_instr_taken <= rq_instr_vld and rq_instr_req;
+
 	dbg: if debug generate
 		mon: entity work.host_tx_monitor_dbg
 		port map(
 			clk            => clk,
 			rst            => rst,
-			rq_instr_vld   => rq_instr_vld,
+			rq_instr_vld   => rq_instr_taken,
 			rq_instr       => rq_instr,
 			int_instr_vld  => int_instr_vld,
 			int_instr      => int_instr,
@@ -80,10 +93,12 @@ begin
 	end generate;
 
 tx_rst <= rst_channel or ctrl_rst;
+data_pending <= '1' when fifo_data_cnt /= 0 else '0';
 
 decoder: entity work.dma_decoder
 	generic map(
-		CHANNEL_ID => id
+		CHANNEL_ID  => id,
+		QUEUE_DEPTH => desc_queue_depth(config)
 	)
 	port map(
 		rst_in        => rst,
@@ -95,9 +110,13 @@ decoder: entity work.dma_decoder
 		cpl_vld       => open,
 		cpl           => open,
 		rq_instr_vld  => rq_instr_vld,
+		rq_instr_req  => rq_instr_req,
 		rq_instr      => rq_instr,
 		int_instr_vld => int_instr_vld,
-		int_instr     => int_instr
+		int_instr     => int_instr,
+		xfer_vld      => xfer_vld,
+		xfer_req      => xfer_req,
+		abort         => abort
 	);
 
 requester: entity work.dma_requester
@@ -111,8 +130,9 @@ requester: entity work.dma_requester
 		rst        => tx_rst,
 		clk        => clk,
 		instr_vld  => rq_instr_vld,
-		instr_req  => open,
+		instr_req  => rq_instr_req,
 		instr      => rq_instr,
+		halt       => halt,
 		tag_vld    => '1',
 		tag_req    => open,
 		tag        => "00000",
@@ -123,8 +143,9 @@ requester: entity work.dma_requester
 
 interrupt_handler: entity work.tx_dma_interrupt_handler
 	generic map(
-		debug      => debug,
-		CHANNEL_ID => id
+		debug       => debug,
+		QUEUE_DEPTH => desc_queue_depth(config),
+		CHANNEL_ID  => id
 	)
 	port map(
 		clk            => clk,
@@ -132,10 +153,19 @@ interrupt_handler: entity work.tx_dma_interrupt_handler
 		ctrl_rst       => ctrl_rst,
 		instr_vld      => int_instr_vld,
 		instr          => int_instr,
+		xfer_vld       => xfer_vld,
+		xfer_req       => xfer_req,
+		abort          => abort,
+		halt           => halt,
+		rq_pending     => req_writer_vld,
+		data_pending   => data_pending,
+		flush          => flush,
+		flushed        => flushed,
 		mwr_vld        => mwr_vld,
 		mwr_req        => mwr_req,
 		mwr            => mwr,
 		mwr_eot        => mwr_eot,
+		timestamp      => timestamp,
 		writer_vld     => int_writer_vld,
 		writer_req     => int_writer_req,
 		writer         => int_writer,
@@ -162,6 +192,9 @@ writer: entity work.tx_dma_writer
 		payload       => fifo_data,
 		payload_cnt   => fifo_data_cnt,
 		payload_eot   => fifo_eot,
+		payload_eot_bytes => fifo_eot_bytes,
+		flush         => flush,
+		flushed       => flushed,
 		o             => mwr,
 		o_eot         => mwr_eot,
 		o_vld         => mwr_vld,
@@ -183,6 +216,7 @@ fifo: entity work.tx_dma_fifo
 		o_req           => fifo_req,
 		o               => fifo_data,
 		end_of_transfer => fifo_eot,
+		end_of_transfer_bytes => fifo_eot_bytes,
 		data_count      => fifo_data_cnt
 	);
 
@@ -73,6 +73,12 @@ architecture behavioral of rx_dma_buffer is
 --
 -- memory address format:                       | tag [tag_bits] | [repr(MemLinesPerTag)_bits] |
 -- Example: tag_bits = 2, MemLinesPerTag = 32   | 2 bits         | 5 bits                      |
+--
+-- Cut-through: the completions of one tag arrive in order and fill its MemLines from the top,
+-- the last DWORD of every MemLine is written to Mem3. The write side records the lowest
+-- completely written MemLine of every tag, so the read side streams the oldest tag as soon
+-- as its first MemLine is written instead of waiting for the whole request. Only data of
+-- tags behind the oldest one waits in memory.
 
 ---------------------------------------------------------
 -- Helper functions, signals and constant declerations --
@@ -87,6 +93,7 @@ architecture behavioral of rx_dma_buffer is
 	signal tlp_length     : unsigned(9 downto 0) := (others => '0');
 	--signal tlp_lower_addr : unsigned(6 downto 0) := (others => '0');
 	signal tlp_byte_count : unsigned(11 downto 0) := (others => '0');
+	signal tlp_last_bytes : unsigned(1 downto 0) := (others => '0');
 
 ------------------------
 -- signals for memory --
@@ -133,6 +140,13 @@ architecture behavioral of rx_dma_buffer is
 	signal rd_init_mem   : rd_init_t := (others => (others => '0'));                            -- byte_count memory to notify read FSM how to initialize read address pointer
 	signal rd_init_in    : unsigned(byteCountBits-3-1 downto 0) := (others => '0');             -- rd_init_mem output register
 
+	-- valid bytes in the last DWORD of every request, stored like rd_init_mem
+	type   last_bytes_t  is array (0 to 2**tag_bits-1) of unsigned(1 downto 0);
+	signal last_bytes_mem : last_bytes_t := (others => (others => '0'));
+	signal last_bytes_in  : unsigned(1 downto 0) := (others => '0');
+	signal rd_last_bytes  : unsigned(1 downto 0) := (others => '0');
+	signal last_bytes_out : unsigned(1 downto 0) := (others => '0');
+
 	signal tag_readable    : std_logic_vector(0 to 2**tag_bits-1) := (others => '0'); -- memory to notify read FSM which transfers are finished
 	signal rd_tag_is_ready : std_logic := '0';                                        -- flag used to check if current read tag is ready to read
 	signal rqst_complete   : std_logic := '0';                                        -- flag to notify read FSM that a transfer finished
@@ -142,6 +156,12 @@ architecture behavioral of rx_dma_buffer is
 	signal release_tag   : std_logic := '0';                                        -- flag to notify tag-generate side that a tag is released and can be used to request data
 	signal rd_tag_ptr    : unsigned(tag_bits-1 downto 0);                           -- read to tag-generate pointer for tag_available
 
+	-- signals for cut-through between write FSM and read FSM
+	type   line_t        is array (0 to 2**tag_bits-1) of unsigned(byteCountBits-5-1 downto 0);
+	signal wr_line       : line_t := (others => (others => '0'));                       -- lowest completely written MemLine of every tag
+	signal wr_line_vld   : std_logic_vector(0 to 2**tag_bits-1) := (others => '0');  -- at least one MemLine of the tag is written
+	signal rd_line_ready : std_logic;                                               -- MemLine at rd_ptr can be read
+
 	attribute ram_style : string;
 	attribute ram_style of Mem0 : signal is "block";
 	attribute ram_style of Mem1 : signal is "block";
@@ -156,6 +176,7 @@ begin
 	-- assign input to internal signals for better code readability
 	tlp_tag        <= unsigned(get_cpld(i_data.data).dw0.tag(tag_bits-1 downto 0));
 	tlp_byte_count <= unsigned(get_cpld(i_data.data).dw1.byte_count);      
+	tlp_last_bytes <= unsigned(get_cpld(i_data.data).dw1.last_bytes);
 	--tlp_lower_addr <= unsigned(to_cpld_header(i_data.data).dw1.lower_address); -- we need this line to support byte granularity
 	tlp_length     <= unsigned(i_data.data(15 downto 6));
 
@@ -195,6 +216,15 @@ begin
 			if wr_en3 = '1' then
 				Mem3(to_integer(wr_ptr3)) <= dword3;
 				wr_ptr3                   <= wr_ptr3 - 1;
+
+				-- Mem3 holds the last DWORD of a MemLine -> MemLine is complete
+				wr_line(to_integer(wr_tag))     <= wr_ptr3(byteCountBits-5-1 downto 0);
+				wr_line_vld(to_integer(wr_tag)) <= '1';
+			end if;
+
+			-- tag is read out completely -> forget its progress before it is requested again
+			if release_tag = '1' then
+				wr_line_vld(to_integer(rd_tag_ptr)) <= '0';
 			end if;
 
 			-- defaults
@@ -232,6 +262,7 @@ begin
 
 				-- store byte_count to initialize read address pointer
 				rd_init_in <= wr_ptr3_temp(byteCountBits-3-1 downto 0); -- tlp_byte_count(byteCountBits-1-1 downto 2) - 1;
+				last_bytes_in <= tlp_last_bytes;
 
 				if i_vld = '1' then
 					wr_state   <= WRITE_S;
@@ -256,6 +287,7 @@ begin
 				-- necessary to write correct byte_count into rd_init_mem to notify read side
 				if tag_in_process(to_integer(wr_tag)) = '0' then
 					rd_init_mem(to_integer(wr_tag)) <= rd_init_in;
+					last_bytes_mem(to_integer(wr_tag)) <= last_bytes_in;
 				end if;
 
 			end case;
@@ -272,7 +304,9 @@ begin
 				rqst_complete <= '0';
 				
 				tag_in_process <= (others => '0');
+				wr_line_vld    <= (others => '0');
 				rd_init_mem    <= (others => (others => '0'));
+				last_bytes_mem <= (others => (others => '0'));
 			end if;
 		end if;
 	end process;
@@ -299,8 +333,8 @@ begin
 	begin
 		if rising_edge(clk) then
 
-			-- check if current rd_tag is completely received by write-FSM
-			rd_tag_is_ready <= tag_readable(to_integer(rd_tag));
+			-- check if the first MemLine of the current rd_tag is received by write-FSM
+			rd_tag_is_ready <= tag_readable(to_integer(rd_tag)) or wr_line_vld(to_integer(rd_tag));
 
 			-- read-FSM
 			case rd_state is
@@ -318,6 +352,7 @@ begin
 
 				-- output status bits = byte_count(3 downto 2)
 				dword_count <= rd_init_mem(to_integer(rd_tag))(1 downto 0);
+				rd_last_bytes <= last_bytes_mem(to_integer(rd_tag));
 
 				if rd_tag_is_ready = '1' then
 					-- initialize read address pointer with current tag & byte_count(byteCountBits-1 downto 4) provided by write-FSM
@@ -330,13 +365,15 @@ begin
 
 			when FIRST_S =>
 
-				if o_req = '1' then
+				if o_req = '1' and rd_line_ready = '1' then
 					dw_cnt_out <= dword_count;
+					last_bytes_out <= "00";
 
 					-- if start address is 0, only one word to output -> goto initial state and release current tag
 					if rd_ptr(byteCountBits-5-1 downto 0) = 0 then
 						rd_state    <= INIT_S;
 						release_tag <= '1';
+						last_bytes_out <= rd_last_bytes;
 					else
 						rd_state <= READ_S;
 					end if;
@@ -344,30 +381,36 @@ begin
 
 			when READ_S =>
 
-				if o_req = '1' then
+				if o_req = '1' and rd_line_ready = '1' then
 
 					-- dword count is always 4, unless it's the first word i a transfer (tag)
 					dw_cnt_out <= "11";
+					last_bytes_out <= "00";
 
-					-- output last word and go to initial state
+					-- output last word and go to initial state,
+					-- a partial last DWORD of the request is always the last DWORD of this word
 					if rd_ptr(byteCountBits-5-1 downto 0) = 0 then
 						rd_state    <= INIT_S;
 						release_tag <= '1';
+						last_bytes_out <= rd_last_bytes;
 					end if;
 				end if;
 
 			end case;
 
-			-- store word in output register
+			-- store word in output register,
+			-- wait if the write side has not completed the MemLine yet
 			if o_req = '1' and (rd_state = READ_S or rd_state = FIRST_S) then
-				o_vld <= '1';
+				o_vld <= rd_line_ready;
 
-				Mem0_out <= Mem0(to_integer(rd_ptr));
-				Mem1_out <= Mem1(to_integer(rd_ptr));
-				Mem2_out <= Mem2(to_integer(rd_ptr));
-				Mem3_out <= Mem3(to_integer(rd_ptr));
+				if rd_line_ready = '1' then
+					Mem0_out <= Mem0(to_integer(rd_ptr));
+					Mem1_out <= Mem1(to_integer(rd_ptr));
+					Mem2_out <= Mem2(to_integer(rd_ptr));
+					Mem3_out <= Mem3(to_integer(rd_ptr));
 
-				rd_ptr   <= rd_ptr - 1;
+					rd_ptr   <= rd_ptr - 1;
+				end if;
 			end if;
 			
 			if rst = '1' then
@@ -382,7 +425,14 @@ begin
 		end if;
 	end process;
 
-	o_data.cnt     <= (resize(dw_cnt_out, 3) + 1);
+	-- MemLines are written from the top, a MemLine at or above the lowest written one is complete
+	rd_line_ready <= '1' when tag_readable(to_integer(rd_tag_ptr)) = '1' or
+	                          (wr_line_vld(to_integer(rd_tag_ptr)) = '1' and
+	                           wr_line(to_integer(rd_tag_ptr)) <= rd_ptr(byteCountBits-5-1 downto 0))
+	                     else '0';
+
+	o_data.cnt        <= (resize(dw_cnt_out, 3) + 1);
+	o_data.last_bytes <= last_bytes_out;
 	o_data.payload <= std_ulogic_vector(
 		unsigned'(Mem3_out & Mem2_out & Mem1_out & Mem0_out)
 	);
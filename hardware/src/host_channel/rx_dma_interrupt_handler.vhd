@@ -8,6 +8,7 @@ use work.host_channel_types.all;
 entity rx_dma_interrupt_handler is
 	generic (
 		debug : boolean := false;
+		QUEUE_DEPTH : positive := 1;
 		CHANNEL_ID: natural
 	);
 	port (
@@ -24,11 +25,32 @@ entity rx_dma_interrupt_handler is
 		instr_vld : in std_logic;
 		instr     : in interrupt_instr_t;
 
+		-- next queued transfer
+		xfer_vld  : in  std_logic;
+		xfer_req  : out std_logic;
+
+		-- abort by the host, see dma_interrupt_handler
+		abort      : in  std_logic := '0';
+		halt       : out std_logic;
+		rq_pending : in  std_logic := '0';
+
+		-- MRds taken by the writer, the abort waits for their completions
+		rq_vld     : in  std_logic := '0';
+		rq_length  : in  unsigned(9 downto 0) := (others => '0');
+
 		-- input ports for data stream to be observed, only length field in header is relevant.
 		-- no req signal needed: never interferes with observed data stream.
 		cpl_vld : in std_logic;
 		cpl     : in fragment;
 
+		-- output stream of the dma buffer to the user core, observed for the checksum
+		user_vld : in std_logic := '0';
+		user_req : in std_logic := '0';
+		user     : in rx_stream := default_rx_stream;
+
+		-- endpoint cycle counter for transaction timestamps
+		timestamp : in unsigned(63 downto 0) := (others => '0');
+
 		-- output port "packer" to packer
 		writer_vld     : out std_logic;
 		writer_req     : in  std_logic;
@@ -40,22 +62,132 @@ end entity rx_dma_interrupt_handler;
 architecture RTL of rx_dma_interrupt_handler is
 	signal transfer_vld : std_logic;
 	signal transfer_length : unsigned(9 downto 0);
+	signal transfer_unused : unsigned(1 downto 0);
+
+	signal user_taken : std_logic;
+	signal xfer_start_req : std_logic;
+	signal crc_clear : std_logic;
+	signal crc_vld : std_logic;
+	signal crc : std_logic_vector(31 downto 0);
+	signal crc_bytes : unsigned(31 downto 0);
+	signal transfer_eof : std_logic;
+
+	-- bytes completed and not taken by the user core yet, the ones of
+	-- earlier transfers when the current one started, and the ones
+	-- completed for the current transfer
+	signal backlog : unsigned(31 downto 0) := (others => '0');
+	signal skip : unsigned(31 downto 0) := (others => '0');
+	signal received : unsigned(31 downto 0) := (others => '0');
+
+	-- DWords requested by MRds and not completed yet
+	signal outstanding : unsigned(31 downto 0) := (others => '0');
+	signal drained : std_logic;
+
+	-- valid bytes of a word of the user stream, see crc32c_stream
+	function word_bytes(word: rx_stream) return unsigned is
+		variable ret : unsigned(4 downto 0);
+	begin
+		ret := word.cnt & "00";
+		if word.cnt /= 0 and word.last_bytes /= 0 then
+			ret := ret - 4 + word.last_bytes;
+		end if;
+		return resize(ret, 32);
+	end function;
 
 begin
 
+xfer_req <= xfer_start_req;
+
 filter: entity work.rx_dma_interrupt_handler_filter
 	port map(
 		cpl_vld         => cpl_vld,
 		cpl             => cpl,
 		transfer_vld    => transfer_vld,
-		transfer_length => transfer_length
+		transfer_length => transfer_length,
+		transfer_unused => transfer_unused
 	);
 
+-- with the checksum enabled an aborted transfer also waits until the user
+-- core took its data, so none of it is counted for the next transfer
+drained <= '1' when outstanding = 0 and (instr.crc_en = '0' or crc_bytes = received) else '0';
+
+track_mrd: process
+	variable requested, completed : unsigned(9 downto 0);
+begin
+	wait until rising_edge(clk);
+	requested := (others => '0');
+	completed := (others => '0');
+	if rq_vld = '1' then
+		requested := rq_length;
+	end if;
+	if transfer_vld = '1' then
+		completed := transfer_length;
+	end if;
+	outstanding <= outstanding + requested - completed;
+	if rst = '1' then
+		outstanding <= (others => '0');
+	end if;
+end process;
+
+-- checksum of the data handed to the user core, restarted with every
+-- transaction. Data of earlier transfers still in the buffer when it starts
+-- is skipped, a word of the user stream never holds data of two transfers.
+user_taken <= user_vld and user_req;
+crc_clear  <= xfer_vld and xfer_start_req;
+crc_vld    <= user_taken when skip = 0 else '0';
+
+track_bytes: process
+	variable completed, taken : unsigned(31 downto 0);
+begin
+	wait until rising_edge(clk);
+	completed := (others => '0');
+	taken     := (others => '0');
+	if transfer_vld = '1' then
+		completed := resize(transfer_length & "00", 32) - transfer_unused;
+	end if;
+	if user_taken = '1' then
+		taken := word_bytes(user);
+	end if;
+	backlog <= backlog + completed - taken;
+
+	if crc_clear = '1' then
+		skip     <= backlog + completed - taken;
+		received <= (others => '0');
+	else
+		if skip /= 0 then
+			skip <= skip - taken;
+		end if;
+		received <= received + completed;
+	end if;
+
+	if rst = '1' then
+		backlog  <= (others => '0');
+		skip     <= (others => '0');
+		received <= (others => '0');
+	end if;
+end process;
+
+checksum: entity work.crc32c_stream
+	port map(
+		clk          => clk,
+		clear        => crc_clear,
+		i_vld        => crc_vld,
+		i_data       => user.payload,
+		i_cnt        => user.cnt,
+		i_last_bytes => user.last_bytes,
+		crc          => crc,
+		bytes        => crc_bytes
+	);
+
+-- with the checksum enabled the interrupt waits until the user core took all data
+transfer_eof <= '1' when instr.crc_en = '0' or crc_bytes = received else '0';
+
 handler: entity work.dma_interrupt_handler
 	generic map(
-		debug      => debug,
-		CHANNEL_ID => CHANNEL_ID,
-		direction  => "rx"
+		debug       => debug,
+		CHANNEL_ID  => CHANNEL_ID,
+		QUEUE_DEPTH => QUEUE_DEPTH,
+		direction   => "rx"
 	)
 	port map(
 		clk             => clk,
@@ -63,10 +195,19 @@ handler: entity work.dma_interrupt_handler
 		ctrl_rst        => ctrl_rst,
 		instr_vld       => instr_vld,
 		instr           => instr,
+		xfer_vld        => xfer_vld,
+		xfer_req        => xfer_start_req,
+		abort           => abort,
+		halt            => halt,
+		rq_pending      => rq_pending,
+		drained         => drained,
 		transfer_vld    => transfer_vld,
 		transfer_length => transfer_length,
+		transfer_unused => transfer_unused,
 		transfer_eot    => '0',
-		transfer_eof    => '1',
+		transfer_eof    => transfer_eof,
+		timestamp       => timestamp,
+		crc             => crc,
 		writer_vld      => writer_vld,
 		writer_req      => writer_req,
 		writer          => writer,
@@ -11,13 +11,20 @@ entity rx_dma_interrupt_handler_filter is
 		cpl      : in fragment;
 		
 		transfer_vld    : out std_logic;
-		transfer_length : out unsigned(9 downto 0)
+		transfer_length : out unsigned(9 downto 0);
+		transfer_unused : out unsigned(1 downto 0)
 	);
 end entity rx_dma_interrupt_handler_filter;
 
 architecture RTL of rx_dma_interrupt_handler_filter is
-	
+	signal dword0 : common_dw0;
+	signal dword1 : cpld_dw1;
 begin
+	dword0 <= to_common_dw0(get_dword(cpl, 0));
+	dword1 <= to_cpld_dw1(get_dword(cpl, 1));
+
 	transfer_vld    <= cpl_vld and cpl.sof;
-	transfer_length <= unsigned(to_common_dw0(get_dword(cpl, 0)).length);
+	transfer_length <= unsigned(dword0.length);
+	-- only the last CplD of a request ends with a partial DWORD
+	transfer_unused <= "00" - unsigned(dword1.last_bytes) when dword0.length = dword1.byte_count(11 downto 2) else "00";
 end architecture RTL;
@@ -26,12 +26,14 @@ entity tx_dma_fifo is
 		o      : out tx_stream;
 
 		end_of_transfer : out std_logic;
+		-- valid bytes in the last DWORD of the transfer, valid with end_of_transfer
+		end_of_transfer_bytes : out unsigned(1 downto 0) := "00";
 		data_count      : out unsigned(11 downto 0)
 	);
 end tx_dma_fifo;
 
 architecture arch of tx_dma_fifo is
-	type   RAM_t  is array (0 to 511) of std_logic_vector(131 downto 0);
+	type   RAM_t  is array (0 to 511) of std_logic_vector(133 downto 0);
 	signal memory : RAM_t := (others => (others => '0'));
 
 	signal wr_ptr, rd_ptr : unsigned(8 downto 0) := (others => '0');
@@ -43,7 +45,7 @@ architecture arch of tx_dma_fifo is
 	signal rst_state : rst_state_t := WAIT_FOR_EOT;
 
 	signal written, read : unsigned(2 downto 0) := (others => '0');
-	signal mem_out  : std_logic_vector(131 downto 0) := (others => '0');
+	signal mem_out  : std_logic_vector(133 downto 0) := (others => '0');
 
 	signal data_cnt : unsigned(11 downto 0) := (others => '0');
 begin
@@ -53,7 +55,8 @@ i_req <= not i_vld when state = FULL or rst_state = WAIT_FOR_RST else '1';
 o <= (
 	 payload       => mem_out(127 downto 0),
 	 cnt           => unsigned(mem_out(130 downto 128)),
-	 end_of_stream => mem_out(131)
+	 end_of_stream => mem_out(131),
+	 last_bytes    => unsigned(mem_out(133 downto 132))
  );
 
 written <= unsigned(i.cnt) when state /= FULL and rst_state /= WAIT_FOR_RST and i_vld = '1' else "000";
@@ -74,7 +77,7 @@ begin
 	if state /= FULL and i_vld = '1' and rst_state = WAIT_FOR_EOT then
 		wr_ptr <= wr_ptr + 1;
 		memory(to_integer(wr_ptr)) <=
-			i.end_of_stream & std_logic_vector(i.cnt) & i.payload;
+			std_logic_vector(i.last_bytes) & i.end_of_stream & std_logic_vector(i.cnt) & i.payload;
 	end if;
 
 	if state /= EMPTY and o_req = '1' then
@@ -102,6 +105,7 @@ begin
 			if i.end_of_stream = '1' then
 				rst_state <= WAIT_FOR_RST;
 				end_of_transfer <= '1';
+				end_of_transfer_bytes <= i.last_bytes;
 			end if;
 		end if;
 	when TRANSFER =>
@@ -114,6 +118,7 @@ begin
 		if i_vld = '1' and i.end_of_stream = '1' and rst_state = WAIT_FOR_EOT then
 			rst_state <= WAIT_FOR_RST;
 			end_of_transfer <= '1';
+			end_of_transfer_bytes <= i.last_bytes;
 		end if;
 	when FULL =>
 		if o_req = '1' then
@@ -8,6 +8,7 @@ use work.host_channel_types.all;
 entity tx_dma_interrupt_handler is
 	generic(
 		debug : boolean := false;
+		QUEUE_DEPTH : positive := 1;
 		CHANNEL_ID : natural
 	);
 	port (
@@ -24,6 +25,20 @@ entity tx_dma_interrupt_handler is
 		instr_vld : in std_logic;
 		instr     : in interrupt_instr_t;
 
+		-- next queued transfer
+		xfer_vld  : in  std_logic;
+		xfer_req  : out std_logic;
+
+		-- abort by the host, see dma_interrupt_handler
+		abort      : in  std_logic := '0';
+		halt       : out std_logic;
+		rq_pending : in  std_logic := '0';
+
+		-- completion deadline, see dma_interrupt_handler
+		data_pending : in  std_logic := '0';
+		flush        : out std_logic;
+		flushed      : in  std_logic := '1';
+
 		-- input ports for data stream to be observed, only length field in header is relevant.
 		-- no req signal needed: never interferes with observed data stream.
 		mwr_vld : in std_logic;
@@ -31,6 +46,9 @@ entity tx_dma_interrupt_handler is
 		mwr     : in fragment;
 		mwr_eot : in std_logic;
 
+		-- endpoint cycle counter for transaction timestamps
+		timestamp : in unsigned(63 downto 0) := (others => '0');
+
 		-- output port "packer" to packer
 		writer_vld     : out std_logic;
 		writer_req     : in  std_logic;
@@ -42,11 +60,26 @@ end entity tx_dma_interrupt_handler;
 architecture RTL of tx_dma_interrupt_handler is
 	signal transfer_vld : std_logic;
 	signal transfer_length : unsigned(9 downto 0);
+	signal transfer_unused : unsigned(1 downto 0);
 	signal transfer_eot : std_logic;
 	signal transfer_eof : std_logic;
 
+	signal payload_vld : std_logic;
+	signal payload : std_ulogic_vector(127 downto 0);
+	signal payload_cnt : unsigned(2 downto 0);
+	signal payload_last_bytes : unsigned(1 downto 0);
+	signal xfer_start_req : std_logic;
+	signal crc_clear : std_logic;
+	signal crc : std_logic_vector(31 downto 0);
+
+	-- a MWr is being sent, it is completed before an abort ends
+	signal in_mwr  : std_logic := '0';
+	signal drained : std_logic;
+
 begin
 
+xfer_req <= xfer_start_req;
+
 filter: entity work.tx_dma_interrupt_handler_filter
 	port map(
 		clk => clk,
@@ -56,15 +89,49 @@ filter: entity work.tx_dma_interrupt_handler_filter
 		mwr_eot => mwr_eot,
 		transfer_vld => transfer_vld,
 		transfer_length => transfer_length,
+		transfer_unused => transfer_unused,
 		transfer_eof => transfer_eof,
-		transfer_eot => transfer_eot
+		transfer_eot => transfer_eot,
+		payload_vld => payload_vld,
+		payload => payload,
+		payload_cnt => payload_cnt,
+		payload_last_bytes => payload_last_bytes
+	);
+
+drained <= '0' when in_mwr = '1' or (mwr_vld = '1' and mwr.sof = '1') else '1';
+
+track_mwr: process
+begin
+	wait until rising_edge(clk);
+	if mwr_vld = '1' and mwr_req = '1' then
+		in_mwr <= not mwr.eof;
+	end if;
+	if rst = '1' then
+		in_mwr <= '0';
+	end if;
+end process;
+
+-- checksum of the data written to the buffer, restarted with every transaction
+crc_clear <= xfer_vld and xfer_start_req;
+
+checksum: entity work.crc32c_stream
+	port map(
+		clk          => clk,
+		clear        => crc_clear,
+		i_vld        => payload_vld,
+		i_data       => payload,
+		i_cnt        => payload_cnt,
+		i_last_bytes => payload_last_bytes,
+		crc          => crc,
+		bytes        => open
 	);
 
 handler: entity work.dma_interrupt_handler
 	generic map(
-		debug      => debug,
-		CHANNEL_ID => CHANNEL_ID,
-		direction  => "tx"
+		debug       => debug,
+		CHANNEL_ID  => CHANNEL_ID,
+		QUEUE_DEPTH => QUEUE_DEPTH,
+		direction   => "tx"
 	)
 	port map(
 		clk             => clk,
@@ -72,10 +139,22 @@ handler: entity work.dma_interrupt_handler
 		ctrl_rst        => ctrl_rst,
 		instr_vld       => instr_vld,
 		instr           => instr,
+		xfer_vld        => xfer_vld,
+		xfer_req        => xfer_start_req,
+		abort           => abort,
+		halt            => halt,
+		rq_pending      => rq_pending,
+		drained         => drained,
+		data_pending    => data_pending,
+		flush           => flush,
+		flushed         => flushed,
 		transfer_vld    => transfer_vld,
 		transfer_length => transfer_length,
+		transfer_unused => transfer_unused,
 		transfer_eot    => transfer_eot,
 		transfer_eof    => transfer_eof,
+		timestamp       => timestamp,
+		crc             => crc,
 		writer_vld      => writer_vld,
 		writer_req      => writer_req,
 		writer          => writer,
@@ -16,15 +16,25 @@ entity tx_dma_interrupt_handler_filter is
 
 		transfer_vld    : out std_logic;
 		transfer_length : out unsigned(9 downto 0);
+		transfer_unused : out unsigned(1 downto 0);
 		transfer_eof    : out std_logic;
-		transfer_eot    : out std_logic
+		transfer_eot    : out std_logic;
+
+		-- payload words of the MWrs for the CRC
+		payload_vld        : out std_logic;
+		payload            : out std_ulogic_vector(127 downto 0);
+		payload_cnt        : out unsigned(2 downto 0);
+		payload_last_bytes : out unsigned(1 downto 0)
 	);
 end entity tx_dma_interrupt_handler_filter;
 
 architecture RTL of tx_dma_interrupt_handler_filter is
 	signal dword0 : common_dw0;
+	signal dword1 : rqst_dw1;
+	signal mwr_last_bytes : unsigned(1 downto 0) := "00";
 begin
 dword0 <= to_common_dw0(get_dword(mwr, 0));
+dword1 <= to_rqst_dw1(get_dword(mwr, 1));
 
 filter: process
 begin
@@ -33,6 +43,21 @@ begin
 	transfer_vld    <= (mwr_vld and mwr_req and mwr.sof) when dword0.desc = MWr32_desc or dword0.desc = MWr64_desc else '0';
 	transfer_eof    <= mwr_vld and mwr_req and mwr.eof;
 	transfer_length <= unsigned(dword0.length);
+	-- a partial last DWORD is marked by its byte enables
+	transfer_unused <= be2unused(dword1.first_be) when unsigned(dword0.length) = 1 else be2unused(dword1.last_be);
 	transfer_eot    <= mwr_eot;
+
+	-- only MWrs have more than one word, the header word carries no payload
+	payload_vld        <= mwr_vld and mwr_req and not mwr.sof;
+	payload            <= mwr.data;
+	payload_cnt        <= keep2cnt(mwr.keep);
+	payload_last_bytes <= mwr_last_bytes when mwr.eof = '1' else "00";
+	if mwr_vld = '1' and mwr_req = '1' and mwr.sof = '1' then
+		if unsigned(dword0.length) = 1 then
+			mwr_last_bytes <= "00" - be2unused(dword1.first_be);
+		else
+			mwr_last_bytes <= "00" - be2unused(dword1.last_be);
+		end if;
+	end if;
 end process;
 end architecture RTL;
@@ -33,6 +33,11 @@ entity tx_dma_writer is
 		payload     : in  tx_stream;
 		payload_cnt : in  unsigned(11 downto 0);
 		payload_eot : in  std_logic := '0';
+		payload_eot_bytes : in unsigned(1 downto 0) := "00";
+
+		-- send the data held early, see dma_writer_packer
+		flush   : in  std_logic := '0';
+		flushed : out std_logic;
 
 		o     : out fragment := default_fragment;
 		o_eot : out std_logic;
@@ -71,6 +76,9 @@ writer_packer: entity work.dma_writer_packer
 		payload     => buf,
 		payload_cnt => buf_cnt,
 		payload_eot => buf_eot,
+		payload_eot_bytes => payload_eot_bytes,
+		flush       => flush,
+		flushed     => flushed,
 		o           => o,
 		o_eot       => o_eot,
 		o_vld       => o_vld,
@@ -91,6 +91,12 @@ package pcie is
 	--!   request finishes the overall transaction, or a request would cross
 	--!   a page boundary in main memory.
 	--!
+	--!   The value is the upper bound the hardware is synthesized for, the
+	--!   driver reads `DevCtl` when the device is probed and programs the
+	--!   actual size of every channel (register 10 of the channel). Setting
+	--!   the maximum to 4096 therefore works on every host, at the cost of
+	--!   block RAM in the @ref rx_host_channel instances.
+	--!
 	--! * `max_payload_bytes`:
 	--!
 	--!   Sets the maximum number of bytes a channel is allowed to
@@ -103,6 +109,9 @@ package pcie is
 	--!   . They will not do so if either the outstanding request is smaller
 	--!   than `max_payload_bytes` or if the payload would cross a page boundary
 	--!   on the main memory.
+	--!   Like `max_request_bytes` this is an upper bound, the size used at
+	--!   runtime is programmed by the driver. FPGA tx channels don't have
+	--!   this register yet and always use `max_payload_bytes`.
 	--!
 	--! * `interrupts`:
 	--!
@@ -122,6 +131,41 @@ package pcie is
 	--!   This is mainly used to size the endpoint ports connecting the
 	--!   channel instances.
 	--!
+	--! * `rx_tags_min`, `rx_tags_max`:
+	--!
+	--!   Bounds for the number of outstanding read requests of every
+	--!   @ref host_rx_channel.
+	--!   All channels share the 256 PCIe tags of the endpoint. A reading
+	--!   channel borrows free tags up to `rx_tags_max`, but never takes
+	--!   tags that are needed to give every other channel `rx_tags_min`
+	--!   outstanding requests. A channel without a tag left waits in the
+	--!   rx arbiter, the other channels are not held up by it.
+	--!   `rx_tags_max` also sizes the completion buffer of each channel
+	--!   (`rx_tags_max * max_request_bytes` bytes of block RAM) and must
+	--!   be a power of two between 2 and 256.
+	--!   On hosts with a long read latency a single channel needs roughly
+	--!   `latency * bandwidth / max_request_bytes` outstanding requests
+	--!   to saturate the link, e.g. 2us at 4 GByte/s with 512 byte
+	--!   requests needs 16 tags.
+	--!   `host_rx * rx_tags_min` must not exceed 256.
+	--!   The reservation is kept per channel id, so the Host-FPGA
+	--!   channels must use the ids 1 to `host_rx` and FPGA-FPGA
+	--!   channels the ids above them.
+	--!
+	--! * `desc_queue_depth`:
+	--!
+	--!   Number of buffers the driver may hand to each host channel in
+	--!   advance (1 to 15). The channel starts the next queued buffer as
+	--!   soon as the previous one is complete, instead of waiting for the
+	--!   driver to program it after the completion interrupt.
+	--!   The depth is reported to the driver in the channel info register.
+	--!
+	--! * `trace_depth`:
+	--!
+	--!   Number of entries of the TLP trace buffer in the endpoint core
+	--!   (0 or a power of two up to 32768). The buffer records the headers
+	--!   of the TLPs in both directions for debugging, 0 leaves it out.
+	--!
 	--! Creation functions:
 	--!   * @ref new_config
 	--!
@@ -133,6 +177,11 @@ package pcie is
 	--!   * @ref host_tx_count
 	--!   * @ref fpga_rx_count
 	--!   * @ref fpga_tx_count
+	--!   * @ref rx_tags_min
+	--!   * @ref rx_tags_max
+	--!   * @ref rx_tag_bits
+	--!   * @ref desc_queue_depth
+	--!   * @ref trace_depth
 	type transceiver_configuration is record
 		max_payload_bytes : natural;
 		max_request_bytes : natural;
@@ -141,6 +190,10 @@ package pcie is
 		host_tx_channels : natural;
 		fpga_rx_channels : natural;
 		fpga_tx_channels : natural;
+		rx_tags_min      : natural;
+		rx_tags_max      : natural;
+		desc_queue_depth : natural;
+		trace_depth      : natural;
 	end record;
 
 	--! Create new transceiver configuration
@@ -158,6 +211,10 @@ package pcie is
 	--! @param host_rx Number of Host-FPGA channels
 	--! @param fpga_tx Number of outgoing FPGA-FPGA channels
 	--! @param fpga_rx Number of incoming FPGA-FPGA channels
+	--! @param rx_tags_min Guaranteed outstanding reads per Host-FPGA channel
+	--! @param rx_tags_max Maximum outstanding reads per Host-FPGA channel
+	--! @param desc_queue_depth Buffers queued in advance per host channel
+	--! @param trace_depth Entries of the TLP trace buffer, 0 for none
 	function new_config(
 		mpb: natural := 128;
 		mrb: natural := 512;
@@ -165,7 +222,11 @@ package pcie is
 		host_tx: natural;
 		host_rx: natural;
 		fpga_tx: natural := 0;
-		fpga_rx: natural := 0
+		fpga_rx: natural := 0;
+		rx_tags_min: natural := 4;
+		rx_tags_max: natural := 32;
+		desc_queue_depth: natural := 4;
+		trace_depth: natural := 0
 	) return transceiver_configuration;
 
 	--- Accessor functions for the transceiver_configuration record.
@@ -205,6 +266,26 @@ package pcie is
 	--! transceiver_configuration.
 	function fpga_tx_count(conf: transceiver_configuration) return natural;
 
+	--! Get the number of tags reserved for every Host-FPGA channel of a
+	--! transceiver_configuration.
+	function rx_tags_min(conf: transceiver_configuration) return natural;
+
+	--! Get the maximum number of tags a Host-FPGA channel of a
+	--! transceiver_configuration may use.
+	function rx_tags_max(conf: transceiver_configuration) return natural;
+
+	--! Get the number of bits of the channel-local tags of a
+	--! transceiver_configuration (log2 of @ref rx_tags_max).
+	function rx_tag_bits(conf: transceiver_configuration) return natural;
+
+	--! Get the number of buffers every host channel of a
+	--! transceiver_configuration can queue.
+	function desc_queue_depth(conf: transceiver_configuration) return natural;
+
+	--! Get the number of TLP trace buffer entries of a
+	--! transceiver_configuration.
+	function trace_depth(conf: transceiver_configuration) return natural;
+
 	---
 
 	--! Datatype used by all outgoing channels of the transceiver.
@@ -239,6 +320,14 @@ package pcie is
 	--! In this case all DWords whose indices are smaller or equal to `cnt` - 1
 	--! are interpreted as valid and all other DWords are ignored.
 	--!
+	--! Host channels additionally support transmissions which end in the
+	--! middle of a DWord:
+	--! `last_bytes` gives the number of valid bytes of DWord `cnt` - 1 in
+	--! the word marked with `end_of_stream`, starting at the lowest byte.
+	--! `0` means all four bytes are valid.
+	--! The host reads the exact number of bytes, no padding is transferred.
+	--! `last_bytes` is ignored for all other words and by FPGA channels.
+	--!
 	--! **Warning!**:
 	--! Setting `cnt` to anything less than 4 at any time other than the last
 	--! word of a transmission is considered an error will probably result in
@@ -246,6 +335,7 @@ package pcie is
 	type tx_stream is record
 		payload       : std_ulogic_vector(127 downto 0);
 		cnt           : unsigned(2 downto 0);
+		last_bytes    : unsigned(1 downto 0);
 		end_of_stream : std_ulogic;
 	end record;
 
@@ -253,6 +343,7 @@ package pcie is
 	constant default_tx_stream: tx_stream := (
 		payload       => (others => '0'),
 		cnt           => (others => '0'),
+		last_bytes    => (others => '0'),
 		end_of_stream => '0'
 	);
 
@@ -279,15 +370,24 @@ package pcie is
 	--! `cnt` - 1 are valid, while all DWords with an index larger than `cnt`
 	--! should be ignored.
 	--! This may happen at any time during a transaction.
+	--!
+	--! If the host writes a number of bytes that is not a multiple of four,
+	--! the host channel marks the last DWord of the transfer with
+	--! `last_bytes`, the number of valid bytes of DWord `cnt` - 1 starting
+	--! at the lowest byte.
+	--! `last_bytes` is `0` whenever all bytes of the word are valid and is
+	--! always `0` on FPGA channels.
 	type rx_stream is record
-		payload : std_ulogic_vector(127 downto 0);
-		cnt     : unsigned(2 downto 0);
+		payload    : std_ulogic_vector(127 downto 0);
+		cnt        : unsigned(2 downto 0);
+		last_bytes : unsigned(1 downto 0);
 	end record;
 
 	--! Default value to initialize rx_stream signals with.
 	constant default_rx_stream: rx_stream := (
-		payload => (others => '0'),
-		cnt     => (others => '0')
+		payload    => (others => '0'),
+		cnt        => (others => '0'),
+		last_bytes => (others => '0')
 	);
 
 	--! Convenience vector type to handle multiple rx_stream signals.
@@ -324,6 +424,41 @@ package pcie is
 	--! Vector type to handle multiple fragments.
 	type fragment_vector is array (natural range <>) of fragment;
 
+	--! Operating modes of the @ref traffic_generator.
+	--!
+	--! * `TRAFFIC_OFF`: the user design is connected to the channels.
+	--! * `TRAFFIC_STREAM`: pattern data is generated on the tx channel and
+	--!   checked on the rx channel at line rate.
+	--! * `TRAFFIC_PING`: every message received on the rx channel is echoed
+	--!   on the tx channel to measure the round-trip latency.
+	type traffic_mode is (TRAFFIC_OFF, TRAFFIC_STREAM, TRAFFIC_PING);
+
+	--! Settings of the @ref traffic_generator, written by the host to the
+	--! config channel and distributed by the endpoint.
+	type traffic_control is record
+		mode : traffic_mode;
+	end record;
+
+	--! Default value to initialize traffic_control signals with.
+	constant default_traffic_control: traffic_control := (
+		mode => TRAFFIC_OFF
+	);
+
+	--! Counters of the @ref traffic_generator, readable by the host through
+	--! the config channel.
+	--! `dwords` counts the DWords received on the rx channel while a test is
+	--! running, `errors` the DWords which didn't match the pattern.
+	type traffic_counters is record
+		dwords : unsigned(31 downto 0);
+		errors : unsigned(31 downto 0);
+	end record;
+
+	--! Default value to initialize traffic_counters signals with.
+	constant default_traffic_counters: traffic_counters := (
+		dwords => (others => '0'),
+		errors => (others => '0')
+	);
+
 	--! PCIe-2 Endpoint
 	--!
 	--! Connects the different channel modules to a PCIe-2 physical
@@ -404,8 +539,19 @@ package pcie is
 			--
 			to_tx_vld   : out std_ulogic_vector(tx_count(config)-1 downto 0);
 			to_tx_req   : in  std_ulogic_vector(tx_count(config)-1 downto 0);
-			to_tx       : out fragment_vector(tx_count(config)-1 downto 0)
+			to_tx       : out fragment_vector(tx_count(config)-1 downto 0);
 			---
+
+			--! Free running cycle counter of the endpoint clock domain.
+			--! Connect it to the `timestamp` port of the host channels to
+			--! enable per-transaction timestamps (see @ref host_rx_channel).
+			timestamp   : out unsigned(63 downto 0);
+
+			--! Control and counters of an optional
+			--! @ref traffic_generator, connect them to its
+			--! `ctrl` and `status` ports.
+			traffic_ctrl   : out traffic_control;
+			traffic_status : in  traffic_counters := default_traffic_counters
 		);
 	end component;
 
@@ -415,7 +561,8 @@ package pcie is
 	--! constant of the corresponding endpoint.
 	--! The id must be unique for all channels connected to the
 	--! same endpoint.
-	--! It also **must** be in the interval [1, rx_count(config)].
+	--! It also **must** be in the interval [1, host_rx_count(config)],
+	--! the tag reservation of `rx_tags_min` is indexed by it.
 	--! The 'from_ep' and 'to_ep' interfaces need to be connected to the
 	--! 'to_rx'/'from_rx' interfaces of the endpoit.
 	--! The user data is delivered at the 'o' interface.
@@ -423,6 +570,10 @@ package pcie is
 	--! inserted. These submodules observe several ports inside the
 	--! channel and contain signal with set 'mark_debug' attributes
 	--! for easier debugging with ILAs.
+	--! If 'timestamp' is connected to the endpoint's 'timestamp' port, the
+	--! channel records the cycle of the doorbell, the first and the last
+	--! data TLP of every transaction, which the host can read back after
+	--! the completion interrupt.
 	component host_rx_channel
 		generic(
 			debug  : boolean := false;
@@ -440,7 +591,8 @@ package pcie is
 			to_ep_req   : in  std_ulogic;
 			o           : out rx_stream := default_rx_stream;
 			o_vld       : out std_ulogic := '0';
-			o_req       : in  std_ulogic
+			o_req       : in  std_ulogic;
+			timestamp   : in  unsigned(63 downto 0) := (others => '0')
 		);
 	end component;
 
@@ -460,6 +612,8 @@ package pcie is
 	--! inserted. These submodules observe several ports inside the
 	--! channel and contain signal with set 'mark_debug' attributes
 	--! for easier debugging with ILAs.
+	--! The optional 'timestamp' port behaves like the one of
+	--! @ref host_rx_channel.
 	component host_tx_channel
 		generic(
 			debug  : boolean := false;
@@ -477,7 +631,8 @@ package pcie is
 			from_ep_req : out std_logic;
 			to_ep       : out fragment;
 			to_ep_vld   : out std_logic;
-			to_ep_req   : in  std_logic
+			to_ep_req   : in  std_logic;
+			timestamp   : in  unsigned(63 downto 0) := (others => '0')
 		);
 	end component host_tx_channel;
 
@@ -498,11 +653,20 @@ package pcie is
 	--! The resulting actual depth is equal to '2 ** fifo_addr_bits'.
 	--! The selected default shouldn't affect performance and is selected
 	--! to use a minimal number of BRAM resources for implementation.
+	--!
+	--! With 'max_peers' greater than 1 (up to 8) the channel can send the
+	--! same data to several @ref fpga_rx_channel instances at once.
+	--! Every write request is stored and sent once per peer, so the link
+	--! carries the data once for every peer, and data is only sent as far
+	--! as all peers have granted space, i.e. the channel runs at the speed
+	--! of the slowest receiver.
+	--! The peers are set up by the host, see the driver README.
 	component fpga_tx_channel
 		generic(
 			config         : transceiver_configuration;
 			id             : positive;
-			fifo_addr_bits : positive := 9
+			fifo_addr_bits : positive := 9;
+			max_peers      : positive := 1
 		);
 		port(
 			clk         : in  std_logic;
@@ -525,7 +689,8 @@ package pcie is
 	--! constant of the corresponding endpoint.
 	--! The id must be unique for all channels connected to the
 	--! same endpoint.
-	--! It also **must** be in the interval [1, rx_count(config)].
+	--! It also **must** be in the interval [1, rx_count(config)] and
+	--! above the ids of all @ref host_rx_channel.
 	--! The 'from_ep' and 'to_ep' interfaces need to be connected to the
 	--! 'to_rx'/'from_rx' interfaces of the endpoit.
 	--! The user data is delivered at the 'o' interface.
@@ -535,11 +700,20 @@ package pcie is
 	--! The resulting actual depth is equal to '2 ** fifo_addr_bits'.
 	--! The selected default shouldn't affect performance and is selected
 	--! to use a minimal number of BRAM resources for implementation.
+	--!
+	--! The channel grants its free FIFO space to the sending
+	--! @ref fpga_tx_channel with posted writes, the whole FIFO once the
+	--! host set it up and then whenever the user logic read 'credit_bytes'
+	--! (0 selects a quarter of the FIFO, but at least one max. payload).
+	--! The sender streams max. payload sized writes as long as it has
+	--! credit, so the FIFO can't overflow and the link is kept busy as long
+	--! as the FIFO covers the round trip of a grant.
 	component fpga_rx_channel
 		generic(
 			config         : transceiver_configuration;
 			id             : positive;
-			fifo_addr_bits : positive := 9
+			fifo_addr_bits : positive := 9;
+			credit_bytes   : natural := 0
 		);
 		port(
 			clk         : in  std_logic;
@@ -567,9 +741,36 @@ package body pcie is
 		host_tx: natural;
 		host_rx: natural;
 		fpga_tx: natural := 0;
-		fpga_rx: natural := 0
+		fpga_rx: natural := 0;
+		rx_tags_min: natural := 4;
+		rx_tags_max: natural := 32;
+		desc_queue_depth: natural := 4;
+		trace_depth: natural := 0
 	) return transceiver_configuration is
+		variable pow2: natural := 2;
 	begin
+		while pow2 < rx_tags_max loop
+			pow2 := pow2 * 2;
+		end loop;
+		assert pow2 = rx_tags_max and rx_tags_max <= 256
+			report "rx_tags_max must be a power of two between 2 and 256"
+			severity failure;
+		assert rx_tags_min <= rx_tags_max
+			report "rx_tags_min must not exceed rx_tags_max"
+			severity failure;
+		assert host_rx * rx_tags_min <= 256
+			report "Not enough PCIe tags to reserve rx_tags_min for every channel"
+			severity failure;
+		assert desc_queue_depth >= 1 and desc_queue_depth <= 15
+			report "desc_queue_depth must be between 1 and 15"
+			severity failure;
+		pow2 := 1;
+		while pow2 < trace_depth loop
+			pow2 := pow2 * 2;
+		end loop;
+		assert trace_depth = 0 or (pow2 = trace_depth and trace_depth <= 32768)
+			report "trace_depth must be 0 or a power of two up to 32768"
+			severity failure;
 		return transceiver_configuration'(
 			max_payload_bytes => mpb,
 			max_request_bytes => mrb,
@@ -577,7 +778,11 @@ package body pcie is
 			host_rx_channels => host_rx,
 			host_tx_channels => host_tx,
 			fpga_rx_channels => fpga_rx,
-			fpga_tx_channels => fpga_tx
+			fpga_tx_channels => fpga_tx,
+			rx_tags_min      => rx_tags_min,
+			rx_tags_max      => rx_tags_max,
+			desc_queue_depth => desc_queue_depth,
+			trace_depth      => trace_depth
 		);
 	end;
 
@@ -631,4 +836,33 @@ package body pcie is
 	begin
 		return conf.host_tx_channels;
 	end;
+
+	function rx_tags_min(conf: transceiver_configuration) return natural is
+	begin
+		return conf.rx_tags_min;
+	end;
+
+	function rx_tags_max(conf: transceiver_configuration) return natural is
+	begin
+		return conf.rx_tags_max;
+	end;
+
+	function rx_tag_bits(conf: transceiver_configuration) return natural is
+		variable ret: natural := 0;
+	begin
+		while 2**ret < conf.rx_tags_max loop
+			ret := ret + 1;
+		end loop;
+		return ret;
+	end;
+
+	function desc_queue_depth(conf: transceiver_configuration) return natural is
+	begin
+		return conf.desc_queue_depth;
+	end;
+
+	function trace_depth(conf: transceiver_configuration) return natural is
+	begin
+		return conf.trace_depth;
+	end;
 end package body;
@@ -34,4 +34,108 @@ package pcie_utilities is
 		o_vld: out std_ulogic := '0';
 		o_req: in std_ulogic);
 	end component;
+
+	--! Traffic generator, checker and echo for a pair of host channels
+
+	--! Placed between a @ref host_rx_channel, a @ref host_tx_channel and
+	--! the user design, it lets the host measure the link with the same
+	--! bitstream that runs the application.
+	--! The mode is set by the host in register 3 of the config channel and
+	--! reaches the module through the `traffic_ctrl` port of the endpoint,
+	--! the counters are read back through `traffic_status` (registers 5
+	--! and 6).
+	--! * `TRAFFIC_OFF`: the user design is connected to the channels.
+	--! * `TRAFFIC_STREAM`: the tx channel sends an endless stream of
+	--!   incrementing 32 bit counters starting at 0 and the data of the rx
+	--!   channel is checked against the same pattern. Every DWord that
+	--!   doesn't follow its predecessor is counted as an error.
+	--!   When the mode is changed the stream is closed with an
+	--!   `end_of_stream` word, so the host must keep reading until the
+	--!   last buffer arrives.
+	--! * `TRAFFIC_PING`: every message written to the rx channel is
+	--!   echoed on the tx channel. A message ends when no word follows
+	--!   within `ping_timeout` cycles.
+	--!
+	--! The counters are cleared when a test is started from `TRAFFIC_OFF`
+	--! and keep their value when it is stopped.
+	--! The user design should be idle while the mode changes.
+	component traffic_generator
+	generic(ping_timeout: natural := 4);
+	port(
+		clk: in std_ulogic;
+		rst: in std_ulogic;
+
+		ctrl: in pcie.traffic_control;
+		status: out pcie.traffic_counters := pcie.default_traffic_counters;
+
+		rx: in pcie.rx_stream;
+		rx_vld: in std_ulogic;
+		rx_req: out std_ulogic := '0';
+
+		tx: out pcie.tx_stream := pcie.default_tx_stream;
+		tx_vld: out std_ulogic := '0';
+		tx_req: in std_ulogic;
+
+		o: out pcie.rx_stream := pcie.default_rx_stream;
+		o_vld: out std_ulogic := '0';
+		o_req: in std_ulogic;
+
+		i: in pcie.tx_stream;
+		i_vld: in std_ulogic;
+		i_req: out std_ulogic := '0');
+	end component;
+
+	--! Multiplex several virtual streams onto one host tx channel
+
+	--! The user streams are sent in frames, each frame is a header word
+	--! followed by the payload of one stream, padded to a full word:
+	--! * DWord 0: stream id in bits 15:0, `0x5653` in bits 31:16
+	--! * DWord 1: payload bytes of the frame
+	--! * DWord 2 and 3: zero
+	--!
+	--! Streams with waiting data are served round robin. A frame ends after
+	--! `frame_words` words, with a short word or an `end_of_stream` word,
+	--! or when the stream has no data for `hold` cycles.
+	--! The `end_of_stream` of a user stream is passed on to the channel
+	--! after the frame, so buffers can be completed early; otherwise the
+	--! completion deadline of the channel bounds the latency.
+	--! The driver splits the frames into one device file per stream.
+	component vstream_mux
+	generic(
+		streams: positive;
+		frame_words: positive := 32;
+		hold: natural := 8);
+	port(
+		clk: in std_ulogic;
+		rst: in std_ulogic;
+
+		i: in pcie.tx_stream_vector(0 to streams-1);
+		i_vld: in std_ulogic_vector(0 to streams-1);
+		i_req: out std_ulogic_vector(0 to streams-1) := (others => '0');
+
+		o: out pcie.tx_stream := pcie.default_tx_stream;
+		o_vld: out std_ulogic := '0';
+		o_req: in std_ulogic);
+	end component;
+
+	--! Split the frames of one host rx channel into virtual streams
+
+	--! The counterpart of @ref vstream_mux for the host to FPGA direction,
+	--! the frames written by the driver have the same format.
+	--! Frames for a stream id of `streams` or above, or with a wrong header,
+	--! are dropped. A stream that doesn't take its data stalls all others.
+	component vstream_demux
+	generic(streams: positive);
+	port(
+		clk: in std_ulogic;
+		rst: in std_ulogic;
+
+		i: in pcie.rx_stream;
+		i_vld: in std_ulogic;
+		i_req: out std_ulogic := '0';
+
+		o: out pcie.rx_stream_vector(0 to streams-1);
+		o_vld: out std_ulogic_vector(0 to streams-1) := (others => '0');
+		o_req: in std_ulogic_vector(0 to streams-1));
+	end component;
 end package;
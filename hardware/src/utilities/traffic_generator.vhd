@@ -0,0 +1,166 @@
+-- Pattern generator, checker and echo for a pair of host channels, switched
+-- on by the host through the config channel to measure the link without a
+-- dedicated bitstream.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vercolib;
+use vercolib.pcie;
+use vercolib.pcie.all;
+
+
+entity traffic_generator is
+generic(ping_timeout: natural := 4);
+port(
+	clk: in std_ulogic;
+	rst: in std_ulogic;
+
+	ctrl: in pcie.traffic_control;
+	status: out pcie.traffic_counters := pcie.default_traffic_counters;
+
+	-- output of the host rx channel
+	rx: in pcie.rx_stream;
+	rx_vld: in std_ulogic;
+	rx_req: out std_ulogic := '0';
+
+	-- input of the host tx channel
+	tx: out pcie.tx_stream := pcie.default_tx_stream;
+	tx_vld: out std_ulogic := '0';
+	tx_req: in std_ulogic;
+
+	-- user design, connected to the channels while the generator is off
+	o: out pcie.rx_stream := pcie.default_rx_stream;
+	o_vld: out std_ulogic := '0';
+	o_req: in std_ulogic;
+
+	i: in pcie.tx_stream;
+	i_vld: in std_ulogic;
+	i_req: out std_ulogic := '0');
+end entity;
+
+architecture impl of traffic_generator is
+	-- follows ctrl.mode, but stays in TRAFFIC_STREAM until the generated
+	-- stream is closed with an end_of_stream word
+	signal sel: pcie.traffic_mode := TRAFFIC_OFF;
+
+	signal gen: pcie.tx_stream := pcie.default_tx_stream;
+	signal gen_vld: std_ulogic := '0';
+	signal gen_seq: unsigned(31 downto 0) := (others => '0');
+	signal expected: unsigned(31 downto 0) := (others => '0');
+
+	signal echo_in, echo: pcie.tx_stream := pcie.default_tx_stream;
+	signal echo_in_vld, echo_in_req, echo_vld, echo_req: std_ulogic := '0';
+begin
+
+o <= rx;
+o_vld <= rx_vld when sel = TRAFFIC_OFF else '0';
+
+with sel select rx_req <=
+	o_req       when TRAFFIC_OFF,
+	'1'         when TRAFFIC_STREAM,
+	echo_in_req when TRAFFIC_PING;
+
+with sel select tx <=
+	i    when TRAFFIC_OFF,
+	gen  when TRAFFIC_STREAM,
+	echo when TRAFFIC_PING;
+
+with sel select tx_vld <=
+	i_vld    when TRAFFIC_OFF,
+	gen_vld  when TRAFFIC_STREAM,
+	echo_vld when TRAFFIC_PING;
+
+i_req <= tx_req when sel = TRAFFIC_OFF else '0';
+
+
+main: process
+	variable seq, dw: unsigned(31 downto 0);
+	variable errors: natural range 0 to 4;
+begin
+	wait until rising_edge(clk);
+
+	-- pattern source, a DWord counter starting at zero
+	if sel = TRAFFIC_STREAM and (gen_vld = '0' or tx_req = '1') then
+		if gen_vld = '1' and gen.end_of_stream = '1' then
+			gen_vld <= '0';
+			sel <= ctrl.mode;
+		else
+			seq := gen_seq;
+			for idx in 0 to 3 loop
+				gen.payload(32*idx+31 downto 32*idx) <= std_ulogic_vector(seq);
+				seq := seq + 1;
+			end loop;
+			gen.cnt <= to_unsigned(4, 3);
+			gen.end_of_stream <= '1' when ctrl.mode /= TRAFFIC_STREAM else '0';
+			gen_vld <= '1';
+			gen_seq <= seq;
+		end if;
+	end if;
+
+	-- pattern sink, resynchronizes to the received data after an error
+	if sel = TRAFFIC_STREAM and rx_vld = '1' then
+		seq := expected;
+		errors := 0;
+		for idx in 0 to 3 loop
+			if idx < rx.cnt then
+				dw := unsigned(rx.payload(32*idx+31 downto 32*idx));
+				if dw /= seq then
+					errors := errors + 1;
+				end if;
+				seq := dw + 1;
+			end if;
+		end loop;
+		expected <= seq;
+		status.dwords <= status.dwords + rx.cnt;
+		status.errors <= status.errors + errors;
+	end if;
+
+	if sel = TRAFFIC_PING and echo_vld = '1' and echo_req = '1' then
+		status.dwords <= status.dwords + echo.cnt;
+	end if;
+
+	-- counters stay readable after a test and start over with the next one
+	if sel /= TRAFFIC_STREAM and sel /= ctrl.mode then
+		sel <= ctrl.mode;
+		if sel = TRAFFIC_OFF then
+			gen_seq  <= (others => '0');
+			expected <= (others => '0');
+			status   <= pcie.default_traffic_counters;
+		end if;
+	end if;
+
+	if rst = '1' then
+		sel      <= TRAFFIC_OFF;
+		gen_vld  <= '0';
+		gen_seq  <= (others => '0');
+		expected <= (others => '0');
+		status   <= pcie.default_traffic_counters;
+	end if;
+end process;
+
+
+-- ping: words following each other directly are echoed as one message,
+-- the last one is marked to flush the tx channel
+echo_in.payload    <= rx.payload;
+echo_in.cnt        <= rx.cnt;
+echo_in.last_bytes <= rx.last_bytes;
+echo_in_vld <= rx_vld when sel = TRAFFIC_PING else '0';
+echo_req    <= tx_req when sel = TRAFFIC_PING else '0';
+
+echo_timeout: entity vercolib.tx_stream_timeout
+generic map(timeout => ping_timeout)
+port map(
+	clk => clk,
+
+	i => echo_in,
+	i_vld => echo_in_vld,
+	i_req => echo_in_req,
+
+	o => echo,
+	o_vld => echo_vld,
+	o_req => echo_req
+);
+
+end architecture;
@@ -0,0 +1,99 @@
+-- Splits the frames written by the host to one rx channel into the streams
+-- of several virtual channels, see pcie_utilities for the frame format.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vercolib;
+use vercolib.pcie;
+
+
+entity vstream_demux is
+generic(streams: positive);
+port(
+	clk: in std_ulogic;
+	rst: in std_ulogic;
+
+	-- output of the host rx channel
+	i: in pcie.rx_stream;
+	i_vld: in std_ulogic;
+	i_req: out std_ulogic := '0';
+
+	-- user streams, the index is the stream id
+	o: out pcie.rx_stream_vector(0 to streams-1);
+	o_vld: out std_ulogic_vector(0 to streams-1) := (others => '0');
+	o_req: in std_ulogic_vector(0 to streams-1));
+end entity;
+
+architecture impl of vstream_demux is
+	-- frames for unknown streams or with a broken header are dropped
+	type state_t is (HEADER_WORD, DATA_WORD, DROP_WORD);
+	signal state: state_t := HEADER_WORD;
+	signal sel: natural range 0 to streams-1 := 0;
+	signal left: unsigned(31 downto 0) := (others => '0');
+
+	signal cnt: unsigned(2 downto 0);
+	signal last_bytes: unsigned(1 downto 0);
+begin
+
+-- the last word of a frame carries the remaining bytes only
+cnt <= "100" when left >= 16 else resize(shift_right(left + 3, 2), 3);
+last_bytes <= "00" when left >= 16 else left(1 downto 0);
+
+with state select i_req <=
+	o_req(sel) when DATA_WORD,
+	'1'        when others;
+
+process(i, cnt, last_bytes, state, sel, i_vld)
+begin
+	for k in 0 to streams-1 loop
+		o(k).payload <= i.payload;
+		o(k).cnt <= cnt;
+		o(k).last_bytes <= last_bytes;
+		o_vld(k) <= '0';
+	end loop;
+	if state = DATA_WORD then
+		o_vld(sel) <= i_vld;
+	end if;
+end process;
+
+process
+	variable id: natural;
+	variable bytes: unsigned(31 downto 0);
+begin
+	wait until rising_edge(clk);
+
+	case state is
+	when HEADER_WORD =>
+		if i_vld = '1' then
+			id := to_integer(unsigned(i.payload(15 downto 0)));
+			bytes := unsigned(i.payload(63 downto 32));
+			left <= bytes;
+			if bytes = 0 then
+				state <= HEADER_WORD;
+			elsif i.payload(31 downto 16) /= x"5653" or id >= streams then
+				state <= DROP_WORD;
+			else
+				sel <= id;
+				state <= DATA_WORD;
+			end if;
+		end if;
+
+	when DATA_WORD | DROP_WORD =>
+		if i_vld = '1' and (state = DROP_WORD or o_req(sel) = '1') then
+			if left <= 16 then
+				left <= (others => '0');
+				state <= HEADER_WORD;
+			else
+				left <= left - 16;
+			end if;
+		end if;
+	end case;
+
+	if rst = '1' then
+		state <= HEADER_WORD;
+	end if;
+end process;
+
+end architecture;
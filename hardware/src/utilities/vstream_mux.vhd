@@ -0,0 +1,218 @@
+-- Multiplexes the streams of several virtual channels onto one host tx
+-- channel. Every frame is a header word followed by up to `frame_words`
+-- payload words of a single stream, see pcie_utilities for the format.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vercolib;
+use vercolib.pcie;
+
+
+entity vstream_mux is
+generic(
+	streams: positive;
+	frame_words: positive := 32;
+	hold: natural := 8);
+port(
+	clk: in std_ulogic;
+	rst: in std_ulogic;
+
+	-- user streams, the index is the stream id
+	i: in pcie.tx_stream_vector(0 to streams-1);
+	i_vld: in std_ulogic_vector(0 to streams-1);
+	i_req: out std_ulogic_vector(0 to streams-1) := (others => '0');
+
+	-- input of the host tx channel
+	o: out pcie.tx_stream := pcie.default_tx_stream;
+	o_vld: out std_ulogic := '0';
+	o_req: in std_ulogic);
+end entity;
+
+architecture impl of vstream_mux is
+	function header(id: natural; bytes: unsigned(31 downto 0)) return std_ulogic_vector is
+		variable ret: std_ulogic_vector(127 downto 0) := (others => '0');
+	begin
+		ret(15 downto 0) := std_ulogic_vector(to_unsigned(id, 16));
+		ret(31 downto 16) := x"5653";
+		ret(63 downto 32) := std_ulogic_vector(bytes);
+		return ret;
+	end function;
+
+	function word_bytes(w: pcie.tx_stream) return unsigned is
+		variable ret: unsigned(31 downto 0) := (others => '0');
+	begin
+		ret(4 downto 2) := w.cnt;
+		if w.cnt /= 0 and w.last_bytes /= 0 then
+			ret := ret - 4 + w.last_bytes;
+		end if;
+		return ret;
+	end function;
+
+	-- room for two frames, the next one is collected while the last is sent
+	constant depth: positive := 2*frame_words;
+	type data_mem_t is array (0 to depth-1) of std_ulogic_vector(127 downto 0);
+	signal mem: data_mem_t;
+	signal wr, rd: natural range 0 to depth-1 := 0;
+	signal used: natural range 0 to depth := 0;
+
+	type frame_t is record
+		id: natural range 0 to streams-1;
+		bytes: unsigned(31 downto 0);
+		words: natural range 0 to frame_words;
+		eos: std_ulogic;
+	end record;
+	constant frame_slots: positive := 4;
+	type frame_vector is array (0 to frame_slots-1) of frame_t;
+	signal frames: frame_vector;
+	signal fr_wr, fr_rd: natural range 0 to frame_slots-1 := 0;
+	signal fr_cnt: natural range 0 to frame_slots := 0;
+
+	type fill_state is (SELECT_STREAM, COLLECT);
+	signal fill: fill_state := SELECT_STREAM;
+	signal sel: natural range 0 to streams-1 := 0;
+	signal last: natural range 0 to streams-1 := streams-1;
+	signal words: natural range 0 to frame_words := 0;
+	signal bytes: unsigned(31 downto 0) := (others => '0');
+	signal idle: natural range 0 to hold := 0;
+
+	type drain_state is (HEADER_WORD, DATA_WORD);
+	signal drain: drain_state := HEADER_WORD;
+	signal left: natural range 0 to frame_words := 0;
+begin
+
+process(fill, sel)
+begin
+	i_req <= (others => '0');
+	if fill = COLLECT then
+		i_req(sel) <= '1';
+	end if;
+end process;
+
+process
+	variable push, pop, fr_push, fr_pop, close: boolean;
+	variable idx: natural range 0 to streams-1;
+	variable nbytes: unsigned(31 downto 0);
+begin
+	wait until rising_edge(clk);
+	push := false;
+	pop := false;
+	fr_push := false;
+	fr_pop := false;
+
+	case fill is
+	when SELECT_STREAM =>
+		-- round robin over the waiting streams, a whole frame has to fit
+		if depth - used >= frame_words and fr_cnt < frame_slots then
+			for k in 1 to streams loop
+				idx := (last + k) mod streams;
+				if i_vld(idx) = '1' then
+					sel   <= idx;
+					last  <= idx;
+					words <= 0;
+					bytes <= (others => '0');
+					idle  <= 0;
+					fill  <= COLLECT;
+					exit;
+				end if;
+			end loop;
+		end if;
+
+	when COLLECT =>
+		close := false;
+		nbytes := bytes;
+		if i_vld(sel) = '1' then
+			mem(wr) <= i(sel).payload;
+			push := true;
+			nbytes := bytes + word_bytes(i(sel));
+			bytes <= nbytes;
+			words <= words + 1;
+			idle  <= 0;
+			-- a short word can only be the last one of a frame
+			close := i(sel).end_of_stream = '1' or i(sel).cnt /= 4 or
+			         i(sel).last_bytes /= 0 or words + 1 = frame_words;
+			if close then
+				frames(fr_wr) <= (id => sel, bytes => nbytes, words => words + 1,
+				                  eos => i(sel).end_of_stream);
+			end if;
+		elsif idle = hold then
+			close := true;
+			frames(fr_wr) <= (id => sel, bytes => nbytes, words => words, eos => '0');
+		else
+			idle <= idle + 1;
+		end if;
+
+		if close then
+			fr_push := true;
+			fill <= SELECT_STREAM;
+		end if;
+	end case;
+
+	if o_req = '1' then
+		o_vld <= '0';
+		case drain is
+		when HEADER_WORD =>
+			if fr_cnt /= 0 then
+				o.payload <= header(frames(fr_rd).id, frames(fr_rd).bytes);
+				o.cnt <= "100";
+				o.last_bytes <= "00";
+				o.end_of_stream <= '0';
+				o_vld <= '1';
+				left  <= frames(fr_rd).words;
+				drain <= DATA_WORD;
+			end if;
+
+		when DATA_WORD =>
+			o.payload <= mem(rd);
+			o_vld <= '1';
+			pop := true;
+			left <= left - 1;
+			-- the end of a user stream also ends the channel transfer
+			if left = 1 then
+				o.end_of_stream <= frames(fr_rd).eos;
+				fr_pop := true;
+				drain <= HEADER_WORD;
+			end if;
+		end case;
+	end if;
+
+	if push then
+		wr <= (wr + 1) mod depth;
+	end if;
+	if pop then
+		rd <= (rd + 1) mod depth;
+	end if;
+	if push and not pop then
+		used <= used + 1;
+	elsif pop and not push then
+		used <= used - 1;
+	end if;
+
+	if fr_push then
+		fr_wr <= (fr_wr + 1) mod frame_slots;
+	end if;
+	if fr_pop then
+		fr_rd <= (fr_rd + 1) mod frame_slots;
+	end if;
+	if fr_push and not fr_pop then
+		fr_cnt <= fr_cnt + 1;
+	elsif fr_pop and not fr_push then
+		fr_cnt <= fr_cnt - 1;
+	end if;
+
+	if rst = '1' then
+		fill   <= SELECT_STREAM;
+		drain  <= HEADER_WORD;
+		last   <= streams-1;
+		wr     <= 0;
+		rd     <= 0;
+		used   <= 0;
+		fr_wr  <= 0;
+		fr_rd  <= 0;
+		fr_cnt <= 0;
+		o_vld  <= '0';
+	end if;
+end process;
+
+end architecture;
@@ -0,0 +1,596 @@
+-- Behavioural model of the PCIe host for the endpoint testbenches
+--
+-- Drives the AXI stream interface of endpoint_core like the 7-series PCIe
+-- core does (128 bit, never straddled). Memory reads of the FPGA are
+-- answered after READ_LATENCY cycles with completions split at RCB
+-- boundaries, memory writes are reported on the monitor ports and MSI-X
+-- writes are queued as interrupts for the CPU. Each direction of the link
+-- moves 16 bytes per cycle including TLP_OVERHEAD bytes per TLP.
+--
+-- The host memory holds its own DWORD address at every location, so the
+-- data read by the FPGA can be checked without storing it.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+package pcie_host_model_pkg is
+
+	-- bus addresses of the FPGA BARs and of the MSI-X doorbell
+	constant BAR0_BASE : unsigned(31 downto 0) := x"F0000000";
+	constant BAR1_BASE : unsigned(31 downto 0) := x"F1000000";
+	constant MSIX_ADDR : unsigned(31 downto 0) := x"FEE00000";
+
+	type host_cmd_kind_t is (REG_WRITE, REG_READ);
+
+	-- register access of the CPU, addr is the offset in the BAR
+	type host_cmd_t is record
+		kind : host_cmd_kind_t;
+		bar  : natural range 0 to 1;
+		addr : unsigned(31 downto 0);
+		data : std_logic_vector(31 downto 0);
+	end record;
+
+	constant default_host_cmd : host_cmd_t := (
+		kind => REG_WRITE,
+		bar  => 0,
+		addr => (others => '0'),
+		data => (others => '0')
+	);
+
+	-- memory writes of a peer device behind the host, the DWORDs of all
+	-- writes continue one counter and go to the same offset in BAR0
+	type peer_write_t is record
+		addr  : unsigned(31 downto 0);
+		bytes : natural;
+	end record;
+
+	constant default_peer_write : peer_write_t := (
+		addr  => (others => '0'),
+		bytes => 0
+	);
+
+	-- contents of the host memory at a byte address
+	function host_memory(addr: natural) return std_logic_vector;
+
+end package;
+
+package body pcie_host_model_pkg is
+
+	function host_memory(addr: natural) return std_logic_vector is
+	begin
+		return std_logic_vector(to_unsigned(addr / 4, 32));
+	end function;
+
+end package body;
+
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+use work.utils.all;
+use work.tlp_types.all;
+use work.pcie_host_model_pkg.all;
+
+entity pcie_host_model is
+	generic(
+		-- cycles from a memory read request to its first completion
+		READ_LATENCY   : natural  := 200;
+		-- read completion boundary and max. payload of one completion
+		RCB            : positive := 64;
+		CPL_MAX_BYTES  : positive := 256;
+		-- completions of different requests in random order
+		REORDER        : boolean  := false;
+		-- memory reads the host keeps track of at once, 0 = unlimited
+		NP_CREDITS     : natural  := 0;
+		-- posted data credits in 16 byte units, 0 = unlimited, and the
+		-- cycles until the host returns them
+		PD_CREDITS     : natural  := 0;
+		CREDIT_LATENCY : natural  := 32;
+		-- link bytes per TLP besides header and payload (framing, sequence
+		-- number, LCRC and the share of the DLLPs)
+		TLP_OVERHEAD   : natural  := 20;
+		-- max. payload of the peer writes
+		MPS            : positive := 256;
+		-- cycles from an MSI-X write until the CPU takes the interrupt
+		IRQ_LATENCY    : natural  := 100
+	);
+	port(
+		clk : in std_logic;
+
+		-- to the endpoint
+		axis_rx_user  : out std_logic_vector(21 downto 0) := (others => '0');
+		axis_rx_data  : out std_logic_vector(127 downto 0) := (others => '0');
+		axis_rx_valid : out std_logic := '0';
+		axis_rx_ready : in  std_logic;
+
+		-- from the endpoint
+		axis_tx_last  : in  std_logic;
+		axis_tx_keep  : in  std_logic_vector(15 downto 0);
+		axis_tx_data  : in  std_logic_vector(127 downto 0);
+		axis_tx_valid : in  std_logic;
+		axis_tx_ready : out std_logic := '1';
+
+		-- register accesses of the CPU, the next one is taken once a write
+		-- is sent or a read is answered on rsp
+		cmd_vld : in  std_logic;
+		cmd_req : out std_logic := '1';
+		cmd     : in  host_cmd_t;
+		rsp_vld : out std_logic := '0';
+		rsp     : out std_logic_vector(31 downto 0) := (others => '0');
+
+		-- peer writes, the next one is taken once all data is sent
+		peer_vld : in  std_logic;
+		peer_req : out std_logic := '1';
+		peer     : in  peer_write_t;
+
+		-- interrupt vectors in the order of the MSI-X writes
+		irq_vld : out std_logic := '0';
+		irq_req : in  std_logic;
+		irq     : out natural := 0;
+
+		-- pulse for every memory write of the FPGA
+		wr_vld        : out std_logic := '0';
+		wr_addr       : out unsigned(31 downto 0) := (others => '0');
+		wr_bytes      : out natural := 0;
+		wr_link_bytes : out natural := 0;
+		wr_data       : out std_logic_vector(31 downto 0) := (others => '0');
+
+		-- pulse for every memory read of the FPGA when its last completion
+		-- is sent, latency from the request to the last completion
+		rd_vld        : out std_logic := '0';
+		rd_addr       : out unsigned(31 downto 0) := (others => '0');
+		rd_bytes      : out natural := 0;
+		rd_link_bytes : out natural := 0;
+		rd_latency    : out natural := 0
+	);
+end entity;
+
+architecture arch of pcie_host_model is
+
+	-- bytes per cycle and direction, the same as the 128 bit interface
+	constant LINK_BYTES : positive := 16;
+
+	subtype dword_t is std_logic_vector(31 downto 0);
+	type dword_vector is array (natural range <>) of dword_t;
+	type natural_vector is array (natural range <>) of natural;
+
+	type read_t is record
+		first, addr, last : natural;  -- byte addresses, last is exclusive
+		tag        : std_logic_vector(7 downto 0);
+		requester  : std_logic_vector(15 downto 0);
+		issued     : natural;
+		link_bytes : natural;
+	end record;
+	type read_vector is array (natural range <>) of read_t;
+
+	-- state shared with the tx ready logic
+	signal tx_at_sof : boolean := true;
+	signal tx_link   : integer := 0;
+	signal np_used   : natural := 0;
+	signal pd_used   : natural := 0;
+
+	function tlp_length(dw0: std_logic_vector(31 downto 0)) return natural is
+	begin
+		if unsigned(dw0(9 downto 0)) = 0 then
+			return 1024;
+		end if;
+		return to_integer(unsigned(dw0(9 downto 0)));
+	end function;
+
+	function is_write(dw0: std_logic_vector(31 downto 0)) return boolean is
+	begin
+		return dw0(30 downto 24) = fmtType_MWr or dw0(30 downto 24) = fmtType_MWr64;
+	end function;
+
+	function is_read(dw0: std_logic_vector(31 downto 0)) return boolean is
+	begin
+		return dw0(30 downto 24) = fmtType_MRd or dw0(30 downto 24) = fmtType_MRd64;
+	end function;
+
+	-- header and payload bytes of a TLP on the link
+	function tlp_bytes(dw0: std_logic_vector(31 downto 0)) return natural is
+		variable ret : natural := 12;
+	begin
+		if dw0(29) = '1' then
+			ret := 16;
+		end if;
+		if dw0(30) = '1' then
+			ret := ret + 4 * tlp_length(dw0);
+		end if;
+		return ret;
+	end function;
+
+	function lowest_set(be: std_logic_vector(3 downto 0)) return natural is
+	begin
+		for i in 0 to 3 loop
+			if be(i) = '1' then
+				return i;
+			end if;
+		end loop;
+		return 0;
+	end function;
+
+	function highest_set(be: std_logic_vector(3 downto 0)) return natural is
+	begin
+		for i in 3 downto 0 loop
+			if be(i) = '1' then
+				return i;
+			end if;
+		end loop;
+		return 0;
+	end function;
+
+	-- bytes covered by the byte enables of a request
+	function be_bytes(length: natural; first_be, last_be: std_logic_vector(3 downto 0)) return natural is
+	begin
+		if length = 1 then
+			return highest_set(first_be) - lowest_set(first_be) + 1;
+		end if;
+		return (4 - lowest_set(first_be)) + 4 * (length - 2) + highest_set(last_be) + 1;
+	end function;
+
+begin
+
+-- holds a TLP back at its first beat while the link or the credits of
+-- the host are exhausted
+tx_ready: process(all)
+	variable ok : boolean;
+begin
+	ok := true;
+	if tx_at_sof then
+		ok := tx_link >= 0;
+		if is_read(axis_tx_data(31 downto 0)) and NP_CREDITS /= 0 then
+			ok := ok and np_used < NP_CREDITS;
+		end if;
+		if is_write(axis_tx_data(31 downto 0)) and PD_CREDITS /= 0 then
+			ok := ok and pd_used + (tlp_length(axis_tx_data(31 downto 0)) + 3) / 4 <= PD_CREDITS;
+		end if;
+	end if;
+	axis_tx_ready <= '1' when ok else '0';
+end process;
+
+
+main: process
+	variable cycle : natural := 0;
+
+	-- FPGA -> host
+	variable tlp       : dword_vector(0 to 1027);
+	variable tlp_len   : natural := 0;
+	variable at_sof    : boolean := true;
+	variable tx_link_v : integer := 0;
+
+	variable reads    : read_vector(0 to 255);
+	variable read_cnt : natural := 0;
+	variable np_v     : natural := 0;
+
+	variable pd_v       : natural := 0;
+	variable pd_time    : natural_vector(0 to 255);
+	variable pd_units   : natural_vector(0 to 255);
+	variable pd_rd, pd_wr, pd_cnt : natural := 0;
+
+	variable irq_time   : natural_vector(0 to 255);
+	variable irq_vector : natural_vector(0 to 255);
+	variable irq_rd, irq_wr, irq_cnt : natural := 0;
+	variable irq_vld_v  : boolean := false;
+
+	-- host -> FPGA
+	variable out_dw    : dword_vector(0 to 1027);
+	variable out_len   : natural := 0;
+	variable out_bar   : std_logic_vector(5 downto 0) := (others => '0');
+	variable beat      : natural := 0;
+	variable sending   : boolean := false;
+	variable rx_link_v : integer := 0;
+
+	variable cmd_v      : host_cmd_t := default_host_cmd;
+	variable cmd_busy   : boolean := false;
+	variable cmd_unsent : boolean := false;
+
+	variable peer_v     : peer_write_t := default_peer_write;
+	variable peer_left  : natural := 0;
+	variable peer_count : unsigned(31 downto 0) := (others => '0');
+	variable last_peer  : boolean := false;
+
+	variable lfsr : unsigned(31 downto 0) := x"1234ABCD";
+
+	procedure receive is
+		variable dw0    : dword_t;
+		variable hdr    : natural;
+		variable length : natural;
+		variable addr   : unsigned(31 downto 0);
+		variable units  : natural;
+		variable first  : natural;
+	begin
+		dw0    := tlp(0);
+		length := tlp_length(dw0);
+		hdr    := 4 when dw0(29) = '1' else 3;
+		addr   := unsigned(tlp(hdr - 1));
+
+		if is_write(dw0) then
+			if PD_CREDITS /= 0 then
+				units := (length + 3) / 4;
+				pd_v  := pd_v + units;
+				pd_time(pd_wr)  := cycle + CREDIT_LATENCY;
+				pd_units(pd_wr) := units;
+				pd_wr  := (pd_wr + 1) mod pd_time'length;
+				pd_cnt := pd_cnt + 1;
+			end if;
+
+			if addr = MSIX_ADDR then
+				irq_time(irq_wr)   := cycle + IRQ_LATENCY;
+				irq_vector(irq_wr) := to_integer(unsigned(change_endianess_DW(tlp(hdr))));
+				irq_wr  := (irq_wr + 1) mod irq_time'length;
+				irq_cnt := irq_cnt + 1;
+			else
+				wr_vld        <= '1';
+				wr_addr       <= addr + lowest_set(tlp(1)(3 downto 0));
+				wr_bytes      <= be_bytes(length, tlp(1)(3 downto 0), tlp(1)(7 downto 4));
+				wr_link_bytes <= tlp_bytes(dw0) + TLP_OVERHEAD;
+				wr_data       <= change_endianess_DW(tlp(hdr));
+			end if;
+
+		elsif is_read(dw0) then
+			first := to_integer(addr) + lowest_set(tlp(1)(3 downto 0));
+			reads(read_cnt) := (
+				first      => first,
+				addr       => first,
+				last       => first + be_bytes(length, tlp(1)(3 downto 0), tlp(1)(7 downto 4)),
+				tag        => tlp(1)(15 downto 8),
+				requester  => tlp(1)(31 downto 16),
+				issued     => cycle,
+				link_bytes => 0
+			);
+			read_cnt := read_cnt + 1;
+			np_v := np_v + 1;
+
+		elsif dw0(30 downto 24) = fmtType_CplD then
+			rsp_vld  <= '1';
+			rsp      <= change_endianess_DW(tlp(3));
+			cmd_busy := false;
+
+		else
+			report "unexpected TLP from the FPGA: " & to_hstring(dw0) severity error;
+		end if;
+	end procedure;
+
+	procedure header(fmt_type: std_logic_vector(6 downto 0); length: natural; dw1, dw2: dword_t) is
+	begin
+		out_dw(0) := (others => '0');
+		out_dw(0)(30 downto 24) := fmt_type;
+		out_dw(0)(9 downto 0)   := std_logic_vector(to_unsigned(length mod 1024, 10));
+		out_dw(1) := dw1;
+		out_dw(2) := dw2;
+		out_len   := 3;
+	end procedure;
+
+	procedure payload(dw: dword_t) is
+	begin
+		out_dw(out_len) := change_endianess_DW(dw);
+		out_len := out_len + 1;
+	end procedure;
+
+	procedure send_cmd is
+		variable base : unsigned(31 downto 0);
+	begin
+		base := BAR0_BASE when cmd_v.bar = 0 else BAR1_BASE;
+		out_bar := (others => '0');
+		out_bar(cmd_v.bar) := '1';
+		if cmd_v.kind = REG_WRITE then
+			header(fmtType_MWr, 1, x"0000000F", std_logic_vector(base + cmd_v.addr));
+			payload(cmd_v.data);
+			cmd_busy := false;
+		else
+			header(fmtType_MRd, 1, x"0000000F", std_logic_vector(base + cmd_v.addr));
+		end if;
+		cmd_unsent := false;
+	end procedure;
+
+	-- next completion of read `idx`, ends at an RCB boundary
+	procedure send_completion(idx: natural) is
+		variable rd      : read_t;
+		variable last    : natural;
+		variable aligned : natural;
+		variable dw1     : dword_t := (others => '0');
+		variable dw2     : dword_t := (others => '0');
+	begin
+		rd := reads(idx);
+		last := rd.addr + CPL_MAX_BYTES;
+		last := minimum(rd.last, last - last mod RCB);
+		aligned := rd.addr - rd.addr mod 4;
+
+		dw1(11 downto 0)  := std_logic_vector(to_unsigned((rd.last - rd.addr) mod 4096, 12));
+		dw2(31 downto 16) := rd.requester;
+		dw2(15 downto 8)  := rd.tag;
+		dw2(6 downto 0)   := std_logic_vector(to_unsigned(rd.addr mod 128, 7));
+		header(fmtType_CplD, (last - aligned + 3) / 4, dw1, dw2);
+		for i in 0 to (last - aligned + 3) / 4 - 1 loop
+			payload(host_memory(aligned + 4 * i));
+		end loop;
+		out_bar := (others => '0');
+
+		rd.addr := last;
+		rd.link_bytes := rd.link_bytes + 4 * out_len + TLP_OVERHEAD;
+		reads(idx) := rd;
+
+		if rd.addr = rd.last then
+			rd_vld        <= '1';
+			rd_addr       <= to_unsigned(rd.first, 32);
+			rd_bytes      <= rd.last - rd.first;
+			rd_link_bytes <= rd.link_bytes;
+			rd_latency    <= cycle - rd.issued;
+
+			for i in idx to read_cnt - 2 loop
+				reads(i) := reads(i + 1);
+			end loop;
+			read_cnt := read_cnt - 1;
+			np_v := np_v - 1;
+		end if;
+	end procedure;
+
+	procedure send_peer is
+		variable bytes : natural;
+	begin
+		bytes := minimum(MPS, peer_left);
+		if bytes = 4 then
+			header(fmtType_MWr, 1, x"0000000F", std_logic_vector(BAR0_BASE + peer_v.addr));
+		else
+			header(fmtType_MWr, bytes / 4, x"000000FF", std_logic_vector(BAR0_BASE + peer_v.addr));
+		end if;
+		for i in 1 to bytes / 4 loop
+			payload(std_logic_vector(peer_count));
+			peer_count := peer_count + 1;
+		end loop;
+		out_bar := "000001";
+		peer_left := peer_left - bytes;
+	end procedure;
+
+	-- chooses the next TLP to the FPGA, register accesses first
+	procedure next_tlp is
+		variable due, pick : natural;
+		variable cpl_ready : boolean;
+	begin
+		due := 0;
+		for i in 0 to read_cnt - 1 loop
+			if reads(i).issued + READ_LATENCY <= cycle then
+				due := due + 1;
+			end if;
+		end loop;
+		cpl_ready := due /= 0;
+		-- completions of one request stay in order, so only the oldest
+		-- request is served without reordering
+		if not REORDER then
+			cpl_ready := read_cnt /= 0 and reads(0).issued + READ_LATENCY <= cycle;
+		end if;
+
+		sending := true;
+		if cmd_unsent then
+			send_cmd;
+		elsif cpl_ready and (peer_left = 0 or last_peer) then
+			if REORDER then
+				lfsr := lfsr(30 downto 0) & (lfsr(31) xor lfsr(21) xor lfsr(1) xor lfsr(0));
+				pick := to_integer(lfsr(15 downto 0)) mod due;
+				for i in 0 to read_cnt - 1 loop
+					if reads(i).issued + READ_LATENCY <= cycle then
+						if pick = 0 then
+							send_completion(i);
+							exit;
+						end if;
+						pick := pick - 1;
+					end if;
+				end loop;
+			else
+				send_completion(0);
+			end if;
+			last_peer := false;
+		elsif peer_left /= 0 then
+			send_peer;
+			last_peer := true;
+		else
+			sending := false;
+		end if;
+	end procedure;
+
+begin
+	wait until rising_edge(clk);
+	cycle := cycle + 1;
+
+	wr_vld  <= '0';
+	rd_vld  <= '0';
+	rsp_vld <= '0';
+
+	-- new requests of the CPU and the peer
+	if cmd_vld = '1' and not cmd_busy then
+		cmd_v      := cmd;
+		cmd_busy   := true;
+		cmd_unsent := true;
+	end if;
+	if peer_vld = '1' and peer_left = 0 then
+		peer_v    := peer;
+		peer_left := peer.bytes;
+	end if;
+
+	-- FPGA -> host
+	if axis_tx_valid = '1' and axis_tx_ready = '1' then
+		if at_sof then
+			tx_link_v := tx_link_v - tlp_bytes(axis_tx_data(31 downto 0)) - TLP_OVERHEAD;
+		end if;
+		for lane in 0 to 3 loop
+			if axis_tx_keep(4 * lane) = '1' then
+				tlp(tlp_len) := axis_tx_data(32 * lane + 31 downto 32 * lane);
+				tlp_len := tlp_len + 1;
+			end if;
+		end loop;
+		at_sof := axis_tx_last = '1';
+		if axis_tx_last = '1' then
+			receive;
+			tlp_len := 0;
+		end if;
+	end if;
+	tx_link_v := minimum(tx_link_v + LINK_BYTES, 0);
+
+	-- credits the host has freed up again
+	while pd_cnt /= 0 and pd_time(pd_rd) <= cycle loop
+		pd_v   := pd_v - pd_units(pd_rd);
+		pd_rd  := (pd_rd + 1) mod pd_time'length;
+		pd_cnt := pd_cnt - 1;
+	end loop;
+
+	-- interrupts
+	if irq_vld_v and irq_req = '1' then
+		irq_rd    := (irq_rd + 1) mod irq_time'length;
+		irq_cnt   := irq_cnt - 1;
+		irq_vld_v := false;
+	end if;
+	if not irq_vld_v and irq_cnt /= 0 and irq_time(irq_rd) <= cycle then
+		irq       <= irq_vector(irq_rd);
+		irq_vld_v := true;
+	end if;
+
+	-- host -> FPGA
+	if sending and axis_rx_ready = '1' then
+		beat := beat + 1;
+		if beat = (out_len + 3) / 4 then
+			sending := false;
+		end if;
+	end if;
+	rx_link_v := minimum(rx_link_v + LINK_BYTES, 0);
+	if not sending and rx_link_v >= 0 then
+		next_tlp;
+		if sending then
+			beat := 0;
+			rx_link_v := rx_link_v - 4 * out_len - TLP_OVERHEAD;
+		end if;
+	end if;
+
+	axis_rx_valid <= '0';
+	if sending then
+		axis_rx_valid <= '1';
+		axis_rx_user  <= (others => '0');
+		axis_rx_user(7 downto 2) <= out_bar;
+		if beat = 0 then
+			axis_rx_user(14) <= '1';
+		end if;
+		if beat = (out_len + 3) / 4 - 1 then
+			axis_rx_user(21) <= '1';
+			axis_rx_user(20 downto 19) <= std_logic_vector(to_unsigned((out_len - 1) mod 4, 2));
+		end if;
+		for lane in 0 to 3 loop
+			if 4 * beat + lane < out_len then
+				axis_rx_data(32 * lane + 31 downto 32 * lane) <= out_dw(4 * beat + lane);
+			else
+				axis_rx_data(32 * lane + 31 downto 32 * lane) <= (others => '0');
+			end if;
+		end loop;
+	end if;
+
+	tx_at_sof <= at_sof;
+	tx_link   <= tx_link_v;
+	np_used   <= np_v;
+	pd_used   <= pd_v;
+	cmd_req   <= '0' when cmd_busy else '1';
+	peer_req  <= '0' when peer_left /= 0 else '1';
+	irq_vld   <= '1' when irq_vld_v else '0';
+end process;
+
+end architecture;
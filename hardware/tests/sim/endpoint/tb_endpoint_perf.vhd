@@ -0,0 +1,705 @@
+-- Testbench for the throughput and latency of the whole transceiver
+--
+-- endpoint_core with host and FPGA channels is connected to the model of the
+-- PCIe host. The main process serves the channels like the driver does, the
+-- user sides consume and produce data as fast as the channels allow.
+-- Bandwidth, TLP efficiency and latency are reported for every channel and
+-- the bandwidth of each link direction is checked against a lower bound, so
+-- performance regressions fail the run. The host is set up by the generics,
+-- run_tests.py runs some typical configurations.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.pcie.all;
+use work.cfg_channel_types.all;
+use work.pcie_host_model_pkg.all;
+
+
+entity tb_endpoint_perf is
+generic(
+	runner_cfg: string;
+
+	-- host
+	READ_LATENCY  : natural  := 200;
+	RCB           : positive := 64;
+	CPL_MAX_BYTES : positive := 256;
+	REORDER       : boolean  := false;
+	NP_CREDITS    : natural  := 0;
+	PD_CREDITS    : natural  := 0;
+
+	-- sizes the driver programs into the channels
+	MPS  : positive := 256;
+	MRRS : positive := 512;
+
+	-- lower bounds in percent of the link bandwidth
+	MIN_DOWN_PERCENT : natural := 50;
+	MIN_UP_PERCENT   : natural := 50
+);
+end entity;
+
+architecture arch of tb_endpoint_perf is
+	signal clk: std_logic := '0';
+	-- 250 MHz, like the 128 bit interface of the PCIe core
+	constant clk_per: natural := 4;
+
+	constant config: transceiver_configuration := new_config(
+		host_rx => 2,
+		host_tx => 2,
+		fpga_rx => 1,
+		fpga_tx => 1,
+		mpb     => 256,
+		mrb     => 512
+	);
+
+	-- channel ids
+	constant HOST_RX_1 : positive := 1;
+	constant HOST_RX_2 : positive := 2;
+	constant FPGA_RX   : positive := 3;
+	constant HOST_TX_1 : positive := 4;
+	constant HOST_TX_2 : positive := 5;
+	constant FPGA_TX   : positive := 6;
+	constant CHANNELS  : positive := 6;
+
+	subtype channel_t is natural range 1 to CHANNELS;
+	type natural_array is array (channel_t) of natural;
+	type time_array is array (channel_t) of time;
+
+	-- register numbers
+	constant CFG_HOST_INSTR : natural := 7;
+	constant CHN_ADDR_LO    : natural := 0;
+	constant CHN_SIZE       : natural := 2;
+	constant CHN_TARGET     : natural := 3;
+	constant CHN_TRNS       : natural := 4;
+	constant CHN_INFO       : natural := 5;
+	constant CHN_MAX_TLP    : natural := 10;
+	constant CHN_QUEUE      : natural := 12;
+	constant CHN_DATA       : natural := 15;
+
+	-- every channel works on 1 MiB of host memory at id * 1 MiB
+	constant REGION_BYTES : positive := 2**20;
+	constant BUF_BYTES    : positive := 4096;
+	constant BUF_CNT      : positive := 8;
+	constant XFER_BYTES   : positive := 64 * 1024;
+
+	function region(id: natural) return natural is
+	begin
+		return id * REGION_BYTES;
+	end function;
+
+	function chn_reg(id, reg: natural) return unsigned is
+	begin
+		return to_unsigned(id * 64 + reg * 4, 32);
+	end function;
+
+	function is_host_channel(id: natural) return boolean is
+	begin
+		return id /= FPGA_RX and id /= FPGA_TX;
+	end function;
+
+	-- bytes per 100 cycles as "x.yy"
+	function per_cycle(bytes, cycles: natural) return string is
+		variable x100 : natural;
+	begin
+		x100 := bytes * 100 / maximum(cycles, 1);
+		if x100 mod 100 < 10 then
+			return to_string(x100 / 100) & ".0" & to_string(x100 mod 100);
+		end if;
+		return to_string(x100 / 100) & "." & to_string(x100 mod 100);
+	end function;
+
+	signal active: boolean_vector(1 to CHANNELS) := (others => false);
+	signal started: boolean := false;
+	signal start_time: time := 0 ns;
+
+	-- endpoint
+	signal rst: std_logic;
+	signal timestamp: unsigned(63 downto 0);
+	signal qos: qos_config_vector(channel_count(config) downto 1);
+	signal rd_grant: std_logic_vector(rx_count(config) downto 1);
+
+	signal axis_rx_user: std_logic_vector(21 downto 0);
+	signal axis_rx_data: std_logic_vector(127 downto 0);
+	signal axis_rx_valid, axis_rx_ready: std_logic;
+	signal axis_tx_last: std_logic;
+	signal axis_tx_keep: std_logic_vector(15 downto 0);
+	signal axis_tx_data: std_logic_vector(127 downto 0);
+	signal axis_tx_valid, axis_tx_ready: std_logic;
+
+	signal to_rx_vld, to_rx_req_all, to_tx_vld, to_tx_req_all: std_logic;
+	signal to_rx_mux, to_tx_mux: fragment;
+	signal from_rx_arb, from_tx_arb: fragment;
+	signal from_rx_arb_vld, from_rx_arb_req, from_tx_arb_vld, from_tx_arb_req: std_logic;
+
+	signal to_rx_req, from_rx_vld, from_rx_req: std_logic_vector(rx_count(config)-1 downto 0);
+	signal from_rx: fragment_vector(rx_count(config)-1 downto 0);
+	signal to_tx_req, from_tx_vld, from_tx_req: std_logic_vector(tx_count(config)-1 downto 0);
+	signal from_tx: fragment_vector(tx_count(config)-1 downto 0);
+
+	-- user side of the channels
+	type rx_stream_array is array (channel_t range <>) of rx_stream;
+	type tx_stream_array is array (channel_t range <>) of tx_stream;
+	signal rx_user: rx_stream_array(HOST_RX_1 to FPGA_RX);
+	signal rx_user_vld: std_logic_vector(HOST_RX_1 to FPGA_RX);
+	signal tx_user: tx_stream_array(HOST_TX_1 to FPGA_TX);
+	signal tx_user_vld, tx_user_req: std_logic_vector(HOST_TX_1 to FPGA_TX);
+
+	-- host model
+	signal cmd_vld: std_logic := '0';
+	signal cmd_req: std_logic;
+	signal cmd: host_cmd_t := default_host_cmd;
+	signal rsp_vld: std_logic;
+	signal rsp: std_logic_vector(31 downto 0);
+	signal peer_vld: std_logic := '0';
+	signal peer_req: std_logic;
+	signal peer: peer_write_t := default_peer_write;
+	signal irq_vld: std_logic;
+	signal irq_req: std_logic := '0';
+	signal irq: natural;
+	signal wr_vld, rd_vld: std_logic;
+	signal wr_addr, rd_addr: unsigned(31 downto 0);
+	signal wr_bytes, wr_link_bytes, rd_bytes, rd_link_bytes, rd_latency: natural;
+	signal wr_data: std_logic_vector(31 downto 0);
+
+	-- collected by the monitors
+	signal data_bytes: natural_array := (others => 0);
+	signal last_data: time_array := (others => 0 ns);
+	signal tlp_payload, tlp_link: natural_array := (others => 0);
+	signal read_cnt, read_latency_sum, read_latency_max: natural_array := (others => 0);
+	signal peer_granted: natural := 0;
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+
+-- serves the channels like the driver does and reports the results
+main: process
+	variable value: natural;
+
+	-- per channel, like the buffer lists of the driver
+	variable queue_depth, submitted, completed: natural_array;
+	type submit_times is array (0 to BUF_CNT-1) of time;
+	type submit_time_array is array (channel_t) of submit_times;
+	variable submit_time: submit_time_array;
+	variable xfer_latency_sum, xfer_latency_max: natural_array;
+	variable all_done: boolean;
+
+	procedure reg_write(bar: natural; addr: unsigned; data: std_logic_vector) is
+	begin
+		cmd <= (
+			kind => REG_WRITE,
+			bar  => bar,
+			addr => addr,
+			data => data
+		);
+		cmd_vld <= '1';
+		wait until rising_edge(clk) and cmd_req = '1';
+		cmd_vld <= '0';
+	end procedure;
+
+	procedure reg_write(bar: natural; addr: unsigned; data: natural) is
+	begin
+		reg_write(bar, addr, std_logic_vector(to_unsigned(data, 32)));
+	end procedure;
+
+	procedure reg_read(addr: unsigned; variable value: out natural) is
+	begin
+		cmd <= (
+			kind => REG_READ,
+			bar  => 0,
+			addr => addr,
+			data => (others => '0')
+		);
+		cmd_vld <= '1';
+		wait until rising_edge(clk) and cmd_req = '1';
+		cmd_vld <= '0';
+		wait until rising_edge(clk) and rsp_vld = '1';
+		value := to_integer(unsigned(rsp));
+	end procedure;
+
+	procedure submit(id: channel_t) is
+		variable buf: natural;
+	begin
+		buf := submitted(id) mod BUF_CNT;
+		submit_time(id)(buf) := now;
+		reg_write(0, chn_reg(id, CHN_ADDR_LO), region(id) + buf * BUF_BYTES);
+		reg_write(0, chn_reg(id, CHN_SIZE), BUF_BYTES);
+		submitted(id) := submitted(id) + 1;
+	end procedure;
+
+	-- interrupt service routine of a host channel
+	procedure service(id: channel_t) is
+		variable cycles: natural;
+	begin
+		loop
+			exit when submitted(id) = completed(id);
+			if queue_depth(id) > 1 then
+				reg_read(chn_reg(id, CHN_QUEUE), value);
+				exit when value = 0;
+			end if;
+
+			reg_read(chn_reg(id, CHN_TRNS), value);
+			check_equal(value, BUF_BYTES, "transferred bytes of channel " & to_string(id));
+
+			cycles := (now - submit_time(id)(completed(id) mod BUF_CNT)) / (clk_per * 1 ns);
+			xfer_latency_sum(id) := xfer_latency_sum(id) + cycles;
+			xfer_latency_max(id) := maximum(xfer_latency_max(id), cycles);
+			completed(id) := completed(id) + 1;
+		end loop;
+
+		while submitted(id) - completed(id) < queue_depth(id) and
+		      submitted(id) < XFER_BYTES / BUF_BYTES loop
+			submit(id);
+		end loop;
+	end procedure;
+
+	impure function channel_done(id: channel_t) return boolean is
+	begin
+		if not active(id) then
+			return true;
+		elsif is_host_channel(id) then
+			return completed(id) = XFER_BYTES / BUF_BYTES;
+		end if;
+		return data_bytes(id) = XFER_BYTES;
+	end function;
+
+	procedure run_traffic(channels: boolean_vector) is
+	begin
+		active <= channels;
+		wait until rising_edge(clk);
+
+		-- like the driver when it is probed
+		reg_write(0, to_unsigned(CFG_HOST_INSTR * 4, 32), 1);
+		for idx in 1 to 32 loop
+			wait until rising_edge(clk);
+		end loop;
+
+		for id in channel_t loop
+			reg_write(1, to_unsigned(id * 16, 32), std_logic_vector(MSIX_ADDR));
+			reg_write(1, to_unsigned(id * 16 + 8, 32), id);
+		end loop;
+
+		for id in channel_t loop
+			queue_depth(id) := 1;
+			submitted(id) := 0;
+			completed(id) := 0;
+			xfer_latency_sum(id) := 0;
+			xfer_latency_max(id) := 0;
+			if is_host_channel(id) then
+				reg_read(chn_reg(id, CHN_INFO), value);
+				queue_depth(id) := maximum(value / 2**16 mod 16, 1);
+				if id < FPGA_RX then
+					reg_write(0, chn_reg(id, CHN_MAX_TLP), MRRS);
+				else
+					reg_write(0, chn_reg(id, CHN_MAX_TLP), MPS);
+				end if;
+			end if;
+		end loop;
+
+		started <= true;
+		start_time <= now;
+
+		if active(FPGA_RX) then
+			-- free space is reported to a sender at the address, the peer
+			-- writes of the host model serve as sender
+			reg_write(0, chn_reg(FPGA_RX, CHN_ADDR_LO), region(FPGA_RX));
+			reg_write(0, chn_reg(FPGA_RX, CHN_TARGET), 1);
+		end if;
+		if active(FPGA_TX) then
+			reg_write(0, chn_reg(FPGA_TX, CHN_ADDR_LO), region(FPGA_TX));
+			reg_write(0, chn_reg(FPGA_TX, CHN_TARGET), 0);
+			reg_write(0, chn_reg(FPGA_TX, CHN_SIZE), XFER_BYTES);
+		end if;
+		for id in channel_t loop
+			if active(id) and is_host_channel(id) then
+				service(id);
+			end if;
+		end loop;
+
+		loop
+			all_done := true;
+			for id in channel_t loop
+				all_done := all_done and channel_done(id);
+			end loop;
+			exit when all_done;
+
+			irq_req <= '1';
+			wait until rising_edge(clk);
+			irq_req <= '0';
+			if irq_vld = '1' and irq >= 1 and irq <= CHANNELS then
+				if active(irq) and is_host_channel(irq) then
+					service(irq);
+				end if;
+			end if;
+		end loop;
+		wait until rising_edge(clk);
+	end procedure;
+
+	procedure report_results(channels: boolean_vector) is
+		variable cycles, down_bytes, down_cycles, up_bytes, up_cycles: natural := 0;
+	begin
+		for id in channel_t loop
+			if channels(id) then
+				cycles := (last_data(id) - start_time) / (clk_per * 1 ns);
+				info(
+					"channel " & to_string(id) & ": " &
+					to_string(data_bytes(id)) & " bytes in " & to_string(cycles) & " cycles, " &
+					per_cycle(data_bytes(id), cycles) & " bytes/cycle, " &
+					to_string(data_bytes(id) * 250 / maximum(cycles, 1)) & " MB/s at 250 MHz"
+				);
+				if tlp_link(id) /= 0 then
+					info(
+						"channel " & to_string(id) & ": TLP efficiency " &
+						to_string(tlp_payload(id) * 100 / tlp_link(id)) & " %"
+					);
+				end if;
+				if read_cnt(id) /= 0 then
+					info(
+						"channel " & to_string(id) & ": read latency avg " &
+						to_string(read_latency_sum(id) / read_cnt(id)) & " max " &
+						to_string(read_latency_max(id)) & " cycles"
+					);
+				end if;
+				if is_host_channel(id) then
+					info(
+						"channel " & to_string(id) & ": buffer latency avg " &
+						to_string(xfer_latency_sum(id) / completed(id)) & " max " &
+						to_string(xfer_latency_max(id)) & " cycles"
+					);
+				end if;
+
+				if id <= FPGA_RX then
+					down_bytes  := down_bytes + data_bytes(id);
+					down_cycles := maximum(down_cycles, cycles);
+				else
+					up_bytes  := up_bytes + data_bytes(id);
+					up_cycles := maximum(up_cycles, cycles);
+				end if;
+			end if;
+		end loop;
+
+		if down_bytes /= 0 then
+			info("host to FPGA: " & per_cycle(down_bytes, down_cycles) & " bytes/cycle");
+			check_relation(down_bytes * 100 >= MIN_DOWN_PERCENT * 16 * down_cycles,
+				"host to FPGA bandwidth below " & to_string(MIN_DOWN_PERCENT) & " % of the link");
+		end if;
+		if up_bytes /= 0 then
+			info("FPGA to host: " & per_cycle(up_bytes, up_cycles) & " bytes/cycle");
+			check_relation(up_bytes * 100 >= MIN_UP_PERCENT * 16 * up_cycles,
+				"FPGA to host bandwidth below " & to_string(MIN_UP_PERCENT) & " % of the link");
+		end if;
+	end procedure;
+
+	variable channels: boolean_vector(1 to CHANNELS);
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+
+	if run("host rx channels") then
+		channels := (HOST_RX_1 | HOST_RX_2 => true, others => false);
+	elsif run("host tx channels") then
+		channels := (HOST_TX_1 | HOST_TX_2 => true, others => false);
+	elsif run("fpga channels") then
+		channels := (FPGA_RX | FPGA_TX => true, others => false);
+	elsif run("all channels") then
+		channels := (others => true);
+	end if;
+
+	run_traffic(channels);
+	report_results(channels);
+
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 2 ms);
+
+
+-- attributes the memory accesses of the FPGA to the channels
+monitor: process
+	variable id: natural;
+begin
+	wait until rising_edge(clk);
+	if wr_vld = '1' then
+		id := to_integer(wr_addr) / REGION_BYTES;
+		if id = FPGA_RX then
+			-- free FIFO space reported by the receiver
+			peer_granted <= peer_granted + to_integer(unsigned(wr_data));
+		elsif id >= 1 and id <= CHANNELS then
+			tlp_payload(id) <= tlp_payload(id) + wr_bytes;
+			tlp_link(id)    <= tlp_link(id) + wr_link_bytes;
+			data_bytes(id)  <= data_bytes(id) + wr_bytes;
+			last_data(id)   <= now;
+		end if;
+	end if;
+	if rd_vld = '1' then
+		id := to_integer(rd_addr) / REGION_BYTES;
+		if id >= 1 and id <= CHANNELS then
+			tlp_payload(id)      <= tlp_payload(id) + rd_bytes;
+			tlp_link(id)         <= tlp_link(id) + rd_link_bytes;
+			read_cnt(id)         <= read_cnt(id) + 1;
+			read_latency_sum(id) <= read_latency_sum(id) + rd_latency;
+			read_latency_max(id) <= maximum(read_latency_max(id), rd_latency);
+		end if;
+	end if;
+
+	for rx in HOST_RX_1 to FPGA_RX loop
+		if rx_user_vld(rx) = '1' then
+			data_bytes(rx) <= data_bytes(rx) + 4 * to_integer(rx_user(rx).cnt);
+			last_data(rx)  <= now;
+		end if;
+	end loop;
+end process;
+
+
+-- sends data to the FPGA rx channel as long as it has free space
+peer_writer: process
+	variable sent: natural := 0;
+begin
+	wait until rising_edge(clk);
+	if peer_granted > sent and sent < XFER_BYTES then
+		peer <= (
+			addr  => chn_reg(FPGA_RX, CHN_DATA),
+			bytes => minimum(peer_granted - sent, XFER_BYTES - sent)
+		);
+		peer_vld <= '1';
+		wait until rising_edge(clk) and peer_req = '1';
+		peer_vld <= '0';
+		sent := sent + minimum(peer_granted - sent, XFER_BYTES - sent);
+	end if;
+end process;
+
+
+-- checks the data of the rx channels against the host memory and the
+-- counter of the peer writes
+rx_sink: for rx in HOST_RX_1 to FPGA_RX generate
+	check_data: process
+		variable dw, addr: natural := 0;
+		variable expected: std_logic_vector(31 downto 0);
+	begin
+		wait until rising_edge(clk);
+		if rx_user_vld(rx) = '1' then
+			for lane in 0 to to_integer(rx_user(rx).cnt) - 1 loop
+				if rx = FPGA_RX then
+					expected := std_logic_vector(to_unsigned(dw, 32));
+				else
+					addr := region(rx) + (dw * 4) mod (BUF_CNT * BUF_BYTES);
+					expected := host_memory(addr);
+				end if;
+				check_equal(rx_user(rx).payload(32 * lane + 31 downto 32 * lane), expected,
+					"data of channel " & to_string(rx) & ", DWORD " & to_string(dw));
+				dw := dw + 1;
+			end loop;
+		end if;
+	end process;
+end generate;
+
+
+-- counter as user data for the tx channels, as fast as they take it
+tx_source: for tx in HOST_TX_1 to FPGA_TX generate
+	tx_user_vld(tx) <= '1' when active(tx) and started else '0';
+
+	count: process
+		variable dw: natural := 0;
+	begin
+		for lane in 0 to 3 loop
+			tx_user(tx).payload(32 * lane + 31 downto 32 * lane) <= std_logic_vector(to_unsigned(dw + lane, 32));
+		end loop;
+		tx_user(tx).cnt <= to_unsigned(4, 3);
+		tx_user(tx).last_bytes <= (others => '0');
+		tx_user(tx).end_of_stream <= '0';
+
+		wait until rising_edge(clk);
+		if tx_user_vld(tx) = '1' and tx_user_req(tx) = '1' then
+			dw := dw + 4;
+		end if;
+	end process;
+end generate;
+
+
+host: entity work.pcie_host_model
+	generic map(
+		READ_LATENCY  => READ_LATENCY,
+		RCB           => RCB,
+		CPL_MAX_BYTES => CPL_MAX_BYTES,
+		REORDER       => REORDER,
+		NP_CREDITS    => NP_CREDITS,
+		PD_CREDITS    => PD_CREDITS,
+		MPS           => MPS
+	)
+	port map(
+		clk           => clk,
+		axis_rx_user  => axis_rx_user,
+		axis_rx_data  => axis_rx_data,
+		axis_rx_valid => axis_rx_valid,
+		axis_rx_ready => axis_rx_ready,
+		axis_tx_last  => axis_tx_last,
+		axis_tx_keep  => axis_tx_keep,
+		axis_tx_data  => axis_tx_data,
+		axis_tx_valid => axis_tx_valid,
+		axis_tx_ready => axis_tx_ready,
+		cmd_vld       => cmd_vld,
+		cmd_req       => cmd_req,
+		cmd           => cmd,
+		rsp_vld       => rsp_vld,
+		rsp           => rsp,
+		peer_vld      => peer_vld,
+		peer_req      => peer_req,
+		peer          => peer,
+		irq_vld       => irq_vld,
+		irq_req       => irq_req,
+		irq           => irq,
+		wr_vld        => wr_vld,
+		wr_addr       => wr_addr,
+		wr_bytes      => wr_bytes,
+		wr_link_bytes => wr_link_bytes,
+		wr_data       => wr_data,
+		rd_vld        => rd_vld,
+		rd_addr       => rd_addr,
+		rd_bytes      => rd_bytes,
+		rd_link_bytes => rd_link_bytes,
+		rd_latency    => rd_latency
+	);
+
+
+-- the same as gen2_endpoint without the PCIe core
+ep: entity work.endpoint_core
+	generic map(config => config)
+	port map(
+		clk           => clk,
+		rst           => rst,
+		Core_ID       => x"0100",
+		axis_rx_user  => axis_rx_user,
+		axis_rx_data  => axis_rx_data,
+		axis_rx_valid => axis_rx_valid,
+		axis_rx_ready => axis_rx_ready,
+		axis_tx_user  => open,
+		axis_tx_last  => axis_tx_last,
+		axis_tx_keep  => axis_tx_keep,
+		axis_tx_data  => axis_tx_data,
+		axis_tx_valid => axis_tx_valid,
+		axis_tx_ready => axis_tx_ready,
+		to_rx_vld     => to_rx_vld,
+		to_rx_req     => to_rx_req_all,
+		to_rx         => to_rx_mux,
+		from_rx_vld   => from_rx_arb_vld,
+		from_rx_req   => from_rx_arb_req,
+		from_rx       => from_rx_arb,
+		from_tx_vld   => from_tx_arb_vld,
+		from_tx_req   => from_tx_arb_req,
+		from_tx       => from_tx_arb,
+		to_tx_vld     => to_tx_vld,
+		to_tx_req     => to_tx_req_all,
+		to_tx         => to_tx_mux,
+		timestamp     => timestamp,
+		qos           => qos,
+		rd_grant      => rd_grant
+	);
+
+to_rx_req_all <= and to_rx_req;
+to_tx_req_all <= and to_tx_req;
+
+rx_arbiter: entity work.packet_arbiter
+	generic map(ports => rx_count(config))
+	port map(
+		clk   => clk,
+		rst   => rst,
+		i_req => from_rx_req,
+		i_vld => from_rx_vld,
+		i     => from_rx,
+		o_req => from_rx_arb_req,
+		o_vld => from_rx_arb_vld,
+		o     => from_rx_arb,
+		qos   => qos(rx_count(config) downto 1),
+		rd_grant => rd_grant
+	);
+
+tx_arbiter: entity work.packet_arbiter
+	generic map(ports => tx_count(config))
+	port map(
+		clk   => clk,
+		rst   => rst,
+		i_req => from_tx_req,
+		i_vld => from_tx_vld,
+		i     => from_tx,
+		o_req => from_tx_arb_req,
+		o_vld => from_tx_arb_vld,
+		o     => from_tx_arb,
+		qos   => qos(channel_count(config) downto rx_count(config)+1)
+	);
+
+
+host_rx: for id in HOST_RX_1 to HOST_RX_2 generate
+	chn: entity work.host_rx_channel
+		generic map(debug => false, config => config, id => id)
+		port map(
+			clk         => clk,
+			rst         => rst,
+			from_ep     => to_rx_mux,
+			from_ep_vld => to_rx_vld,
+			from_ep_req => to_rx_req(id-1),
+			to_ep       => from_rx(id-1),
+			to_ep_vld   => from_rx_vld(id-1),
+			to_ep_req   => from_rx_req(id-1),
+			o           => rx_user(id),
+			o_vld       => rx_user_vld(id),
+			o_req       => '1',
+			timestamp   => timestamp
+		);
+end generate;
+
+fpga_rx_chn: entity work.fpga_rx_channel
+	generic map(config => config, id => FPGA_RX)
+	port map(
+		clk         => clk,
+		rst         => rst,
+		from_ep     => to_rx_mux,
+		from_ep_vld => to_rx_vld,
+		from_ep_req => to_rx_req(FPGA_RX-1),
+		to_ep       => from_rx(FPGA_RX-1),
+		to_ep_vld   => from_rx_vld(FPGA_RX-1),
+		to_ep_req   => from_rx_req(FPGA_RX-1),
+		o           => rx_user(FPGA_RX),
+		o_vld       => rx_user_vld(FPGA_RX),
+		o_req       => '1'
+	);
+
+host_tx: for id in HOST_TX_1 to HOST_TX_2 generate
+	chn: entity work.host_tx_channel
+		generic map(config => config, id => id)
+		port map(
+			clk         => clk,
+			rst         => rst,
+			i_vld       => tx_user_vld(id),
+			i_req       => tx_user_req(id),
+			i           => tx_user(id),
+			from_ep_vld => to_tx_vld,
+			from_ep_req => to_tx_req(id-FPGA_RX-1),
+			from_ep     => to_tx_mux,
+			to_ep_vld   => from_tx_vld(id-FPGA_RX-1),
+			to_ep_req   => from_tx_req(id-FPGA_RX-1),
+			to_ep       => from_tx(id-FPGA_RX-1),
+			timestamp   => timestamp
+		);
+end generate;
+
+fpga_tx_chn: entity work.fpga_tx_channel
+	generic map(config => config, id => FPGA_TX)
+	port map(
+		clk         => clk,
+		rst         => rst,
+		from_ep     => to_tx_mux,
+		from_ep_vld => to_tx_vld,
+		from_ep_req => to_tx_req(FPGA_TX-FPGA_RX-1),
+		to_ep       => from_tx(FPGA_TX-FPGA_RX-1),
+		to_ep_vld   => from_tx_vld(FPGA_TX-FPGA_RX-1),
+		to_ep_req   => from_tx_req(FPGA_TX-FPGA_RX-1),
+		i           => tx_user(FPGA_TX),
+		i_vld       => tx_user_vld(FPGA_TX),
+		i_req       => tx_user_req(FPGA_TX)
+	);
+
+end architecture;
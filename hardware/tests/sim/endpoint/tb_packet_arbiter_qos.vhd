@@ -0,0 +1,213 @@
+-- Testbench for the packet arbiter arbitration classes and rate limits
+--
+-- Two bulk ports send back-to-back 16 word packets, a control port sends
+-- a single word packet every 50 clock cycles. The latency of the control
+-- packets is measured at the arbiter output.
+-- The control port may send read requests instead, which are held back
+-- while its rd_grant is not set.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.pcie;
+use work.cfg_channel_types.all;
+
+
+entity tb_packet_arbiter_qos is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_packet_arbiter_qos is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	constant ports: natural := 3;
+	constant ctrl_port: natural := 2;
+	constant bulk_len: natural := 16;
+	constant ctrl_period: natural := 50;
+
+	signal rst: std_logic := '1';
+
+	signal i: pcie.fragment_vector(ports-1 downto 0) := (others => pcie.default_fragment);
+	signal i_vld: std_logic_vector(ports-1 downto 0) := (others => '0');
+	signal i_req: std_logic_vector(ports-1 downto 0);
+	signal o: pcie.fragment;
+	signal o_vld: std_logic;
+	signal o_req: std_logic := '1';
+
+	signal qos: qos_config_vector(ports-1 downto 0) := (others => default_qos_config);
+	signal rd_grant: std_logic_vector(ports-1 downto 0) := (others => '1');
+
+	signal bulk_on, ctrl_on: boolean := false;
+	-- the control packets are read requests
+	signal ctrl_read: boolean := false;
+
+	type beat_vector is array (0 to 1) of natural;
+	signal beat: beat_vector := (others => 0);
+
+	signal ctrl_issue: time := 0 ns;
+
+	-- measured at the output
+	signal max_ctrl_latency: natural := 0;
+	signal ctrl_packets: natural := 0;
+	signal bulk_dwords: beat_vector := (others => 0);
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+
+main: process
+	procedure run_cycles(n: natural) is
+	begin
+		for idx in 1 to n loop
+			wait until rising_edge(clk);
+		end loop;
+	end procedure;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	rst <= '1';
+	run_cycles(4);
+	rst <= '0';
+
+	if run("round robin latency") then
+		bulk_on <= true;
+		ctrl_on <= true;
+		wait until ctrl_packets = 20;
+
+		info("max. control latency (round robin): " & to_string(max_ctrl_latency));
+		check_relation(max_ctrl_latency <= 2 * bulk_len + 4);
+
+	elsif run("high priority latency isolation") then
+		qos(ctrl_port).high_prio <= '1';
+		bulk_on <= true;
+		ctrl_on <= true;
+		wait until ctrl_packets = 20;
+
+		-- a high priority packet waits at most for the bulk packet in flight
+		info("max. control latency (high priority): " & to_string(max_ctrl_latency));
+		check_relation(max_ctrl_latency <= bulk_len + 4);
+
+	elsif run("weighted round robin") then
+		qos(0).weight <= x"3";
+		bulk_on <= true;
+		run_cycles(2000);
+
+		-- port 0 sends 4 packets per round, port 1 one
+		info("DWORDs port 0: " & to_string(bulk_dwords(0)) & ", port 1: " & to_string(bulk_dwords(1)));
+		check_relation(bulk_dwords(0) > 3 * bulk_dwords(1));
+
+	elsif run("token bucket rate limit") then
+		-- 1 DWORD per clock cycle, 64 DWORD burst
+		qos(0).rate  <= to_unsigned(256, 12);
+		qos(0).burst <= to_unsigned(64, 12);
+		bulk_on <= true;
+		run_cycles(4000);
+
+		info("DWORDs port 0: " & to_string(bulk_dwords(0)) & ", port 1: " & to_string(bulk_dwords(1)));
+		check(bulk_dwords(0) >= 3800 and bulk_dwords(0) <= 4000 + 64 + 4 * bulk_len,
+		      "port 0 is limited to one DWORD per clock cycle");
+		check_relation(bulk_dwords(1) > 2 * bulk_dwords(0));
+
+	elsif run("read requests without grant are skipped") then
+		rd_grant(ctrl_port) <= '0';
+		ctrl_read <= true;
+		bulk_on   <= true;
+		ctrl_on   <= true;
+		run_cycles(1000);
+
+		check_equal(ctrl_packets, 0, "read requests sent without grant");
+		info("DWORDs port 0: " & to_string(bulk_dwords(0)) & ", port 1: " & to_string(bulk_dwords(1)));
+		check_relation(bulk_dwords(0) + bulk_dwords(1) >= 3 * 1000, "bulk ports blocked");
+
+		rd_grant(ctrl_port) <= '1';
+		wait until ctrl_packets = 5;
+		info("max. control latency (granted): " & to_string(max_ctrl_latency));
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 1 ms);
+
+
+-- saturating bulk sources, the channel id of the packet is the port index
+bulk: for p in 0 to 1 generate
+	i_vld(p)    <= '1' when bulk_on else '0';
+	i(p).sof    <= '1' when beat(p) = 0 else '0';
+	i(p).eof    <= '1' when beat(p) = bulk_len - 1 else '0';
+	i(p).keep   <= "1111";
+	i(p).data   <= std_logic_vector(to_unsigned(beat(p), 96)) & std_logic_vector(to_unsigned(p, 8)) & x"000000";
+
+	src: process
+	begin
+		wait until rising_edge(clk);
+		if i_vld(p) = '1' and i_req(p) = '1' then
+			beat(p) <= (beat(p) + 1) mod bulk_len;
+		end if;
+	end process;
+end generate;
+
+ctrl: process
+begin
+	wait until ctrl_on;
+	loop
+		for idx in 1 to ctrl_period loop
+			wait until rising_edge(clk);
+		end loop;
+
+		i(ctrl_port).sof  <= '1';
+		i(ctrl_port).eof  <= '1';
+		i(ctrl_port).keep <= "0111";
+		i(ctrl_port).data <= std_logic_vector(to_unsigned(0, 96)) & std_logic_vector(to_unsigned(ctrl_port, 8)) & x"00000" &
+		                     ("0001" when ctrl_read else "0000");
+		i_vld(ctrl_port)  <= '1';
+		ctrl_issue <= now;
+
+		wait until rising_edge(clk) and i_req(ctrl_port) = '1';
+		i_vld(ctrl_port) <= '0';
+	end loop;
+end process;
+
+monitor: process
+	variable latency: natural;
+	variable chn: natural;
+begin
+	wait until rising_edge(clk);
+	if o_vld = '1' then
+		chn := to_integer(unsigned(o.data(31 downto 24)));
+		if chn = ctrl_port then
+			latency := (now - ctrl_issue) / (clk_per * 1 ns);
+			if latency > max_ctrl_latency then
+				max_ctrl_latency <= latency;
+			end if;
+			ctrl_packets <= ctrl_packets + 1;
+		else
+			bulk_dwords(chn) <= bulk_dwords(chn) + 4;
+		end if;
+	end if;
+end process;
+
+
+uut: entity work.packet_arbiter
+	generic map(
+		ports => ports
+	)
+	port map(
+		clk   => clk,
+		rst   => rst,
+		i_req => i_req,
+		i_vld => i_vld,
+		i     => i,
+		o_req => o_req,
+		o_vld => o_vld,
+		o     => o,
+		qos   => qos,
+		rd_grant => rd_grant
+	);
+
+end architecture;
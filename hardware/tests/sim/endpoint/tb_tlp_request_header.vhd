@@ -0,0 +1,87 @@
+-- Testbench for the wire layout of request headers in tlp_types
+--
+-- DW0 has to follow the PCIe layout: Length 9:0, Attr 13:12, EP 14, TD 15,
+-- TH 16, TC 22:20 and Fmt/Type 30:24.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.host_types.all;
+use work.tlp_types.all;
+
+
+entity tb_tlp_request_header is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_tlp_request_header is
+
+	function request(length: natural; th: std_logic; attr: std_logic_vector(1 downto 0);
+		fmt_type: std_logic_vector(6 downto 0)) return tlp_request_header is
+		variable header: tlp_request_header;
+	begin
+		header.dw0.length   := std_logic_vector(to_unsigned(length mod 1024, 10));
+		header.dw0.attr     := attr;
+		header.dw0.th       := th;
+		header.dw0.ep       := '0';
+		header.dw0.td       := '0';
+		header.dw0.tc       := "000";
+		header.dw0.fmt_type := fmt_type;
+		header.dw1.first_byte_enable := x"F";
+		header.dw1.last_byte_enable  := x"F";
+		header.dw1.tag               := x"05";
+		header.dw1.requester_id      := x"0100";
+		header.dw2.address := x"00001000";
+		header.dw3 := (others => '0');
+		return header;
+	end function;
+
+begin
+
+main: process
+	variable slv: std_logic_vector(95 downto 0);
+	variable header: tlp_request_header;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+
+	if run("MWr with TPH sets TH and keeps the length") then
+		slv := tlp_request_header_to_slv(request(32, '1', "10", fmtType_MWr));
+		check_equal(slv(31 downto 0), std_logic_vector'(x"40012020"));
+		check_equal(slv(63 downto 32), std_logic_vector'(x"010005FF"));
+		check_equal(slv(95 downto 64), std_logic_vector'(x"00001000"));
+
+	elsif run("MRd of 256 DWords without TPH") then
+		slv := tlp_request_header_to_slv(request(256, '0', "00", fmtType_MRd));
+		check_equal(slv(31 downto 0), std_logic_vector'(x"00000100"));
+		check_equal(slv(8), '1', "Length[8]");
+		check_equal(slv(16), '0', "TH");
+
+	elsif run("MRd of 1024 DWords with all fields set") then
+		header := request(1024, '1', "11", fmtType_MRd64);
+		header.dw0.ep := '1';
+		header.dw0.td := '1';
+		header.dw0.tc := "101";
+		slv := tlp_request_header_to_slv(header);
+		check_equal(slv(31 downto 0), std_logic_vector'(x"2051F000"));
+
+	elsif run("round trip") then
+		header := request(511, '1', "01", fmtType_MWr64);
+		slv := tlp_request_header_to_slv(header);
+		header := slv_to_tlp_request_header(slv);
+		check_equal(header.dw0.length, std_logic_vector'("0111111111"));
+		check_equal(header.dw0.th, '1');
+		check_equal(header.dw0.attr, std_logic_vector'("01"));
+		check_equal(header.dw0.fmt_type, fmtType_MWr64);
+		check_equal(header.dw1.tag, std_logic_vector'(x"05"));
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+
+end architecture;
@@ -0,0 +1,191 @@
+-- Testbench for the tag reservation of the host rx channels
+--
+-- Two host rx channels share 8 tags with a minimum of 2 each, id 5 stands
+-- for a channel which is no host rx channel.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+
+entity tb_tlp_tag_quota is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_tlp_tag_quota is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	constant channels: natural := 2;
+	constant tags: positive := 8;
+	constant tags_min: natural := 2;
+	constant OTHER: natural := 5;
+
+	signal rst: std_logic := '1';
+
+	signal rqst_chn_id: std_logic_vector(7 downto 0) := (others => '0');
+	signal grant: std_logic_vector(channels downto 0);
+	signal take: std_logic := '0';
+	signal give: std_logic := '0';
+	signal give_chn_id: std_logic_vector(7 downto 0) := (others => '0');
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+
+main: process
+	function id(chn: natural) return std_logic_vector is
+	begin
+		return std_logic_vector(to_unsigned(chn, 8));
+	end function;
+
+	-- grant is checked once the registers have settled
+	procedure settle is
+	begin
+		wait for 1 ps;
+	end procedure;
+
+	-- channels without reservation share grant(0)
+	impure function granted(chn: natural) return std_logic is
+	begin
+		if chn <= channels then
+			return grant(chn);
+		end if;
+		return grant(0);
+	end function;
+
+	procedure check_grant(constant chn: in natural; constant expected: in std_logic;
+		constant msg: in string := "") is
+	begin
+		settle;
+		check_equal(granted(chn), expected, "grant of channel " & natural'image(chn) & " " & msg);
+	end procedure;
+
+	-- one cycle with a take by `taker` and/or a give by `giver`, 0 for none
+	procedure cycle(constant taker, giver: in natural) is
+	begin
+		rqst_chn_id <= id(taker);
+		give_chn_id <= id(giver);
+		take <= '1' when taker /= 0 else '0';
+		give <= '1' when giver /= 0 else '0';
+		wait until rising_edge(clk);
+		take <= '0';
+		give <= '0';
+	end procedure;
+
+	-- takes tags for `chn` while grant is set, returns their number
+	procedure borrow(constant chn: in natural; variable count: out natural) is
+	begin
+		count := 0;
+		settle;
+		while granted(chn) = '1' and count < tags loop
+			cycle(chn, 0);
+			count := count + 1;
+			settle;
+		end loop;
+	end procedure;
+
+	variable count: natural;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	rst <= '1';
+	wait until rising_edge(clk);
+	rst <= '0';
+	wait until rising_edge(clk);
+
+	if run("minimum of the other channel is reserved") then
+		borrow(1, count);
+		check_equal(count, tags - tags_min, "tags borrowed by channel 1");
+
+		borrow(2, count);
+		check_equal(count, tags_min, "tags of channel 2");
+
+	elsif run("other channels get no reservation") then
+		borrow(OTHER, count);
+		check_equal(count, tags - channels * tags_min, "tags of a channel without reservation");
+		check_grant(1, '1');
+		check_grant(2, '1');
+
+	elsif run("borrowing above the minimum") then
+		for i in 1 to tags_min loop
+			cycle(2, 0);
+		end loop;
+		-- channel 2 has its minimum, channel 1 may take the rest but its own reserve
+		borrow(2, count);
+		check_equal(count, tags - 2 * tags_min, "tags borrowed by channel 2");
+		check_grant(1, '1', "reserve of channel 1");
+
+		-- returned tags can be borrowed again
+		cycle(0, 2);
+		check_grant(2, '1');
+		borrow(1, count);
+		check_equal(count, tags_min + 1, "tags of channel 1");
+		check_grant(2, '0');
+
+	elsif run("take and give of the same channel in one cycle") then
+		cycle(1, 0);
+		-- at, below and above the minimum
+		for i in 1 to 4 loop
+			cycle(1, 1);
+		end loop;
+		cycle(1, 0);
+		for i in 1 to 4 loop
+			cycle(1, 1);
+		end loop;
+		cycle(1, 0);
+		for i in 1 to 4 loop
+			cycle(1, 1);
+		end loop;
+
+		-- 3 in flight, the counts must be unchanged
+		borrow(1, count);
+		check_equal(count, tags - tags_min - 3, "tags left for channel 1");
+		borrow(2, count);
+		check_equal(count, tags_min, "tags of channel 2");
+
+	elsif run("take and give of different channels in one cycle") then
+		borrow(1, count);
+		check_equal(count, tags - tags_min);
+
+		-- channel 2 takes from its reserve while channel 1 returns a borrowed tag
+		cycle(2, 1);
+		check_grant(1, '1', "returned tag may be borrowed again");
+		cycle(1, 0);
+		check_grant(1, '0');
+		check_grant(2, '1', "rest of the reserve of channel 2");
+
+		-- channel 1 takes a borrowed tag while channel 2 returns a reserved one
+		cycle(0, 1);
+		cycle(1, 2);
+		check_grant(1, '0');
+		borrow(2, count);
+		check_equal(count, tags_min, "reserve of channel 2 restored");
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 10 us);
+
+
+uut: entity work.tlp_tag_quota
+	generic map(
+		channels => channels,
+		tags     => tags,
+		tags_min => tags_min
+	)
+	port map(
+		clk         => clk,
+		rst         => rst,
+		grant       => grant,
+		take        => take,
+		rqst_chn_id => rqst_chn_id,
+		give        => give,
+		give_chn_id => give_chn_id
+	);
+
+end architecture;
@@ -0,0 +1,207 @@
+-- Testbench for the TLP trace buffer
+--
+-- Single word TLPs are sent on both observed sides, the recorded entries
+-- are read back the way the config channel does.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.pcie;
+use work.transceiver_128bit_types.all;
+use work.cfg_channel_types.all;
+
+
+entity tb_tlp_trace is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_tlp_trace is
+	constant depth: positive := 8;
+
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+	signal rst: std_logic := '1';
+
+	signal timestamp: unsigned(63 downto 0) := (others => '0');
+
+	signal rx, tx: pcie.fragment := pcie.default_fragment;
+	signal rx_vld, tx_vld: std_logic := '0';
+	signal tx_waiting: std_ulogic_vector(3 downto 0) := "0000";
+
+	signal ctrl: trace_control := default_trace_control;
+	signal status: trace_state;
+
+	-- MWr32 of one DWord for channel chn to address addr
+	function tlp(chn, addr: natural) return pcie.fragment is
+		variable ret: pcie.fragment := pcie.default_fragment;
+	begin
+		ret.sof := '1';
+		ret.eof := '1';
+		ret.keep := "1111";
+		ret.data(31 downto 0) := std_logic_vector(to_unsigned(chn, 8)) & x"00" &
+		                         std_logic_vector(to_unsigned(1, 10)) & "00" & MWr32_desc;
+		ret.data(95 downto 64) := std_logic_vector(to_unsigned(addr, 32));
+		return ret;
+	end function;
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+counter: process
+begin
+	wait until rising_edge(clk);
+	timestamp <= timestamp + 1;
+end process;
+
+
+main: process
+	variable entry: std_ulogic_vector(127 downto 0);
+
+	procedure cycle(n: natural := 1) is
+	begin
+		for k in 1 to n loop
+			wait until rising_edge(clk);
+		end loop;
+	end procedure;
+
+	procedure pulse_arm is
+	begin
+		ctrl.arm <= '1';
+		cycle;
+		ctrl.arm <= '0';
+	end procedure;
+
+	procedure pulse_stop is
+	begin
+		ctrl.stop <= '1';
+		cycle;
+		ctrl.stop <= '0';
+		cycle(3);
+	end procedure;
+
+	-- one TLP on each side that is given, chn < 0 leaves a side idle
+	procedure send(rx_chn, tx_chn: integer) is
+	begin
+		if rx_chn >= 0 then
+			rx <= tlp(rx_chn, 16#100# + rx_chn);
+			rx_vld <= '1';
+		end if;
+		if tx_chn >= 0 then
+			tx <= tlp(tx_chn, 16#200# + tx_chn);
+			tx_vld <= '1';
+		end if;
+		cycle;
+		rx_vld <= '0';
+		tx_vld <= '0';
+	end procedure;
+
+	procedure read_entry is
+	begin
+		for dw in 0 to 3 loop
+			entry(32*dw+31 downto 32*dw) := status.data;
+			ctrl.read <= '1';
+			cycle;
+			ctrl.read <= '0';
+			cycle(3);
+		end loop;
+	end procedure;
+
+	procedure check_entry(dir: std_ulogic_vector(1 downto 0); chn, addr: natural) is
+	begin
+		read_entry;
+		check_equal(entry(63 downto 62), dir, "direction");
+		check_equal(to_common_dw0(entry(95 downto 64)).chn_id,
+		            std_ulogic_vector(to_unsigned(chn, 8)), "channel");
+		check_equal(unsigned(entry(127 downto 96)), addr, "address");
+	end procedure;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	rst <= '1';
+	ctrl <= default_trace_control;
+	cycle;
+	rst <= '0';
+	cycle;
+
+	if run("records both directions") then
+		tx_waiting <= "0101";
+		pulse_arm;
+		send(1, -1);
+		send(2, 3);
+		send(-1, 4);
+		cycle(2);
+		pulse_stop;
+		check_equal(status.entries, 4, "entries");
+		check_equal(status.lost, '0', "nothing lost");
+		check_equal(status.depth_log2, 3, "depth");
+		check_entry("01", 1, 16#101#);
+		check_entry("01", 2, 16#102#);
+		check_entry("10", 3, 16#203#);
+		check_equal(entry(59 downto 56), std_ulogic_vector'("0101"), "waiting inputs");
+		check_entry("10", 4, 16#204#);
+		read_entry;
+		check_equal(entry(63 downto 62), std_ulogic_vector'("01"), "wraps to the oldest");
+
+	elsif run("filter") then
+		ctrl.filter <= x"FFFF0506"; -- FPGA to host TLPs of channel 5
+		pulse_arm;
+		send(5, 4);
+		send(5, 5);
+		send(-1, 5);
+		pulse_stop;
+		check_equal(status.entries, 2, "entries");
+		check_entry("10", 5, 16#205#);
+		check_entry("10", 5, 16#205#);
+
+	elsif run("trigger and post entries") then
+		ctrl.trigger <= x"00000707"; -- any direction, channel 7
+		ctrl.post <= to_unsigned(2, 16);
+		pulse_arm;
+		for k in 0 to 9 loop
+			send(k mod 4, -1);
+		end loop;
+		send(-1, 7);
+		for k in 0 to 5 loop
+			send(10 + k, -1);
+		end loop;
+		cycle(2);
+		check_equal(status.recording, '0', "stopped by the trigger");
+		check_equal(status.triggered, '1', "triggered");
+		check_equal(status.wrapped, '1', "wrapped");
+		check_equal(status.entries, depth, "entries");
+		pulse_stop;
+		for k in 0 to 4 loop
+			read_entry;
+		end loop;
+		check_entry("10", 7, 16#207#);
+		check_entry("01", 10, 16#10A#);
+		check_entry("01", 11, 16#10B#);
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 20 us);
+
+
+uut: entity work.tlp_trace
+generic map(depth => depth)
+port map(
+	clk        => clk,
+	rst        => rst,
+	timestamp  => timestamp,
+	rx         => rx,
+	rx_vld     => rx_vld,
+	rx_req     => '1',
+	tx         => tx,
+	tx_vld     => tx_vld,
+	tx_req     => '1',
+	tx_waiting => tx_waiting,
+	ctrl       => ctrl,
+	status     => status
+);
+
+end architecture;
@@ -24,6 +24,9 @@ architecture arch of tb_receiver is
 
 	signal length: natural := 0;
 
+	-- granularity of the FIFO space granted to the sender
+	constant credit_bytes: natural := 256;
+
 	signal i,rqst: pcie.fragment := pcie.default_fragment;
 	signal o: pcie.rx_stream := pcie.default_rx_stream;
 	signal i_vld, o_vld, rqst_vld: std_logic := '0';
@@ -52,6 +55,36 @@ rqst_req <= '1';
 
 main: process
 	variable test_length: natural := 0;
+
+	-- data write of `dwords` dwords, the first one in the header
+	procedure write_data(constant dwords: in natural) is
+		variable left: natural;
+	begin
+		wait until rising_edge(clk);
+		reset(i);
+		set_rqst32_header(i, make_wr_rqst32(
+			length => dwords,
+			chn_id => 1,
+			address => 32x"f720107c"
+		));
+		set_dw(i, 3, 32x"0");
+		i.eof <= '1' when dwords = 1 else '0';
+		i_vld <= '1';
+
+		left := dwords - 1;
+		while left > 0 loop
+			wait until rising_edge(clk);
+			reset(i);
+			for idx in 0 to minimum(left, 4) - 1 loop
+				set_dw(i, idx, 32x"0");
+			end loop;
+			i.eof  <= '1' when left <= 4 else '0';
+			left := left - minimum(left, 4);
+		end loop;
+
+		wait until rising_edge(clk);
+		i_vld <= '0';
+	end procedure;
 begin
 	test_runner_setup(runner, runner_cfg);
 	while test_suite loop
@@ -112,6 +145,35 @@ begin
 		i_vld <= '0';
 
 		wait until done;
+
+	elsif run("grant consumed space") then
+		wait until rising_edge(clk);
+		reset(i);
+		start_cfg <= true;
+		set_rqst32_header(i, make_wr_rqst32(
+			length => 1,
+			chn_id => 1,
+			address => 32x"f720104c"
+		));
+		set_dw(i, 3, 32x"1");
+		i_vld <= '1';
+
+		wait until rising_edge(clk);
+		i_vld <= '0';
+
+		wait until cfg_done for 100 ns;
+		check(cfg_done);
+
+		-- below one credit nothing is granted
+		write_data(32);
+		wait for 100 ns;
+		check_equal(rqst_vld, '0', "grant before a full credit");
+
+		-- the credit covers the data read by the user logic
+		write_data(32);
+		wait until rising_edge(clk) and rqst_vld = '1' for 100 ns;
+		check_equal(rqst_vld, '1', "grant after a full credit");
+		check_equal(unsigned(rqst.data(127 downto 96)), credit_bytes, "granted bytes");
 	end if;
 	end loop;
 	test_runner_cleanup(runner);
@@ -157,7 +219,11 @@ begin
 end process;
 
 uut: entity work.fpga_rx_channel
-generic map(config => pcie.new_config(host_rx => 0, host_tx => 0), id => 1)
+generic map(
+	config       => pcie.new_config(host_rx => 0, host_tx => 0),
+	id           => 1,
+	credit_bytes => credit_bytes
+)
 port map(
 	clk => clk,
 	rst => '0',
@@ -26,6 +26,9 @@ architecture tb of tb_sender_cfg_ctrl is
 	signal i_pkt: filter_packet := ((others => '0'), (others => '0'));
 	signal i_vld, i_req: std_logic := '0';
 	signal config: fpga_tx_config_t := init_config;
+
+	-- sum of the bytes passed on to the sender
+	signal released: natural := 0;
 begin
 
 clk <= not clk after (clk_period/2) * 1 ns;
@@ -107,6 +110,49 @@ begin
 			wait until rising_edge(clk);
 			wait until rising_edge(clk);
 
+		elsif run("test_multicast_credits") then
+			wait until rising_edge(clk);
+			i_vld <= '1';
+			i_pkt.address <= x"5";
+			i_pkt.payload <= to_unsigned(3, 32);
+			wait until rising_edge(clk);
+
+			-- the slowest of the three peers has granted nothing yet
+			i_pkt.address <= x"8";
+			i_pkt.payload <= to_unsigned(64, 32);
+			wait until rising_edge(clk);
+			i_pkt.address <= x"9";
+			i_pkt.payload <= to_unsigned(32, 32);
+			wait until rising_edge(clk);
+			i_vld <= '0';
+			wait until rising_edge(clk);
+			wait until rising_edge(clk);
+			check_equal(config.peers, 3);
+			check_equal(released, 0);
+
+			i_vld <= '1';
+			i_pkt.address <= x"A";
+			i_pkt.payload <= to_unsigned(48, 32);
+			wait until rising_edge(clk);
+			i_vld <= '0';
+			wait until rising_edge(clk);
+			wait until rising_edge(clk);
+			wait until rising_edge(clk);
+			check_equal(released, 32);
+
+			-- peer 0 through the unicast register
+			i_vld <= '1';
+			i_pkt.address <= x"9";
+			i_pkt.payload <= to_unsigned(64, 32);
+			wait until rising_edge(clk);
+			i_pkt.address <= x"2";
+			i_pkt.payload <= to_unsigned(16, 32);
+			wait until rising_edge(clk);
+			i_vld <= '0';
+			wait until rising_edge(clk);
+			wait until rising_edge(clk);
+			wait until rising_edge(clk);
+			check_equal(released, 48);
 
 		end if;
 	end loop;
@@ -115,7 +161,14 @@ begin
 end process main;
 test_runner_watchdog(runner, 10 ms);
 
+count_released: process
+begin
+	wait until rising_edge(clk);
+	released <= released + to_integer(config.size_bytes);
+end process;
+
 uut: entity work.sender_cfg_ctrl
+generic map(max_peers => 4)
 port map(
 	clk => clk,
 	i => i_pkt,
@@ -0,0 +1,145 @@
+-- Testbench for the replication of write requests to several peers
+--
+-- Write requests of one to three fragments are fed like the sender does,
+-- every copy must carry the address of its peer and the original payload.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.host_types.all;
+use work.transceiver_128bit_types.all;
+use work.sender_cfg_ctrl_types.all;
+use work.pcie;
+
+entity tb_sender_multicast is
+generic(runner_cfg: string);
+end entity;
+
+architecture tb of tb_sender_multicast is
+	constant clk_period: natural := 2;
+	signal clk: std_logic := '0';
+
+	signal config: fpga_tx_config_t := init_config;
+
+	signal i, o: pcie.fragment := pcie.default_fragment;
+	signal i_vld, o_vld: std_logic := '0';
+	signal i_req, o_req: std_logic := '1';
+
+	type natural_vector is array (natural range <>) of natural;
+	constant lengths: natural_vector := (1, 5, 9);
+
+	signal copies: natural := 0;
+
+	-- fragments of a write request with a 32 bit address
+	function fragments(length: natural) return natural is
+	begin
+		return (length + 3 - 1) / 4 + 1;
+	end function;
+
+	function peer_addr(peer: natural) return u32 is
+	begin
+		return to_unsigned(16#f7300000# + peer * 16#40#, 32);
+	end function;
+begin
+
+clk <= not clk after clk_period/2 * 1 ns;
+
+main: process
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+		if run("test_unicast_passthrough") then
+			config.peers <= 1;
+			i <= pcie.default_fragment;
+			set_rqst32_header(i, make_wr_rqst32(length => 1, chn_id => 2, address => 32x"1000"));
+			i_vld <= '1';
+			wait until rising_edge(clk);
+			check_equal(o_vld, '1');
+			check_equal(o.data(95 downto 64), 32x"1000");
+			i_vld <= '0';
+
+		elsif run("test_three_peers") then
+			config.peers <= 3;
+			for peer in 0 to max_fpga_peers-1 loop
+				config.peer_addr(peer) <= peer_addr(peer);
+			end loop;
+
+			for idx in lengths'range loop
+				for frag in 0 to fragments(lengths(idx))-1 loop
+					i <= pcie.default_fragment;
+					if frag = 0 then
+						set_rqst32_header(i, make_wr_rqst32(
+							length  => lengths(idx),
+							chn_id  => 2,
+							address => std_logic_vector(peer_addr(0))
+						));
+						set_dw(i, 3, std_logic_vector(to_unsigned(idx * 100, 32)));
+					else
+						i.data <= std_logic_vector(to_unsigned(idx * 100 + frag, 128));
+					end if;
+					i.eof <= '1' when frag = fragments(lengths(idx))-1 else '0';
+					i_vld <= '1';
+					wait until rising_edge(clk) and i_req = '1';
+				end loop;
+				i_vld <= '0';
+			end loop;
+
+			wait until rising_edge(clk) and i_req = '1';
+			wait until rising_edge(clk);
+			check_equal(o_vld, '0');
+			check_equal(copies, 3 * lengths'length);
+		end if;
+	end loop;
+	test_runner_cleanup(runner);
+	wait;
+end process main;
+test_runner_watchdog(runner, 10 us);
+
+-- takes a fragment every other cycle and checks the copies
+check_copies: process
+	variable tlp, frag, peer: natural := 0;
+begin
+	wait until rising_edge(clk);
+	o_req <= not o_req;
+
+	if o_vld = '1' and o_req = '1' and config.peers > 1 then
+		if frag = 0 then
+			check_equal(o.sof, '1');
+			check_equal(o.data(95 downto 64), std_logic_vector(peer_addr(peer)), "peer address");
+			check_equal(o.data(127 downto 96), std_logic_vector(to_unsigned(tlp * 100, 32)));
+		else
+			check_equal(o.data, std_logic_vector(to_unsigned(tlp * 100 + frag, 128)));
+		end if;
+
+		frag := frag + 1;
+		if frag = fragments(lengths(tlp)) then
+			check_equal(o.eof, '1');
+			copies <= copies + 1;
+			frag := 0;
+			peer := peer + 1;
+			if peer = 3 then
+				peer := 0;
+				tlp  := tlp + 1;
+			end if;
+		end if;
+	end if;
+end process;
+
+uut: entity work.fpga_tx_multicast
+generic map(max_payload_bytes => 256)
+port map(
+	clk   => clk,
+	cfg   => config,
+	i     => i,
+	i_vld => i_vld,
+	i_req => i_req,
+	o     => o,
+	o_vld => o_vld,
+	o_req => o_req
+);
+
+end architecture;
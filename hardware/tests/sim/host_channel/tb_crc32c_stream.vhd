@@ -0,0 +1,101 @@
+-- Testbench for the CRC32C of the host channel data streams
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+
+entity tb_crc32c_stream is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_crc32c_stream is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	signal clear: std_logic := '0';
+	signal i_vld: std_logic := '0';
+	signal i_data: std_ulogic_vector(127 downto 0) := (others => '0');
+	signal i_cnt: unsigned(2 downto 0) := (others => '0');
+	signal i_last_bytes: unsigned(1 downto 0) := (others => '0');
+
+	signal crc: std_logic_vector(31 downto 0);
+	signal bytes: unsigned(31 downto 0);
+
+	-- check value of CRC32C for the ASCII string "123456789"
+	constant check_value: std_logic_vector(31 downto 0) := x"E3069283";
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+
+main: process
+	procedure word(data: std_ulogic_vector(127 downto 0); cnt, last_bytes: natural) is
+	begin
+		i_data       <= data;
+		i_cnt        <= to_unsigned(cnt, 3);
+		i_last_bytes <= to_unsigned(last_bytes, 2);
+		i_vld        <= '1';
+		wait until rising_edge(clk);
+		i_vld        <= '0';
+	end procedure;
+
+	procedure restart is
+	begin
+		clear <= '1';
+		wait until rising_edge(clk);
+		clear <= '0';
+	end procedure;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	wait until rising_edge(clk);
+	restart;
+
+	if run("check value in one word") then
+		word(x"00000000_00000039_38373635_34333231", 3, 1);
+		wait until rising_edge(clk);
+
+		check_equal(crc, check_value);
+		check_equal(bytes, 9);
+
+	elsif run("check value over two words") then
+		word(x"00000000_00000000_00000000_34333231", 1, 0);
+		word(x"00000000_00000000_00000039_38373635", 2, 1);
+		wait until rising_edge(clk);
+
+		check_equal(crc, check_value);
+		check_equal(bytes, 9);
+
+	elsif run("clear restarts the checksum") then
+		word(x"FFFFFFFF_FFFFFFFF_FFFFFFFF_FFFFFFFF", 4, 0);
+		restart;
+		word(x"00000000_00000039_38373635_34333231", 3, 1);
+		wait until rising_edge(clk);
+
+		check_equal(crc, check_value);
+		check_equal(bytes, 9);
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 10 us);
+
+
+uut: entity work.crc32c_stream
+	port map(
+		clk          => clk,
+		clear        => clear,
+		i_vld        => i_vld,
+		i_data       => i_data,
+		i_cnt        => i_cnt,
+		i_last_bytes => i_last_bytes,
+		crc          => crc,
+		bytes        => bytes
+	);
+
+end architecture;
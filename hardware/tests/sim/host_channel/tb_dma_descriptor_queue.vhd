@@ -0,0 +1,147 @@
+-- Testbench for the descriptor queue running full
+--
+-- The host may queue more transfers than the queue holds, these have to
+-- be dropped without touching the queued ones.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.host_channel_types.all;
+
+
+entity tb_dma_descriptor_queue is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_dma_descriptor_queue is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	constant depth: positive := 4;
+
+	signal rst: std_logic := '1';
+
+	signal i_vld: std_logic := '0';
+	signal i: requester_instr_t := (
+		instr     => TRANSFER_DMA32,
+		dma_addr  => (others => '0'),
+		dma_size  => (others => '0'),
+		options   => default_tlp_options,
+		max_bytes => (others => '0'),
+		crc_en    => '0'
+	);
+
+	signal full, overflow: std_logic;
+
+	signal o_vld: std_logic;
+	signal o_req: std_logic := '0';
+	signal o: requester_instr_t;
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+
+main: process
+	-- the outputs of a clock edge are checked once they have settled
+	procedure settle is
+	begin
+		wait for 1 ps;
+	end procedure;
+
+	procedure push(constant size: in natural) is
+	begin
+		i.dma_size <= to_unsigned(size, 32);
+		i_vld <= '1';
+		wait until rising_edge(clk);
+		i_vld <= '0';
+		settle;
+	end procedure;
+
+	procedure pop(constant size: in natural) is
+	begin
+		check_equal(o_vld, '1', "queue empty");
+		check_equal(o.dma_size, to_unsigned(size, 32), "size of the head");
+		o_req <= '1';
+		wait until rising_edge(clk);
+		o_req <= '0';
+		settle;
+	end procedure;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	rst <= '1';
+	wait until rising_edge(clk);
+	rst <= '0';
+	wait until rising_edge(clk);
+	settle;
+
+	if run("transfers beyond the depth are dropped") then
+		for n in 1 to depth loop
+			check_equal(full, '0');
+			push(n);
+		end loop;
+		check_equal(full, '1');
+		check_equal(overflow, '0');
+
+		push(100);
+		push(101);
+		check_equal(overflow, '1');
+
+		for n in 1 to depth loop
+			pop(n);
+		end loop;
+		check_equal(o_vld, '0', "dropped transfer queued");
+		check_equal(full, '0');
+		check_equal(overflow, '1', "overflow cleared without a reset");
+
+	elsif run("a freed entry is used again") then
+		for n in 1 to depth loop
+			push(n);
+		end loop;
+		pop(1);
+		push(5);
+		check_equal(overflow, '0');
+		for n in 2 to depth + 1 loop
+			pop(n);
+		end loop;
+
+	elsif run("reset clears the overflow") then
+		for n in 1 to depth + 1 loop
+			push(n);
+		end loop;
+		rst <= '1';
+		wait until rising_edge(clk);
+		rst <= '0';
+		settle;
+		check_equal(overflow, '0');
+		check_equal(full, '0');
+		check_equal(o_vld, '0');
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 10 us);
+
+
+uut: entity work.dma_descriptor_queue
+	generic map(
+		depth => depth
+	)
+	port map(
+		clk      => clk,
+		rst      => rst,
+		i_vld    => i_vld,
+		i        => i,
+		full     => full,
+		overflow => overflow,
+		o_vld    => o_vld,
+		o_req    => o_req,
+		o        => o
+	);
+
+end architecture;
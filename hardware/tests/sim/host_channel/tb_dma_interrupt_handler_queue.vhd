@@ -0,0 +1,302 @@
+-- Testbench for chained transfers, queued results and aborts of the
+-- interrupt handler
+--
+-- A model of the requester feeds 64 byte TLPs for every transfer taken by
+-- the handler, the registers are read like the driver does after the
+-- interrupts.
+--
+-- More transfers than results are kept may complete before the driver reads
+-- them, the newer results are dropped then and reported in QUEUE_REG.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.transceiver_128bit_types.all;
+use work.host_channel_types.all;
+
+
+entity tb_dma_interrupt_handler_queue is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_dma_interrupt_handler_queue is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	constant depth: positive := 4;
+
+	signal rst: std_logic := '1';
+
+	signal instr_vld: std_logic := '0';
+	signal instr: interrupt_instr_t := (
+		instr       => GET_CHANNEL_INFO,
+		dma_size    => (others => '0'),
+		cpl_tag     => (others => '0'),
+		cpl_lo_addr => (others => '0'),
+		crc_en      => '0',
+		deadline    => (others => '0'),
+		queue_full     => '0',
+		queue_overflow => '0'
+	);
+
+	signal xfer_vld: std_logic := '0';
+	signal xfer_req: std_logic;
+
+	signal transfer_vld: std_logic := '0';
+
+	signal abort, halt: std_logic := '0';
+	signal drained: std_logic := '1';
+	signal flush: std_logic;
+	-- TLPs fed per transfer at most, a stalled transfer is aborted
+	signal tlp_limit: natural := natural'high;
+
+	signal writer_vld: std_logic;
+	signal writer: tlp_header_info_t;
+	signal writer_payload: std_logic_vector(31 downto 0);
+
+	signal timestamp: unsigned(63 downto 0) := (others => '0');
+
+	type size_vector is array (natural range <>) of natural;
+	constant sizes: size_vector := (256, 64, 128);
+
+	signal queued: natural := 0;
+	signal taken: natural := 0;
+	signal interrupts: natural := 0;
+
+	-- idle cycles between the last TLP of a transfer and taking the next one
+	signal max_gap: natural := 0;
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+
+main: process
+	procedure read_reg(constant reg: in instruction_t; variable value: out natural) is
+	begin
+		wait until rising_edge(clk);
+		instr.instr <= reg;
+		instr_vld   <= '1';
+		wait until rising_edge(clk);
+		instr_vld   <= '0';
+		wait until rising_edge(clk) and writer_vld = '1' and writer.desc = CplD_desc;
+		value := to_integer(unsigned(writer_payload));
+	end procedure;
+
+	variable value: natural;
+	variable first: natural;
+	variable start: time;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	rst <= '1';
+	wait until rising_edge(clk);
+	rst <= '0';
+
+	if run("chained transfers") then
+		queued <= sizes'length;
+		wait until interrupts = sizes'length;
+		wait until rising_edge(clk);
+
+		info("max. cycles between transfers: " & to_string(max_gap));
+		check_relation(max_gap <= 4);
+
+		read_reg(GET_QUEUE, value);
+		check_equal(value, sizes'length, "queued results");
+		for idx in sizes'range loop
+			read_reg(GET_TRANSFERRED_BYTES, value);
+			check_equal(value, sizes(idx), "transferred bytes");
+		end loop;
+		read_reg(GET_QUEUE, value);
+		check_equal(value, 0, "queued results");
+
+		-- no result left, the last one is repeated
+		read_reg(GET_TRANSFERRED_BYTES, value);
+		check_equal(value, sizes(sizes'high));
+
+	elsif run("register reads during a transfer") then
+		queued <= 1;
+		wait until taken = 1;
+
+		read_reg(GET_CHANNEL_INFO, value);
+		check_equal(value / 2**16 mod 16, depth, "queue depth in channel info");
+		check_equal(interrupts, 0);
+
+		wait until interrupts = 1;
+		read_reg(GET_TRANSFERRED_BYTES, value);
+		check_equal(value, sizes(0));
+
+	elsif run("timestamps of the first and last TLP") then
+		-- the TLPs of a transfer are fed in consecutive cycles
+		queued <= 1;
+		wait until interrupts = 1;
+		wait for 20 * clk_per * 1 ns;
+
+		read_reg(GET_TRANSFERRED_BYTES, value);
+		check_equal(value, sizes(0));
+		read_reg(GET_TS_FIRST_TLP, value);
+		first := value;
+		read_reg(GET_TS_LAST_TLP, value);
+		check_equal(value - first, sizes(0) / 64 - 1, "cycles between first and last TLP");
+
+	elsif run("results beyond the depth are dropped") then
+		queued <= depth + 2;
+		wait until interrupts = depth + 2;
+		wait until rising_edge(clk);
+
+		read_reg(GET_QUEUE, value);
+		check_equal(value mod 2**16, depth, "queued results");
+		check_equal(value / 2**29 mod 2, 1, "result overflow");
+		for idx in 0 to depth - 1 loop
+			read_reg(GET_TRANSFERRED_BYTES, value);
+			check_equal(value, sizes(idx mod sizes'length), "unread result overwritten");
+		end loop;
+		read_reg(GET_QUEUE, value);
+		check_equal(value mod 2**16, 0, "queued results");
+		check_equal(value / 2**29 mod 2, 1, "overflow cleared without an abort");
+
+		wait until rising_edge(clk);
+		abort <= '1';
+		wait until rising_edge(clk);
+		abort <= '0';
+		read_reg(GET_QUEUE, value);
+		check_equal(value / 2**29 mod 2, 0, "overflow cleared by the abort");
+
+	elsif run("abort a stalled transfer") then
+		tlp_limit <= 2;
+		drained   <= '0';
+		queued    <= 1;
+		wait until taken = 1;
+		wait for 20 * clk_per * 1 ns;
+
+		wait until rising_edge(clk);
+		abort <= '1';
+		wait until rising_edge(clk);
+		abort <= '0';
+		wait until rising_edge(clk);
+		check_equal(halt, '1', "requester halted");
+
+		-- ends once the requests in progress are complete
+		read_reg(GET_ABORT, value);
+		check_equal(value, 1, "draining");
+		check_equal(interrupts, 0);
+		drained <= '1';
+
+		wait until interrupts = 1;
+		check_equal(halt, '0');
+		read_reg(GET_ABORT, value);
+		check_equal(value, 0, "draining");
+		read_reg(GET_QUEUE, value);
+		check_equal(value, 1, "queued results");
+		read_reg(GET_TRANSFERRED_BYTES, value);
+		check_equal(value, 128, "bytes transferred before the abort");
+
+	elsif run("deadline completes a stalled transfer") then
+		instr.deadline <= to_unsigned(50, 32);
+		tlp_limit <= 2;
+		queued    <= 1;
+		wait until taken = 1;
+		start := now;
+
+		-- the writer flushes immediately, see flushed in the port map
+		wait until rising_edge(clk) and flush = '1';
+		check_relation((now - start) / (clk_per * 1 ns) >= 50, "deadline waited for");
+		check_equal(interrupts, 0);
+
+		wait until interrupts = 1;
+		check_equal(flush, '0');
+		check_equal(halt, '0');
+		read_reg(GET_QUEUE, value);
+		check_equal(value, 1, "queued results");
+		read_reg(GET_TRANSFERRED_BYTES, value);
+		check_equal(value, 128, "bytes transferred before the deadline");
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 100 us);
+
+
+-- offers the queued transfers and feeds the data of the taken ones
+requester: process
+	variable tlps, gap: natural;
+	variable last_tlp: time := 0 ns;
+begin
+	wait until rising_edge(clk);
+	if taken < queued then
+		xfer_vld <= '1';
+		wait until rising_edge(clk) and xfer_req = '1';
+		xfer_vld <= '0';
+		-- held by the decoder until the next transfer is taken
+		instr.dma_size <= to_unsigned(sizes(taken mod sizes'length), 32);
+		taken <= taken + 1;
+
+		if taken > 0 then
+			gap := (now - last_tlp) / (clk_per * 1 ns);
+			if gap > max_gap then
+				max_gap <= gap;
+			end if;
+		end if;
+
+		tlps := sizes(taken mod sizes'length) / 64;
+		if tlps > tlp_limit then
+			tlps := tlp_limit;
+		end if;
+		for idx in 1 to tlps loop
+			transfer_vld <= '1';
+			wait until rising_edge(clk);
+		end loop;
+		transfer_vld <= '0';
+		last_tlp := now;
+	end if;
+end process;
+
+counter: process
+begin
+	wait until rising_edge(clk);
+	timestamp <= timestamp + 1;
+end process;
+
+monitor: process
+begin
+	wait until rising_edge(clk);
+	if writer_vld = '1' and writer.desc = MSIX_desc then
+		interrupts <= interrupts + 1;
+	end if;
+end process;
+
+
+uut: entity work.dma_interrupt_handler
+	generic map(
+		CHANNEL_ID  => 1,
+		direction   => "tx",
+		QUEUE_DEPTH => depth
+	)
+	port map(
+		clk             => clk,
+		rst             => rst,
+		ctrl_rst        => open,
+		instr_vld       => instr_vld,
+		instr           => instr,
+		xfer_vld        => xfer_vld,
+		xfer_req        => xfer_req,
+		abort           => abort,
+		halt            => halt,
+		drained         => drained,
+		flush           => flush,
+		flushed         => flush,
+		transfer_vld    => transfer_vld,
+		transfer_length => to_unsigned(16, 10),
+		transfer_eof    => '1',
+		timestamp       => timestamp,
+		writer_vld      => writer_vld,
+		writer_req      => '1',
+		writer          => writer,
+		writer_payload  => writer_payload
+	);
+
+end architecture;
@@ -0,0 +1,177 @@
+-- Testbench for halting the DMA requester during a transfer
+--
+-- The halt comes at every point of the request sequence, with the writer
+-- stalled and ready. Every tag the requester took from the tag source has
+-- to end up in a request the writer took, else its completion never
+-- arrives and the rx_dma_buffer waits for it forever.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.transceiver_128bit_types.all;
+use work.host_channel_types.all;
+
+
+entity tb_dma_requester_abort is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_dma_requester_abort is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	constant MRS: positive := 128;
+
+	signal rst: std_logic := '1';
+
+	signal instr: requester_instr_t;
+	signal instr_vld: std_logic := '0';
+	signal instr_req: std_logic;
+	signal halt: std_logic := '0';
+
+	signal tag_vld: std_logic := '1';
+	signal tag_req: std_logic;
+	signal tag: std_logic_vector(4 downto 0);
+
+	signal writer: tlp_header_info_t;
+	signal writer_vld: std_logic;
+	signal writer_req: std_logic := '1';
+
+	-- tags handed out and requests sent since the reset
+	signal tags_taken: natural := 0;
+	signal sent: natural := 0;
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+tag <= std_logic_vector(to_unsigned(tags_taken mod 32, 5));
+
+main: process
+	procedure start_transfer is
+	begin
+		rst <= '1';
+		wait until rising_edge(clk);
+		rst <= '0';
+		wait until rising_edge(clk);
+		instr.instr     <= TRANSFER_DMA32;
+		instr.dma_addr  <= to_unsigned(16#1000#, 64);
+		instr.dma_size  <= to_unsigned(4096, 32);
+		instr.options   <= default_tlp_options;
+		instr.max_bytes <= (others => '0');
+		instr.crc_en    <= '0';
+		instr_vld <= '1';
+		wait until rising_edge(clk) and instr_req = '1';
+		instr_vld <= '0';
+	end procedure;
+
+	-- halts after `delay` cycles, the writer stalls from the cycle before
+	-- the halt for `stall` cycles
+	procedure abort(constant delay, stall: in natural) is
+	begin
+		start_transfer;
+		for i in 1 to delay loop
+			wait until rising_edge(clk);
+		end loop;
+		writer_req <= '0' when stall > 0 else '1';
+		wait until rising_edge(clk);
+		halt <= '1';
+		for i in 1 to stall loop
+			wait until rising_edge(clk);
+		end loop;
+		writer_req <= '1';
+		for i in 1 to 4 loop
+			wait until rising_edge(clk);
+		end loop;
+		halt <= '0';
+		for i in 1 to 8 loop
+			wait until rising_edge(clk);
+		end loop;
+
+		check_equal(writer_vld, '0', "request left after the halt");
+		check_equal(sent, tags_taken, "tags without a request, delay " & natural'image(delay));
+		check_relation(sent < 4096 / MRS, "halt stopped the transfer");
+	end procedure;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+
+	if run("halt with the writer ready") then
+		for delay in 0 to 12 loop
+			abort(delay, 0);
+		end loop;
+
+	elsif run("halt with the writer stalled") then
+		for delay in 0 to 12 loop
+			abort(delay, 3);
+		end loop;
+
+	elsif run("halt while waiting for a tag") then
+		tag_vld <= '0';
+		start_transfer;
+		for i in 1 to 4 loop
+			wait until rising_edge(clk);
+		end loop;
+		halt <= '1';
+		wait until rising_edge(clk);
+		tag_vld <= '1';
+		for i in 1 to 4 loop
+			wait until rising_edge(clk);
+		end loop;
+		halt <= '0';
+		for i in 1 to 8 loop
+			wait until rising_edge(clk);
+		end loop;
+
+		check_equal(tags_taken, 0, "tag taken by a halted requester");
+		check_equal(sent, 0, "request sent by a halted requester");
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 1 ms);
+
+
+monitor: process
+begin
+	wait until rising_edge(clk);
+	if tag_vld = '1' and tag_req = '1' then
+		tags_taken <= tags_taken + 1;
+	end if;
+	if writer_vld = '1' and writer_req = '1' then
+		check_equal(writer.tag(4 downto 0), to_unsigned(sent mod 32, 5), "tags in order");
+		sent <= sent + 1;
+	end if;
+	if rst = '1' then
+		tags_taken <= 0;
+		sent       <= 0;
+	end if;
+end process;
+
+
+uut: entity work.dma_requester
+	generic map(
+		MAX_REQUEST_SIZE => MRS,
+		TAG_BITS         => 5,
+		TRANSFER_DIR     => "DOWNSTREAM"
+	)
+	port map(
+		rst        => rst,
+		clk        => clk,
+		instr_vld  => instr_vld,
+		instr_req  => instr_req,
+		instr      => instr,
+		halt       => halt,
+		tag_vld    => tag_vld,
+		tag_req    => tag_req,
+		tag        => tag,
+		writer_vld => writer_vld,
+		writer_req => writer_req,
+		writer     => writer
+	);
+
+end architecture;
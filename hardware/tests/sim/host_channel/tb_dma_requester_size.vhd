@@ -0,0 +1,133 @@
+-- Testbench for the runtime request size of the DMA requester
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.transceiver_128bit_types.all;
+use work.host_channel_types.all;
+
+
+entity tb_dma_requester_size is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_dma_requester_size is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	constant MRS: positive := 512;
+
+	signal rst: std_logic := '1';
+
+	signal instr: requester_instr_t;
+	signal instr_vld: std_logic := '0';
+	signal instr_req: std_logic;
+
+	signal writer: tlp_header_info_t;
+	signal writer_vld: std_logic;
+
+	signal start, done: boolean := false;
+	signal max_dw: natural := MRS / 4;
+
+	constant dma_addr: natural := 16#1040#;
+	constant dma_size: natural := 4096;
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+
+main: process
+	procedure transfer(constant max_bytes: in natural) is
+	begin
+		wait until rising_edge(clk);
+		instr.instr     <= TRANSFER_DMA32;
+		instr.dma_addr  <= to_unsigned(dma_addr, 64);
+		instr.dma_size  <= to_unsigned(dma_size, 32);
+		instr.options   <= default_tlp_options;
+		instr.max_bytes <= to_unsigned(max_bytes, tlp_bytes_t'length);
+		instr.crc_en    <= '0';
+		instr_vld <= '1';
+		start <= true;
+
+		wait until rising_edge(clk) and instr_req = '1';
+		instr_vld <= '0';
+
+		wait until done;
+	end procedure;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	rst <= '1';
+	wait until rising_edge(clk);
+	rst <= '0';
+
+	if run("synthesized size") then
+		max_dw <= MRS / 4;
+		transfer(0);
+
+	elsif run("smaller runtime size") then
+		max_dw <= 128 / 4;
+		transfer(128);
+
+	elsif run("runtime size above synthesized size") then
+		max_dw <= MRS / 4;
+		transfer(4096);
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 1 ms);
+
+-- Checks that the requests cover the buffer without gaps, that no request is
+-- longer than the runtime size and that no request crosses a boundary of it.
+validate: process
+	variable addr, length, dwords: natural := 0;
+begin
+	wait until start;
+
+	addr := dma_addr;
+	while dwords < dma_size / 4 loop
+		wait until rising_edge(clk) and writer_vld = '1';
+		length := to_integer(writer.length);
+
+		check_equal(writer.desc, MRd32_desc);
+		check_equal(unsigned(writer.mrq_address), addr, "request address");
+		check_relation(length <= max_dw);
+		check_equal((addr / 4) / max_dw, (addr / 4 + length - 1) / max_dw, "request crosses a boundary");
+
+		addr   := addr + 4 * length;
+		dwords := dwords + length;
+	end loop;
+
+	check_equal(dwords, dma_size / 4, "transferred DWORDs");
+	done <= true;
+	wait;
+end process;
+
+
+uut: entity work.dma_requester
+	generic map(
+		MAX_REQUEST_SIZE => MRS,
+		TAG_BITS         => 5,
+		TRANSFER_DIR     => "DOWNSTREAM"
+	)
+	port map(
+		rst        => rst,
+		clk        => clk,
+		instr_vld  => instr_vld,
+		instr_req  => instr_req,
+		instr      => instr,
+		tag_vld    => '1',
+		tag_req    => open,
+		tag        => "00000",
+		writer_vld => writer_vld,
+		writer_req => '1',
+		writer     => writer
+	);
+
+end architecture;
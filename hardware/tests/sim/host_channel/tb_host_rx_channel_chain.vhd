@@ -0,0 +1,245 @@
+-- Testbench for chained buffers of a host rx channel
+--
+-- Several buffers are queued at once, the host answers every MRd with one
+-- CplD. The endpoint stalls the channel or the host polls QUEUE_REG, so the
+-- requester is often blocked by back-pressure or a pending register
+-- completion when the next buffer is handed over. Every buffer has to
+-- complete with its interrupt and all of its data.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.pcie.all;
+use work.transceiver_128bit_types.all;
+use work.host_channel_types.all;
+
+
+entity tb_host_rx_channel_chain is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_host_rx_channel_chain is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	constant ID: positive := 1;
+	constant config: transceiver_configuration := new_config(
+		host_rx => 1,
+		host_tx => 0,
+		mrb     => 128
+	);
+
+	constant BUFFERS: positive := 3;
+	constant BUF_BYTES: positive := 512;
+
+	signal rst: std_logic := '1';
+
+	signal from_ep: fragment := default_fragment;
+	signal from_ep_vld: std_ulogic := '0';
+	signal from_ep_req: std_ulogic;
+	signal to_ep: fragment;
+	signal to_ep_vld: std_ulogic;
+	signal to_ep_req: std_ulogic := '1';
+	signal o: rx_stream;
+	signal o_vld: std_ulogic;
+
+	-- endpoint back-pressure: to_ep_req is low for `stall_off` of every
+	-- `stall_period` cycles
+	signal stall_period: natural := 1;
+	signal stall_off: natural := 0;
+
+	-- MRds sent by the channel, in order
+	type natural_array is array (0 to 255) of natural;
+	signal mrd_tag: natural_array := (others => 0);
+	signal mrd_len: natural_array := (others => 0);
+	signal mrd_cnt: natural := 0;
+
+	signal interrupts: natural := 0;
+	signal reg_reads: natural := 0;
+	signal user_bytes: natural := 0;
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+
+main: process
+	procedure write_reg(constant reg: in reg_addr_t; constant value: in natural) is
+	begin
+		reset(from_ep);
+		set_rqst32_header(from_ep, make_wr_rqst32(1, ID, x"000000" & "00" & std_logic_vector(reg) & "00"));
+		set_dw(from_ep, 3, std_logic_vector(to_unsigned(value, 32)));
+		from_ep_vld <= '1';
+		wait until rising_edge(clk);
+		from_ep_vld <= '0';
+	end procedure;
+
+	procedure read_reg(constant reg: in reg_addr_t) is
+	begin
+		reset(from_ep);
+		set_rqst32_header(from_ep, make_rd_rqst32(1, ID, 0, x"000000" & "00" & std_logic_vector(reg) & "00"));
+		from_ep_vld <= '1';
+		wait until rising_edge(clk);
+		from_ep_vld <= '0';
+	end procedure;
+
+	-- one CplD with all data of MRd `idx`
+	procedure complete(constant idx: in natural) is
+		variable dw: natural := 0;
+	begin
+		reset(from_ep);
+		set_cpld_header(from_ep.data(95 downto 0), make_cpld(
+			length     => mrd_len(idx),
+			chn_id     => ID,
+			tag        => mrd_tag(idx),
+			byte_count => mrd_len(idx) * 4,
+			lower_addr => "0000000"
+		));
+		from_ep.sof <= '1';
+		from_ep.keep <= "0011";
+		from_ep_vld <= '1';
+		while dw < mrd_len(idx) loop
+			wait until rising_edge(clk);
+			reset(from_ep);
+			for i in 0 to 3 loop
+				set_dw(from_ep, i, std_logic_vector(to_unsigned(idx * 256 + dw, 32)));
+				dw := dw + 1;
+			end loop;
+			if dw = mrd_len(idx) then
+				from_ep.eof <= '1';
+			end if;
+		end loop;
+		wait until rising_edge(clk);
+		from_ep_vld <= '0';
+	end procedure;
+
+	-- queues all buffers, then serves the MRds until every buffer raised
+	-- its interrupt, with a read of QUEUE_REG in every idle cycle if `poll`
+	procedure run_buffers(constant poll: in boolean) is
+		variable served: natural := 0;
+		variable cycles: natural := 0;
+	begin
+		rst <= '1';
+		for i in 1 to 4 loop
+			wait until rising_edge(clk);
+		end loop;
+		rst <= '0';
+		for i in 1 to 4 loop
+			wait until rising_edge(clk);
+		end loop;
+
+		for n in 0 to BUFFERS - 1 loop
+			write_reg(ADDR_LO_REG, 16#10000# + n * BUF_BYTES);
+			write_reg(BUFFER_SIZE, BUF_BYTES);
+		end loop;
+
+		while interrupts < BUFFERS and cycles < 20000 loop
+			if served < mrd_cnt then
+				complete(served);
+				served := served + 1;
+			elsif poll then
+				read_reg(QUEUE_REG);
+			else
+				wait until rising_edge(clk);
+			end if;
+			cycles := cycles + 1;
+		end loop;
+
+		for i in 1 to 20 loop
+			wait until rising_edge(clk);
+		end loop;
+		check_equal(interrupts, BUFFERS, "interrupts");
+		check_equal(mrd_cnt, BUFFERS * BUF_BYTES / config.max_request_bytes, "MRds");
+		check_equal(user_bytes, BUFFERS * BUF_BYTES, "bytes delivered");
+	end procedure;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+
+	if run("chained buffers with the endpoint stalling") then
+		stall_period <= 5;
+		stall_off    <= 3;
+		run_buffers(false);
+
+	elsif run("chained buffers with register reads pending") then
+		stall_period <= 1;
+		stall_off    <= 0;
+		run_buffers(true);
+
+	elsif run("chained buffers with both") then
+		stall_period <= 7;
+		stall_off    <= 4;
+		run_buffers(true);
+		check_relation(reg_reads > 0, "register reads answered");
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 1 ms);
+
+
+stall: process
+	variable cycle: natural := 0;
+begin
+	wait until rising_edge(clk);
+	cycle := (cycle + 1) mod stall_period;
+	to_ep_req <= '0' when cycle < stall_off else '1';
+end process;
+
+
+monitor: process
+	variable dw0: common_dw0;
+begin
+	wait until rising_edge(clk);
+	if to_ep_vld = '1' and to_ep_req = '1' and to_ep.sof = '1' then
+		dw0 := to_common_dw0(get_dword(to_ep, 0));
+		case dw0.desc is
+		when MRd32_desc | MRd64_desc =>
+			mrd_tag(mrd_cnt) <= to_integer(unsigned(dw0.tag));
+			mrd_len(mrd_cnt) <= to_integer(unsigned(dw0.length));
+			mrd_cnt <= mrd_cnt + 1;
+		when MSIX_desc =>
+			interrupts <= interrupts + 1;
+		when CplD_desc =>
+			reg_reads <= reg_reads + 1;
+		when others =>
+			report "unexpected TLP from the channel" severity error;
+		end case;
+	end if;
+	if o_vld = '1' then
+		user_bytes <= user_bytes + 4 * to_integer(o.cnt);
+	end if;
+	if rst = '1' then
+		mrd_cnt    <= 0;
+		interrupts <= 0;
+		reg_reads  <= 0;
+		user_bytes <= 0;
+	end if;
+end process;
+
+
+uut: entity work.host_rx_channel
+	generic map(
+		debug  => false,
+		config => config,
+		id     => ID
+	)
+	port map(
+		clk         => clk,
+		rst         => rst,
+		from_ep     => from_ep,
+		from_ep_vld => from_ep_vld,
+		from_ep_req => from_ep_req,
+		to_ep       => to_ep,
+		to_ep_vld   => to_ep_vld,
+		to_ep_req   => to_ep_req,
+		o           => o,
+		o_vld       => o_vld,
+		o_req       => '1'
+	);
+
+end architecture;
@@ -0,0 +1,85 @@
+-- Testbench for the TLP attributes and processing hints set by make_packet
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.pcie.all;
+use work.transceiver_128bit_types.all;
+use work.host_channel_types.all;
+
+
+entity tb_make_packet_attr is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_make_packet_attr is
+begin
+
+main: process
+	variable info : tlp_header_info_t;
+	variable pkt  : fragment;
+	variable dw0  : common_dw0;
+	variable dw1  : rqst_dw1;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+
+	info := init_tlp_header_info;
+	info.length      := to_unsigned(32, 10);
+	info.tag         := x"05";
+	info.mrq_address := x"00000001_0000_1000";
+
+	if run("default attributes") then
+		info.desc := MWr32_desc;
+		pkt := make_packet(info, 3, x"00000000");
+		dw0 := to_common_dw0(get_dword(pkt, 0));
+		dw1 := to_rqst_dw1(get_dword(pkt, 1));
+
+		check_equal(dw0.attr, ATTR_DEFAULT);
+		check_equal(dw1.th, '0');
+		check_equal(get_dword(pkt, 2), info.mrq_address(31 downto 0));
+
+	elsif run("relaxed ordering and no snoop on MRd") then
+		info.desc := MRd32_desc;
+		info.options := to_tlp_options(x"00000003");
+		pkt := make_packet(info, 3, x"00000000");
+		dw0 := to_common_dw0(get_dword(pkt, 0));
+
+		check_equal(dw0.attr, ATTR_RO or ATTR_NS);
+		check_equal(dw0.tag, std_logic_vector'(x"05"), "MRd keeps its tag");
+
+	elsif run("processing hints on MWr64") then
+		info.desc := MWr64_desc;
+		info.options := to_tlp_options(x"00AB0212");
+		pkt := make_packet(info, 3, x"00000000");
+		dw0 := to_common_dw0(get_dword(pkt, 0));
+		dw1 := to_rqst_dw1(get_dword(pkt, 1));
+
+		check_equal(dw0.attr, ATTR_RO);
+		check_equal(dw0.tag, std_logic_vector'(x"AB"), "steering tag");
+		check_equal(dw1.th, '1');
+		check_equal(get_dword(pkt, 2), info.mrq_address(63 downto 32));
+		check_equal(get_dword(pkt, 3), info.mrq_address(31 downto 2) & "10", "processing hint");
+
+	elsif run("no attributes on interrupts and completions") then
+		info.options := to_tlp_options(x"00AB0213");
+
+		info.desc := CplD_desc;
+		pkt := make_packet(info, 3, x"00000000");
+		check_equal(to_common_dw0(get_dword(pkt, 0)).attr, ATTR_DEFAULT);
+		check_equal(to_common_dw0(get_dword(pkt, 0)).tag, std_logic_vector'(x"05"));
+
+		info.desc := MSIX_desc;
+		pkt := make_packet(info, 3, x"00000000");
+		check_equal(to_common_dw0(get_dword(pkt, 0)).attr, ATTR_DEFAULT);
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+
+end architecture;
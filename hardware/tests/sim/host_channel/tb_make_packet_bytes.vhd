@@ -0,0 +1,66 @@
+-- Testbench for the byte enables of requests with a partial last DWORD
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.pcie.all;
+use work.transceiver_128bit_types.all;
+use work.host_channel_types.all;
+
+
+entity tb_make_packet_bytes is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_make_packet_bytes is
+begin
+
+main: process
+	variable info : tlp_header_info_t;
+	variable dw1  : rqst_dw1;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+
+	info := init_tlp_header_info;
+	info.desc        := MWr32_desc;
+	info.length      := to_unsigned(32, 10);
+	info.mrq_address := x"00000000_0000_1000";
+
+	if run("whole DWORDs") then
+		dw1 := to_rqst_dw1(get_dword(make_packet(info, 3, x"00000000"), 1));
+		check_equal(dw1.first_be, std_logic_vector'("1111"));
+		check_equal(dw1.last_be, std_logic_vector'("1111"));
+
+		info.length := to_unsigned(1, 10);
+		dw1 := to_rqst_dw1(get_dword(make_packet(info, 3, x"00000000"), 1));
+		check_equal(dw1.first_be, std_logic_vector'("1111"));
+		check_equal(dw1.last_be, std_logic_vector'("0000"));
+
+	elsif run("partial last DWORD") then
+		for bytes in 1 to 3 loop
+			info.desc       := MRd32_desc;
+			info.last_bytes := to_unsigned(bytes, 2);
+			dw1 := to_rqst_dw1(get_dword(make_packet(info, 3, x"00000000"), 1));
+			check_equal(dw1.first_be, std_logic_vector'("1111"));
+			check_equal(be2unused(dw1.last_be), 4 - bytes, "unused bytes");
+		end loop;
+
+	elsif run("single partial DWORD") then
+		info.desc       := MWr64_desc;
+		info.length     := to_unsigned(1, 10);
+		info.last_bytes := "10";
+		dw1 := to_rqst_dw1(get_dword(make_packet(info, 3, x"00000000"), 1));
+		check_equal(dw1.first_be, std_logic_vector'("0011"));
+		check_equal(dw1.last_be, std_logic_vector'("0000"));
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+
+end architecture;
@@ -0,0 +1,192 @@
+-- Testbench for the DMA completion buffer with reordered completions
+-- and cut-through of the oldest request
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.pcie;
+use work.transceiver_128bit_types.all;
+
+
+entity tb_rx_dma_buffer is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_rx_dma_buffer is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	constant tag_bits: natural := 2;
+	constant MRS: positive := 512;
+	constant MRS_DW: positive := MRS / 4;
+
+	signal rst: std_logic := '0';
+
+	signal start, done: boolean := false;
+	signal requests: natural := 0;
+	signal first_output: boolean := false;
+
+	signal i: pcie.fragment := pcie.default_fragment;
+	signal i_vld, i_req: std_logic := '0';
+
+	signal o: pcie.rx_stream := pcie.default_rx_stream;
+	signal o_vld: std_logic := '0';
+	signal o_req: std_logic := '1';
+
+	signal tag_vld, tag_req: std_logic := '0';
+	signal tag_data: std_logic_vector(tag_bits-1 downto 0);
+
+	-- Sends one CplD for the request with `tag` as it leaves the completion
+	-- preprocessor. `first_dw` is the offset of the completion inside the
+	-- request, the payload values continue the counting sequence of all
+	-- requests with lower tags.
+	procedure send_cpld(
+		signal   i        : out pcie.fragment;
+		signal   i_vld    : out std_logic;
+		constant tag      : in  natural;
+		constant first_dw : in  natural;
+		constant length   : in  natural
+	) is
+		variable dw: natural := 0;
+	begin
+		wait until rising_edge(clk);
+		reset(i);
+		set_cpld_header(i.data(95 downto 0), make_cpld(
+			length     => length,
+			chn_id     => 1,
+			tag        => tag,
+			byte_count => (MRS_DW - first_dw) * 4,
+			lower_addr => "0000000"
+		));
+		i.sof  <= '1';
+		i.keep <= "0011";
+		i_vld  <= '1';
+
+		while dw < length loop
+			wait until rising_edge(clk);
+			reset(i);
+			for idx in 0 to 3 loop
+				set_dw(i, idx, std_logic_vector(to_unsigned(tag * MRS_DW + first_dw + dw, 32)));
+				dw := dw + 1;
+			end loop;
+			if dw = length then
+				i.eof <= '1';
+			end if;
+		end loop;
+	end procedure;
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+o_req <= '1';
+
+
+main: process
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	if run("test single completion") then
+		requests <= 1;
+		start <= true;
+
+		send_cpld(i, i_vld, 0, 0, MRS_DW);
+
+		wait until rising_edge(clk);
+		i_vld <= '0';
+
+		wait until done;
+
+	elsif run("test reordered tags") then
+		requests <= 3;
+		start <= true;
+
+		send_cpld(i, i_vld, 2, 0, MRS_DW);
+		send_cpld(i, i_vld, 1, 0, MRS_DW / 2);
+		send_cpld(i, i_vld, 0, 0, MRS_DW);
+		send_cpld(i, i_vld, 1, MRS_DW / 2, MRS_DW / 2);
+
+		wait until rising_edge(clk);
+		i_vld <= '0';
+
+		wait until done;
+
+	elsif run("test cut-through") then
+		requests <= 2;
+		start <= true;
+
+		-- the first half of the oldest request is forwarded while the
+		-- rest of it is still missing
+		send_cpld(i, i_vld, 0, 0, MRS_DW / 2);
+		wait until rising_edge(clk);
+		i_vld <= '0';
+		for idx in 1 to 20 loop
+			wait until rising_edge(clk);
+		end loop;
+		check(first_output, "first completion is forwarded before the request is complete");
+
+		-- a younger request waits for the oldest one
+		send_cpld(i, i_vld, 1, 0, MRS_DW);
+		send_cpld(i, i_vld, 0, MRS_DW / 2, MRS_DW / 2);
+
+		wait until rising_edge(clk);
+		i_vld <= '0';
+
+		wait until done;
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 10 ms);
+
+-- Checks that the requests are released in tag order without gaps or
+-- reordered DWORDs.
+validate: process
+	variable cnt: natural := 0;
+begin
+	wait until start;
+
+	for rqst in 0 to requests - 1 loop
+		for beat in 0 to MRS_DW / 4 - 1 loop
+			wait until rising_edge(clk) and o_vld = '1';
+			first_output <= true;
+			check_equal(o.cnt, 4);
+			for idx in 0 to 3 loop
+				check_equal(unsigned(o.payload(32*idx+31 downto 32*idx)), cnt,
+				            "DWORD " & to_string(idx) & " of word " & to_string(beat) & " of request " & to_string(rqst));
+				cnt := cnt + 1;
+			end loop;
+		end loop;
+	end loop;
+
+	done <= true;
+	wait;
+end process;
+
+
+uut: entity work.rx_dma_buffer
+	generic map(
+		tag_bits => tag_bits,
+		MRS      => MRS
+	)
+	port map(
+		rst => rst,
+		clk => clk,
+
+		i_vld  => i_vld,
+		i_req  => i_req,
+		i_data => i,
+
+		o_vld  => o_vld,
+		o_req  => o_req,
+		o_data => o,
+
+		tag_vld  => tag_vld,
+		tag_req  => tag_req,
+		tag_data => tag_data
+	);
+
+end architecture;
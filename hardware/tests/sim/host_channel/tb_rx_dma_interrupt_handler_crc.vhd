@@ -0,0 +1,238 @@
+-- Testbench for the checksum of host-FPGA transfers in the rx interrupt
+-- handler
+--
+-- Completions and the user stream are driven directly. Data of a transfer
+-- may still be in the buffer when the next one starts, the checksum of a
+-- transfer has to cover exactly its own data.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+use work.pcie.all;
+use work.transceiver_128bit_types.all;
+use work.host_channel_types.all;
+
+
+entity tb_rx_dma_interrupt_handler_crc is
+generic(runner_cfg: string);
+end entity;
+
+architecture arch of tb_rx_dma_interrupt_handler_crc is
+	signal clk: std_logic := '0';
+	constant clk_per: natural := 2;
+
+	signal rst: std_logic := '1';
+
+	signal instr_vld: std_logic := '0';
+	signal instr: interrupt_instr_t := (
+		instr       => GET_CHANNEL_INFO,
+		dma_size    => (others => '0'),
+		cpl_tag     => (others => '0'),
+		cpl_lo_addr => (others => '0'),
+		crc_en      => '0',
+		deadline    => (others => '0'),
+		queue_full     => '0',
+		queue_overflow => '0'
+	);
+
+	signal xfer_vld: std_logic := '0';
+	signal xfer_req: std_logic;
+	signal abort: std_logic := '0';
+	signal halt: std_logic;
+
+	signal cpl: fragment := default_fragment;
+	signal cpl_vld: std_logic := '0';
+	signal rq_vld: std_logic;
+	signal rq_length: unsigned(9 downto 0);
+
+	signal user: rx_stream := default_rx_stream;
+	signal user_vld: std_logic := '0';
+
+	signal writer_vld: std_logic;
+	signal writer: tlp_header_info_t;
+	signal writer_payload: std_logic_vector(31 downto 0);
+
+	signal interrupts: natural := 0;
+
+	-- "123456789" and its CRC32C
+	constant check_data: std_ulogic_vector(127 downto 0) := x"00000000_00000039_38373635_34333231";
+	constant check_value: std_logic_vector(31 downto 0) := x"E3069283";
+begin
+
+clk <= not clk after clk_per / 2 * 1 ns;
+
+-- every completion answers a request made in the same cycle
+rq_vld    <= cpl_vld and cpl.sof;
+rq_length <= unsigned(cpl.data(15 downto 6));
+
+
+main: process
+	procedure read_reg(constant reg: in instruction_t; variable value: out std_logic_vector(31 downto 0)) is
+	begin
+		wait until rising_edge(clk);
+		instr.instr <= reg;
+		instr_vld   <= '1';
+		wait until rising_edge(clk);
+		instr_vld   <= '0';
+		wait until rising_edge(clk) and writer_vld = '1' and writer.desc = CplD_desc;
+		value := writer_payload;
+	end procedure;
+
+	-- takes the next transfer like the decoder hands it over
+	procedure start(constant size: in natural; constant crc_en: in std_logic) is
+	begin
+		xfer_vld <= '1';
+		wait until rising_edge(clk) and xfer_req = '1';
+		xfer_vld <= '0';
+		instr.dma_size <= to_unsigned(size, 32);
+		instr.crc_en   <= crc_en;
+	end procedure;
+
+	-- one CplD ending its request, `bytes` of the last DWord valid
+	procedure complete(constant dwords, bytes: in natural) is
+		variable dw0, dw1: dword := (others => '0');
+	begin
+		dw0(15 downto 6)  := std_logic_vector(to_unsigned(dwords, 10));
+		dw1(27 downto 16) := std_logic_vector(to_unsigned(4 * dwords, 12));
+		dw1(29 downto 28) := std_logic_vector(to_unsigned(bytes mod 4, 2));
+		cpl.data(31 downto 0)  <= dw0;
+		cpl.data(63 downto 32) <= dw1;
+		cpl.sof  <= '1';
+		cpl_vld  <= '1';
+		wait until rising_edge(clk);
+		cpl_vld  <= '0';
+		cpl.sof  <= '0';
+	end procedure;
+
+	procedure take(constant data: in std_ulogic_vector(127 downto 0); constant cnt, last_bytes: in natural) is
+	begin
+		user.payload    <= data;
+		user.cnt        <= to_unsigned(cnt, 3);
+		user.last_bytes <= to_unsigned(last_bytes, 2);
+		user_vld <= '1';
+		wait until rising_edge(clk);
+		user_vld <= '0';
+	end procedure;
+
+	procedure idle(constant cycles: in natural) is
+	begin
+		for i in 1 to cycles loop
+			wait until rising_edge(clk);
+		end loop;
+	end procedure;
+
+	variable value: std_logic_vector(31 downto 0);
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	abort <= '0';
+	rst <= '1';
+	wait until rising_edge(clk);
+	rst <= '0';
+
+	if run("data of an earlier transfer is skipped") then
+		-- 128 bytes without checksum, left in the buffer
+		start(128, '0');
+		complete(16, 0);
+		complete(16, 0);
+		wait until interrupts = 1;
+
+		start(9, '1');
+		complete(3, 1);
+		idle(10);
+		check_equal(interrupts, 1, "interrupt before the user core took the data");
+
+		for i in 1 to 8 loop
+			take(x"FFFFFFFF_FFFFFFFF_FFFFFFFF_FFFFFFFF", 4, 0);
+		end loop;
+		take(check_data, 3, 1);
+		wait until interrupts = 2;
+
+		read_reg(GET_TRANSFERRED_BYTES, value);
+		check_equal(unsigned(value), 128);
+		read_reg(GET_TRANSFERRED_BYTES, value);
+		check_equal(unsigned(value), 9);
+		read_reg(GET_CRC, value);
+		check_equal(value, check_value);
+
+	elsif run("abort waits for the user core") then
+		start(128, '1');
+		complete(3, 1);
+		idle(4);
+		abort <= '1';
+		wait until rising_edge(clk);
+		abort <= '0';
+		idle(10);
+		check_equal(halt, '1', "abort ended before the user core took the data");
+		check_equal(interrupts, 0);
+
+		take(check_data, 3, 1);
+		wait until interrupts = 1;
+
+		read_reg(GET_TRANSFERRED_BYTES, value);
+		check_equal(unsigned(value), 9);
+		read_reg(GET_CRC, value);
+		check_equal(value, check_value);
+
+		-- nothing of the aborted transfer is left for the next one
+		start(9, '1');
+		complete(3, 1);
+		take(check_data, 3, 1);
+		wait until interrupts = 2;
+		read_reg(GET_TRANSFERRED_BYTES, value);
+		read_reg(GET_CRC, value);
+		check_equal(value, check_value);
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 100 us);
+
+
+monitor: process
+begin
+	wait until rising_edge(clk);
+	if writer_vld = '1' and writer.desc = MSIX_desc then
+		interrupts <= interrupts + 1;
+	end if;
+	if rst = '1' then
+		interrupts <= 0;
+	end if;
+end process;
+
+
+uut: entity work.rx_dma_interrupt_handler
+	generic map(
+		QUEUE_DEPTH => 4,
+		CHANNEL_ID  => 1
+	)
+	port map(
+		clk            => clk,
+		rst            => rst,
+		ctrl_rst       => open,
+		instr_vld      => instr_vld,
+		instr          => instr,
+		xfer_vld       => xfer_vld,
+		xfer_req       => xfer_req,
+		abort          => abort,
+		halt           => halt,
+		rq_pending     => '0',
+		rq_vld         => rq_vld,
+		rq_length      => rq_length,
+		cpl_vld        => cpl_vld,
+		cpl            => cpl,
+		user_vld       => user_vld,
+		user_req       => '1',
+		user           => user,
+		writer_vld     => writer_vld,
+		writer_req     => '1',
+		writer         => writer,
+		writer_payload => writer_payload
+	);
+
+end architecture;
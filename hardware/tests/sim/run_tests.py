@@ -35,8 +35,10 @@ vcl_sources = [
     "./hardware/src/endpoint/tlp_tag_mapper/rx_tag_restorer.vhd",
     "./hardware/src/endpoint/tlp_tag_mapper/tlp_tag_mapper.vhd",
     "./hardware/src/endpoint/tlp_tag_mapper/tlp_tag_memory.vhd",
+    "./hardware/src/endpoint/tlp_tag_mapper/tlp_tag_quota.vhd",
     "./hardware/src/endpoint/tlp_tag_mapper/tx_tag_replacer.vhd",
     "./hardware/src/endpoint/tlp_tag_mapper/virtual_tag_memory.vhd",
+    "./hardware/src/endpoint/tlp_trace.vhd",
     "./hardware/src/endpoint/tx_axi_converter.vhd",
     "./hardware/src/endpoint/tx_interrupt_mux.vhd",
     "./hardware/src/endpoint/tx_tlp_mux.vhd",
@@ -56,13 +58,16 @@ vcl_sources = [
     "./hardware/src/fpga_channel/tx_fifo.vhd",
     "./hardware/src/fpga_channel/tx_fifo_internal.vhd",
     "./hardware/src/fpga_channel/tx_fifo_types.vhd",
+    "./hardware/src/fpga_channel/tx_multicast.vhd",
     "./hardware/src/fpga_channel/tx_pack_data.vhd",
     "./hardware/src/fpga_channel/tx_write_cpld.vhd",
     "./hardware/src/host_channel/channel_DNCtoDVC.vhd",
     "./hardware/src/host_channel/channel_DVCtoDNC.vhd",
+    "./hardware/src/host_channel/crc32c_stream.vhd",
     "./hardware/src/host_channel/dma_decoder.vhd",
     "./hardware/src/host_channel/dma_decoder_filter.vhd",
     "./hardware/src/host_channel/dma_decoder_instructor.vhd",
+    "./hardware/src/host_channel/dma_descriptor_queue.vhd",
     "./hardware/src/host_channel/dma_interrupt_handler.vhd",
     "./hardware/src/host_channel/dma_requester.vhd",
     "./hardware/src/host_channel/dma_writer_packer.vhd",
@@ -85,7 +90,10 @@ vcl_sources = [
     "./hardware/src/host_channel/tx_dma_writer.vhd",
     "./hardware/src/host_channel/tx_dma_writer_buffer.vhd",
     "./hardware/src/host_channel/tx_mwr32_shifter_128.vhd",
+    "./hardware/src/utilities/traffic_generator.vhd",
     "./hardware/src/utilities/tx_timeout.vhd",
+    "./hardware/src/utilities/vstream_demux.vhd",
+    "./hardware/src/utilities/vstream_mux.vhd",
     "./hardware/src/pcie_utilities.vhd",
     "./hardware/src/pcie.vhd",
 ]
@@ -93,15 +101,34 @@ vcl_sources = [join(root_path, src) for src in vcl_sources]
 
 sim_sources = [
     "./tb_types.vhd",
+    "./endpoint/pcie_host_model.vhd",
+    "./endpoint/tb_endpoint_perf.vhd",
+    "./endpoint/tb_packet_arbiter_qos.vhd",
+    "./endpoint/tb_tlp_request_header.vhd",
+    "./endpoint/tb_tlp_tag_quota.vhd",
+    "./endpoint/tb_tlp_trace.vhd",
     "./fpga_channel/tb_pcie_fifo_128.vhd",
     "./fpga_channel/tb_receiver_filter.vhd",
     "./fpga_channel/tb_receiver_repack.vhd",
     "./fpga_channel/tb_receiver.vhd",
     "./fpga_channel/tb_sender_cfg_ctrl.vhd",
+    "./fpga_channel/tb_sender_multicast.vhd",
     "./fpga_channel/tb_sender.vhd",
     "./fpga_channel/tb_sender_write_cpld.vhd",
     "./fpga_channel/tb_sender_write_data.vhd",
+    "./host_channel/tb_crc32c_stream.vhd",
+    "./host_channel/tb_dma_descriptor_queue.vhd",
+    "./host_channel/tb_dma_interrupt_handler_queue.vhd",
+    "./host_channel/tb_dma_requester_abort.vhd",
+    "./host_channel/tb_dma_requester_size.vhd",
+    "./host_channel/tb_host_rx_channel_chain.vhd",
+    "./host_channel/tb_make_packet_attr.vhd",
+    "./host_channel/tb_make_packet_bytes.vhd",
+    "./host_channel/tb_rx_dma_buffer.vhd",
+    "./host_channel/tb_rx_dma_interrupt_handler_crc.vhd",
+    "./utilities/tb_traffic_generator.vhd",
     "./utilities/tb_tx_stream_timeout.vhd",
+    "./utilities/tb_vstream.vhd",
 ]
 
 sim_sources = [join(sim_path, src) for src in sim_sources]
@@ -109,6 +136,19 @@ sim_sources = [join(sim_path, src) for src in sim_sources]
 vercolib.add_source_files(sim_sources)
 vercolib.add_source_files(vcl_sources)
 
+# Host setups for the performance testbench, each configuration runs all of
+# its test cases
+perf = vercolib.test_bench("tb_endpoint_perf")
+perf.add_config(name="default")
+perf.add_config(
+    name="rcb64_reordered",
+    generics=dict(CPL_MAX_BYTES=64, REORDER=True, NP_CREDITS=16),
+)
+perf.add_config(
+    name="mps128_mrrs256",
+    generics=dict(MPS=128, MRRS=256, READ_LATENCY=300, PD_CREDITS=64),
+)
+
 tests = ui.add_library("tests")
 
 # Look for pre-compiled vendor libraries
@@ -0,0 +1,188 @@
+-- Testbench for the traffic generator
+--
+-- The rx channel side is fed with the counter pattern the host would write,
+-- the tx channel side takes the generated words with a stall every few
+-- cycles.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vercolib;
+use vercolib.pcie;
+use vercolib.pcie.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+
+entity tb_traffic_generator is
+generic(runner_cfg: string);
+end entity;
+
+architecture tb of tb_traffic_generator is
+	signal clk: std_ulogic := '0';
+	constant clk_per: time := 2 ns;
+
+	signal rst: std_ulogic := '1';
+
+	signal ctrl: pcie.traffic_control := pcie.default_traffic_control;
+	signal status: pcie.traffic_counters;
+
+	signal rx, o: pcie.rx_stream := pcie.default_rx_stream;
+	signal rx_vld, rx_req, o_vld, o_req: std_ulogic := '0';
+
+	signal tx, i: pcie.tx_stream := pcie.default_tx_stream;
+	signal tx_vld, tx_req, i_vld, i_req: std_ulogic := '0';
+
+	-- words taken from the tx side, checked against the pattern if set
+	signal check_pattern: boolean := false;
+	signal tx_words, tx_eos: natural := 0;
+	signal last_tx: pcie.tx_stream := pcie.default_tx_stream;
+
+	function pattern(first, cnt: natural) return pcie.rx_stream is
+		variable ret: pcie.rx_stream := pcie.default_rx_stream;
+	begin
+		for idx in 0 to cnt-1 loop
+			ret.payload(32*idx+31 downto 32*idx) := std_ulogic_vector(to_unsigned(first+idx, 32));
+		end loop;
+		ret.cnt := to_unsigned(cnt, 3);
+		return ret;
+	end function;
+begin
+
+clk <= not clk after clk_per / 2;
+
+main: process
+	procedure send(constant word: in pcie.rx_stream) is
+	begin
+		rx     <= word;
+		rx_vld <= '1';
+		wait until rising_edge(clk) and rx_req = '1';
+		rx_vld <= '0';
+	end procedure;
+
+	procedure set_mode(constant mode: in pcie.traffic_mode) is
+	begin
+		ctrl.mode <= mode;
+		wait until rising_edge(clk);
+	end procedure;
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	rst <= '1';
+	wait until rising_edge(clk);
+	rst <= '0';
+
+	if run("stream pattern") then
+		check_pattern <= true;
+		set_mode(TRAFFIC_STREAM);
+
+		-- 15 DWords with a short word, the last word skips 11
+		send(pattern(0, 4));
+		send(pattern(4, 3));
+		send(pattern(7, 4));
+		send(pattern(12, 4));
+		wait until rising_edge(clk);
+		check_equal(status.dwords, 15, "checked DWords");
+		check_equal(status.errors, 1, "pattern errors");
+
+		wait until tx_words >= 64;
+		set_mode(TRAFFIC_OFF);
+		wait until tx_eos = 1;
+		wait until rising_edge(clk);
+		check_equal(tx_vld, '0', "no words after end_of_stream");
+
+		-- counters are kept until the next test
+		check_equal(status.dwords, 15);
+		check_pattern <= false;
+		set_mode(TRAFFIC_STREAM);
+		wait until rising_edge(clk);
+		check_equal(status.dwords, 0);
+
+	elsif run("ping echo") then
+		set_mode(TRAFFIC_PING);
+		send(pattern(100, 4));
+		send(pattern(104, 2));
+		wait until tx_eos = 1;
+		check_equal(tx_words, 2, "echoed words");
+		check_equal(last_tx.cnt, 2);
+		check_equal(last_tx.payload(63 downto 32), std_ulogic_vector(to_unsigned(105, 32)));
+		check_equal(status.dwords, 6, "echoed DWords");
+
+	elsif run("user design connected while off") then
+		o_req  <= '1';
+		rx     <= pattern(7, 4);
+		rx_vld <= '1';
+		wait until rising_edge(clk) and o_vld = '1';
+		check_equal(rx_req, '1');
+		check_equal(o.payload, pattern(7, 4).payload);
+		rx_vld <= '0';
+
+		i     <= (payload => (others => '1'), cnt => "100", last_bytes => "00", end_of_stream => '1');
+		i_vld <= '1';
+		wait until rising_edge(clk) and i_req = '1';
+		i_vld <= '0';
+		wait until tx_eos = 1;
+		check_equal(last_tx.payload, std_ulogic_vector'(127 downto 0 => '1'));
+		check_equal(status.dwords, 0);
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 10 us);
+
+
+-- takes the tx words, stalling every fourth cycle
+sink: process
+	variable cycle: natural := 0;
+	variable next_dw: natural := 0;
+begin
+	wait until rising_edge(clk);
+	cycle := cycle + 1;
+
+	if tx_vld = '1' and tx_req = '1' then
+		tx_words <= tx_words + 1;
+		last_tx <= tx;
+		if tx.end_of_stream = '1' then
+			tx_eos <= tx_eos + 1;
+		end if;
+		if check_pattern then
+			for idx in 0 to to_integer(tx.cnt)-1 loop
+				check_equal(tx.payload(32*idx+31 downto 32*idx),
+				            std_ulogic_vector(to_unsigned(next_dw, 32)), "generated pattern");
+				next_dw := next_dw + 1;
+			end loop;
+		end if;
+	end if;
+
+	if cycle mod 4 = 0 then
+		tx_req <= '0';
+	else
+		tx_req <= '1';
+	end if;
+end process;
+
+
+uut: entity vercolib.traffic_generator
+port map(
+	clk    => clk,
+	rst    => rst,
+	ctrl   => ctrl,
+	status => status,
+	rx     => rx,
+	rx_vld => rx_vld,
+	rx_req => rx_req,
+	tx     => tx,
+	tx_vld => tx_vld,
+	tx_req => tx_req,
+	o      => o,
+	o_vld  => o_vld,
+	o_req  => o_req,
+	i      => i,
+	i_vld  => i_vld,
+	i_req  => i_req
+);
+
+end architecture;
@@ -131,6 +131,7 @@ begin
 	i <= pcie.tx_stream'(
 		payload => std_ulogic_vector(to_unsigned(current_data, 128)),
 		cnt => to_unsigned(4, 3),
+		last_bytes => "00",
 		end_of_stream => '0'
 	);
 
@@ -0,0 +1,205 @@
+-- Testbench for the virtual stream multiplexer and demultiplexer
+--
+-- The frames of the multiplexer are fed straight back into the
+-- demultiplexer, every stream has to arrive unchanged at its own output.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library vercolib;
+use vercolib.pcie;
+use vercolib.pcie.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+
+entity tb_vstream is
+generic(runner_cfg: string);
+end entity;
+
+architecture tb of tb_vstream is
+	constant streams: positive := 3;
+	constant frame_words: positive := 8;
+
+	signal clk: std_ulogic := '0';
+	constant clk_per: time := 2 ns;
+
+	signal rst: std_ulogic := '1';
+
+	signal i: pcie.tx_stream_vector(0 to streams-1) := (others => pcie.default_tx_stream);
+	signal i_vld, i_req: std_ulogic_vector(0 to streams-1) := (others => '0');
+
+	signal frame: pcie.tx_stream := pcie.default_tx_stream;
+	signal frame_vld, frame_req: std_ulogic := '0';
+	signal frame_rx: pcie.rx_stream := pcie.default_rx_stream;
+
+	signal o: pcie.rx_stream_vector(0 to streams-1);
+	signal o_vld, o_req: std_ulogic_vector(0 to streams-1) := (others => '0');
+
+	-- words each source sends, the last one of a stream has three DWords
+	signal send_words: natural := 0;
+	type count_vector is array (0 to streams-1) of natural;
+	signal received: count_vector := (others => 0);
+
+	signal frames: natural := 0;
+	signal first_header: std_ulogic_vector(127 downto 0) := (others => '0');
+	signal frame_eos: natural := 0;
+
+	function dw(stream, seq: natural) return std_ulogic_vector is
+	begin
+		return std_ulogic_vector(to_unsigned(stream*65536 + seq, 32));
+	end function;
+begin
+
+clk <= not clk after clk_per / 2;
+
+main: process
+begin
+	test_runner_setup(runner, runner_cfg);
+	while test_suite loop
+	rst <= '1';
+	wait until rising_edge(clk);
+	rst <= '0';
+
+	if run("frame header") then
+		send_words <= 3;
+		wait until received(0) = 3 and received(1) = 3 and received(2) = 3;
+		-- stream 0 is served first: two full words and a short one
+		check_equal(first_header(15 downto 0), std_ulogic_vector(to_unsigned(0, 16)), "stream id");
+		check_equal(first_header(31 downto 16), std_ulogic_vector'(x"5653"), "magic");
+		check_equal(unsigned(first_header(63 downto 32)), 44, "frame bytes");
+		check_equal(first_header(127 downto 64), std_ulogic_vector'(63 downto 0 => '0'));
+		check_equal(frames, 3, "one frame per stream");
+		check_equal(frame_eos, 3, "end_of_stream after each stream");
+
+	elsif run("interleaved streams") then
+		send_words <= 5*frame_words + 3;
+		wait until received(0) = 5*frame_words + 3 and
+		           received(1) = 5*frame_words + 3 and
+		           received(2) = 5*frame_words + 3;
+		check(frames >= 3*6, "streams are split into frames");
+
+	end if;
+	end loop;
+	test_runner_cleanup(runner);
+end process;
+test_runner_watchdog(runner, 20 us);
+
+
+streams_gen: for s in 0 to streams-1 generate
+	-- source pausing after every (s+3) words, the pauses close frames early
+	source: process
+		variable seq, pause: natural := 0;
+		variable busy: boolean;
+	begin
+		wait until rising_edge(clk);
+		busy := i_vld(s) = '1' and i_req(s) = '0';
+		if i_vld(s) = '1' and i_req(s) = '1' then
+			i_vld(s) <= '0';
+			seq := seq + 1;
+			if seq mod (s+3) = 0 then
+				pause := 4;
+			end if;
+		end if;
+
+		if pause /= 0 then
+			pause := pause - 1;
+		elsif rst = '0' and not busy and seq < send_words then
+			for idx in 0 to 3 loop
+				i(s).payload(32*idx+31 downto 32*idx) <= dw(s, 4*seq+idx);
+			end loop;
+			i(s).cnt <= "100";
+			i(s).last_bytes <= "00";
+			i(s).end_of_stream <= '0';
+			if seq = send_words-1 then
+				i(s).cnt <= "011";
+				i(s).end_of_stream <= '1';
+			end if;
+			i_vld(s) <= '1';
+		end if;
+	end process;
+
+	-- sink stalling every third cycle
+	sink: process
+		variable cycle: natural := 0;
+	begin
+		wait until rising_edge(clk);
+		cycle := cycle + 1;
+		if o_vld(s) = '1' and o_req(s) = '1' then
+			for idx in 0 to to_integer(o(s).cnt)-1 loop
+				check_equal(o(s).payload(32*idx+31 downto 32*idx),
+				            dw(s, 4*received(s)+idx), "stream payload");
+			end loop;
+			if received(s) = send_words-1 then
+				check_equal(o(s).cnt, 3, "short last word");
+			else
+				check_equal(o(s).cnt, 4);
+			end if;
+			check_equal(o(s).last_bytes, 0);
+			received(s) <= received(s) + 1;
+		end if;
+		if (cycle + s) mod 3 = 0 then
+			o_req(s) <= '0';
+		else
+			o_req(s) <= '1';
+		end if;
+	end process;
+end generate;
+
+
+-- counts the frames between the two modules
+monitor: process
+	variable in_frame: natural := 0;
+begin
+	wait until rising_edge(clk);
+	if frame_vld = '1' and frame_req = '1' then
+		if in_frame = 0 then
+			if frames = 0 then
+				first_header <= frame.payload;
+			end if;
+			frames <= frames + 1;
+			in_frame := (to_integer(unsigned(frame.payload(63 downto 32))) + 15) / 16;
+		else
+			in_frame := in_frame - 1;
+			if frame.end_of_stream = '1' then
+				frame_eos <= frame_eos + 1;
+			end if;
+		end if;
+	end if;
+end process;
+
+
+mux: entity vercolib.vstream_mux
+generic map(
+	streams     => streams,
+	frame_words => frame_words,
+	hold        => 2)
+port map(
+	clk   => clk,
+	rst   => rst,
+	i     => i,
+	i_vld => i_vld,
+	i_req => i_req,
+	o     => frame,
+	o_vld => frame_vld,
+	o_req => frame_req
+);
+
+frame_rx <= (payload => frame.payload, cnt => frame.cnt, last_bytes => frame.last_bytes);
+
+demux: entity vercolib.vstream_demux
+generic map(streams => streams)
+port map(
+	clk   => clk,
+	rst   => rst,
+	i     => frame_rx,
+	i_vld => frame_vld,
+	i_req => frame_req,
+	o     => o,
+	o_vld => o_vld,
+	o_req => o_req
+);
+
+end architecture;
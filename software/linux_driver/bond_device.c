@@ -0,0 +1,467 @@
+// Bonded channel device, stripes one stream across several host channels
+//
+// Every open of /dev/vcl_bond is a bond of its own, set up with the ioctls
+// of bond_ioctl.h. The stream is cut into stripes which go to the members
+// in turn, stripe n to member n % members. Every stripe starts with a
+// 16 byte header and its payload is padded to 16 bytes:
+//   DWord 0: member index in bits 15:0, 0x424E in bits 31:16
+//   DWord 1: stripe number n
+//   DWord 2: payload bytes, at most the stripe size
+//   DWord 3: zero
+//
+// A write sends at most one stripe size per stripe, so stripes of short
+// writes are short. Reading checks every header against the expected
+// stripe number, a bond whose members got out of step fails with -EIO
+// instead of returning reordered data.
+
+#include <linux/fs.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/poll.h>
+#include <linux/vmalloc.h>
+
+#include "vercolib_pcie.h"
+#include "bond_ioctl.h"
+
+#define DEFAULT_STRIPE (64 << 10)
+#define STRIPE_MAGIC 0x424E
+#define STRIPE_HEADER 16
+
+struct bond {
+	struct mutex lock;
+	enum dma_data_direction direction;
+
+	struct channel *members[VCL_BOND_MAX_MEMBERS];
+	size_t member_cnt;
+
+	u32 stripe;
+	bool started;
+
+	// member and number of the current stripe
+	size_t cur;
+	u32 seq;
+
+	// writing: the current stripe with its header, bytes of it sent
+	char *bounce;
+	u32 frame;
+	u32 sent;
+
+	// reading: header of the current stripe, payload and padding left
+	u8 header[STRIPE_HEADER];
+	u32 header_bytes;
+	u32 left;
+	u32 pad;
+	bool broken;
+};
+
+static int open(struct inode *, struct file *);
+static int release(struct inode *, struct file *);
+
+static ssize_t write(struct file *, const char *, size_t, loff_t *);
+static ssize_t read(struct file *, char *, size_t, loff_t *);
+
+static unsigned int poll(struct file *, poll_table *);
+
+static long ioctl(struct file *, unsigned int, unsigned long);
+
+static struct file_operations bond_ops = {
+	.owner = THIS_MODULE,
+	.llseek = no_llseek,
+	.open = open,
+	.release = release,
+	.write = write,
+	.read = read,
+	.poll = poll,
+	.unlocked_ioctl = ioctl,
+};
+
+static struct cdev bond_cdev;
+
+static int open(struct inode *inode, struct file *filp) {
+	struct bond *bond = kzalloc(sizeof(*bond), GFP_KERNEL);
+
+	if(!bond) {
+		return -ENOMEM;
+	}
+
+	mutex_init(&bond->lock);
+	bond->direction = DMA_NONE;
+	bond->stripe = DEFAULT_STRIPE;
+
+	filp->private_data = bond;
+	return nonseekable_open(inode, filp);
+}
+
+static ssize_t flush_stripe(struct bond *, bool);
+
+static int release(struct inode *inode, struct file *filp) {
+	struct bond *bond = filp->private_data;
+	size_t idx;
+
+	if(bond->frame) {
+		flush_stripe(bond, false);
+	}
+	vfree(bond->bounce);
+
+	for(idx = 0; idx < bond->member_cnt; ++idx) {
+		release_buffers(bond->members[idx]);
+		atomic_dec(&bond->members[idx]->open_count);
+	}
+	kfree(bond);
+	return 0;
+}
+
+static void next_stripe(struct bond *bond) {
+	bond->cur = (bond->cur + 1) % bond->member_cnt;
+	bond->seq++;
+}
+
+// Puts the header and `len` bytes of user data into the bounce buffer.
+static int fill_stripe(struct bond *bond, const char *usr_ptr, size_t len) {
+	__le32 *header = (__le32 *)bond->bounce;
+
+	header[0] = cpu_to_le32((STRIPE_MAGIC << 16) | bond->cur);
+	header[1] = cpu_to_le32(bond->seq);
+	header[2] = cpu_to_le32(len);
+	header[3] = 0;
+	if(copy_from_user(bond->bounce + STRIPE_HEADER, usr_ptr, len)) {
+		return -EFAULT;
+	}
+
+	bond->frame = STRIPE_HEADER + ALIGN(len, 16);
+	bond->sent = 0;
+	memset(bond->bounce + STRIPE_HEADER + len, 0, bond->frame - STRIPE_HEADER - len);
+	return 0;
+}
+
+// Sends the rest of the current stripe to its member. Returns 0 once the
+// stripe is sent completely, else the error of the member.
+static ssize_t flush_stripe(struct bond *bond, bool nonblock) {
+	ssize_t ret;
+
+	while(bond->sent < bond->frame) {
+		ret = channel_write_kernel(bond->members[bond->cur], bond->bounce + bond->sent,
+			bond->frame - bond->sent, nonblock);
+		if(ret <= 0) {
+			return ret ? ret : -EAGAIN;
+		}
+		bond->sent += ret;
+	}
+
+	bond->frame = 0;
+	bond->sent = 0;
+	next_stripe(bond);
+	return 0;
+}
+
+static ssize_t write(struct file *filp, const char *usr_ptr, size_t size, loff_t *offs) {
+	struct bond *bond = filp->private_data;
+	bool nonblock = filp->f_flags & O_NONBLOCK;
+	ssize_t ret = 0, bytes_written = 0;
+	size_t len;
+
+	if(bond->direction != DMA_TO_DEVICE) {
+		return -EINVAL;
+	}
+
+	mutex_lock(&bond->lock);
+	bond->started = true;
+
+	if(!bond->bounce) {
+		bond->bounce = vmalloc(STRIPE_HEADER + ALIGN(bond->stripe, 16));
+		if(!bond->bounce) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
+	}
+
+	// The rest of a stripe a former call could not send completely goes
+	// first, its data has been counted by that call.
+	if(bond->frame) {
+		ret = flush_stripe(bond, nonblock);
+		if(ret) {
+			goto unlock;
+		}
+	}
+
+	// A member only blocks while all of its buffers are in flight, the
+	// others keep transferring meanwhile.
+	while(size) {
+		len = min_t(size_t, size, bond->stripe);
+		ret = fill_stripe(bond, usr_ptr + bytes_written, len);
+		if(!ret) {
+			ret = flush_stripe(bond, nonblock);
+		}
+		if(ret && !bond->sent) {
+			// nothing of the stripe was sent, it is dropped
+			bond->frame = 0;
+			break;
+		}
+
+		bytes_written += len;
+		size -= len;
+		if(ret) {
+			// the member took only part of the stripe, the next call
+			// sends the rest
+			break;
+		}
+	}
+
+unlock:
+	mutex_unlock(&bond->lock);
+	return bytes_written ? bytes_written : ret;
+}
+
+// Checks the header of the current stripe. Returns -EIO if it is not the
+// expected stripe, the bond is broken from then on.
+static int start_stripe(struct bond *bond) {
+	struct channel *chn = bond->members[bond->cur];
+	u32 dw0 = le32_to_cpup((__le32 *)bond->header);
+	u32 seq = le32_to_cpup((__le32 *)(bond->header + 4));
+	u32 bytes = le32_to_cpup((__le32 *)(bond->header + 8));
+
+	if(dw0 != ((STRIPE_MAGIC << 16) | bond->cur) || seq != bond->seq ||
+			!bytes || bytes > bond->stripe) {
+		dev_err(chn->dev,
+			"Channel %u: Expected stripe %u of member %zu, got header %08x %08x %08x",
+			chn->id, bond->seq, bond->cur, dw0, seq, bytes);
+		bond->broken = true;
+		return -EIO;
+	}
+
+	bond->left = bytes;
+	bond->pad = ALIGN(bytes, 16) - bytes;
+	return 0;
+}
+
+static ssize_t read(struct file *filp, char *usr_ptr, size_t size, loff_t *offs) {
+	struct bond *bond = filp->private_data;
+	bool nonblock = filp->f_flags & O_NONBLOCK;
+	struct channel *chn;
+	ssize_t ret, bytes_read = 0;
+	size_t len, ahead, idx;
+	u8 pad[16];
+
+	if(bond->direction != DMA_FROM_DEVICE) {
+		return -EINVAL;
+	}
+
+	mutex_lock(&bond->lock);
+	bond->started = true;
+
+	if(bond->broken) {
+		mutex_unlock(&bond->lock);
+		return -EIO;
+	}
+
+	// Request this read's share on every idle member, so that all of
+	// them receive their stripes at the same time.
+	ahead = DIV_ROUND_UP(DIV_ROUND_UP(size, bond->member_cnt), bond->stripe);
+	ahead *= STRIPE_HEADER + ALIGN(bond->stripe, 16);
+	for(idx = 0; idx < bond->member_cnt; ++idx) {
+		chn = bond->members[idx];
+		if(!has_serviced_buffer(chn) && !has_active_buffer(chn)) {
+			ret = request_idle_buffers(chn, ahead);
+			if(ret < 0) {
+				mutex_unlock(&bond->lock);
+				return ret;
+			}
+		}
+	}
+
+	while(size) {
+		chn = bond->members[bond->cur];
+
+		if(bond->header_bytes < STRIPE_HEADER) {
+			len = STRIPE_HEADER - bond->header_bytes;
+			ret = channel_read_kernel(chn, bond->header + bond->header_bytes, len, nonblock);
+			if(ret > 0) {
+				bond->header_bytes += ret;
+				if(bond->header_bytes == STRIPE_HEADER && start_stripe(bond)) {
+					ret = -EIO;
+				}
+			}
+		} else if(bond->left) {
+			len = min_t(size_t, size, bond->left);
+			ret = channel_read(chn, usr_ptr + bytes_read, len, nonblock);
+			if(ret > 0) {
+				bytes_read += ret;
+				size -= ret;
+				bond->left -= ret;
+			}
+		} else {
+			len = bond->pad;
+			ret = channel_read_kernel(chn, pad, len, nonblock);
+			if(ret > 0) {
+				bond->pad -= ret;
+			}
+		}
+
+		// After a broken header the data read so far is still returned,
+		// the next call fails.
+		if(ret <= 0) {
+			if(!bytes_read) {
+				bytes_read = ret;
+			}
+			break;
+		}
+
+		if(bond->header_bytes == STRIPE_HEADER && !bond->left && !bond->pad) {
+			bond->header_bytes = 0;
+			next_stripe(bond);
+		} else if(bond->left && ret < len) {
+			// the rest of the payload has not arrived yet
+			break;
+		}
+	}
+
+	mutex_unlock(&bond->lock);
+	return bytes_read;
+}
+
+static unsigned int poll(struct file *filp, poll_table *wait) {
+	struct bond *bond = filp->private_data;
+	struct channel *chn;
+	size_t idx;
+
+	for(idx = 0; idx < bond->member_cnt; ++idx) {
+		poll_wait(filp, &bond->members[idx]->waitq, wait);
+	}
+
+	if(!bond->member_cnt) {
+		return 0;
+	}
+
+	// only the member of the current stripe can make progress
+	chn = bond->members[bond->cur];
+	if(has_idle_buffer(chn) || has_serviced_buffer(chn)) {
+		if(bond->direction == DMA_TO_DEVICE) {
+			return (POLLOUT | POLLWRNORM);
+		} else {
+			return (POLLIN | POLLRDNORM);
+		}
+	}
+
+	return 0;
+}
+
+static long add_member(struct bond *bond, struct vcl_bond_member *member) {
+	struct pcie_endpoint *ep;
+	struct channel *chn;
+	int ret;
+
+	if(bond->started) {
+		return -EBUSY;
+	}
+	if(bond->member_cnt == VCL_BOND_MAX_MEMBERS) {
+		return -ENOSPC;
+	}
+
+	ep = find_endpoint(member->endpoint);
+	if(!ep) {
+		return -ENODEV;
+	}
+	chn = find_channel(ep, member->channel);
+	if(!chn) {
+		return -ENODEV;
+	}
+	if(bond->member_cnt && chn->direction != bond->direction) {
+		dev_err(chn->dev, "Channel %u has a different direction than the bond", chn->id);
+		return -EINVAL;
+	}
+
+	if(atomic_cmpxchg(&chn->open_count, 0, 1)) {
+		dev_err(chn->dev, "Tried to bond busy channel %u", chn->id);
+		return -EBUSY;
+	}
+	ret = reserve_buffers(chn);
+	if(ret) {
+		atomic_dec(&chn->open_count);
+		return ret;
+	}
+	write_channel_config(chn);
+
+	bond->direction = chn->direction;
+	bond->members[bond->member_cnt++] = chn;
+	return 0;
+}
+
+static long ioctl(struct file *filp, unsigned int cmd, unsigned long params) {
+	struct bond *bond = filp->private_data;
+	struct vcl_bond_member member;
+	unsigned int stripe;
+	long ret = 0;
+
+	mutex_lock(&bond->lock);
+
+	switch(cmd) {
+	case VCL_BOND_IOCTL_ADD:
+		if(copy_from_user(&member, (struct vcl_bond_member __user *)params, sizeof(member))) {
+			ret = -EFAULT;
+			break;
+		}
+		ret = add_member(bond, &member);
+		break;
+	case VCL_BOND_IOCTL_SET_STRIPE:
+		if(get_user(stripe, (unsigned int __user *)params)) {
+			ret = -EFAULT;
+			break;
+		}
+		if(!stripe || stripe % 4 || stripe > VCL_BOND_MAX_STRIPE) {
+			ret = -EINVAL;
+		} else if(bond->started) {
+			ret = -EBUSY;
+		} else {
+			bond->stripe = stripe;
+		}
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	mutex_unlock(&bond->lock);
+	return ret;
+}
+
+int bond_device_init(void) {
+	int ret = 0;
+	dev_t devt;
+	struct device *dev;
+
+	ret = alloc_chrdev_region(&devt, 0, 1, "vercolib_pcie_bond");
+	if(ret < 0) {
+		goto done;
+	}
+
+	cdev_init(&bond_cdev, &bond_ops);
+	bond_cdev.owner = THIS_MODULE;
+
+	ret = cdev_add(&bond_cdev, devt, 1);
+	if(ret) {
+		goto unregister;
+	}
+
+	dev = device_create(vcl_channel_class, NULL, devt, NULL, "vcl_bond");
+	if(IS_ERR(dev)) {
+		ret = PTR_ERR(dev);
+		goto del;
+	}
+
+	goto done;
+
+del:
+	cdev_del(&bond_cdev);
+unregister:
+	unregister_chrdev_region(devt, 1);
+done:
+	return ret;
+}
+
+void bond_device_cleanup(void) {
+	dev_t devt = bond_cdev.dev;
+
+	device_destroy(vcl_channel_class, devt);
+	cdev_del(&bond_cdev);
+	unregister_chrdev_region(devt, 1);
+}
@@ -0,0 +1,30 @@
+// ioctl definitions for bonded channel devices
+
+#ifndef _VCL_BOND_IOCTL_H_
+#define _VCL_BOND_IOCTL_H_
+
+#include <linux/ioctl.h>
+
+#define VCL_BOND_MAX_MEMBERS 8
+#define VCL_BOND_MAX_STRIPE (16 << 20)
+
+// A host channel, given by the number of its endpoint (the <i> of
+// /dev/vcl_<i>) and its channel id.
+struct vcl_bond_member {
+	unsigned int endpoint;
+	unsigned int channel;
+};
+
+#define VCL_BOND_IOCTL_BASE 0xFD
+
+// Add a channel as the next member of the bond. All members must transfer
+// in the same direction. Returns -EBUSY if the channel is open or the bond
+// has already transferred data.
+#define VCL_BOND_IOCTL_ADD _IOW(VCL_BOND_IOCTL_BASE, 0, struct vcl_bond_member *)
+
+// Set the number of bytes transferred on one member before the next member
+// is used, a multiple of 4 up to VCL_BOND_MAX_STRIPE, not counting the
+// stripe header. Must be set before the first transfer.
+#define VCL_BOND_IOCTL_SET_STRIPE _IOW(VCL_BOND_IOCTL_BASE, 1, unsigned int *)
+
+#endif
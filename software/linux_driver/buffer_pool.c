@@ -0,0 +1,256 @@
+// Endpoint-wide pool of channel buffers
+//
+// Channels get their buffers when they are opened and give them back when
+// they are closed, closed channels hold no memory. An open channel keeps
+// min_buffers buffers for itself. When those are all in use it borrows
+// further ones up to its max_buffers, as long as the endpoint has shared
+// buffers left, and returns them as soon as they are idle again. Returned
+// buffers are kept for reuse while they fit into the shared buffers, the
+// rest is freed.
+
+#include <linux/slab.h>
+
+#include "vercolib_pcie.h"
+
+#define BUF_ORD 8
+#define DEFAULT_SHARED_BUFFERS 16
+
+u32 buffer_bytes(void) {
+	return (1 << BUF_ORD) * PAGE_SIZE;
+}
+
+static struct buffer *create_buffer(u8 id) {
+	struct buffer *buffer = kmalloc(sizeof(*buffer), GFP_KERNEL);
+	if(!buffer) {
+		return NULL;
+	}
+	INIT_LIST_HEAD(&buffer->list);
+	buffer->head = 0;
+	buffer->size = 0;
+	buffer->in_flight = false;
+	buffer->id = id;
+	buffer->init_size = buffer_bytes();
+	buffer->ptr = (void *)__get_free_pages(GFP_KERNEL, BUF_ORD);
+	if(!buffer->ptr) {
+		kfree(buffer);
+		return NULL;
+	}
+
+	return buffer;
+}
+
+static void destroy_buffer(struct buffer *buf) {
+	free_pages((unsigned long)buf->ptr, BUF_ORD);
+	kfree(buf);
+}
+
+void buffer_pool_init(struct buffer_pool *pool) {
+	spin_lock_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->free_buffers);
+	pool->num_free = 0;
+	pool->allocated = 0;
+	pool->lent = 0;
+	pool->shared = DEFAULT_SHARED_BUFFERS;
+	pool->next_id = 0;
+}
+
+// Buffers of the channel which are not covered by its reservation.
+// Must be called with the pool lock held.
+static u32 lent(struct channel *chn) {
+	u32 reserved = chn->reserved ? chn->min_buffers : 0;
+	return chn->num_buffers > reserved ? chn->num_buffers - reserved : 0;
+}
+
+// Changes the buffers the channel holds and keeps the pool's count of
+// lent buffers. Must be called with the pool lock held.
+static void account(struct channel *chn, int buffers, bool reserved) {
+	struct buffer_pool *pool = chn->pool;
+
+	pool->lent -= lent(chn);
+	chn->num_buffers += buffers;
+	chn->reserved = reserved;
+	pool->lent += lent(chn);
+}
+
+bool has_lent_buffer(struct channel *chn) {
+	struct buffer_pool *pool = chn->pool;
+	unsigned long flags;
+	bool ret;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	ret = lent(chn) > 0;
+	spin_unlock_irqrestore(&pool->lock, flags);
+	return ret;
+}
+
+u32 borrowable_buffers(struct channel *chn) {
+	struct buffer_pool *pool = chn->pool;
+	unsigned long flags;
+	u32 own = 0, shared = 0;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if(chn->reserved && chn->num_buffers < chn->min_buffers) {
+		own = chn->min_buffers - chn->num_buffers;
+	}
+	if(chn->reserved && chn->num_buffers + own < chn->max_buffers &&
+		pool->lent < pool->shared) {
+		shared = min(chn->max_buffers - chn->num_buffers - own,
+			pool->shared - pool->lent);
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+	return own + shared;
+}
+
+// Takes a buffer from the pool for the channel, allocating it if the pool
+// has none left. Returns NULL if the channel may not take further buffers.
+struct buffer *borrow_buffer(struct channel *chn) {
+	struct buffer_pool *pool = chn->pool;
+	struct buffer *buf = NULL;
+	unsigned long flags;
+	u8 id = 0;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if(!chn->reserved || (chn->num_buffers >= chn->min_buffers &&
+		(chn->num_buffers >= chn->max_buffers || pool->lent >= pool->shared))) {
+		spin_unlock_irqrestore(&pool->lock, flags);
+		return NULL;
+	}
+
+	account(chn, 1, chn->reserved);
+	if(!list_empty(&pool->free_buffers)) {
+		buf = list_first_entry(&pool->free_buffers, struct buffer, list);
+		list_del_init(&buf->list);
+		pool->num_free -= 1;
+	} else {
+		pool->allocated += 1;
+		id = pool->next_id++;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if(!buf) {
+		buf = create_buffer(id);
+		if(!buf) {
+			dev_warn(chn->dev, "Channel %d: Failed to allocate a buffer", chn->id);
+			spin_lock_irqsave(&pool->lock, flags);
+			account(chn, -1, chn->reserved);
+			pool->allocated -= 1;
+			spin_unlock_irqrestore(&pool->lock, flags);
+			return NULL;
+		}
+	}
+
+	buf->head = 0;
+	buf->size = 0;
+	return buf;
+}
+
+// Gives an idle buffer back to the pool if the channel holds more than
+// its reservation. Returns false if the channel keeps the buffer.
+bool return_buffer(struct channel *chn, struct buffer *buf) {
+	struct buffer_pool *pool = chn->pool;
+	unsigned long flags;
+	bool keep;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if(!lent(chn)) {
+		spin_unlock_irqrestore(&pool->lock, flags);
+		return false;
+	}
+
+	account(chn, -1, chn->reserved);
+	keep = pool->num_free + pool->lent < pool->shared;
+	if(keep) {
+		list_add(&buf->list, &pool->free_buffers);
+		pool->num_free += 1;
+	} else {
+		pool->allocated -= 1;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if(!keep) {
+		destroy_buffer(buf);
+	}
+	return true;
+}
+
+struct buffer *get_idle_buffer(struct channel *chn) {
+	struct buffer *buf = remove_idle_buffer(chn);
+	if(buf) {
+		return buf;
+	}
+	return borrow_buffer(chn);
+}
+
+// Called when the channel is opened, takes its reserved buffers.
+int reserve_buffers(struct channel *chn) {
+	struct buffer_pool *pool = chn->pool;
+	struct buffer *buf;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	account(chn, 0, true);
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	// Buffers still in flight from the last time the channel was open
+	// count towards its reservation.
+	while(chn->num_buffers < chn->min_buffers) {
+		buf = borrow_buffer(chn);
+		if(!buf) {
+			release_buffers(chn);
+			return -ENOMEM;
+		}
+		add_idle_buffer(chn, buf);
+	}
+
+	return 0;
+}
+
+// Called when the channel is closed, gives back all buffers the hardware
+// is done with. Unread data is dropped. Buffers in flight stay with the
+// channel and are returned once they are serviced and the channel is
+// opened and closed again.
+void release_buffers(struct channel *chn) {
+	struct buffer_pool *pool = chn->pool;
+	struct buffer *buf, *tmp;
+	unsigned long flags;
+	LIST_HEAD(returned);
+
+	spin_lock_irqsave(&chn->lock, flags);
+	list_splice_tail_init(&chn->idle_buffers, &returned);
+	list_splice_tail_init(&chn->serviced_buffers, &returned);
+	chn->num_idle_buffers = 0;
+	chn->num_serviced_buffers = 0;
+	spin_unlock_irqrestore(&chn->lock, flags);
+
+	spin_lock_irqsave(&pool->lock, flags);
+	account(chn, 0, false);
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	list_for_each_entry_safe(buf, tmp, &returned, list) {
+		list_del_init(&buf->list);
+		return_buffer(chn, buf);
+	}
+}
+
+static void destroy_list(struct list_head *list) {
+	struct buffer *buf, *tmp;
+
+	list_for_each_entry_safe(buf, tmp, list, list) {
+		list_del(&buf->list);
+		destroy_buffer(buf);
+	}
+}
+
+// Frees all buffers of the endpoint, the channels must not be used anymore.
+void buffer_pool_cleanup(struct pcie_endpoint *ep) {
+	struct channel *chn;
+	size_t idx;
+
+	for(idx = 0; idx < ep->channel_cnt; ++idx) {
+		chn = ep->channels[idx];
+		destroy_list(&chn->idle_buffers);
+		destroy_list(&chn->active_buffers);
+		destroy_list(&chn->serviced_buffers);
+	}
+	destroy_list(&ep->pool.free_buffers);
+}
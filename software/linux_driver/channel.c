@@ -1,19 +1,29 @@
 // General channel oriented function
 // Author: Sebastian Schüller <schueller@ti.uni-bonn.de>
 
-#include "vercolib_pcie.h"
+#include <linux/delay.h>
+#include <linux/ktime.h>
 
-#define chn_id_offset(id) (id << 6)
+#include "vercolib_pcie.h"
 
 #define chn_info_dir(info) ((info >> 8) & 0x3)
 #define chn_info_kind(info) ((info >> 10) & 0x7)
+#define chn_info_queue_depth(info) ((info >> 16) & 0xF)
+#define chn_info_abort(info) ((info >> 20) & 0x1)
+#define chn_info_deadline(info) ((info >> 21) & 0x1)
 
 #define host_chn_cnt(info) ((info & 0xFF) + ((info >> 8) & 0xFF))
 #define chn_cnt(info) (info & 0xFF) + ((info >> 8) & 0xFF) + \
 	((info >> 16) & 0xFF) + ((info >> 24) & 0xFF)
 
-#define BUF_CNT 2
-#define BUF_ORD 8
+// default reservation of an open channel and limit of what it borrows
+#define MIN_BUFFERS 4
+#define MAX_BUFFERS 16
+
+// The hardware finishes the requests it already sent before an abort ends.
+#define ABORT_TIMEOUT_US 100
+
+#define DEFAULT_TIMEOUT_MS 1000
 
 enum channel_info_dir {
 	CHN_DIR_RX = 0,
@@ -35,6 +45,19 @@ static inline u32 read_transferred_bytes(struct channel *chn) {
 	return ioread32(chn->base_addr + chn_id_offset(chn->id) + CHN_TRNS_REG);
 }
 
+// Number of completed transactions whose results have not been read yet,
+// the upper bits of the register hold the state of the descriptor queue.
+static inline u32 read_completed(struct channel *chn) {
+	return ioread32(chn->base_addr + chn_id_offset(chn->id) + CHN_QUEUE_REG) & 0xFFFF;
+}
+
+static inline void read_timestamps(struct channel *chn, struct vcl_completion *meta) {
+	__iomem void *regs = chn->base_addr + chn_id_offset(chn->id);
+	meta->hw_doorbell = ioread32(regs + CHN_TS_DOORBELL_REG);
+	meta->hw_first_tlp = ioread32(regs + CHN_TS_FIRST_TLP_REG);
+	meta->hw_last_tlp = ioread32(regs + CHN_TS_LAST_TLP_REG);
+}
+
 
 static bool has_buffer(struct channel *chn, struct list_head *list) {
 	bool ret;
@@ -69,7 +92,11 @@ void add_active_buffer(struct channel *chn, struct buffer *buf) {
 	chn->num_active_buffers += 1;
 }
 
+// Buffers borrowed from the pool go back to it instead.
 void add_idle_buffer(struct channel *chn, struct buffer *buf) {
+	if(return_buffer(chn, buf)) {
+		return;
+	}
 	add_buffer(chn, &chn->idle_buffers, buf);
 	chn->num_idle_buffers += 1;
 }
@@ -107,11 +134,62 @@ struct buffer *remove_serviced_buffer(struct channel *chn) {
 	return buf;
 }
 
-void write_buffer_info(struct channel *chn, struct buffer *buf) {
+// Bytes of the serviced buffers not read yet.
+u32 readable_bytes(struct channel *chn) {
+	struct buffer *buf;
+	unsigned long flags;
+	u32 bytes = 0;
+
+	spin_lock_irqsave(&chn->lock, flags);
+	list_for_each_entry(buf, &chn->serviced_buffers, list) {
+		bytes += buf->size - buf->head;
+	}
+	spin_unlock_irqrestore(&chn->lock, flags);
+	return bytes;
+}
+
+// Bytes a write could hand to the hardware without waiting, the serviced
+// buffers of a rx channel are reused right away and further ones can be
+// borrowed from the pool.
+u32 writable_bytes(struct channel *chn) {
+	struct buffer *buf;
+	unsigned long flags;
+	u32 bytes = 0;
+
+	spin_lock_irqsave(&chn->lock, flags);
+	list_for_each_entry(buf, &chn->idle_buffers, list) {
+		bytes += buf->init_size;
+	}
+	list_for_each_entry(buf, &chn->serviced_buffers, list) {
+		bytes += buf->init_size;
+	}
+	spin_unlock_irqrestore(&chn->lock, flags);
+	return bytes + borrowable_buffers(chn) * buffer_bytes();
+}
+
+// Programs the per channel packet settings. The registers keep their value
+// until the FPGA is reset, so this is repeated whenever the channel is opened.
+void write_channel_config(struct channel *chn) {
+	__iomem void *regs = chn->base_addr + chn_id_offset(chn->id);
+
+	iowrite32(chn->max_tlp_bytes, regs + CHN_MAX_TLP_REG);
+	iowrite32(chn->tlp_attr, regs + CHN_TLP_ATTR_REG);
+	iowrite32(chn->crc, regs + CHN_CRC_REG);
+	if(chn->has_deadline) {
+		iowrite32(chn->deadline_cycles, regs + CHN_DEADLINE_REG);
+	}
+}
+
+static void write_buffer_info(struct channel *chn, struct buffer *buf) {
 	u32 lo_addr = (u32)(buf->dma_addr);
 	u32 hi_addr = (u32)(buf->dma_addr >> 32);
 
 	buf->in_flight = true;
+	chn->transaction_id += 1;
+	memset(&buf->meta, 0, sizeof(buf->meta));
+	buf->meta.transaction_id = chn->transaction_id;
+	buf->meta.submit_ns = ktime_get_ns();
+
 	iowrite32(lo_addr, chn->base_addr + chn_id_offset(chn->id) + CHN_ADDR_LO_REG);
 	if(!!hi_addr) {
 		iowrite32(hi_addr, chn->base_addr + chn_id_offset(chn->id) + CHN_ADDR_HI_REG);
@@ -119,20 +197,53 @@ void write_buffer_info(struct channel *chn, struct buffer *buf) {
 	iowrite32((u32)buf->size, chn->base_addr + chn_id_offset(chn->id) + CHN_SIZE_REG);
 }
 
-
-irqreturn_t host_channel_isr(int irq, void *data) {
-	struct channel *chn = data;
+// Hands active buffers to the hardware until its descriptor queue is full,
+// the hardware starts each one as soon as the previous is complete.
+// Must be called with the channel lock held.
+void submit_active_buffers(struct channel *chn) {
 	struct buffer *buf;
+
+	list_for_each_entry(buf, &chn->active_buffers, list) {
+		if(chn->num_in_flight >= chn->queue_depth) {
+			break;
+		}
+		if(buf->in_flight) {
+			continue;
+		}
+
+		write_buffer_info(chn, buf);
+		chn->num_in_flight += 1;
+		chn->submitted_bufs += 1;
+		dev_dbg(chn->dev, "Channel %d: Opening transaction %u requesting %u bytes on buffer %d.", chn->id, chn->transaction_id, buf->size, buf->id);
+	}
+}
+
+// Called once the user is done with a buffer, right before it is
+// put back to the idle list. Publishes the buffer's completion record,
+// dropping the oldest one if nobody collects them.
+void complete_buffer(struct channel *chn, struct buffer *buf) {
 	unsigned long flags;
 
+	buf->meta.consumed_ns = ktime_get_ns();
 
-	// The first active buffer has been serviced by the hardware
-	//
 	spin_lock_irqsave(&chn->lock, flags);
+	if(kfifo_is_full(&chn->completions)) {
+		kfifo_skip(&chn->completions);
+	}
+	kfifo_put(&chn->completions, buf->meta);
+	spin_unlock_irqrestore(&chn->lock, flags);
+}
+
+
+// The first active buffer has been serviced by the hardware.
+// Must be called with the channel lock held.
+static struct buffer *service_active_buffer(struct channel *chn) {
+	struct buffer *buf;
 
 	buf = list_entry(chn->active_buffers.next, struct buffer, list);
 	list_del_init(&buf->list);
 	chn->num_active_buffers -= 1;
+	chn->num_in_flight -= 1;
 
 	dma_unmap_single(
 		chn->dev, buf->dma_addr, buf->size, chn->direction);
@@ -140,72 +251,158 @@ irqreturn_t host_channel_isr(int irq, void *data) {
 	buf->size = read_transferred_bytes(chn);
 	buf->head = 0;
 
-	dev_dbg(chn->dev, "ISR Channel %d: Closing transaction %u with %u bytes transfer on buffer %d.", chn->id, chn->transaction_id, buf->size,  buf->id);
+	buf->meta.irq_ns = ktime_get_ns();
+	buf->meta.bytes = buf->size;
+	if(chn->timestamps) {
+		read_timestamps(chn, &buf->meta);
+	}
+	if(chn->crc) {
+		buf->meta.crc = ioread32(chn->base_addr + chn_id_offset(chn->id) + CHN_CRC_REG);
+	}
+
+	dev_dbg(chn->dev, "ISR Channel %d: Closing transaction %u with %u bytes transfer on buffer %d.", chn->id, buf->meta.transaction_id, buf->size,  buf->id);
 
 	list_add_tail(&buf->list, &chn->serviced_buffers);
 	chn->num_serviced_buffers += 1;
+	return buf;
+}
+
+// Services the buffers the hardware completed without waiting for their
+// interrupt, for busy polling. Only hardware with a descriptor queue
+// tells how many buffers are complete. Returns true if any was serviced.
+bool poll_channel(struct channel *chn) {
+	unsigned long flags;
+	bool serviced = false;
+
+	if(chn->queue_depth == 1) {
+		return false;
+	}
+
+	spin_lock_irqsave(&chn->lock, flags);
+	while(chn->num_in_flight && read_completed(chn)) {
+		service_active_buffer(chn);
+		serviced = true;
+	}
+	if(serviced) {
+		submit_active_buffers(chn);
+	}
+	spin_unlock_irqrestore(&chn->lock, flags);
+	return serviced;
+}
+
+irqreturn_t host_channel_isr(int irq, void *data) {
+	struct channel *chn = data;
+	struct buffer *buf;
+	unsigned long flags;
 
+	spin_lock_irqsave(&chn->lock, flags);
+	chn->interrupts += 1;
+
+	// With a descriptor queue the hardware may complete further buffers
+	// before this handler runs and their interrupts can be merged, so
+	// all results the hardware holds are collected here. Without a queue
+	// every interrupt belongs to exactly one buffer.
+	while(chn->num_in_flight &&
+		(chn->queue_depth == 1 || read_completed(chn))) {
+		service_active_buffer(chn);
+	}
 
-	// We may still have some active buffers waiting to be serviced by the hardware.
+	// Refill the hardware queue with the buffers waiting for it.
 	if(!list_empty(&chn->active_buffers)) {
-		buf = list_entry(chn->active_buffers.next, struct buffer, list);
-		if(buf->in_flight != true) {
-			buf->dma_addr = dma_map_single(
-				chn->dev, buf->ptr, buf->size, chn->direction);
-			if(unlikely(dma_mapping_error(chn->dev, buf->dma_addr))) {
-				dev_warn(chn->dev, "ISR Channel %d: Failed to map dma adress for buffer %d", chn->id, buf->id);
-				dma_unmap_single(
-					chn->dev, buf->dma_addr,
-					buf->size, chn->direction
-				);
-				spin_unlock_irqrestore(&chn->lock, flags);
-				return IRQ_HANDLED;
-			}
-			write_buffer_info(chn, buf);
-			chn->transaction_id += 1;
-			dev_dbg(chn->dev, "ISR Channel %d: Opening transaction %u requesting %u bytes on buffer %d.", chn->id, chn->transaction_id, buf->size, buf->id);
-		} else {
-			dev_dbg(chn->dev, "ISR Channel %d: Didn't schedule new buffer since it's already been scheduled by map_and_request_buffer.", chn->id);
-		}
+		submit_active_buffers(chn);
 	} else {
 		dev_dbg(chn->dev, "ISR Channel %d: Did't find any further buffers for queueing", chn->id);
 	}
 
 	spin_unlock_irqrestore(&chn->lock, flags);
 
+	// Nothing reads the serviced buffers of rx channels and closed
+	// channels, the borrowed ones go back to the pool right away.
+	if(chn->direction == DMA_TO_DEVICE || !chn->reserved) {
+		while(has_lent_buffer(chn) && (buf = remove_serviced_buffer(chn))) {
+			complete_buffer(chn, buf);
+			add_idle_buffer(chn, buf);
+		}
+	}
+
 	wake_up_interruptible(&chn->waitq);
 
 	return IRQ_HANDLED;
 }
 
-static struct buffer *create_buffer(struct channel *chn, u8 id, size_t page_order) {
-	struct buffer *buffer = NULL;
-	buffer = devm_kmalloc(chn->dev, sizeof(*buffer), GFP_KERNEL);
-	if(!buffer) {
-		return ERR_PTR(-ENOMEM);
+// Aborts the channel's transfers and moves all buffers which are not idle
+// back to the idle list. The lock is held throughout, so the interrupt of
+// the aborted transfer finds nothing left to do.
+int abort_channel(struct channel *chn, struct vcl_abort *res) {
+	__iomem void *regs = chn->base_addr + chn_id_offset(chn->id);
+	struct buffer *buf, *tmp;
+	unsigned long flags;
+	LIST_HEAD(returned);
+	size_t us;
+
+	if(!chn->can_abort) {
+		return -EOPNOTSUPP;
 	}
-	INIT_LIST_HEAD(&buffer->list);
-	buffer->head = 0;
-	buffer->size = 0;
-	buffer->in_flight = false;
-	buffer->id = id;
-	buffer->init_size = (1 << page_order) * PAGE_SIZE;
-	buffer->ptr = (void *)devm_get_free_pages(chn->dev, GFP_KERNEL, page_order);
-	if(!buffer->ptr) {
-		return ERR_PTR(-ENOMEM);
+
+	res->bytes = 0;
+	res->buffers = 0;
+
+	spin_lock_irqsave(&chn->lock, flags);
+
+	iowrite32(1, regs + CHN_ABORT_REG);
+	for(us = 0; us < ABORT_TIMEOUT_US && ioread32(regs + CHN_ABORT_REG); ++us) {
+		udelay(1);
+	}
+	if(us == ABORT_TIMEOUT_US) {
+		spin_unlock_irqrestore(&chn->lock, flags);
+		dev_err(chn->dev, "Channel %d: Timeout while aborting", chn->id);
+		return -ETIMEDOUT;
 	}
 
-	return buffer;
+	// The aborted transaction and any completed before it have a result,
+	// the queued ones were dropped by the hardware.
+	while(chn->num_in_flight && read_completed(chn)) {
+		buf = service_active_buffer(chn);
+		res->bytes += buf->size;
+	}
+
+	list_for_each_entry_safe(buf, tmp, &chn->active_buffers, list) {
+		dma_unmap_single(chn->dev, buf->dma_addr, buf->size, chn->direction);
+		buf->in_flight = false;
+		list_move_tail(&buf->list, &returned);
+	}
+	list_splice_tail_init(&chn->serviced_buffers, &returned);
+
+	chn->num_active_buffers = 0;
+	chn->num_serviced_buffers = 0;
+	chn->num_in_flight = 0;
+
+	spin_unlock_irqrestore(&chn->lock, flags);
+
+	list_for_each_entry_safe(buf, tmp, &returned, list) {
+		list_del_init(&buf->list);
+		buf->head = 0;
+		buf->size = 0;
+		complete_buffer(chn, buf);
+		add_idle_buffer(chn, buf);
+		res->buffers += 1;
+	}
+
+	dev_dbg(chn->dev, "Channel %d: Aborted, %llu bytes transferred, %u buffers returned", chn->id, res->bytes, res->buffers);
+
+	wake_up_interruptible(&chn->waitq);
+	return 0;
 }
 
 static struct channel *init_channel(
 	struct pcie_endpoint *ep,
 	u32 id,
-	enum dma_data_direction dir
+	enum dma_data_direction dir,
+	u8 queue_depth,
+	bool can_abort,
+	bool has_deadline
 ) {
 	struct channel *chn = devm_kmalloc(ep->dev, sizeof(*chn), GFP_KERNEL);
-	struct buffer *buf = NULL;
-	size_t idx;
 
 	if(unlikely(!chn)) {
 		return ERR_PTR(-ENOMEM);
@@ -227,20 +424,43 @@ static struct channel *init_channel(
 	chn->num_active_buffers = 0;
 	chn->num_serviced_buffers = 0;
 
+	// Hardware without a descriptor queue reports a depth of 0
+	// and takes one buffer at a time.
+	chn->num_in_flight = 0;
+	chn->queue_depth = queue_depth ? queue_depth : 1;
+	chn->can_abort = can_abort;
+	chn->has_deadline = has_deadline;
+
 	chn->id = id;
 	chn->transaction_id = 0;
 	atomic_set(&chn->open_count, 0);
 
-	for(idx = 0; idx < BUF_CNT; ++idx) {
-		buf = create_buffer(chn, idx, BUF_ORD);
-		if(IS_ERR(buf)) {
-			dev_err(chn->dev,
-				"Failed to create channel buffer.");
-			return ERR_PTR(PTR_ERR(buf));
-		}
-		list_add_tail(&buf->list, &chn->idle_buffers);
-		chn->num_idle_buffers += 1;
+	chn->timestamps = false;
+	chn->crc = false;
+	chn->tlp_attr = 0;
+	// Host-FPGA channels issue MRd, FPGA-Host channels MWr
+	if(dir == DMA_TO_DEVICE) {
+		chn->max_tlp_bytes = ep->max_read_request;
+	} else {
+		chn->max_tlp_bytes = ep->max_payload;
 	}
+	chn->deadline_cycles = 0;
+	chn->timeout_ms = DEFAULT_TIMEOUT_MS;
+	chn->read_watermark = 0;
+	chn->write_watermark = 0;
+	chn->busy_poll_us = 0;
+	chn->interrupts = 0;
+	chn->submitted_bufs = 0;
+	INIT_KFIFO(chn->completions);
+
+	// buffers are taken from the pool once the channel is opened
+	chn->pool = &ep->pool;
+	chn->num_buffers = 0;
+	chn->min_buffers = MIN_BUFFERS;
+	chn->max_buffers = MAX_BUFFERS;
+	chn->reserved = false;
+
+	write_channel_config(chn);
 
 	return chn;
 }
@@ -300,7 +520,8 @@ int channels_init(struct pcie_endpoint *ep) {
 			return -ENODEV;
 		}
 
-		new = init_channel(ep, id, dma_dir);
+		new = init_channel(ep, id, dma_dir, chn_info_queue_depth(chn_info),
+			chn_info_abort(chn_info), chn_info_deadline(chn_info));
 		if(IS_ERR(new)) {
 			return PTR_ERR(new);
 		}
@@ -4,20 +4,33 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/poll.h>
+#include <linux/sched/signal.h>
+#include <linux/uio.h>
+#include <linux/version.h>
 
 #include "vercolib_pcie.h"
 
-#define BUF_CNT 2
+#define BUF_CNT 4
 #define BUF_ORD 8
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,20,0)
+#define VCL_ITER_KVEC(Iter, Dir, Kvec, Nr, Count) iov_iter_kvec(Iter, ITER_KVEC | (Dir), Kvec, Nr, Count)
+#else
+#define VCL_ITER_KVEC(Iter, Dir, Kvec, Nr, Count) iov_iter_kvec(Iter, Dir, Kvec, Nr, Count)
+#endif
+
 static int open(struct inode *, struct file *);
 static int release(struct inode *, struct file *);
 
 static ssize_t write(struct file *, const char *, size_t, loff_t *);
 static ssize_t read(struct file *, char *, size_t, loff_t *);
+static ssize_t write_iter(struct kiocb *, struct iov_iter *);
+static ssize_t read_iter(struct kiocb *, struct iov_iter *);
 
 static unsigned int poll(struct file *, poll_table *);
 
+static long ioctl(struct file *, unsigned int, unsigned long);
+
 
 static struct file_operations chn_ops = {
 	.owner = THIS_MODULE,
@@ -26,13 +39,17 @@ static struct file_operations chn_ops = {
 	.release = release,
 	.write = write,
 	.read = read,
+	.write_iter = write_iter,
+	.read_iter = read_iter,
 	.poll = poll,
+	.unlocked_ioctl = ioctl,
 };
 
 static int open(struct inode *inode, struct file *filp) {
 	struct pcie_endpoint *ep;
 	struct channel *chn;
 	int open_count;
+	int ret;
 
 	ep = container_of(inode->i_cdev, struct pcie_endpoint, channel_cdev);
 	chn = ep->channels[iminor(inode)];
@@ -60,7 +77,15 @@ static int open(struct inode *inode, struct file *filp) {
 	}
 
 
+	ret = reserve_buffers(chn);
+	if(ret) {
+		dev_err(chn->dev, "Failed to allocate buffers for channel %u", chn->id);
+		atomic_dec(&chn->open_count);
+		return ret;
+	}
+
 	filp->private_data = chn;
+	write_channel_config(chn);
 
 	return nonseekable_open(inode, filp);
 }
@@ -68,12 +93,15 @@ static int open(struct inode *inode, struct file *filp) {
 static int release(struct inode *inode, struct file *filp) {
 	struct channel *chn = filp->private_data;
 	int open_count;
+	release_buffers(chn);
 	atomic_dec(&chn->open_count);
 	open_count = atomic_read(&chn->open_count);
 	return 0;
 }
 
-static ssize_t map_and_request_buffer(struct channel *chn, struct buffer *buf) {
+// Maps a buffer and appends it to the active ones. It is handed to the
+// hardware by the next submit_queued_buffers.
+static ssize_t map_and_queue_buffer(struct channel *chn, struct buffer *buf) {
 	ssize_t ret = 0;
 	unsigned long flags;
 	buf->dma_addr = dma_map_single(
@@ -98,119 +126,225 @@ static ssize_t map_and_request_buffer(struct channel *chn, struct buffer *buf) {
 
 
 	spin_lock_irqsave(&chn->lock, flags);
-	if(list_empty(&chn->active_buffers)) {
-		list_add(&buf->list, &chn->active_buffers);
+	dev_dbg(chn->dev, "Channel %d: Queueing buffer %d for transaction with size %d", chn->id, buf->id, buf->size);
+	list_add_tail(&buf->list, &chn->active_buffers);
+	chn->num_active_buffers += 1;
+	spin_unlock_irqrestore(&chn->lock, flags);
+	return ret;
+}
 
-		chn->num_active_buffers += 1;
-		write_buffer_info(chn, buf);
-		chn->transaction_id += 1;
-		dev_dbg(chn->dev, "Channel %d: Opening transaction %u requesting %u bytes on buffer %d.", chn->id, chn->transaction_id, buf->size, buf->id);
+// Hands all buffers queued by one call to the hardware in one pass.
+static void submit_queued_buffers(struct channel *chn) {
+	unsigned long flags;
 
-	} else {
-		dev_dbg(chn->dev, "Channel %d: Queueing buffer %d for transaction with size %d", chn->id, buf->id, buf->size);
-		list_add_tail(&buf->list, &chn->active_buffers);
-		chn->num_active_buffers += 1;
-		dev_dbg(chn->dev, "Channel %d: After queueing a buffer, %d buffers are in the queue.", chn->id, chn->num_active_buffers);
-	}
+	spin_lock_irqsave(&chn->lock, flags);
+	submit_active_buffers(chn);
+	dev_dbg(chn->dev, "Channel %d: After queueing buffers, %d buffers are in the queue.", chn->id, chn->num_active_buffers);
 	spin_unlock_irqrestore(&chn->lock, flags);
-	return ret;
 }
 
-static ssize_t request_idle_buffers(
+ssize_t request_idle_buffers(
 	struct channel *chn,
 	size_t size
 ) {
 	struct buffer *buf;
 	ssize_t requested = 0, ret = 0;
+	size_t len;
 
 
-	while(has_idle_buffer(chn) && size) {
-		buf = remove_idle_buffer(chn);
-		buf->size = buf->init_size < size ? buf->init_size : size;
+	while(size && (buf = get_idle_buffer(chn))) {
+		len = buf->init_size < size ? buf->init_size : size;
+		// The FPGA only ends a transfer in the middle of a DWORD at the end
+		// of its stream, any other data would be lost in a partial DWORD.
+		buf->size = ALIGN(len, 4);
 
-		ret = map_and_request_buffer(chn, buf);
+		ret = map_and_queue_buffer(chn, buf);
 		if(ret < 0) {
-			return ret;
+			break;
 		}
 
-		size -= ret;
+		size -= len;
 	}
 
-	return requested;
+	submit_queued_buffers(chn);
+	return ret < 0 ? ret : requested;
 }
 
 
-static ssize_t write(
-	struct file *filp,
-	const char *usr_ptr,
-	size_t size, loff_t *offs
-) {
-	struct channel *chn;
-	struct buffer *buf;
-	ssize_t bytes_written;
-	ssize_t ret;
+// Spins on the completions for up to the channel's busy_poll_us before the
+// caller goes to sleep, saving the wakeup for short waits. It only spins
+// while the hardware holds buffers which can complete and gives up early
+// if another task needs the CPU.
+static bool busy_poll(struct channel *chn, bool (*ready)(struct channel *)) {
+	u64 end;
 
-	chn = filp->private_data;
+	if(!chn->busy_poll_us || !has_active_buffer(chn)) {
+		return false;
+	}
+
+	end = ktime_get_ns() + (u64)chn->busy_poll_us * NSEC_PER_USEC;
+	do {
+		poll_channel(chn);
+		if(ready(chn)) {
+			return true;
+		}
+		cpu_relax();
+	} while(ktime_get_ns() < end && !need_resched() && !signal_pending(current));
+
+	return false;
+}
+
+// Waits until `ready` holds, for at most the channel's timeout. Without
+// waiting if `nonblock` is set. Returns -EAGAIN if the channel isn't ready.
+static int wait_channel(struct channel *chn, bool nonblock, bool (*ready)(struct channel *)) {
+	long ret;
+
+	if(ready(chn)) {
+		return 0;
+	}
+	if(nonblock) {
+		return -EAGAIN;
+	}
+	if(busy_poll(chn, ready)) {
+		return 0;
+	}
+	if(!chn->timeout_ms) {
+		return wait_event_interruptible(chn->waitq, ready(chn));
+	}
 
 	ret = wait_event_interruptible_timeout(
 		chn->waitq,
-		has_idle_buffer(chn) || has_serviced_buffer(chn),
-		500
+		ready(chn),
+		msecs_to_jiffies(chn->timeout_ms)
 	);
-	if(ret == -ERESTARTSYS) {
+	if(ret < 0) {
 		return ret;
 	}
-	if(ret == 0 || ret == 1) { // Timeout
+	if(ret == 0) { // Timeout
 		return -EAGAIN;
 	}
+	return 0;
+}
+
+static bool can_write(struct channel *chn) {
+	return has_idle_buffer(chn) || has_serviced_buffer(chn) ||
+		borrowable_buffers(chn);
+}
+
+// Plain memory as an iov_iter, from user space or, for devices built on
+// top of a channel, kernel memory.
+static void init_iter(
+	struct iov_iter *iter,
+	unsigned int dir,
+	struct iovec *iov,
+	struct kvec *kv,
+	const char *ptr,
+	size_t size,
+	bool user
+) {
+	if(user) {
+		iov->iov_base = (void __user *)ptr;
+		iov->iov_len = size;
+		iov_iter_init(iter, dir, iov, 1, size);
+	} else {
+		kv->iov_base = (void *)ptr;
+		kv->iov_len = size;
+		VCL_ITER_KVEC(iter, dir, kv, 1, size);
+	}
+}
+
+// Gathers the data of all segments of `from` into as few buffers as
+// possible, a writev of many small segments costs one system call and
+// one submission instead of one for each segment.
+static ssize_t write_channel(struct channel *chn, struct iov_iter *from, bool nonblock) {
+	struct buffer *buf;
+	ssize_t bytes_written;
+	ssize_t ret;
+	size_t size;
+
+	ret = wait_channel(chn, nonblock, can_write);
+	if(ret) {
+		return ret;
+	}
 
 
 	while(has_serviced_buffer(chn)) {
 		buf = remove_serviced_buffer(chn);
+		complete_buffer(chn, buf);
 		add_idle_buffer(chn, buf);
 	}
 
 	bytes_written = 0;
-	while(has_idle_buffer(chn) && size) {
-		buf = remove_idle_buffer(chn);
-
-		buf->size = buf->init_size < size ? buf->init_size : size;
-		ret = copy_from_user(
-			buf->ptr,
-			usr_ptr + bytes_written,
-			buf->size
-		);
-
+	while(iov_iter_count(from) && (buf = get_idle_buffer(chn))) {
+		size = min_t(size_t, buf->init_size, iov_iter_count(from));
+		if(unlikely(copy_from_iter(buf->ptr, size, from) != size)) {
+			add_idle_buffer(chn, buf);
+			ret = -EFAULT;
+			break;
+		}
+		buf->size = size;
 
-		ret = map_and_request_buffer(chn, buf);
+		ret = map_and_queue_buffer(chn, buf);
 		if(ret < 0) {
 			dev_err(chn->dev, "[write] Failed to dma-map buffer.");
-			return ret;
+			break;
 		}
 		bytes_written += ret;
-		size -= ret;
 	}
 
-	return bytes_written;
+	submit_queued_buffers(chn);
+	return bytes_written ? bytes_written : ret;
 };
 
+ssize_t channel_write(struct channel *chn, const char *usr_ptr, size_t size, bool nonblock) {
+	struct iov_iter iter;
+	struct iovec iov;
+	struct kvec kv;
+
+	init_iter(&iter, WRITE, &iov, &kv, usr_ptr, size, true);
+	return write_channel(chn, &iter, nonblock);
+}
+
+ssize_t channel_write_kernel(struct channel *chn, const char *ptr, size_t size, bool nonblock) {
+	struct iov_iter iter;
+	struct iovec iov;
+	struct kvec kv;
+
+	init_iter(&iter, WRITE, &iov, &kv, ptr, size, false);
+	return write_channel(chn, &iter, nonblock);
+}
 
+static ssize_t write(
+	struct file *filp,
+	const char *usr_ptr,
+	size_t size, loff_t *offs
+) {
+	return channel_write(filp->private_data, usr_ptr, size, filp->f_flags & O_NONBLOCK);
+}
+
+static ssize_t write_iter(struct kiocb *iocb, struct iov_iter *from) {
+	struct file *filp = iocb->ki_filp;
+	return write_channel(filp->private_data, from, filp->f_flags & O_NONBLOCK);
+}
+
+
+// Scatters the serviced buffers into the segments of `to`.
 static ssize_t read_serviced_buffers(
 	struct channel *chn,
-	char *usr_ptr,
-	size_t size
+	struct iov_iter *to
 ) {
-	size_t read_size;
-	ssize_t ret, bytes_read;
+	size_t read_size, copied;
+	ssize_t bytes_read;
 	struct buffer *buf = NULL;
 	unsigned long flags;
 	u32 bytes_left_in_buffer;
 
 	bytes_read = 0;
-	while(has_serviced_buffer(chn) && size) {
+	while(has_serviced_buffer(chn) && iov_iter_count(to)) {
 		buf = remove_serviced_buffer(chn);
 		if(!buf->size) {
 			dev_dbg(chn->dev, "Channel %d: Encountered empty buffer %d, skipping", chn->id, buf->id);
+			complete_buffer(chn, buf);
 			add_idle_buffer(chn, buf);
 			continue;
 		}
@@ -221,28 +355,17 @@ static ssize_t read_serviced_buffers(
 				"Invalid fill state of buffer %u with head %u and size %u",
 				buf->id, buf->head, buf->size);
 		}
-		read_size = bytes_left_in_buffer < size ?
-			bytes_left_in_buffer : size;
+		read_size = min_t(size_t, bytes_left_in_buffer, iov_iter_count(to));
 		dev_dbg(chn->dev, "Channel %d: Reading %lu bytes from buffer %d", chn->id, read_size, buf->id);
 
-		ret = copy_to_user(
-			usr_ptr + bytes_read,
-			buf->ptr + buf->head,
-			read_size
-		);
-		if(unlikely(ret)) {
-			dev_err(chn->dev,
-				"Failed to copy read data to user.");
-			return ret;
-		}
-
-		buf->head += read_size;
-		bytes_read += read_size;
-		size -= read_size;
+		copied = copy_to_iter(buf->ptr + buf->head, read_size, to);
+		buf->head += copied;
+		bytes_read += copied;
 
 		if(buf->head == buf->size) {
 			buf->head = 0;
 			buf->size = 0;
+			complete_buffer(chn, buf);
 			add_idle_buffer(chn, buf);
 		} else {
 			// This buffer is not done yet, so we stick it
@@ -252,16 +375,19 @@ static ssize_t read_serviced_buffers(
 			chn->num_serviced_buffers += 1;
 			spin_unlock_irqrestore(&chn->lock, flags);
 		}
+
+		if(unlikely(copied != read_size)) {
+			dev_err(chn->dev,
+				"Failed to copy read data to user.");
+			return bytes_read ? bytes_read : -EFAULT;
+		}
 	}
 	return bytes_read;
 }
 
-static ssize_t read(struct file *filp, char *usr_ptr, size_t size, loff_t *offs) {
-	struct channel *chn;
+static ssize_t read_channel(struct channel *chn, struct iov_iter *to, bool nonblock) {
 	ssize_t bytes_read, ret;
 
-	chn = filp->private_data;
-
 	// Step 1: We won't have anything to read on the first read
 	// of every user transaction.
 	// Since POSIX defines a read() return value of 0 as EOF,
@@ -270,43 +396,39 @@ static ssize_t read(struct file *filp, char *usr_ptr, size_t size, loff_t *offs)
 	// can return data.
 	if(!has_serviced_buffer(chn) && !has_active_buffer(chn)) {
 		dev_dbg(chn->dev, "Channel %d: Requesting idle buffers for read.", chn->id);
-		ret = request_idle_buffers(chn, size);
+		ret = request_idle_buffers(chn, iov_iter_count(to));
 		if(ret < 0) {
 			dev_err(chn->dev, "Failed to request buffers");
 			return ret;
 		}
 	}
 
-	ret = wait_event_interruptible_timeout(
-		chn->waitq,
-		has_serviced_buffer(chn),
-		1000
-	);
+	// A non-blocking read returns here with the buffers requested, the
+	// data is read by a later call.
+	ret = wait_channel(chn, nonblock, has_serviced_buffer);
 	if(ret == -ERESTARTSYS) {
 		dev_dbg(chn->dev, "Channel %d: Forced to restart systemcall while waiting for read serviced buffers", chn->id);
 		return ret;
 	}
-	if(ret == 0 || ret == 1) { // Timeout
-		dev_dbg(chn->dev, "Channel %d: Timeout while waiting for read serviced buffers", chn->id);
-		ret = -EAGAIN;
+	if(ret) {
+		dev_dbg(chn->dev, "Channel %d: No serviced buffers to read", chn->id);
 		return ret;
 	}
 
 	bytes_read = 0;
 
 	// Step 2: Read enough data to satisfy the current request.
-	ret = read_serviced_buffers(chn, usr_ptr, size);
+	ret = read_serviced_buffers(chn, to);
 	if(ret < 0) {
 		return ret;
 	}
 
 	bytes_read += ret;
-	size -= ret;
 
 	// Step 3: If we couldn't deliver enough data to complete
 	// the user read transaction, issue a new read request
 	// to hardware for the remainder.
-	ret = request_idle_buffers(chn, size);
+	ret = request_idle_buffers(chn, iov_iter_count(to));
 	if(ret < 0) {
 		return ret;
 	}
@@ -314,6 +436,33 @@ static ssize_t read(struct file *filp, char *usr_ptr, size_t size, loff_t *offs)
 	return bytes_read;
 }
 
+ssize_t channel_read(struct channel *chn, char *usr_ptr, size_t size, bool nonblock) {
+	struct iov_iter iter;
+	struct iovec iov;
+	struct kvec kv;
+
+	init_iter(&iter, READ, &iov, &kv, usr_ptr, size, true);
+	return read_channel(chn, &iter, nonblock);
+}
+
+ssize_t channel_read_kernel(struct channel *chn, char *ptr, size_t size, bool nonblock) {
+	struct iov_iter iter;
+	struct iovec iov;
+	struct kvec kv;
+
+	init_iter(&iter, READ, &iov, &kv, ptr, size, false);
+	return read_channel(chn, &iter, nonblock);
+}
+
+static ssize_t read(struct file *filp, char *usr_ptr, size_t size, loff_t *offs) {
+	return channel_read(filp->private_data, usr_ptr, size, filp->f_flags & O_NONBLOCK);
+}
+
+static ssize_t read_iter(struct kiocb *iocb, struct iov_iter *to) {
+	struct file *filp = iocb->ki_filp;
+	return read_channel(filp->private_data, to, filp->f_flags & O_NONBLOCK);
+}
+
 static unsigned int poll(struct file *filp, poll_table *wait) {
 	struct channel *chn;
 
@@ -321,19 +470,94 @@ static unsigned int poll(struct file *filp, poll_table *wait) {
 
 	poll_wait(filp, &chn->waitq, wait);
 
-	if(has_idle_buffer(chn) || has_serviced_buffer(chn)) {
-		if(chn->direction == DMA_TO_DEVICE) {
+	// Below the watermark the channel is only reported ready once the
+	// hardware has no buffer left, nothing else would arrive otherwise.
+	if(chn->direction == DMA_TO_DEVICE) {
+		if(can_write(chn) && (!has_active_buffer(chn) ||
+			writable_bytes(chn) >= chn->write_watermark)) {
 			return (POLLOUT | POLLWRNORM);
-		} else if(chn->direction == DMA_FROM_DEVICE) {
+		}
+	} else if(chn->direction == DMA_FROM_DEVICE) {
+		if(has_serviced_buffer(chn) && (!has_active_buffer(chn) ||
+			readable_bytes(chn) >= chn->read_watermark)) {
 			return (POLLIN | POLLRDNORM);
-		} else {
-			return 0;
 		}
 	}
 
 	return 0;
 }
 
+static long ioctl(struct file *filp, unsigned int cmd, unsigned long params) {
+	struct channel *chn = filp->private_data;
+	struct vcl_completion meta;
+	struct vcl_abort res;
+	struct vcl_wait wait;
+	int ret;
+
+	switch(cmd) {
+	case VCL_CHN_IOCTL_GET_COMPLETION:
+		if(!kfifo_out_spinlocked(&chn->completions, &meta, 1, &chn->lock)) {
+			return -EAGAIN;
+		}
+
+		if(copy_to_user((struct vcl_completion __user *)params, &meta, sizeof(meta))) {
+			dev_err(chn->dev, "Failed to copy completion record to user.");
+			return -EFAULT;
+		}
+
+		break;
+	case VCL_CHN_IOCTL_ABORT:
+		ret = abort_channel(chn, &res);
+		if(ret) {
+			return ret;
+		}
+
+		if(copy_to_user((struct vcl_abort __user *)params, &res, sizeof(res))) {
+			dev_err(chn->dev, "Failed to copy abort result to user.");
+			return -EFAULT;
+		}
+
+		break;
+	case VCL_CHN_IOCTL_GET_WAIT:
+		wait.timeout_ms = chn->timeout_ms;
+		wait.read_watermark = chn->read_watermark;
+		wait.write_watermark = chn->write_watermark;
+
+		if(copy_to_user((struct vcl_wait __user *)params, &wait, sizeof(wait))) {
+			return -EFAULT;
+		}
+
+		break;
+	case VCL_CHN_IOCTL_SET_WAIT:
+		if(copy_from_user(&wait, (struct vcl_wait __user *)params, sizeof(wait))) {
+			return -EFAULT;
+		}
+
+		chn->timeout_ms = wait.timeout_ms;
+		chn->read_watermark = wait.read_watermark;
+		chn->write_watermark = wait.write_watermark;
+		// the new watermarks may make the channel ready
+		wake_up_interruptible(&chn->waitq);
+		break;
+	case VCL_CHN_IOCTL_GET_BUSY_POLL:
+		if(put_user(chn->busy_poll_us, (unsigned int __user *)params)) {
+			return -EFAULT;
+		}
+
+		break;
+	case VCL_CHN_IOCTL_SET_BUSY_POLL:
+		if(get_user(chn->busy_poll_us, (unsigned int __user *)params)) {
+			return -EFAULT;
+		}
+
+		break;
+	default:
+		return -ENOTTY;
+	}
+
+	return 0;
+}
+
 static ssize_t id_show(struct device *dev, struct device_attribute *attr, char *buf) {
 	struct channel *chn = dev_get_drvdata(dev);
 	return snprintf(buf, PAGE_SIZE, "%u\n", (u32)(chn->id));
@@ -365,12 +589,260 @@ static ssize_t idle_bufs_show(struct device *dev, struct device_attribute *attr,
 }
 DEVICE_ATTR_RO(idle_bufs);
 
+static ssize_t queue_depth_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", (u32)(chn->queue_depth));
+}
+DEVICE_ATTR_RO(queue_depth);
+
 static ssize_t serviced_bufs_show(struct device *dev, struct device_attribute *attr, char *buf) {
 	struct channel *chn = dev_get_drvdata(dev);
 	return snprintf(buf, PAGE_SIZE, "%u\n", (u32)(chn->num_serviced_buffers));
 }
 DEVICE_ATTR_RO(serviced_bufs);
 
+static ssize_t interrupts_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%llu\n", chn->interrupts);
+}
+DEVICE_ATTR_RO(interrupts);
+
+static ssize_t submitted_bufs_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%llu\n", chn->submitted_bufs);
+}
+DEVICE_ATTR_RO(submitted_bufs);
+
+static ssize_t timestamps_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", (u32)(chn->timestamps));
+}
+
+static ssize_t timestamps_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	bool enable;
+
+	if(kstrtobool(buf, &enable)) {
+		return -EINVAL;
+	}
+	chn->timestamps = enable;
+	return count;
+}
+DEVICE_ATTR_RW(timestamps);
+
+// Enables the CRC32C of the transferred data, used from the next buffer on.
+static ssize_t crc_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", (u32)(chn->crc));
+}
+
+static ssize_t crc_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	bool enable;
+
+	if(kstrtobool(buf, &enable)) {
+		return -EINVAL;
+	}
+	chn->crc = enable;
+	iowrite32(enable, chn->base_addr + chn_id_offset(chn->id) + CHN_CRC_REG);
+	return count;
+}
+DEVICE_ATTR_RW(crc);
+
+// The arbitration settings are accessed indirectly through the config
+// channel, the select/access register pair is shared by all channels.
+static DEFINE_SPINLOCK(qos_lock);
+
+static ssize_t qos_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	unsigned long flags;
+	u32 qos;
+
+	spin_lock_irqsave(&qos_lock, flags);
+	iowrite32(chn->id, chn->base_addr + CFG_QOS_SELECT_REG);
+	qos = ioread32(chn->base_addr + CFG_QOS_CONFIG_REG);
+	spin_unlock_irqrestore(&qos_lock, flags);
+
+	return snprintf(buf, PAGE_SIZE, "0x%08x\n", qos);
+}
+
+static ssize_t qos_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	unsigned long flags;
+	u32 qos;
+
+	if(kstrtou32(buf, 0, &qos)) {
+		return -EINVAL;
+	}
+
+	spin_lock_irqsave(&qos_lock, flags);
+	iowrite32(chn->id, chn->base_addr + CFG_QOS_SELECT_REG);
+	iowrite32(qos, chn->base_addr + CFG_QOS_CONFIG_REG);
+	spin_unlock_irqrestore(&qos_lock, flags);
+
+	return count;
+}
+DEVICE_ATTR_RW(qos);
+
+// The hardware register is write only, the channel keeps a copy for reading.
+// A new setting is used from the next buffer on.
+static ssize_t tlp_attr_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "0x%08x\n", chn->tlp_attr);
+}
+
+static ssize_t tlp_attr_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	u32 tlp_attr;
+
+	if(kstrtou32(buf, 0, &tlp_attr) || (tlp_attr & ~TLP_ATTR_MASK)) {
+		return -EINVAL;
+	}
+
+	chn->tlp_attr = tlp_attr;
+	iowrite32(tlp_attr, chn->base_addr + chn_id_offset(chn->id) + CHN_TLP_ATTR_REG);
+	return count;
+}
+DEVICE_ATTR_RW(tlp_attr);
+
+static ssize_t max_tlp_bytes_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", chn->max_tlp_bytes);
+}
+DEVICE_ATTR_RO(max_tlp_bytes);
+
+// Like tlp_attr, the channel keeps a copy of the write only register.
+// Only FPGA-Host channels wait for data and support a deadline.
+static ssize_t deadline_cycles_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", chn->deadline_cycles);
+}
+
+static ssize_t deadline_cycles_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	u32 cycles;
+
+	if(!chn->has_deadline) {
+		return -EOPNOTSUPP;
+	}
+	if(kstrtou32(buf, 0, &cycles)) {
+		return -EINVAL;
+	}
+
+	chn->deadline_cycles = cycles;
+	iowrite32(cycles, chn->base_addr + chn_id_offset(chn->id) + CHN_DEADLINE_REG);
+	return count;
+}
+DEVICE_ATTR_RW(deadline_cycles);
+
+// The reservation can only be changed while the channel is closed.
+static ssize_t min_buffers_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", chn->min_buffers);
+}
+
+static ssize_t min_buffers_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	u32 buffers;
+
+	if(kstrtou32(buf, 0, &buffers) || !buffers || buffers > chn->max_buffers) {
+		return -EINVAL;
+	}
+	if(atomic_read(&chn->open_count)) {
+		return -EBUSY;
+	}
+	chn->min_buffers = buffers;
+	return count;
+}
+DEVICE_ATTR_RW(min_buffers);
+
+static ssize_t max_buffers_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", chn->max_buffers);
+}
+
+static ssize_t max_buffers_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	u32 buffers;
+
+	if(kstrtou32(buf, 0, &buffers) || buffers < chn->min_buffers || buffers > U8_MAX) {
+		return -EINVAL;
+	}
+	chn->max_buffers = buffers;
+	return count;
+}
+DEVICE_ATTR_RW(max_buffers);
+
+static ssize_t timeout_ms_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", chn->timeout_ms);
+}
+
+static ssize_t timeout_ms_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	u32 timeout_ms;
+
+	if(kstrtou32(buf, 0, &timeout_ms)) {
+		return -EINVAL;
+	}
+	chn->timeout_ms = timeout_ms;
+	return count;
+}
+DEVICE_ATTR_RW(timeout_ms);
+
+static ssize_t read_watermark_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", chn->read_watermark);
+}
+
+static ssize_t read_watermark_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	u32 watermark;
+
+	if(kstrtou32(buf, 0, &watermark)) {
+		return -EINVAL;
+	}
+	chn->read_watermark = watermark;
+	wake_up_interruptible(&chn->waitq);
+	return count;
+}
+DEVICE_ATTR_RW(read_watermark);
+
+static ssize_t write_watermark_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", chn->write_watermark);
+}
+
+static ssize_t write_watermark_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	u32 watermark;
+
+	if(kstrtou32(buf, 0, &watermark)) {
+		return -EINVAL;
+	}
+	chn->write_watermark = watermark;
+	wake_up_interruptible(&chn->waitq);
+	return count;
+}
+DEVICE_ATTR_RW(write_watermark);
+
+static ssize_t busy_poll_us_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct channel *chn = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", chn->busy_poll_us);
+}
+
+static ssize_t busy_poll_us_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct channel *chn = dev_get_drvdata(dev);
+	u32 busy_poll_us;
+
+	if(kstrtou32(buf, 0, &busy_poll_us)) {
+		return -EINVAL;
+	}
+	chn->busy_poll_us = busy_poll_us;
+	return count;
+}
+DEVICE_ATTR_RW(busy_poll_us);
+
 int chn_devices_init(struct pcie_endpoint *ep) {
 	int ret = 0;
 	dev_t devt;
@@ -427,6 +899,12 @@ int chn_devices_init(struct pcie_endpoint *ep) {
 			goto destroy;
 		}
 
+		ret = device_create_file(dev, &dev_attr_queue_depth);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create queue_depth attribute for channel device");
+			goto destroy;
+		}
+
 		ret = device_create_file(dev, &dev_attr_serviced_bufs);
 		if(ret) {
 			dev_err(chn->dev, "Failed to create serived_bufs attribute for channel device");
@@ -445,6 +923,90 @@ int chn_devices_init(struct pcie_endpoint *ep) {
 			goto destroy;
 		}
 
+		ret = device_create_file(dev, &dev_attr_timestamps);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create timestamps attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_crc);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create crc attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_qos);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create qos attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_tlp_attr);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create tlp_attr attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_max_tlp_bytes);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create max_tlp_bytes attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_deadline_cycles);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create deadline_cycles attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_min_buffers);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create min_buffers attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_max_buffers);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create max_buffers attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_timeout_ms);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create timeout_ms attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_read_watermark);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create read_watermark attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_write_watermark);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create write_watermark attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_busy_poll_us);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create busy_poll_us attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_interrupts);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create interrupts attribute for channel device");
+			goto destroy;
+		}
+
+		ret = device_create_file(dev, &dev_attr_submitted_bufs);
+		if(ret) {
+			dev_err(chn->dev, "Failed to create submitted_bufs attribute for channel device");
+			goto destroy;
+		}
+
 
 	}
 
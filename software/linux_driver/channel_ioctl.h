@@ -0,0 +1,76 @@
+// ioctl definitions for data channel devices
+
+#ifndef _VCL_CHANNEL_IOCTL_H_
+#define _VCL_CHANNEL_IOCTL_H_
+
+#include <linux/ioctl.h>
+
+// Metadata of one completed buffer.
+//
+// The hw_* fields hold the lower 32 bit of the endpoint cycle counter
+// (250MHz) and are only filled in if the `timestamps` sysfs attribute
+// of the channel is set, since reading them costs three additional
+// register reads per interrupt.
+// The *_ns fields are host timestamps taken with ktime_get_ns().
+// `crc` is the CRC32C of the buffer's data computed by the channel,
+// it is 0 unless the `crc` sysfs attribute of the channel is set.
+struct vcl_completion {
+	unsigned int transaction_id;
+	unsigned int bytes;
+
+	unsigned int hw_doorbell;
+	unsigned int hw_first_tlp;
+	unsigned int hw_last_tlp;
+	unsigned int crc;
+
+	unsigned long long submit_ns;
+	unsigned long long irq_ns;
+	unsigned long long consumed_ns;
+};
+
+// Result of aborting a channel.
+// `bytes` is the number the hardware transferred of the buffers in flight
+// when the channel was aborted, `buffers` the number of buffers the abort
+// returned to the driver (in flight, waiting or holding unread data).
+struct vcl_abort {
+	unsigned long long bytes;
+	unsigned int buffers;
+};
+
+// Waiting behaviour of a channel, also available as sysfs attributes.
+// `timeout_ms` bounds how long a blocking read or write waits for a buffer
+// before it returns -EAGAIN, 0 waits without limit. poll reports a tx
+// channel readable once `read_watermark` bytes are received and a rx
+// channel writable once buffers for `write_watermark` bytes are free, or
+// either as soon as the hardware has no buffer left.
+struct vcl_wait {
+	unsigned int timeout_ms;
+	unsigned int read_watermark;
+	unsigned int write_watermark;
+};
+
+#define VCL_CHN_IOCTL_BASE 0xFE
+
+// Pop the oldest completion record of the channel.
+// Returns -EAGAIN if no record is available.
+#define VCL_CHN_IOCTL_GET_COMPLETION _IOR(VCL_CHN_IOCTL_BASE, 0, struct vcl_completion *)
+
+// Stop the channel's transfers and return all buffers to the idle list,
+// without affecting other channels. Data not read yet is dropped.
+// Returns -EOPNOTSUPP for hardware without the abort register and
+// -ETIMEDOUT if the requests in progress don't complete.
+#define VCL_CHN_IOCTL_ABORT _IOR(VCL_CHN_IOCTL_BASE, 1, struct vcl_abort *)
+
+// Read and change the waiting behaviour, it applies to all users of the
+// channel.
+#define VCL_CHN_IOCTL_GET_WAIT _IOR(VCL_CHN_IOCTL_BASE, 2, struct vcl_wait *)
+#define VCL_CHN_IOCTL_SET_WAIT _IOW(VCL_CHN_IOCTL_BASE, 3, struct vcl_wait *)
+
+// Read and change the busy-poll budget in microseconds, also available as
+// the sysfs attribute `busy_poll_us`. A blocking read or write spins on
+// the channel's completions for up to this long before it sleeps, 0 sleeps
+// right away.
+#define VCL_CHN_IOCTL_GET_BUSY_POLL _IOR(VCL_CHN_IOCTL_BASE, 4, unsigned int *)
+#define VCL_CHN_IOCTL_SET_BUSY_POLL _IOW(VCL_CHN_IOCTL_BASE, 5, unsigned int *)
+
+#endif
@@ -11,6 +11,11 @@
 
 #define register_offset(id, offs) ((id & 0xFF) << 6) + ((offs & 0xF) << 2)
 
+// registers of FPGA tx channels for multicast, see tx_cfg_ctrl.vhd
+#define FPGA_TX_PEERS_REG (5 << 2)
+#define FPGA_TX_PEER_SEL_REG (6 << 2)
+#define fpga_tx_credit_reg(peer) ((8 + (peer)) << 2)
+
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(5,0,0)
 #define VCL_WRITE_ACCESS_OK(Addr, Size) access_ok(VERIFY_WRITE, Addr, Size)
 #else
@@ -32,6 +37,35 @@ static struct file_operations mmio_ops = {
 };
 
 
+// Buffers the channels of the endpoint may borrow beyond their reservation.
+static ssize_t shared_buffers_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct pcie_endpoint *ep = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", ep->pool.shared);
+}
+
+static ssize_t shared_buffers_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct pcie_endpoint *ep = dev_get_drvdata(dev);
+	unsigned long flags;
+	u32 shared;
+
+	if(kstrtou32(buf, 0, &shared)) {
+		return -EINVAL;
+	}
+
+	spin_lock_irqsave(&ep->pool.lock, flags);
+	ep->pool.shared = shared;
+	spin_unlock_irqrestore(&ep->pool.lock, flags);
+	return count;
+}
+DEVICE_ATTR_RW(shared_buffers);
+
+// Buffers allocated for the channels, including the ones kept for reuse.
+static ssize_t pool_buffers_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct pcie_endpoint *ep = dev_get_drvdata(dev);
+	return snprintf(buf, PAGE_SIZE, "%u\n", ep->pool.allocated);
+}
+DEVICE_ATTR_RO(pool_buffers);
+
 int mmio_device_init(struct pcie_endpoint *ep) {
 	int ret = 0;
 	dev_t devt;
@@ -54,14 +88,26 @@ int mmio_device_init(struct pcie_endpoint *ep) {
 	}
 
 	sprintf(name, "vcl_%d", ep->id);
-	dev = device_create(vcl_endpoint_class, ep->dev, devt, NULL, name);
+	dev = device_create(vcl_endpoint_class, ep->dev, devt, ep, name);
 	if(IS_ERR(dev)) {
 		ret = PTR_ERR(dev);
 		goto del;
 	}
 
+	ret = device_create_file(dev, &dev_attr_shared_buffers);
+	if(ret) {
+		goto destroy;
+	}
+
+	ret = device_create_file(dev, &dev_attr_pool_buffers);
+	if(ret) {
+		goto destroy;
+	}
+
 	goto done;
 
+destroy:
+	device_destroy(vcl_endpoint_class, devt);
 del:
 	cdev_del(&ep->mmio_cdev);
 unregister:
@@ -105,6 +151,9 @@ static long ioctl(struct file *filp, unsigned int cmd, unsigned long params) {
 	struct pcie_endpoint *ep = filp->private_data;
 	struct vcl_register reg;
 	struct pair_info loc;
+	struct multicast_info mcast;
+	struct multicast_peer_info peer;
+	unsigned int i;
 
 	switch(cmd) {
 	case VCL_MMIO_IOCTL_GETBAR:
@@ -125,9 +174,9 @@ static long ioctl(struct file *filp, unsigned int cmd, unsigned long params) {
 			return -EFAULT;
 		}
 
-		iowrite32((u32)(loc.other_bar + register_offset(loc.other_id, CHN_DATA_REG)),
-			ep->base_addr + register_offset(loc.this_id, CHN_ADDR_LO_REG));
-		iowrite32((u32)1, ep->base_addr + register_offset(loc.this_id, CHN_MODE_REG));
+		iowrite32((u32)(loc.other_bar + chn_id_offset(loc.other_id) + CHN_DATA_REG),
+			ep->base_addr + chn_id_offset(loc.this_id) + CHN_ADDR_LO_REG);
+		iowrite32((u32)1, ep->base_addr + chn_id_offset(loc.this_id) + CHN_MODE_REG);
 
 
 		break;
@@ -138,9 +187,43 @@ static long ioctl(struct file *filp, unsigned int cmd, unsigned long params) {
 			return -EFAULT;
 		}
 
-		iowrite32((u32)(loc.other_bar + register_offset(loc.other_id, CHN_SIZE_REG)),
-			ep->base_addr + register_offset(loc.this_id, CHN_ADDR_LO_REG));
-		iowrite32((u32)1, ep->base_addr + register_offset(loc.this_id, CHN_MODE_REG));
+		iowrite32((u32)(loc.other_bar + chn_id_offset(loc.other_id) + CHN_SIZE_REG),
+			ep->base_addr + chn_id_offset(loc.this_id) + CHN_ADDR_LO_REG);
+		iowrite32((u32)1, ep->base_addr + chn_id_offset(loc.this_id) + CHN_MODE_REG);
+
+		break;
+	case VCL_MMIO_IOCTL_MULTICAST_TX:
+		if(copy_from_user(&mcast, (struct multicast_info __user *)params, sizeof(mcast))) {
+			dev_err(ep->dev, "Failed to copy multicast data from user.");
+			return -EFAULT;
+		}
+		if(mcast.peers < 1 || mcast.peers > VCL_MAX_PEERS) {
+			return -EINVAL;
+		}
+
+		// the peer count resets the credits, the addresses come first
+		for(i = 0; i < mcast.peers; i++) {
+			iowrite32(i, ep->base_addr + chn_id_offset(mcast.this_id) + FPGA_TX_PEER_SEL_REG);
+			iowrite32((u32)(mcast.other_bar[i] + chn_id_offset(mcast.other_id[i]) + CHN_DATA_REG),
+				ep->base_addr + chn_id_offset(mcast.this_id) + CHN_ADDR_LO_REG);
+		}
+		iowrite32(0, ep->base_addr + chn_id_offset(mcast.this_id) + FPGA_TX_PEER_SEL_REG);
+		iowrite32(mcast.peers, ep->base_addr + chn_id_offset(mcast.this_id) + FPGA_TX_PEERS_REG);
+		iowrite32((u32)1, ep->base_addr + chn_id_offset(mcast.this_id) + CHN_MODE_REG);
+
+		break;
+	case VCL_MMIO_IOCTL_MULTICAST_RX:
+		if(copy_from_user(&peer, (struct multicast_peer_info __user *)params, sizeof(peer))) {
+			dev_err(ep->dev, "Failed to copy multicast peer data from user.");
+			return -EFAULT;
+		}
+		if(peer.peer >= VCL_MAX_PEERS) {
+			return -EINVAL;
+		}
+
+		iowrite32((u32)(peer.pair.other_bar + chn_id_offset(peer.pair.other_id) + fpga_tx_credit_reg(peer.peer)),
+			ep->base_addr + chn_id_offset(peer.pair.this_id) + CHN_ADDR_LO_REG);
+		iowrite32((u32)1, ep->base_addr + chn_id_offset(peer.pair.this_id) + CHN_MODE_REG);
 
 		break;
 	case VCL_MMIO_IOCTL_RDREG:
@@ -12,6 +12,22 @@ struct pair_info {
 	unsigned int this_id;
 };
 
+// Peers of a multicasting FPGA tx channel, peer i is paired like with
+// VCL_MMIO_IOCTL_PAIR_TX to other_bar[i]/other_id[i].
+#define VCL_MAX_PEERS 8
+struct multicast_info {
+	unsigned long long other_bar[VCL_MAX_PEERS];
+	unsigned int other_id[VCL_MAX_PEERS];
+	unsigned int this_id;
+	unsigned int peers;
+};
+
+// An FPGA rx channel as peer `peer` of a multicasting tx channel.
+struct multicast_peer_info {
+	struct pair_info pair;
+	unsigned int peer;
+};
+
 struct vcl_register {
 	unsigned int chn_id;
 	unsigned int offset;
@@ -25,5 +41,7 @@ struct vcl_register {
 #define VCL_MMIO_IOCTL_PAIR_RX   _IOW(VCL_MMIO_IOCTL_BASE, 2, struct channel_location *)
 #define VCL_MMIO_IOCTL_RDREG _IOWR(VCL_MMIO_IOCTL_BASE, 3, struct vcl_register *)
 #define VCL_MMIO_IOCTL_WRREG _IOW(VCL_MMIO_IOCTL_BASE, 4, struct vcl_register *)
+#define VCL_MMIO_IOCTL_MULTICAST_TX _IOW(VCL_MMIO_IOCTL_BASE, 5, struct multicast_info *)
+#define VCL_MMIO_IOCTL_MULTICAST_RX _IOW(VCL_MMIO_IOCTL_BASE, 6, struct multicast_peer_info *)
 
 #endif
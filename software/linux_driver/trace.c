@@ -0,0 +1,135 @@
+// debugfs access to the TLP trace buffer of an endpoint
+//
+// /sys/kernel/debug/vercolib_pcie/vcl_<i>/ holds the raw trace registers
+// and the file trace, which stops the recording when it is opened and
+// reads a dump of all recorded entries:
+//   16 byte header: the magic "VCLT", the status of TRACE_CTRL, the number
+//   of entries and a reserved zero DWord
+//   entries: four little endian DWords each, see tlp_trace.vhd
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/vmalloc.h>
+
+#include "vercolib_pcie.h"
+
+#define TRACE_CTRL_STOP (1 << 1)
+#define trace_depth_log2(status) (((status) >> 8) & 0x1F)
+#define trace_entries(status) ((status) >> 16)
+
+static struct dentry *trace_root;
+
+struct trace_dump {
+	size_t size;
+	u32 data[];
+};
+
+static int trace_open(struct inode *inode, struct file *filp) {
+	struct pcie_endpoint *ep = inode->i_private;
+	struct trace_dump *dump;
+	u32 status, entries, idx;
+
+	mutex_lock(&ep->trace_lock);
+
+	status = ioread32(ep->base_addr + CFG_TRACE_CTRL_REG);
+	if(!trace_depth_log2(status)) {
+		mutex_unlock(&ep->trace_lock);
+		return -ENODEV;
+	}
+
+	// stopping resets the read position to the oldest entry
+	iowrite32(TRACE_CTRL_STOP, ep->base_addr + CFG_TRACE_CTRL_REG);
+	status = ioread32(ep->base_addr + CFG_TRACE_CTRL_REG);
+	entries = trace_entries(status);
+
+	dump = vmalloc(sizeof(*dump) + (4 + 4*entries) * sizeof(u32));
+	if(!dump) {
+		mutex_unlock(&ep->trace_lock);
+		return -ENOMEM;
+	}
+
+	dump->size = (4 + 4*entries) * sizeof(u32);
+	dump->data[0] = cpu_to_le32(0x544C4356);
+	dump->data[1] = cpu_to_le32(status);
+	dump->data[2] = cpu_to_le32(entries);
+	dump->data[3] = 0;
+	for(idx = 0; idx < 4*entries; ++idx) {
+		dump->data[4 + idx] = cpu_to_le32(ioread32(ep->base_addr + CFG_TRACE_DATA_REG));
+	}
+
+	mutex_unlock(&ep->trace_lock);
+
+	filp->private_data = dump;
+	return 0;
+}
+
+static ssize_t trace_read(struct file *filp, char __user *buf, size_t count, loff_t *pos) {
+	struct trace_dump *dump = filp->private_data;
+	return simple_read_from_buffer(buf, count, pos, dump->data, dump->size);
+}
+
+static int trace_release(struct inode *inode, struct file *filp) {
+	vfree(filp->private_data);
+	return 0;
+}
+
+static const struct file_operations trace_ops = {
+	.owner = THIS_MODULE,
+	.open = trace_open,
+	.read = trace_read,
+	.release = trace_release,
+	.llseek = default_llseek,
+};
+
+
+// The raw registers, see cfg_channel_types.vhd for their layout.
+#define TRACE_REGISTER_ATTR(name, reg)                                        \
+static int name##_get(void *data, u64 *val) {                                 \
+	struct pcie_endpoint *ep = data;                                      \
+	*val = ioread32(ep->base_addr + reg);                                 \
+	return 0;                                                             \
+}                                                                             \
+static int name##_set(void *data, u64 val) {                                  \
+	struct pcie_endpoint *ep = data;                                      \
+	mutex_lock(&ep->trace_lock);                                          \
+	iowrite32((u32)val, ep->base_addr + reg);                             \
+	mutex_unlock(&ep->trace_lock);                                        \
+	return 0;                                                             \
+}                                                                             \
+DEFINE_DEBUGFS_ATTRIBUTE(name##_fops, name##_get, name##_set, "0x%08llx\n")
+
+TRACE_REGISTER_ATTR(trace_ctrl, CFG_TRACE_CTRL_REG);
+TRACE_REGISTER_ATTR(trace_filter, CFG_TRACE_FILTER_REG);
+TRACE_REGISTER_ATTR(trace_trigger, CFG_TRACE_TRIGGER_REG);
+
+void trace_init(struct pcie_endpoint *ep) {
+	char name[32] = {0};
+
+	mutex_init(&ep->trace_lock);
+	ep->trace_dir = NULL;
+	if(IS_ERR_OR_NULL(trace_root)) {
+		return;
+	}
+
+	// debugfs is optional, failures only leave the files out
+	sprintf(name, "vcl_%d", ep->id);
+	ep->trace_dir = debugfs_create_dir(name, trace_root);
+	debugfs_create_file("trace", 0400, ep->trace_dir, ep, &trace_ops);
+	debugfs_create_file_unsafe("trace_ctrl", 0600, ep->trace_dir, ep, &trace_ctrl_fops);
+	debugfs_create_file_unsafe("trace_filter", 0600, ep->trace_dir, ep, &trace_filter_fops);
+	debugfs_create_file_unsafe("trace_trigger", 0600, ep->trace_dir, ep, &trace_trigger_fops);
+}
+
+void trace_cleanup(struct pcie_endpoint *ep) {
+	debugfs_remove_recursive(ep->trace_dir);
+	ep->trace_dir = NULL;
+}
+
+void trace_debugfs_init(void) {
+	trace_root = debugfs_create_dir(driver_name, NULL);
+}
+
+void trace_debugfs_cleanup(void) {
+	debugfs_remove_recursive(trace_root);
+	trace_root = NULL;
+}
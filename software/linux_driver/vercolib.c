@@ -3,6 +3,7 @@
 
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/pci.h>
 
 #include "vercolib_pcie.h"
@@ -20,6 +21,10 @@ struct class *vcl_endpoint_class = NULL;
 
 static atomic_t ep_id = ATOMIC_INIT(0);
 
+// All probed endpoints, for devices using channels of several endpoints.
+static LIST_HEAD(endpoints);
+static DEFINE_MUTEX(endpoints_lock);
+
 static const struct pci_device_id pcie_ids[] = {
 	{PCI_DEVICE(PCI_VENDOR_ID_XILINX, 0x0007)},
 	{PCI_DEVICE(PCI_VENDOR_ID_XILINX, 0x7028)},
@@ -81,6 +86,13 @@ static int pcie_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		return -ENODEV;
 	}
 
+	// The hardware is synthesized for a maximum packet size, the channels
+	// use the sizes the host configured for the device.
+	ep->max_payload = pcie_get_mps(pdev);
+	ep->max_read_request = pcie_get_readrq(pdev);
+	dev_info(&pdev->dev, "MaxPayload %u bytes, MaxReadReq %u bytes",
+		ep->max_payload, ep->max_read_request);
+
 	nvec = int_cnt(ep->channel_info);
 
 	nvec = pci_alloc_irq_vectors(
@@ -98,6 +110,8 @@ static int pcie_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		return ret;
 	}
 
+	buffer_pool_init(&ep->pool);
+
 	ret = channels_init(ep);
 	if(ret) {
 		dev_err(&pdev->dev, "Failed to initialise channels.");
@@ -127,8 +141,14 @@ static int pcie_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		return ret;
 	}
 
+	trace_init(ep);
+
 	pci_set_drvdata(pdev, ep);
 
+	mutex_lock(&endpoints_lock);
+	list_add_tail(&ep->list, &endpoints);
+	mutex_unlock(&endpoints_lock);
+
 
 	pci_set_master(pdev);
 
@@ -142,8 +162,39 @@ static void pcie_remove(struct pci_dev *pdev)
 	struct pcie_endpoint *ep;
 	ep = pci_get_drvdata(pdev);
 
+	mutex_lock(&endpoints_lock);
+	list_del(&ep->list);
+	mutex_unlock(&endpoints_lock);
+
+	trace_cleanup(ep);
 	chn_devices_cleanup(ep);
 	mmio_device_cleanup(ep);
+	buffer_pool_cleanup(ep);
+}
+
+struct pcie_endpoint *find_endpoint(u32 id) {
+	struct pcie_endpoint *ep, *found = NULL;
+
+	mutex_lock(&endpoints_lock);
+	list_for_each_entry(ep, &endpoints, list) {
+		if(ep->id == id) {
+			found = ep;
+			break;
+		}
+	}
+	mutex_unlock(&endpoints_lock);
+	return found;
+}
+
+struct channel *find_channel(struct pcie_endpoint *ep, u32 id) {
+	size_t idx;
+
+	for(idx = 0; idx < ep->channel_cnt; ++idx) {
+		if(ep->channels[idx]->id == id) {
+			return ep->channels[idx];
+		}
+	}
+	return NULL;
 }
 
 static struct pci_driver pcie_driver = {
@@ -171,8 +222,28 @@ static int __init vercolib_pcie_init(void)
 		return err;
 	}
 
+	err = bond_device_init();
+	if(err < 0) {
+		class_destroy(vcl_channel_class);
+		class_destroy(vcl_endpoint_class);
+		return err;
+	}
+
+	err = vstream_device_init();
+	if(err < 0) {
+		bond_device_cleanup();
+		class_destroy(vcl_channel_class);
+		class_destroy(vcl_endpoint_class);
+		return err;
+	}
+
+	trace_debugfs_init();
+
 	err = pci_register_driver(&pcie_driver);
 	if(err < 0) {
+		trace_debugfs_cleanup();
+		vstream_device_cleanup();
+		bond_device_cleanup();
 		class_destroy(vcl_channel_class);
 		class_destroy(vcl_endpoint_class);
 		return err;
@@ -183,6 +254,9 @@ static int __init vercolib_pcie_init(void)
 static void __exit vercolib_pcie_exit(void)
 {
 	pci_unregister_driver(&pcie_driver);
+	trace_debugfs_cleanup();
+	vstream_device_cleanup();
+	bond_device_cleanup();
 	class_destroy(vcl_channel_class);
 	class_destroy(vcl_endpoint_class);
 }
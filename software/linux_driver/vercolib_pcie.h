@@ -11,8 +11,12 @@
 #include <linux/spinlock.h>
 #include <linux/cdev.h>
 #include <linux/dma-mapping.h>
+#include <linux/kfifo.h>
+#include <linux/mutex.h>
 #include <asm/atomic.h>
 
+#include "channel_ioctl.h"
+
 #define DBG_OUTPUT 1
 
 #ifdef DBG_OUTPUT
@@ -36,6 +40,8 @@ struct buffer {
 	u32 init_size;
 	void *ptr;
 	dma_addr_t dma_addr;
+
+	struct vcl_completion meta;
 };
 
 enum channel_register_offsets {
@@ -45,9 +51,56 @@ enum channel_register_offsets {
 	CHN_MODE_REG = (3 << 2),
 	CHN_TRNS_REG = (4 << 2),
 	CHN_INFO_REG = (5 << 2),
+	CHN_TS_DOORBELL_REG = (6 << 2),
+	CHN_TS_FIRST_TLP_REG = (7 << 2),
+	CHN_TS_LAST_TLP_REG = (8 << 2),
+	CHN_TLP_ATTR_REG = (9 << 2),
+	CHN_MAX_TLP_REG = (10 << 2),
+	CHN_CRC_REG = (11 << 2),
+	CHN_QUEUE_REG = (12 << 2),
+	CHN_ABORT_REG = (13 << 2),
+	CHN_DEADLINE_REG = (14 << 2),
 	CHN_DATA_REG = (15 << 2),
 };
 
+// Registers of the config channel (id 0)
+#define chn_id_offset(id) (id << 6)
+
+// Layout of CHN_TLP_ATTR_REG
+#define TLP_ATTR_NO_SNOOP (1 << 0)
+#define TLP_ATTR_RELAXED_ORDERING (1 << 1)
+#define TLP_ATTR_TPH (1 << 4)
+#define TLP_ATTR_PH(ph) (((ph) & 0x3) << 8)
+#define TLP_ATTR_ST(st) (((st) & 0xff) << 16)
+#define TLP_ATTR_MASK (0x00ff0313)
+
+enum config_register_offsets {
+	CFG_TRACE_CTRL_REG = (0 << 2),
+	CFG_TRACE_FILTER_REG = (1 << 2),
+	CFG_TRACE_TRIGGER_REG = (2 << 2),
+	CFG_TRAFFIC_CTRL_REG = (3 << 2),
+	CFG_TRACE_DATA_REG = (4 << 2),
+	CFG_TRAFFIC_DWORDS_REG = (5 << 2),
+	CFG_TRAFFIC_ERRORS_REG = (6 << 2),
+	CFG_QOS_SELECT_REG = (13 << 2),
+	CFG_QOS_CONFIG_REG = (14 << 2),
+	CFG_QOS_CTRL_REG = (15 << 2),
+};
+
+// Buffers of all host channels of an endpoint, see buffer_pool.c
+struct buffer_pool {
+	spinlock_t lock;
+	struct list_head free_buffers;
+	u32 num_free;
+
+	// buffers allocated, including the free ones
+	u32 allocated;
+	// buffers channels hold beyond their reservation, at most shared
+	u32 lent;
+	u32 shared;
+	u8 next_id;
+};
+
 struct channel {
 	struct device *dev;
 	enum dma_data_direction direction;
@@ -65,17 +118,60 @@ struct channel {
 	u8 num_active_buffers;
 	u8 num_serviced_buffers;
 
+	// Buffers the channel holds, changed with the pool lock. While the
+	// channel is open min_buffers of them are reserved, up to max_buffers
+	// are borrowed from the shared ones of the pool.
+	struct buffer_pool *pool;
+	u32 num_buffers;
+	u32 min_buffers;
+	u32 max_buffers;
+	bool reserved;
+
+	// buffers handed to the hardware, at most queue_depth
+	u8 num_in_flight;
+	u8 queue_depth;
+	bool can_abort;
+	bool has_deadline;
+
 	u32 id;
 	u32 transaction_id;
 	atomic_t open_count;
+
+	bool timestamps;
+	bool crc;
+	u32 tlp_attr;
+	u32 max_tlp_bytes;
+	// Cycles a FPGA-Host buffer with data waits for more before it
+	// completes, 0 waits until it is full or the user logic ends it.
+	u32 deadline_cycles;
+
+	// Longest wait of a blocking read/write in ms, 0 waits forever.
+	u32 timeout_ms;
+	// Bytes which have to be readable/writable before poll reports the
+	// channel ready, 0 reports it with the first buffer.
+	u32 read_watermark;
+	u32 write_watermark;
+	// Longest spin on the completions before a blocking call sleeps, in us.
+	u32 busy_poll_us;
+
+	// Interrupts handled and buffers handed to the hardware since the
+	// driver was loaded, changed with the channel lock.
+	u64 interrupts;
+	u64 submitted_bufs;
+	DECLARE_KFIFO(completions, struct vcl_completion, 64);
 };
 
 struct pcie_endpoint {
 	struct device *dev;
+	struct list_head list;
 
 	u32 id;
 	u32 channel_info;
 
+	// negotiated in DevCtl, in bytes
+	u32 max_payload;
+	u32 max_read_request;
+
 	__iomem void *base_addr;
 	unsigned long long bar;
 
@@ -85,6 +181,12 @@ struct pcie_endpoint {
 	struct cdev channel_cdev;
 	struct channel **channels;
 	size_t channel_cnt;
+
+	struct buffer_pool pool;
+
+	// debugfs files of the TLP trace buffer, see trace.c
+	struct dentry *trace_dir;
+	struct mutex trace_lock;
 };
 
 int mmio_device_init(struct pcie_endpoint *);
@@ -104,10 +206,48 @@ void add_serviced_buffer(struct channel *, struct buffer *);
 bool has_serviced_buffer(struct channel *);
 struct buffer *remove_serviced_buffer(struct channel *);
 
-void write_buffer_info(struct channel *, struct buffer *);
+u32 readable_bytes(struct channel *);
+u32 writable_bytes(struct channel *);
+
+void buffer_pool_init(struct buffer_pool *);
+void buffer_pool_cleanup(struct pcie_endpoint *);
+int reserve_buffers(struct channel *);
+void release_buffers(struct channel *);
+struct buffer *borrow_buffer(struct channel *);
+bool return_buffer(struct channel *, struct buffer *);
+bool has_lent_buffer(struct channel *);
+u32 borrowable_buffers(struct channel *);
+u32 buffer_bytes(void);
+struct buffer *get_idle_buffer(struct channel *);
+
+void write_channel_config(struct channel *);
+void submit_active_buffers(struct channel *);
+bool poll_channel(struct channel *);
+void complete_buffer(struct channel *, struct buffer *);
+int abort_channel(struct channel *, struct vcl_abort *);
 
 
 int chn_devices_init(struct pcie_endpoint *);
 void chn_devices_cleanup(struct pcie_endpoint *);
 
+ssize_t request_idle_buffers(struct channel *, size_t);
+ssize_t channel_write(struct channel *, const char *, size_t, bool);
+ssize_t channel_read(struct channel *, char *, size_t, bool);
+ssize_t channel_write_kernel(struct channel *, const char *, size_t, bool);
+ssize_t channel_read_kernel(struct channel *, char *, size_t, bool);
+
+struct pcie_endpoint *find_endpoint(u32 id);
+struct channel *find_channel(struct pcie_endpoint *, u32 id);
+
+int bond_device_init(void);
+void bond_device_cleanup(void);
+
+int vstream_device_init(void);
+void vstream_device_cleanup(void);
+
+void trace_init(struct pcie_endpoint *);
+void trace_cleanup(struct pcie_endpoint *);
+void trace_debugfs_init(void);
+void trace_debugfs_cleanup(void);
+
 #endif
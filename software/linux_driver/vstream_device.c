@@ -0,0 +1,522 @@
+// Virtual stream device, many independent streams over one host channel
+//
+// Every open of /dev/vcl_vstream is attached to one stream with the ioctl
+// of vstream_ioctl.h. All streams of a channel share a hub which owns the
+// channel. The data travels in frames, a 16 byte header followed by the
+// payload padded to 16 bytes, see vstream_mux in pcie_utilities.vhd:
+//   DWord 0: stream id in bits 15:0, 0x5653 in bits 31:16
+//   DWord 1: payload bytes
+//   DWord 2, 3: zero
+//
+// A write is sent as one frame. For reading, the hub fills the queue of
+// every stream from the channel whenever a reader finds its own queue
+// empty. The frames arrive in order, so a stream whose queue is full
+// stalls all others until it is read.
+
+#include <linux/fs.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/poll.h>
+
+#include "vercolib_pcie.h"
+#include "vstream_ioctl.h"
+
+#define FRAME_MAGIC 0x5653
+#define FRAME_HEADER 16
+#define BOUNCE_SIZE (64 << 10)
+#define QUEUE_SIZE (256 << 10)
+
+struct vstream_hub {
+	struct list_head list;
+	struct channel *chn;
+	unsigned int refs;
+
+	// held while the channel or the frame state is used
+	struct mutex lock;
+	struct list_head streams;
+	char *bounce;
+
+	// received bytes not yet moved to the queues
+	u32 head;
+	u32 len;
+
+	// frame being split, cur is NULL for frames which are dropped
+	u8 header[FRAME_HEADER];
+	u32 header_bytes;
+	struct vstream *cur;
+	u32 left;
+	u32 pad;
+
+	// the queue of cur is full, woken when a stream was read
+	bool stalled;
+	wait_queue_head_t waitq;
+};
+
+struct vstream {
+	struct list_head list;
+	struct vstream_hub *hub;
+	u16 id;
+
+	// held by the reader, the hub only adds to the queue
+	struct mutex lock;
+	DECLARE_KFIFO_PTR(queue, u8);
+};
+
+static LIST_HEAD(hubs);
+static DEFINE_MUTEX(hubs_lock);
+
+static int open(struct inode *, struct file *);
+static int release(struct inode *, struct file *);
+
+static ssize_t write(struct file *, const char *, size_t, loff_t *);
+static ssize_t read(struct file *, char *, size_t, loff_t *);
+
+static unsigned int poll(struct file *, poll_table *);
+
+static long ioctl(struct file *, unsigned int, unsigned long);
+
+static struct file_operations vstream_ops = {
+	.owner = THIS_MODULE,
+	.llseek = no_llseek,
+	.open = open,
+	.release = release,
+	.write = write,
+	.read = read,
+	.poll = poll,
+	.unlocked_ioctl = ioctl,
+};
+
+static struct cdev vstream_cdev;
+
+static int open(struct inode *inode, struct file *filp) {
+	struct vstream *vs = kzalloc(sizeof(*vs), GFP_KERNEL);
+
+	if(!vs) {
+		return -ENOMEM;
+	}
+
+	mutex_init(&vs->lock);
+
+	filp->private_data = vs;
+	return nonseekable_open(inode, filp);
+}
+
+static void put_hub(struct vstream_hub *hub) {
+	if(--hub->refs) {
+		return;
+	}
+
+	release_buffers(hub->chn);
+	atomic_dec(&hub->chn->open_count);
+	list_del(&hub->list);
+	kfree(hub->bounce);
+	kfree(hub);
+}
+
+static int release(struct inode *inode, struct file *filp) {
+	struct vstream *vs = filp->private_data;
+	struct vstream_hub *hub = vs->hub;
+
+	if(hub) {
+		mutex_lock(&hubs_lock);
+		mutex_lock(&hub->lock);
+		list_del(&vs->list);
+		// the rest of a frame for this stream is dropped
+		if(hub->cur == vs) {
+			hub->cur = NULL;
+		}
+		hub->stalled = false;
+		wake_up_interruptible(&hub->waitq);
+		mutex_unlock(&hub->lock);
+		put_hub(hub);
+		mutex_unlock(&hubs_lock);
+	}
+
+	kfifo_free(&vs->queue);
+	kfree(vs);
+	return 0;
+}
+
+static ssize_t write(struct file *filp, const char *usr_ptr, size_t size, loff_t *offs) {
+	struct vstream *vs = filp->private_data;
+	struct vstream_hub *hub = vs->hub;
+	__le32 *header;
+	size_t len, frame;
+	ssize_t ret;
+
+	if(!hub || hub->chn->direction != DMA_TO_DEVICE) {
+		return -EINVAL;
+	}
+	if(!size) {
+		return 0;
+	}
+
+	// A frame fits into one channel buffer, so it is never split between
+	// writes of different streams. The rest of a larger write is left to
+	// the next call.
+	len = min_t(size_t, size, BOUNCE_SIZE - FRAME_HEADER);
+	frame = FRAME_HEADER + ALIGN(len, 16);
+
+	if(mutex_lock_interruptible(&hub->lock)) {
+		return -ERESTARTSYS;
+	}
+
+	header = (__le32 *)hub->bounce;
+	header[0] = cpu_to_le32((FRAME_MAGIC << 16) | vs->id);
+	header[1] = cpu_to_le32(len);
+	header[2] = 0;
+	header[3] = 0;
+	if(copy_from_user(hub->bounce + FRAME_HEADER, usr_ptr, len)) {
+		ret = -EFAULT;
+		goto unlock;
+	}
+	memset(hub->bounce + FRAME_HEADER + len, 0, frame - FRAME_HEADER - len);
+
+	ret = channel_write_kernel(hub->chn, hub->bounce, frame, filp->f_flags & O_NONBLOCK);
+	if(ret > 0) {
+		ret = len;
+	}
+
+unlock:
+	mutex_unlock(&hub->lock);
+	return ret;
+}
+
+static void start_frame(struct vstream_hub *hub) {
+	u32 dw0 = le32_to_cpup((__le32 *)hub->header);
+	u32 bytes = le32_to_cpup((__le32 *)(hub->header + 4));
+	struct vstream *vs;
+
+	hub->cur = NULL;
+	hub->left = 0;
+	hub->pad = 0;
+
+	// With a broken header the next 16 bytes are taken as a header, until
+	// the stream is in sync again.
+	if((dw0 >> 16) != FRAME_MAGIC) {
+		dev_warn_ratelimited(hub->chn->dev,
+			"Channel %u: Invalid virtual stream header %08x", hub->chn->id, dw0);
+		return;
+	}
+
+	hub->left = bytes;
+	hub->pad = ALIGN(bytes, 16) - bytes;
+	list_for_each_entry(vs, &hub->streams, list) {
+		if(vs->id == (dw0 & 0xFFFF)) {
+			hub->cur = vs;
+			break;
+		}
+	}
+}
+
+// Moves received frames to the queues of their streams, must be called
+// with the hub lock held. Returns the number of bytes consumed, it stops
+// early if the queue of the current frame's stream is full.
+static u32 demux(struct vstream_hub *hub) {
+	u32 consumed = 0, len, n;
+	char *src;
+
+	hub->stalled = false;
+	while(hub->head < hub->len) {
+		src = hub->bounce + hub->head;
+		len = hub->len - hub->head;
+
+		if(hub->header_bytes < FRAME_HEADER) {
+			n = min(len, FRAME_HEADER - hub->header_bytes);
+			memcpy(hub->header + hub->header_bytes, src, n);
+			hub->header_bytes += n;
+			if(hub->header_bytes == FRAME_HEADER) {
+				start_frame(hub);
+			}
+		} else if(hub->left) {
+			n = min(len, hub->left);
+			if(hub->cur) {
+				n = kfifo_in(&hub->cur->queue, (u8 *)src, n);
+				if(!n) {
+					hub->stalled = true;
+					break;
+				}
+			}
+			hub->left -= n;
+		} else {
+			n = min(len, hub->pad);
+			hub->pad -= n;
+		}
+
+		hub->head += n;
+		consumed += n;
+		if(hub->header_bytes == FRAME_HEADER && !hub->left && !hub->pad) {
+			hub->header_bytes = 0;
+		}
+	}
+	return consumed;
+}
+
+// Reads from the channel into the stream queues. Returns a positive value
+// if the queues may have changed.
+static ssize_t fill_queues(struct vstream_hub *hub, bool nonblock) {
+	ssize_t ret = 1;
+	bool stalled;
+
+	if(mutex_lock_interruptible(&hub->lock)) {
+		return -ERESTARTSYS;
+	}
+
+	// The channel is only read once the last data has been split up.
+	if(hub->head == hub->len) {
+		ret = channel_read_kernel(hub->chn, hub->bounce, BOUNCE_SIZE, nonblock);
+		if(ret <= 0) {
+			goto unlock;
+		}
+		hub->head = 0;
+		hub->len = ret;
+	}
+
+	stalled = !demux(hub) && hub->stalled;
+	mutex_unlock(&hub->lock);
+
+	if(stalled) {
+		if(nonblock) {
+			return -EAGAIN;
+		}
+		ret = wait_event_interruptible(hub->waitq, !READ_ONCE(hub->stalled));
+		return ret ? ret : 1;
+	}
+	return 1;
+
+unlock:
+	mutex_unlock(&hub->lock);
+	return ret;
+}
+
+static ssize_t read(struct file *filp, char *usr_ptr, size_t size, loff_t *offs) {
+	struct vstream *vs = filp->private_data;
+	struct vstream_hub *hub = vs->hub;
+	unsigned int copied;
+	ssize_t ret;
+
+	if(!hub || hub->chn->direction != DMA_FROM_DEVICE) {
+		return -EINVAL;
+	}
+
+	if(mutex_lock_interruptible(&vs->lock)) {
+		return -ERESTARTSYS;
+	}
+
+	while(kfifo_is_empty(&vs->queue)) {
+		ret = fill_queues(hub, filp->f_flags & O_NONBLOCK);
+		if(ret <= 0) {
+			goto unlock;
+		}
+	}
+
+	ret = kfifo_to_user(&vs->queue, usr_ptr, size, &copied);
+	if(!ret) {
+		ret = copied;
+	}
+
+	if(READ_ONCE(hub->stalled)) {
+		WRITE_ONCE(hub->stalled, false);
+		wake_up_interruptible(&hub->waitq);
+	}
+
+unlock:
+	mutex_unlock(&vs->lock);
+	return ret;
+}
+
+static unsigned int poll(struct file *filp, poll_table *wait) {
+	struct vstream *vs = filp->private_data;
+	struct vstream_hub *hub = vs->hub;
+	struct channel *chn;
+
+	if(!hub) {
+		return 0;
+	}
+
+	chn = hub->chn;
+	poll_wait(filp, &chn->waitq, wait);
+	poll_wait(filp, &hub->waitq, wait);
+
+	if(chn->direction == DMA_TO_DEVICE) {
+		if(has_idle_buffer(chn) || has_serviced_buffer(chn) || borrowable_buffers(chn)) {
+			return (POLLOUT | POLLWRNORM);
+		}
+		return 0;
+	}
+
+	// Received data may belong to any stream, a read returns -EAGAIN then
+	// with O_NONBLOCK.
+	if(!kfifo_is_empty(&vs->queue) || has_serviced_buffer(chn)) {
+		return (POLLIN | POLLRDNORM);
+	}
+	return 0;
+}
+
+static struct vstream_hub *get_hub(struct channel *chn) {
+	struct vstream_hub *hub;
+	int ret;
+
+	list_for_each_entry(hub, &hubs, list) {
+		if(hub->chn == chn) {
+			hub->refs += 1;
+			return hub;
+		}
+	}
+
+	hub = kzalloc(sizeof(*hub), GFP_KERNEL);
+	if(!hub) {
+		return ERR_PTR(-ENOMEM);
+	}
+	hub->bounce = kmalloc(BOUNCE_SIZE, GFP_KERNEL);
+	if(!hub->bounce) {
+		kfree(hub);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	if(atomic_cmpxchg(&chn->open_count, 0, 1)) {
+		dev_err(chn->dev, "Tried to share busy channel %u", chn->id);
+		ret = -EBUSY;
+		goto free;
+	}
+	ret = reserve_buffers(chn);
+	if(ret) {
+		atomic_dec(&chn->open_count);
+		goto free;
+	}
+	write_channel_config(chn);
+
+	hub->chn = chn;
+	hub->refs = 1;
+	mutex_init(&hub->lock);
+	INIT_LIST_HEAD(&hub->streams);
+	init_waitqueue_head(&hub->waitq);
+	list_add_tail(&hub->list, &hubs);
+	return hub;
+
+free:
+	kfree(hub->bounce);
+	kfree(hub);
+	return ERR_PTR(ret);
+}
+
+static long attach(struct vstream *vs, struct vcl_vstream_attach *req) {
+	struct pcie_endpoint *ep;
+	struct channel *chn;
+	struct vstream_hub *hub;
+	struct vstream *other;
+	long ret = 0;
+
+	if(vs->hub) {
+		return -EBUSY;
+	}
+	if(req->stream > VCL_VSTREAM_MAX_ID) {
+		return -EINVAL;
+	}
+
+	ep = find_endpoint(req->endpoint);
+	if(!ep) {
+		return -ENODEV;
+	}
+	chn = find_channel(ep, req->channel);
+	if(!chn) {
+		return -ENODEV;
+	}
+
+	if(chn->direction == DMA_FROM_DEVICE) {
+		ret = kfifo_alloc(&vs->queue, QUEUE_SIZE, GFP_KERNEL);
+		if(ret) {
+			return ret;
+		}
+	}
+
+	mutex_lock(&hubs_lock);
+	hub = get_hub(chn);
+	if(IS_ERR(hub)) {
+		ret = PTR_ERR(hub);
+		goto unlock;
+	}
+
+	mutex_lock(&hub->lock);
+	list_for_each_entry(other, &hub->streams, list) {
+		if(other->id == req->stream) {
+			ret = -EBUSY;
+			break;
+		}
+	}
+	if(!ret) {
+		vs->id = req->stream;
+		vs->hub = hub;
+		list_add_tail(&vs->list, &hub->streams);
+	}
+	mutex_unlock(&hub->lock);
+
+	if(ret) {
+		put_hub(hub);
+	}
+
+unlock:
+	mutex_unlock(&hubs_lock);
+	if(ret) {
+		kfifo_free(&vs->queue);
+	}
+	return ret;
+}
+
+static long ioctl(struct file *filp, unsigned int cmd, unsigned long params) {
+	struct vstream *vs = filp->private_data;
+	struct vcl_vstream_attach req;
+
+	switch(cmd) {
+	case VCL_VSTREAM_IOCTL_ATTACH:
+		if(copy_from_user(&req, (struct vcl_vstream_attach __user *)params, sizeof(req))) {
+			return -EFAULT;
+		}
+		return attach(vs, &req);
+	default:
+		return -ENOTTY;
+	}
+}
+
+int vstream_device_init(void) {
+	int ret = 0;
+	dev_t devt;
+	struct device *dev;
+
+	ret = alloc_chrdev_region(&devt, 0, 1, "vercolib_pcie_vstream");
+	if(ret < 0) {
+		goto done;
+	}
+
+	cdev_init(&vstream_cdev, &vstream_ops);
+	vstream_cdev.owner = THIS_MODULE;
+
+	ret = cdev_add(&vstream_cdev, devt, 1);
+	if(ret) {
+		goto unregister;
+	}
+
+	dev = device_create(vcl_channel_class, NULL, devt, NULL, "vcl_vstream");
+	if(IS_ERR(dev)) {
+		ret = PTR_ERR(dev);
+		goto del;
+	}
+
+	goto done;
+
+del:
+	cdev_del(&vstream_cdev);
+unregister:
+	unregister_chrdev_region(devt, 1);
+done:
+	return ret;
+}
+
+void vstream_device_cleanup(void) {
+	dev_t devt = vstream_cdev.dev;
+
+	device_destroy(vcl_channel_class, devt);
+	cdev_del(&vstream_cdev);
+	unregister_chrdev_region(devt, 1);
+}
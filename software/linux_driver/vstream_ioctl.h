@@ -0,0 +1,26 @@
+// ioctl definitions for virtual stream devices
+
+#ifndef _VCL_VSTREAM_IOCTL_H_
+#define _VCL_VSTREAM_IOCTL_H_
+
+#include <linux/ioctl.h>
+
+#define VCL_VSTREAM_MAX_ID 0xFFFF
+
+// A virtual stream on a host channel, given by the number of its endpoint
+// (the <i> of /dev/vcl_<i>), the channel id and the stream id used by the
+// vstream_mux or vstream_demux in the design.
+struct vcl_vstream_attach {
+	unsigned int endpoint;
+	unsigned int channel;
+	unsigned int stream;
+};
+
+#define VCL_VSTREAM_IOCTL_BASE 0xFC
+
+// Attach the file to a stream. Returns -EBUSY if the file is already
+// attached, the stream is open elsewhere or the channel is open as a
+// plain channel or a bond member.
+#define VCL_VSTREAM_IOCTL_ATTACH _IOW(VCL_VSTREAM_IOCTL_BASE, 0, struct vcl_vstream_attach *)
+
+#endif
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Read throughput of the Python bindings against plain os.read.
+
+Needs the loopback example design, whose traffic generator streams a
+counter over FPGA-host channel 2 while it is in stream mode. Every method
+reads the same amount of data into NumPy arrays:
+
+  os.read      os.read() of the channel device and np.frombuffer(), the
+               usual way, which creates a bytes object per call
+  recv_into    Channel.recv_into() of a preallocated array
+  vfio         Receiver of an endpoint bound to vfio-pci, the arrays alias
+               the DMA memory (only with --vfio)
+"""
+
+import argparse
+import os
+import sys
+import time
+
+import numpy as np
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import vercolib  # noqa: E402
+
+# config channel registers, see cfg_channel_types.vhd
+CFG_CHN = 0
+TRAFFIC_CTRL = 3
+TRAFFIC_OFF = 0
+TRAFFIC_STREAM = 1
+STREAM_CHN = 2
+
+
+def checked(array, offset):
+    """DWords of the counter that do not match, starting at `offset`."""
+    words = array.view(np.uint32)
+    expected = np.arange(offset, offset + len(words), dtype=np.uint32)
+    return int(np.count_nonzero(words != expected))
+
+
+def drain(chn):
+    os.set_blocking(chn.fd, False)
+    deadline = time.monotonic() + 0.1
+    while time.monotonic() < deadline:
+        try:
+            if not os.read(chn.fd, 1 << 20):
+                break
+        except BlockingIOError:
+            time.sleep(0.01)
+    os.set_blocking(chn.fd, True)
+
+
+def bench_os_read(ep, chn, total, bufsize):
+    done = 0
+    errors = 0
+    ep.write_reg(CFG_CHN, TRAFFIC_CTRL, TRAFFIC_STREAM)
+    start = time.perf_counter()
+    while done < total:
+        data = np.frombuffer(os.read(chn.fd, min(bufsize, total - done)), dtype=np.uint8)
+        errors += checked(data, done // 4)
+        done += len(data)
+    elapsed = time.perf_counter() - start
+    ep.write_reg(CFG_CHN, TRAFFIC_CTRL, TRAFFIC_OFF)
+    drain(chn)
+    return done, elapsed, errors
+
+
+def bench_recv_into(ep, chn, total, bufsize):
+    buf = np.empty(bufsize, dtype=np.uint8)
+    done = 0
+    errors = 0
+    ep.write_reg(CFG_CHN, TRAFFIC_CTRL, TRAFFIC_STREAM)
+    start = time.perf_counter()
+    while done < total:
+        n = chn.recv_into(buf[:min(bufsize, total - done)])
+        errors += checked(buf[:n], done // 4)
+        done += n
+    elapsed = time.perf_counter() - start
+    ep.write_reg(CFG_CHN, TRAFFIC_CTRL, TRAFFIC_OFF)
+    drain(chn)
+    return done, elapsed, errors
+
+
+def bench_vfio(bdf, total, bufsize):
+    with vercolib.VfioEndpoint(bdf) as ep:
+        chn = ep.get_channel(STREAM_CHN)
+        rx = vercolib.Receiver(chn, 2 * chn.queue_depth, bufsize)
+        done = 0
+        errors = 0
+        ep.write_reg(CFG_CHN, TRAFFIC_CTRL, TRAFFIC_STREAM)
+        start = time.perf_counter()
+        while done < total:
+            data = rx.recv()
+            errors += checked(data, done // 4)
+            done += len(data)
+            rx.release(data)
+        elapsed = time.perf_counter() - start
+        # the transfers still in flight are dropped with the endpoint
+        ep.write_reg(CFG_CHN, TRAFFIC_CTRL, TRAFFIC_OFF)
+    return done, elapsed, errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--endpoint", type=int, default=None,
+                        help="endpoint number of the kernel driver, the first one by default")
+    parser.add_argument("--mib", type=int, default=256, help="MiB read by every method")
+    parser.add_argument("--bufsize", type=int, default=1 << 20, help="bytes per read")
+    parser.add_argument("--vfio", metavar="BDF",
+                        help="also measure the userspace driver on this endpoint, "
+                             "which has to be bound to vfio-pci instead")
+    args = parser.parse_args()
+
+    total = args.mib << 20
+    results = []
+
+    if args.endpoint is not None or not args.vfio:
+        endpoints = vercolib.endpoints()
+        if args.endpoint is not None:
+            endpoints = [e for e in endpoints if e.number == args.endpoint]
+        if not endpoints:
+            sys.exit("No endpoint of the kernel driver found.")
+        ep = endpoints[0]
+        chn = [c for c in ep.channels() if c.direction == "tx" and c.id == STREAM_CHN]
+        if not chn:
+            sys.exit("%r has no FPGA-host channel %d." % (ep, STREAM_CHN))
+        with chn[0].open() as tx:
+            results.append(("os.read", bench_os_read(ep, tx, total, args.bufsize)))
+            results.append(("recv_into", bench_recv_into(ep, tx, total, args.bufsize)))
+        ep.close()
+
+    if args.vfio:
+        results.append(("vfio", bench_vfio(args.vfio, total, args.bufsize)))
+
+    for name, (done, elapsed, errors) in results:
+        print("%-10s %10d bytes, %8.1f MB/s, %d errors" % (name, done, done / elapsed / 1e6, errors))
+
+
+if __name__ == "__main__":
+    main()
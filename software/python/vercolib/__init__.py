@@ -0,0 +1,21 @@
+"""Python bindings for VerCoLib-PCIe endpoints.
+
+`channel` drives the channel devices of the kernel driver, data is read
+into and written from NumPy arrays without copies in Python. `vfio` drives
+an endpoint bound to vfio-pci through the userspace driver, its arrays
+alias the DMA memory, so data is not copied at all.
+"""
+
+from .channel import Channel, Endpoint, channels, endpoints
+from .vfio import Receiver, Sender, VfioChannel, VfioEndpoint
+
+__all__ = [
+    "Channel",
+    "Endpoint",
+    "channels",
+    "endpoints",
+    "Receiver",
+    "Sender",
+    "VfioChannel",
+    "VfioEndpoint",
+]
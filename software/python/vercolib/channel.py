@@ -0,0 +1,260 @@
+"""Channel devices of the kernel driver.
+
+Channels are found through sysfs and configured through their sysfs
+attributes, see the driver's README. Data moves between the channel's DMA
+buffers and NumPy arrays (or any other writable buffer) with one copy in
+the kernel: reads go straight into the array with readv, writes are taken
+from the array's memory with writev, no bytes objects are created.
+"""
+
+import asyncio
+import fcntl
+import os
+import re
+import struct
+
+import numpy as np
+
+CHANNEL_CLASS = "/sys/class/vcl_channel"
+ENDPOINT_CLASS = "/sys/class/vcl_endpoint"
+
+_CHANNEL_NAME = re.compile(r"vcl_(\d+)_(rx|tx|misc)_(\d+)$")
+
+
+def _ioc(direction, base, nr, size):
+    return (direction << 30) | (size << 16) | (base << 8) | nr
+
+
+# see mmio_ioctl.h, the size is the one of the pointer argument
+_MMIO_RDREG = _ioc(3, 0xFF, 3, struct.calcsize("P"))
+_MMIO_WRREG = _ioc(1, 0xFF, 4, struct.calcsize("P"))
+
+
+def _bytes(data):
+    """Flat byte view of a C-contiguous buffer, without copying it."""
+    return memoryview(data).cast("B")
+
+
+class Endpoint:
+    """An endpoint of the kernel driver, /dev/vcl_<n>."""
+
+    def __init__(self, number, path=None):
+        self.number = number
+        self.path = path or "/dev/vcl_%d" % number
+        self.sysfs = os.path.join(ENDPOINT_CLASS, "vcl_%d" % number)
+        self._fd = None
+
+    def __repr__(self):
+        return "Endpoint(%d)" % self.number
+
+    def channels(self):
+        return channels(self.number)
+
+    def _mmio(self):
+        # the device can only be opened once, it is kept open
+        if self._fd is None:
+            self._fd = os.open(self.path, os.O_RDWR)
+        return self._fd
+
+    def read_reg(self, chn_id, reg):
+        """Register `reg` (counted in DWords) of channel `chn_id`."""
+        buf = bytearray(struct.pack("III", chn_id, reg, 0))
+        fcntl.ioctl(self._mmio(), _MMIO_RDREG, buf)
+        return struct.unpack("III", buf)[2]
+
+    def write_reg(self, chn_id, reg, value):
+        buf = bytearray(struct.pack("III", chn_id, reg, value))
+        fcntl.ioctl(self._mmio(), _MMIO_WRREG, buf)
+
+    def close(self):
+        if self._fd is not None:
+            os.close(self._fd)
+            self._fd = None
+
+
+class Channel:
+    """A host channel device of the kernel driver.
+
+    `direction` is "rx" for channels from the host to the FPGA and "tx"
+    for channels from the FPGA to the host, like in the device names.
+    """
+
+    def __init__(self, name, path=None):
+        match = _CHANNEL_NAME.match(name)
+        if not match:
+            raise ValueError("%s is no channel device name" % name)
+        self.name = name
+        self.endpoint = int(match.group(1))
+        self.direction = match.group(2)
+        self.id = int(match.group(3))
+        self.path = path or os.path.join("/dev", name)
+        self.sysfs = os.path.join(CHANNEL_CLASS, name)
+        self.fd = None
+
+    def __repr__(self):
+        return "Channel(%r)" % self.name
+
+    # configuration, see the driver's README for the attributes
+
+    def get(self, attr):
+        with open(os.path.join(self.sysfs, attr)) as f:
+            value = f.read().strip()
+        try:
+            return int(value, 0)
+        except ValueError:
+            return value
+
+    def set(self, attr, value):
+        with open(os.path.join(self.sysfs, attr), "w") as f:
+            f.write(str(int(value)))
+
+    def _attribute(name, doc):
+        return property(
+            lambda self: self.get(name),
+            lambda self, value: self.set(name, value),
+            doc=doc)
+
+    timeout_ms = _attribute("timeout_ms", "longest wait of a blocking call, 0 waits forever")
+    busy_poll_us = _attribute("busy_poll_us", "spin on completions before sleeping")
+    read_watermark = _attribute("read_watermark", "bytes received before poll reports readable")
+    write_watermark = _attribute("write_watermark", "bytes free before poll reports writable")
+    qos = _attribute("qos", "arbitration class and rate limit")
+    tlp_attr = _attribute("tlp_attr", "relaxed ordering, no snoop and TPH of the TLPs")
+    crc = _attribute("crc", "CRC32C of every buffer")
+    timestamps = _attribute("timestamps", "hardware timestamps of every buffer")
+    deadline_cycles = _attribute("deadline_cycles", "completion deadline of FPGA-host buffers")
+    min_buffers = _attribute("min_buffers", "buffers reserved while the channel is open")
+    max_buffers = _attribute("max_buffers", "buffers the channel may hold")
+
+    del _attribute
+
+    @property
+    def queue_depth(self):
+        return self.get("queue_depth")
+
+    @property
+    def max_tlp_bytes(self):
+        return self.get("max_tlp_bytes")
+
+    @property
+    def interrupts(self):
+        return self.get("interrupts")
+
+    @property
+    def submitted_bufs(self):
+        return self.get("submitted_bufs")
+
+    # data
+
+    def open(self, nonblock=False):
+        flags = os.O_WRONLY if self.direction == "rx" else os.O_RDONLY
+        if nonblock:
+            flags |= os.O_NONBLOCK
+        self.fd = os.open(self.path, flags)
+        return self
+
+    def close(self):
+        if self.fd is not None:
+            os.close(self.fd)
+            self.fd = None
+
+    def __enter__(self):
+        if self.fd is None:
+            self.open()
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def send(self, data):
+        """Writes all of `data`, returns the bytes written."""
+        view = _bytes(data)
+        done = 0
+        while done < len(view):
+            done += os.writev(self.fd, [view[done:]])
+        return done
+
+    def sendv(self, arrays):
+        """Writes a list of arrays with one system call, returns the bytes
+        the driver took, which may be fewer than all of them."""
+        return os.writev(self.fd, [_bytes(a) for a in arrays])
+
+    def recv_into(self, array):
+        """Reads into `array`, returns the bytes read."""
+        return os.readv(self.fd, [_bytes(array)])
+
+    def recvv_into(self, arrays):
+        """Reads into a list of arrays with one system call."""
+        return os.readv(self.fd, [_bytes(a) for a in arrays])
+
+    def recv(self, nbytes, dtype=np.uint8):
+        """Reads up to `nbytes` into a new array of `dtype`."""
+        array = np.empty(nbytes, dtype=np.uint8)
+        n = self.recv_into(array)
+        return array[:n - n % np.dtype(dtype).itemsize].view(dtype)
+
+    # asyncio, the calls switch the file to non-blocking mode
+
+    async def _ready(self, add, remove):
+        loop = asyncio.get_running_loop()
+        fut = loop.create_future()
+
+        def done():
+            if not fut.done():
+                fut.set_result(None)
+
+        add(self.fd, done)
+        try:
+            await fut
+        finally:
+            remove(self.fd)
+
+    async def asend(self, data):
+        """Writes all of `data` without blocking the event loop."""
+        loop = asyncio.get_running_loop()
+        os.set_blocking(self.fd, False)
+        view = _bytes(data)
+        done = 0
+        while done < len(view):
+            try:
+                done += os.writev(self.fd, [view[done:]])
+            except BlockingIOError:
+                await self._ready(loop.add_writer, loop.remove_writer)
+        return done
+
+    async def arecv_into(self, array):
+        """Reads into `array` once data is available, returns the bytes."""
+        loop = asyncio.get_running_loop()
+        os.set_blocking(self.fd, False)
+        while True:
+            try:
+                return self.recv_into(array)
+            except BlockingIOError:
+                await self._ready(loop.add_reader, loop.remove_reader)
+
+    async def arecv(self, nbytes, dtype=np.uint8):
+        array = np.empty(nbytes, dtype=np.uint8)
+        n = await self.arecv_into(array)
+        return array[:n - n % np.dtype(dtype).itemsize].view(dtype)
+
+
+def channels(endpoint=None):
+    """Channel devices of all endpoints or of endpoint number `endpoint`,
+    ordered by endpoint and channel id."""
+    try:
+        names = os.listdir(CHANNEL_CLASS)
+    except FileNotFoundError:
+        return []
+    found = [Channel(n) for n in names if _CHANNEL_NAME.match(n)]
+    if endpoint is not None:
+        found = [c for c in found if c.endpoint == endpoint]
+    return sorted(found, key=lambda c: (c.endpoint, c.id))
+
+
+def endpoints():
+    try:
+        names = os.listdir(ENDPOINT_CLASS)
+    except FileNotFoundError:
+        return []
+    numbers = [int(n[4:]) for n in names if re.match(r"vcl_\d+$", n)]
+    return [Endpoint(n) for n in sorted(numbers)]
@@ -0,0 +1,316 @@
+"""Endpoints bound to vfio-pci, driven through the userspace driver.
+
+The arrays handed out here alias the endpoint's DMA memory: the FPGA
+writes received data straight into them and reads sent data straight from
+them. Needs libvcl_vfio.so of software/vfio_driver, found through the
+environment variable VCL_VFIO_LIB, next to that directory's sources or on
+the library path.
+"""
+
+import asyncio
+import collections
+import ctypes
+import os
+
+import numpy as np
+
+_c_size_p = ctypes.POINTER(ctypes.c_size_t)
+
+
+def _load():
+    here = os.path.dirname(os.path.abspath(__file__))
+    paths = [
+        os.environ.get("VCL_VFIO_LIB"),
+        os.path.join(here, "..", "..", "vfio_driver", "libvcl_vfio.so"),
+    ]
+    for path in paths:
+        if path and os.path.exists(path):
+            return ctypes.CDLL(path)
+    return ctypes.CDLL("libvcl_vfio.so")
+
+
+_lib = None
+
+
+def _library():
+    global _lib
+    if _lib is None:
+        lib = _load()
+        ep = ctypes.c_void_p
+        u32 = ctypes.c_uint32
+        uint = ctypes.c_uint
+        lib.vcl_vfio_error.restype = ctypes.c_char_p
+        lib.vcl_vfio_open.argtypes = [ctypes.c_char_p]
+        lib.vcl_vfio_open.restype = ep
+        lib.vcl_vfio_close.argtypes = [ep]
+        lib.vcl_vfio_close.restype = None
+        lib.vcl_vfio_channel_count.argtypes = [ep]
+        lib.vcl_vfio_channel_count.restype = uint
+        lib.vcl_vfio_channel_info.argtypes = [ep, uint, ctypes.POINTER(uint),
+                                              ctypes.POINTER(ctypes.c_int),
+                                              ctypes.POINTER(uint)]
+        lib.vcl_vfio_read_reg.argtypes = [ep, uint, uint]
+        lib.vcl_vfio_read_reg.restype = u32
+        lib.vcl_vfio_write_reg.argtypes = [ep, uint, uint, u32]
+        lib.vcl_vfio_write_reg.restype = None
+        lib.vcl_vfio_max_payload.argtypes = [ep]
+        lib.vcl_vfio_max_payload.restype = u32
+        lib.vcl_vfio_max_read_request.argtypes = [ep]
+        lib.vcl_vfio_max_read_request.restype = u32
+        lib.vcl_vfio_alloc.argtypes = [ep, ctypes.c_size_t,
+                                       ctypes.POINTER(ctypes.c_void_p),
+                                       ctypes.POINTER(ctypes.c_uint64)]
+        lib.vcl_vfio_configure.argtypes = [ep, uint, u32, u32, ctypes.c_int]
+        lib.vcl_vfio_submit.argtypes = [ep, uint, ctypes.c_uint64, ctypes.c_size_t]
+        lib.vcl_vfio_poll.argtypes = [ep, uint, _c_size_p]
+        lib.vcl_vfio_wait.argtypes = [ep, uint, _c_size_p]
+        _lib = lib
+    return _lib
+
+
+def _check(ret):
+    if ret < 0:
+        raise OSError(_lib.vcl_vfio_error().decode())
+    return ret
+
+
+class VfioEndpoint:
+    """An endpoint bound to vfio-pci, e.g. VfioEndpoint("0000:04:00.0")."""
+
+    def __init__(self, bdf):
+        lib = _library()
+        self._ep = lib.vcl_vfio_open(bdf.encode())
+        if not self._ep:
+            raise OSError(lib.vcl_vfio_error().decode())
+        self.bdf = bdf
+        # (address, iova, bytes) of every allocation
+        self._regions = []
+        self.channels = []
+        for idx in range(lib.vcl_vfio_channel_count(self._ep)):
+            chn_id = ctypes.c_uint()
+            is_rx = ctypes.c_int()
+            depth = ctypes.c_uint()
+            _check(lib.vcl_vfio_channel_info(self._ep, idx, chn_id, is_rx, depth))
+            self.channels.append(VfioChannel(self, chn_id.value, bool(is_rx.value), depth.value))
+
+    def __repr__(self):
+        return "VfioEndpoint(%r)" % self.bdf
+
+    def close(self):
+        """Frees the endpoint and its DMA memory, arrays of alloc() must not
+        be used afterwards."""
+        if self._ep:
+            _lib.vcl_vfio_close(self._ep)
+            self._ep = None
+            self._regions = []
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def get_channel(self, chn_id):
+        for chn in self.channels:
+            if chn.id == chn_id:
+                return chn
+        raise KeyError("no host channel %d" % chn_id)
+
+    def read_reg(self, chn_id, reg):
+        return _lib.vcl_vfio_read_reg(self._ep, chn_id, reg)
+
+    def write_reg(self, chn_id, reg, value):
+        _lib.vcl_vfio_write_reg(self._ep, chn_id, reg, value)
+
+    @property
+    def max_payload(self):
+        return _lib.vcl_vfio_max_payload(self._ep)
+
+    @property
+    def max_read_request(self):
+        return _lib.vcl_vfio_max_read_request(self._ep)
+
+    def alloc(self, nbytes, dtype=np.uint8):
+        """DMA memory as an array of `dtype`, valid until close()."""
+        ptr = ctypes.c_void_p()
+        iova = ctypes.c_uint64()
+        _check(_lib.vcl_vfio_alloc(self._ep, nbytes, ptr, iova))
+        self._regions.append((ptr.value, iova.value, nbytes))
+        mem = (ctypes.c_uint8 * nbytes).from_address(ptr.value)
+        return np.frombuffer(mem, dtype=np.uint8).view(dtype)
+
+    def iova(self, array):
+        """Device address of the data of an array in DMA memory."""
+        addr = array.ctypes.data
+        for start, iova, size in self._regions:
+            if start <= addr and addr + array.nbytes <= start + size:
+                return iova + addr - start
+        raise ValueError("array does not lie in DMA memory of this endpoint")
+
+
+class VfioChannel:
+    """A host channel of a VfioEndpoint. `is_rx` channels move data from
+    the host to the FPGA, the others from the FPGA to the host."""
+
+    def __init__(self, endpoint, chn_id, is_rx, queue_depth):
+        self.endpoint = endpoint
+        self.id = chn_id
+        self.is_rx = is_rx
+        self.queue_depth = queue_depth
+
+    def __repr__(self):
+        return "VfioChannel(%d, %s)" % (self.id, "rx" if self.is_rx else "tx")
+
+    def configure(self, max_tlp_bytes, tlp_attr=0, crc=False):
+        _check(_lib.vcl_vfio_configure(self.endpoint._ep, self.id,
+                                       max_tlp_bytes, tlp_attr, int(crc)))
+
+    def submit(self, array, nbytes=None):
+        """Starts a transfer of the array's memory, which has to be a
+        C-contiguous part of memory of alloc(). Up to queue_depth transfers
+        may be in flight, they complete in submission order."""
+        if not array.flags["C_CONTIGUOUS"]:
+            raise ValueError("array is not contiguous")
+        nbytes = array.nbytes if nbytes is None else nbytes
+        _check(_lib.vcl_vfio_submit(self.endpoint._ep, self.id,
+                                    self.endpoint.iova(array), nbytes))
+
+    def poll(self):
+        """Bytes of the oldest transfer if it is complete, None if not."""
+        nbytes = ctypes.c_size_t()
+        if _check(_lib.vcl_vfio_poll(self.endpoint._ep, self.id, nbytes)):
+            return nbytes.value
+        return None
+
+    def wait(self):
+        """Spins until the oldest transfer is complete, returns its bytes."""
+        nbytes = ctypes.c_size_t()
+        _check(_lib.vcl_vfio_wait(self.endpoint._ep, self.id, nbytes))
+        return nbytes.value
+
+    async def await_completion(self):
+        """Like wait(), but lets other tasks run between the polls."""
+        while True:
+            nbytes = self.poll()
+            if nbytes is not None:
+                return nbytes
+            await asyncio.sleep(0)
+
+
+class Receiver:
+    """Keeps a FPGA-host channel busy with `slots` buffers of `slot_bytes`.
+
+    recv() returns the received data as an array aliasing its slot, the
+    slot is handed to the FPGA again by release() once the data has been
+    used. Slots held by the caller are not refilled, so the channel stalls
+    when all of them are held.
+    """
+
+    def __init__(self, channel, slots, slot_bytes):
+        if channel.is_rx:
+            raise ValueError("%r moves data to the FPGA" % channel)
+        if slot_bytes % 4:
+            raise ValueError("slots have to be DWord multiples")
+        self.channel = channel
+        self.slot_bytes = slot_bytes
+        self._mem = channel.endpoint.alloc(slots * slot_bytes)
+        self._slots = [self._mem[n * slot_bytes:(n + 1) * slot_bytes] for n in range(slots)]
+        self._free = collections.deque(range(slots))
+        self._inflight = collections.deque()
+        self._fill()
+
+    def _fill(self):
+        while self._free and len(self._inflight) < self.channel.queue_depth:
+            slot = self._free.popleft()
+            self.channel.submit(self._slots[slot])
+            self._inflight.append(slot)
+
+    def _slot(self, array):
+        offset = array.ctypes.data - self._mem.ctypes.data
+        if offset < 0 or offset % self.slot_bytes or offset >= self._mem.nbytes:
+            raise ValueError("array is no slot of this receiver")
+        return offset // self.slot_bytes
+
+    def _complete(self, nbytes, dtype):
+        data = self._slots[self._inflight.popleft()][:nbytes]
+        return data[:nbytes - nbytes % np.dtype(dtype).itemsize].view(dtype)
+
+    def recv(self, dtype=np.uint8):
+        """Waits for the next slot and returns its data."""
+        if not self._inflight:
+            raise RuntimeError("all slots are held, release one first")
+        return self._complete(self.channel.wait(), dtype)
+
+    def poll(self, dtype=np.uint8):
+        """Data of the next slot, None if it is not complete yet."""
+        if not self._inflight:
+            return None
+        nbytes = self.channel.poll()
+        return None if nbytes is None else self._complete(nbytes, dtype)
+
+    async def arecv(self, dtype=np.uint8):
+        if not self._inflight:
+            raise RuntimeError("all slots are held, release one first")
+        return self._complete(await self.channel.await_completion(), dtype)
+
+    def release(self, array):
+        """Gives the slot of an array returned by recv() back to the FPGA."""
+        self._free.append(self._slot(array))
+        self._fill()
+
+
+class Sender:
+    """Sends from `slots` buffers of `slot_bytes` over a host-FPGA channel.
+
+    buffer() hands out a free slot as an array to fill, send() transfers it
+    without a copy. The slot returns to the free ones once its transfer is
+    complete.
+    """
+
+    def __init__(self, channel, slots, slot_bytes):
+        if not channel.is_rx:
+            raise ValueError("%r moves data to the host" % channel)
+        if slot_bytes % 4:
+            raise ValueError("slots have to be DWord multiples")
+        self.channel = channel
+        self.slot_bytes = slot_bytes
+        self._mem = channel.endpoint.alloc(slots * slot_bytes)
+        self._slots = [self._mem[n * slot_bytes:(n + 1) * slot_bytes] for n in range(slots)]
+        self._free = collections.deque(range(slots))
+        self._inflight = collections.deque()
+
+    def _reclaim(self):
+        while self._inflight and self.channel.poll() is not None:
+            self._free.append(self._inflight.popleft())
+
+    def buffer(self, count=None, dtype=np.uint8):
+        """A free slot as an array of `count` items of `dtype`, waits for
+        the oldest transfer if all slots are in flight."""
+        self._reclaim()
+        if not self._free:
+            if not self._inflight:
+                raise RuntimeError("all slots are held, send one first")
+            self.channel.wait()
+            self._free.append(self._inflight.popleft())
+        slot = self._slots[self._free.popleft()].view(dtype)
+        return slot if count is None else slot[:count]
+
+    def send(self, array):
+        """Transfers an array of buffer(), waits if queue_depth transfers
+        are in flight."""
+        offset = array.ctypes.data - self._mem.ctypes.data
+        if offset < 0 or offset % self.slot_bytes or offset >= self._mem.nbytes:
+            raise ValueError("array is no slot of this sender")
+        if array.nbytes % 4:
+            raise ValueError("transfers have to be DWord multiples")
+        while len(self._inflight) >= self.channel.queue_depth:
+            self.channel.wait()
+            self._free.append(self._inflight.popleft())
+        self.channel.submit(array)
+        self._inflight.append(offset // self.slot_bytes)
+
+    def flush(self):
+        """Waits until every slot sent is transferred."""
+        while self._inflight:
+            self.channel.wait()
+            self._free.append(self._inflight.popleft())
@@ -0,0 +1,281 @@
+// Decodes a dump of the TLP trace buffer into a timeline and statistics.
+//
+// The dump is read from the debugfs file trace of the kernel driver, see
+// trace.c there for its layout and tlp_trace.vhd for the entries.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+enum { DIR_RX = 1, DIR_TX = 2 };
+
+// descriptors of the internal TLP header, see transceiver_128bit_types.vhd
+enum { MWR32 = 0x0, MRD32 = 0x1, CPLD = 0x2, MWR64 = 0x8, MRD64 = 0x9, MSIX = 0xC };
+
+// inputs of the tx_tlp_mux in the waiting bits, from bit 3 down
+static const char *const inputs[] = {"tx", "rx", "cfg", "int"};
+
+struct entry {
+	uint64_t ts;
+	unsigned dir;
+	unsigned waiting;
+	unsigned desc;
+	unsigned length; // DWords
+	unsigned tag;
+	unsigned chn;
+	uint32_t extra; // address of requests, header DWord 1 of completions
+
+	unsigned byte_count() const {
+		unsigned bytes = (extra >> 16) & 0xFFF;
+		return bytes ? bytes : 4096;
+	}
+};
+
+static const char *desc_name(unsigned desc) {
+	switch(desc) {
+	case MWR32: return "MWr32";
+	case MWR64: return "MWr64";
+	case MRD32: return "MRd32";
+	case MRD64: return "MRd64";
+	case CPLD: return "CplD";
+	case MSIX: return "MSIX";
+	default: return "?";
+	}
+}
+
+static bool is_read(unsigned desc) {
+	return desc == MRD32 || desc == MRD64;
+}
+
+static bool read_dump(const char *path, uint32_t &status, vector<entry> &entries) {
+	FILE *f = fopen(path, "rb");
+	if(!f) {
+		perror(path);
+		return false;
+	}
+
+	uint32_t header[4];
+	if(fread(header, sizeof(header), 1, f) != 1 || header[0] != 0x544C4356) {
+		fprintf(stderr, "%s is no trace dump\n", path);
+		fclose(f);
+		return false;
+	}
+	status = header[1];
+
+	uint32_t dw[4];
+	for(uint32_t n = 0; n < header[2] && fread(dw, sizeof(dw), 1, f) == 1; ++n) {
+		entry e;
+		e.ts = dw[0] | uint64_t(dw[1] & 0xFFFF) << 32;
+		e.dir = dw[1] >> 30;
+		e.waiting = (dw[1] >> 24) & 0xF;
+		e.desc = dw[2] & 0xF;
+		e.length = (dw[2] >> 6) & 0x3FF;
+		e.length = e.length ? e.length : 1024;
+		e.tag = (dw[2] >> 16) & 0xFF;
+		e.chn = dw[2] >> 24;
+		e.extra = dw[3];
+		entries.push_back(e);
+	}
+	fclose(f);
+	return true;
+}
+
+static void print_timeline(const vector<entry> &entries) {
+	printf("%14s %8s  dir  %-5s %4s %4s %5s  %-10s waiting\n",
+		"cycle", "+cycles", "type", "chn", "tag", "DW", "addr/bytes");
+	for(size_t n = 0; n < entries.size(); ++n) {
+		const entry &e = entries[n];
+		uint64_t delta = n ? e.ts - entries[n-1].ts : 0;
+		printf("%14" PRIu64 " %8" PRIu64 "  %s  %-5s %4u %4u %5u  ",
+			e.ts, delta, e.dir == DIR_RX ? "h2f" : "f2h",
+			desc_name(e.desc), e.chn, e.tag, e.length);
+		if(e.desc == CPLD) {
+			printf("%-10u", e.byte_count());
+		} else {
+			printf("0x%08" PRIx32, e.extra);
+		}
+		for(unsigned k = 0; k < 4; ++k) {
+			if(e.waiting & (1 << k)) {
+				printf(" %s", inputs[k]);
+			}
+		}
+		printf("\n");
+	}
+}
+
+static void print_channels(const vector<entry> &entries) {
+	struct counts { uint64_t tlps = 0, dwords = 0; };
+	std::map<unsigned, counts> per_chn[2];
+
+	for(const entry &e: entries) {
+		if(e.dir != DIR_RX && e.dir != DIR_TX) {
+			continue;
+		}
+		counts &c = per_chn[e.dir == DIR_TX][e.chn];
+		c.tlps += 1;
+		c.dwords += is_read(e.desc) ? 0 : e.length;
+	}
+
+	printf("\nTLPs per channel\n");
+	for(int d = 0; d < 2; ++d) {
+		for(const auto &c: per_chn[d]) {
+			printf("  %s channel %3u: %8" PRIu64 " TLPs, %10" PRIu64 " payload DWords\n",
+				d ? "f2h" : "h2f", c.first, c.second.tlps, c.second.dwords);
+		}
+	}
+}
+
+// largest gaps between consecutive TLPs of a direction
+static void print_stalls(const vector<entry> &entries, uint64_t threshold) {
+	struct gap { uint64_t start, cycles; unsigned dir; };
+	vector<gap> gaps;
+	uint64_t last[3] = {0, 0, 0};
+	bool seen[3] = {false, false, false};
+
+	for(const entry &e: entries) {
+		if(e.dir != DIR_RX && e.dir != DIR_TX) {
+			continue;
+		}
+		if(seen[e.dir] && e.ts - last[e.dir] >= threshold) {
+			gaps.push_back({last[e.dir], e.ts - last[e.dir], e.dir});
+		}
+		seen[e.dir] = true;
+		last[e.dir] = e.ts;
+	}
+
+	std::sort(gaps.begin(), gaps.end(), [](const gap &a, const gap &b) {
+		return a.cycles > b.cycles;
+	});
+
+	printf("\nGaps of at least %" PRIu64 " cycles: %zu\n", threshold, gaps.size());
+	for(size_t n = 0; n < gaps.size() && n < 10; ++n) {
+		printf("  %s %10" PRIu64 " cycles after cycle %" PRIu64 "\n",
+			gaps[n].dir == DIR_RX ? "h2f" : "f2h", gaps[n].cycles, gaps[n].start);
+	}
+}
+
+// Time from a read request to its first and its last completion, matched
+// by the PCIe tag. A completion is the last one if its remaining byte
+// count fits into its payload.
+static void print_latency(const vector<entry> &entries, double mhz) {
+	struct request { uint64_t ts; unsigned chn; bool first; };
+	struct stats {
+		uint64_t n = 0, first_sum = 0, sum = 0, min = UINT64_MAX, max = 0;
+	};
+	std::map<unsigned, request> open;
+	std::map<unsigned, stats> per_chn;
+
+	for(const entry &e: entries) {
+		if(e.dir == DIR_TX && is_read(e.desc)) {
+			open[e.tag] = {e.ts, e.chn, true};
+		} else if(e.dir == DIR_RX && e.desc == CPLD) {
+			auto rq = open.find(e.tag);
+			if(rq == open.end()) {
+				continue;
+			}
+			stats &s = per_chn[rq->second.chn];
+			if(rq->second.first) {
+				s.first_sum += e.ts - rq->second.ts;
+				rq->second.first = false;
+			}
+			if(e.byte_count() <= e.length * 4) {
+				uint64_t cycles = e.ts - rq->second.ts;
+				s.n += 1;
+				s.sum += cycles;
+				s.min = std::min(s.min, cycles);
+				s.max = std::max(s.max, cycles);
+				open.erase(rq);
+			}
+		}
+	}
+
+	printf("\nRead completion latency in cycles (%.0f MHz)\n", mhz);
+	for(const auto &c: per_chn) {
+		const stats &s = c.second;
+		printf("  channel %3u: %6" PRIu64 " reads, first CplD mean %8.1f, "
+		       "last CplD min %6" PRIu64 " mean %8.1f max %6" PRIu64 " (%.3f us)\n",
+			c.first, s.n, double(s.first_sum) / s.n, s.min,
+			double(s.sum) / s.n, s.max, s.max / mhz);
+	}
+	if(!open.empty()) {
+		printf("  %zu reads without their last completion in the trace\n", open.size());
+	}
+}
+
+// How often each tx_tlp_mux input was waiting while a TLP was sent.
+static void print_arbitration(const vector<entry> &entries) {
+	uint64_t sent = 0, contended = 0;
+	uint64_t waited[4] = {0, 0, 0, 0};
+
+	for(const entry &e: entries) {
+		if(e.dir != DIR_TX) {
+			continue;
+		}
+		sent += 1;
+		unsigned count = 0;
+		for(unsigned k = 0; k < 4; ++k) {
+			if(e.waiting & (1 << k)) {
+				waited[k] += 1;
+				count += 1;
+			}
+		}
+		contended += count > 1;
+	}
+
+	printf("\nArbitration: %" PRIu64 " of %" PRIu64 " f2h TLPs sent with several inputs waiting\n",
+		contended, sent);
+	for(unsigned k = 4; k-- > 0;) {
+		printf("  %-3s valid at %8" PRIu64 " sends\n", inputs[k], waited[k]);
+	}
+}
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		fprintf(stderr, "Usage: %s <dump> [clock MHz] [gap cycles] [-s]\n"
+		                "  -s: statistics only, no timeline\n", argv[0]);
+		return 1;
+	}
+
+	double mhz = 250;
+	uint64_t threshold = 1000;
+	bool timeline = true;
+	int pos = 0;
+	for(int n = 2; n < argc; ++n) {
+		if(!strcmp(argv[n], "-s")) {
+			timeline = false;
+		} else if(pos++ == 0) {
+			mhz = strtod(argv[n], nullptr);
+		} else {
+			threshold = strtoull(argv[n], nullptr, 0);
+		}
+	}
+
+	uint32_t status;
+	vector<entry> entries;
+	if(!read_dump(argv[1], status, entries)) {
+		return 1;
+	}
+
+	printf("%zu entries of %u%s%s%s\n", entries.size(), 1u << ((status >> 8) & 0x1F),
+		status & 2 ? ", triggered" : "",
+		status & 4 ? ", wrapped" : "",
+		status & 8 ? ", entries lost" : "");
+
+	if(timeline) {
+		print_timeline(entries);
+	}
+	print_channels(entries);
+	print_stalls(entries, std::max<uint64_t>(threshold, 1));
+	print_latency(entries, mhz > 0 ? mhz : 250);
+	print_arbitration(entries);
+	return 0;
+}
@@ -0,0 +1,468 @@
+// Userspace driver for VerCoLib-PCIe endpoints bound to vfio-pci
+
+#include "vcl_vfio.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <linux/pci_regs.h>
+#include <linux/vfio.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace vcl {
+
+namespace {
+
+// endpoint registers, see vercolib.c
+enum { CHANNEL_INFO_REG = 0x28 };
+
+// channel registers, see host_channel_types.vhd
+enum {
+	CHN_ADDR_LO_REG = 0,
+	CHN_ADDR_HI_REG = 1,
+	CHN_SIZE_REG = 2,
+	CHN_TRNS_REG = 4,
+	CHN_INFO_REG = 5,
+	CHN_TLP_ATTR_REG = 9,
+	CHN_MAX_TLP_REG = 10,
+	CHN_CRC_REG = 11,
+	CHN_QUEUE_REG = 12,
+	CHN_ABORT_REG = 13,
+};
+
+// channel info, see to_dw in channel_types.vhd
+enum { CHN_DIR_RX = 0, CHN_DIR_TX = 1 };
+enum { CHN_KIND_HOST = 0 };
+
+inline unsigned int chn_info_dir(std::uint32_t info) { return (info >> 8) & 0x3; }
+inline unsigned int chn_info_kind(std::uint32_t info) { return (info >> 10) & 0xF; }
+inline unsigned int chn_info_queue_depth(std::uint32_t info) { return (info >> 16) & 0xF; }
+inline bool chn_info_abort(std::uint32_t info) { return (info >> 20) & 0x1; }
+
+inline unsigned int host_chn_cnt(std::uint32_t info) {
+	return (info & 0xFF) + ((info >> 8) & 0xFF);
+}
+inline unsigned int chn_cnt(std::uint32_t info) {
+	return (info & 0xFF) + ((info >> 8) & 0xFF) + ((info >> 16) & 0xFF) + ((info >> 24) & 0xFF);
+}
+inline unsigned int int_cnt(std::uint32_t info) { return host_chn_cnt(info) + 1; }
+
+// The hardware finishes the requests it already sent before an abort ends.
+const unsigned int ABORT_POLLS = 100000;
+
+const std::size_t HUGEPAGE_SIZE = 2 << 20;
+
+// DMA addresses stay below 4 GiB, so buffers are programmed with a 32 bit
+// address like by the kernel driver on most hosts, and below the MSI
+// window of x86 hosts.
+const std::uint64_t IOVA_BASE = HUGEPAGE_SIZE;
+const std::uint64_t IOVA_LIMIT = 0xFEE00000;
+
+void fail(const std::string &what) {
+	throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+std::size_t round_up(std::size_t value, std::size_t to) {
+	return (value + to - 1) / to * to;
+}
+
+}
+
+channel::channel(endpoint &ep, unsigned int id, std::uint32_t info)
+	: ep_(ep), id_(id), rx_(chn_info_dir(info) == CHN_DIR_RX),
+	  queue_depth_(chn_info_queue_depth(info) ? chn_info_queue_depth(info) : 1),
+	  can_abort_(chn_info_abort(info)), completed_(0)
+{
+	// Host-FPGA channels issue MRd, FPGA-Host channels MWr
+	configure(rx_ ? ep.max_read_request() : ep.max_payload());
+}
+
+void channel::configure(std::uint32_t max_tlp_bytes, std::uint32_t tlp_attr, bool crc) {
+	ep_.write_reg(id_, CHN_MAX_TLP_REG, max_tlp_bytes);
+	ep_.write_reg(id_, CHN_TLP_ATTR_REG, tlp_attr);
+	ep_.write_reg(id_, CHN_CRC_REG, crc);
+}
+
+void channel::submit(const dma_buffer &buf, std::size_t offset, std::size_t bytes) {
+	if(in_flight_.size() >= queue_depth_) {
+		throw std::logic_error("Channel " + std::to_string(id_) + ": hardware queue is full");
+	}
+	if(offset + bytes > buf.size || bytes % 4) {
+		throw std::invalid_argument("Transfers must be DWords inside the buffer");
+	}
+
+	// same sequence as write_buffer_info of the kernel driver, the size
+	// starts the transfer
+	std::uint64_t addr = buf.iova + offset;
+	ep_.write_reg(id_, CHN_ADDR_LO_REG, static_cast<std::uint32_t>(addr));
+	if(addr >> 32) {
+		ep_.write_reg(id_, CHN_ADDR_HI_REG, static_cast<std::uint32_t>(addr >> 32));
+	}
+	ep_.write_reg(id_, CHN_SIZE_REG, static_cast<std::uint32_t>(bytes));
+	in_flight_.push_back(bytes);
+}
+
+bool channel::poll(std::size_t &bytes) {
+	if(in_flight_.empty()) {
+		return false;
+	}
+
+	// The count covers all transfers completed since the last read, so the
+	// register is only read again once those are returned.
+	if(!completed_) {
+		// bits 15:0, the upper bits hold the state of the descriptor queue
+		completed_ = ep_.read_reg(id_, CHN_QUEUE_REG) & 0xFFFF;
+		if(!completed_) {
+			return false;
+		}
+	}
+
+	bytes = ep_.read_reg(id_, CHN_TRNS_REG);
+	completed_ -= 1;
+	in_flight_.pop_front();
+	return true;
+}
+
+std::size_t channel::wait() {
+	if(in_flight_.empty()) {
+		throw std::logic_error("Channel " + std::to_string(id_) + ": no transfer in flight");
+	}
+
+	std::size_t bytes;
+	while(!poll(bytes));
+	return bytes;
+}
+
+std::size_t channel::abort() {
+	if(!can_abort_) {
+		throw std::logic_error("Channel " + std::to_string(id_) + ": hardware cannot abort");
+	}
+
+	ep_.write_reg(id_, CHN_ABORT_REG, 1);
+	unsigned int polls;
+	for(polls = 0; polls < ABORT_POLLS && ep_.read_reg(id_, CHN_ABORT_REG); ++polls);
+	if(polls == ABORT_POLLS) {
+		throw std::runtime_error("Channel " + std::to_string(id_) + ": timeout while aborting");
+	}
+
+	// The aborted transaction and any completed before it have a result,
+	// the queued ones were dropped by the hardware.
+	std::size_t bytes = 0, transferred;
+	while(poll(transferred)) {
+		bytes += transferred;
+	}
+	in_flight_.clear();
+	completed_ = 0;
+	return bytes;
+}
+
+
+endpoint::endpoint(const std::string &bdf) : next_iova_(IOVA_BASE) {
+	try {
+		open_device(bdf);
+		enable_bus_master();
+		read_packet_sizes();
+
+		std::uint32_t info = bar_[CHANNEL_INFO_REG / 4];
+		if(info == 0xFFFFFFFF) {
+			throw std::runtime_error("Failed to read the channel info of " + bdf);
+		}
+		enable_interrupts(int_cnt(info));
+		find_channels();
+	} catch(...) {
+		release();
+		throw;
+	}
+}
+
+endpoint::~endpoint() {
+	release();
+}
+
+void endpoint::release() {
+	channels_.clear();
+
+	for(auto &buf: buffers_) {
+		vfio_iommu_type1_dma_unmap unmap;
+		std::memset(&unmap, 0, sizeof(unmap));
+		unmap.argsz = sizeof(unmap);
+		unmap.iova = buf.iova;
+		unmap.size = buf.size;
+		ioctl(container_, VFIO_IOMMU_UNMAP_DMA, &unmap);
+		munmap(buf.ptr, buf.size);
+	}
+	buffers_.clear();
+
+	if(!irq_fds_.empty()) {
+		vfio_irq_set irqs;
+		std::memset(&irqs, 0, sizeof(irqs));
+		irqs.argsz = sizeof(irqs);
+		irqs.flags = VFIO_IRQ_SET_DATA_NONE | VFIO_IRQ_SET_ACTION_TRIGGER;
+		irqs.index = VFIO_PCI_MSIX_IRQ_INDEX;
+		ioctl(device_, VFIO_DEVICE_SET_IRQS, &irqs);
+		for(int fd: irq_fds_) {
+			close(fd);
+		}
+		irq_fds_.clear();
+	}
+
+	if(bar_) {
+		munmap(const_cast<std::uint32_t*>(bar_), bar_size_);
+		bar_ = nullptr;
+	}
+	if(device_ != -1) {
+		close(device_);
+		device_ = -1;
+	}
+	if(group_ != -1) {
+		close(group_);
+		group_ = -1;
+	}
+	if(container_ != -1) {
+		close(container_);
+		container_ = -1;
+	}
+}
+
+std::uint32_t endpoint::read_reg(unsigned int chn_id, unsigned int reg) {
+	return bar_[(chn_id << 4) + reg];
+}
+
+void endpoint::write_reg(unsigned int chn_id, unsigned int reg, std::uint32_t value) {
+	bar_[(chn_id << 4) + reg] = value;
+}
+
+channel &endpoint::get_channel(unsigned int id) {
+	for(auto &chn: channels_) {
+		if(chn->id() == id) {
+			return *chn;
+		}
+	}
+	throw std::out_of_range("No host channel with id " + std::to_string(id));
+}
+
+dma_buffer endpoint::alloc(std::size_t bytes) {
+	dma_buffer buf;
+	buf.size = round_up(bytes, HUGEPAGE_SIZE);
+	buf.iova = next_iova_;
+	if(buf.iova + buf.size > IOVA_LIMIT) {
+		throw std::length_error("Out of DMA address space");
+	}
+
+	buf.ptr = mmap(nullptr, buf.size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if(buf.ptr == MAP_FAILED) {
+		buf.ptr = mmap(nullptr, buf.size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(buf.ptr == MAP_FAILED) {
+			fail("Failed to allocate DMA memory");
+		}
+	}
+
+	// pins the pages and maps them for the endpoint
+	vfio_iommu_type1_dma_map map;
+	std::memset(&map, 0, sizeof(map));
+	map.argsz = sizeof(map);
+	map.flags = VFIO_DMA_MAP_FLAG_READ | VFIO_DMA_MAP_FLAG_WRITE;
+	map.vaddr = reinterpret_cast<std::uintptr_t>(buf.ptr);
+	map.iova = buf.iova;
+	map.size = buf.size;
+	if(ioctl(container_, VFIO_IOMMU_MAP_DMA, &map)) {
+		int err = errno;
+		munmap(buf.ptr, buf.size);
+		errno = err;
+		fail("Failed to map DMA memory");
+	}
+
+	next_iova_ += buf.size;
+	buffers_.push_back(buf);
+	return buf;
+}
+
+void endpoint::open_device(const std::string &bdf) {
+	container_ = open("/dev/vfio/vfio", O_RDWR);
+	if(container_ == -1) {
+		fail("Failed to open the VFIO container");
+	}
+	if(ioctl(container_, VFIO_GET_API_VERSION) != VFIO_API_VERSION) {
+		throw std::runtime_error("Unknown VFIO API version");
+	}
+	if(!ioctl(container_, VFIO_CHECK_EXTENSION, VFIO_TYPE1_IOMMU)) {
+		throw std::runtime_error("VFIO does not support the type 1 IOMMU");
+	}
+
+	char link[256];
+	std::string group_path = "/sys/bus/pci/devices/" + bdf + "/iommu_group";
+	ssize_t len = readlink(group_path.c_str(), link, sizeof(link) - 1);
+	if(len < 0) {
+		fail("Failed to find the IOMMU group of " + bdf);
+	}
+	link[len] = '\0';
+	std::string group = std::strrchr(link, '/') + 1;
+
+	group_ = open(("/dev/vfio/" + group).c_str(), O_RDWR);
+	if(group_ == -1) {
+		fail("Failed to open VFIO group " + group);
+	}
+
+	vfio_group_status status;
+	std::memset(&status, 0, sizeof(status));
+	status.argsz = sizeof(status);
+	if(ioctl(group_, VFIO_GROUP_GET_STATUS, &status)) {
+		fail("Failed to get the status of VFIO group " + group);
+	}
+	if(!(status.flags & VFIO_GROUP_FLAGS_VIABLE)) {
+		throw std::runtime_error("VFIO group " + group +
+			" is not viable, all of its devices must be bound to vfio-pci");
+	}
+
+	if(ioctl(group_, VFIO_GROUP_SET_CONTAINER, &container_)) {
+		fail("Failed to add VFIO group " + group + " to the container");
+	}
+	if(ioctl(container_, VFIO_SET_IOMMU, VFIO_TYPE1_IOMMU)) {
+		fail("Failed to set up the IOMMU");
+	}
+
+	device_ = ioctl(group_, VFIO_GROUP_GET_DEVICE_FD, bdf.c_str());
+	if(device_ < 0) {
+		fail("Failed to get the VFIO device of " + bdf);
+	}
+
+	vfio_region_info region;
+	std::memset(&region, 0, sizeof(region));
+	region.argsz = sizeof(region);
+	region.index = VFIO_PCI_CONFIG_REGION_INDEX;
+	if(ioctl(device_, VFIO_DEVICE_GET_REGION_INFO, &region)) {
+		fail("Failed to get the config space of " + bdf);
+	}
+	config_offset_ = region.offset;
+
+	std::memset(&region, 0, sizeof(region));
+	region.argsz = sizeof(region);
+	region.index = VFIO_PCI_BAR0_REGION_INDEX;
+	if(ioctl(device_, VFIO_DEVICE_GET_REGION_INFO, &region)) {
+		fail("Failed to get BAR0 of " + bdf);
+	}
+	if(!(region.flags & VFIO_REGION_INFO_FLAG_MMAP)) {
+		throw std::runtime_error("BAR0 of " + bdf + " cannot be mapped");
+	}
+
+	void *bar = mmap(nullptr, region.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		device_, region.offset);
+	if(bar == MAP_FAILED) {
+		fail("Failed to map BAR0 of " + bdf);
+	}
+	bar_ = static_cast<volatile std::uint32_t*>(bar);
+	bar_size_ = region.size;
+}
+
+void endpoint::enable_bus_master() {
+	std::uint16_t cmd;
+	if(pread(device_, &cmd, sizeof(cmd), config_offset_ + PCI_COMMAND) != sizeof(cmd)) {
+		fail("Failed to read the command register");
+	}
+	cmd |= PCI_COMMAND_MASTER;
+	if(pwrite(device_, &cmd, sizeof(cmd), config_offset_ + PCI_COMMAND) != sizeof(cmd)) {
+		fail("Failed to enable bus mastering");
+	}
+}
+
+void endpoint::read_packet_sizes() {
+	std::uint8_t pos = 0;
+	if(pread(device_, &pos, 1, config_offset_ + PCI_CAPABILITY_LIST) != 1) {
+		fail("Failed to read the capability list");
+	}
+
+	// The sizes the host negotiated are in the device control register of
+	// the PCIe capability, like pcie_get_mps and pcie_get_readrq read them.
+	while(pos) {
+		std::uint8_t cap[2];
+		if(pread(device_, cap, sizeof(cap), config_offset_ + pos) != sizeof(cap)) {
+			fail("Failed to read the capability list");
+		}
+		if(cap[0] == PCI_CAP_ID_EXP) {
+			std::uint16_t ctl;
+			if(pread(device_, &ctl, sizeof(ctl), config_offset_ + pos + PCI_EXP_DEVCTL) != sizeof(ctl)) {
+				fail("Failed to read the device control register");
+			}
+			max_payload_ = 128 << ((ctl & PCI_EXP_DEVCTL_PAYLOAD) >> 5);
+			max_read_request_ = 128 << ((ctl & PCI_EXP_DEVCTL_READRQ) >> 12);
+			return;
+		}
+		pos = cap[1];
+	}
+}
+
+// The MSI-X table is part of the endpoint and ignores the mask bits, so the
+// hardware raises its interrupts in any case. Giving VFIO an eventfd for
+// each vector makes it program valid messages into the table.
+void endpoint::enable_interrupts(unsigned int vectors) {
+	vfio_irq_info info;
+	std::memset(&info, 0, sizeof(info));
+	info.argsz = sizeof(info);
+	info.index = VFIO_PCI_MSIX_IRQ_INDEX;
+	if(ioctl(device_, VFIO_DEVICE_GET_IRQ_INFO, &info)) {
+		fail("Failed to get the MSI-X info");
+	}
+	if(info.count < vectors) {
+		vectors = info.count;
+	}
+	if(!vectors) {
+		return;
+	}
+
+	for(unsigned int idx = 0; idx < vectors; ++idx) {
+		int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(fd == -1) {
+			fail("Failed to create an eventfd");
+		}
+		irq_fds_.push_back(fd);
+	}
+
+	std::vector<char> buf(sizeof(vfio_irq_set) + vectors * sizeof(std::int32_t));
+	vfio_irq_set *irqs = reinterpret_cast<vfio_irq_set*>(buf.data());
+	irqs->argsz = buf.size();
+	irqs->flags = VFIO_IRQ_SET_DATA_EVENTFD | VFIO_IRQ_SET_ACTION_TRIGGER;
+	irqs->index = VFIO_PCI_MSIX_IRQ_INDEX;
+	irqs->start = 0;
+	irqs->count = vectors;
+	std::memcpy(irqs->data, irq_fds_.data(), vectors * sizeof(std::int32_t));
+	if(ioctl(device_, VFIO_DEVICE_SET_IRQS, irqs)) {
+		fail("Failed to enable MSI-X");
+	}
+}
+
+// Walks the channels like channels_init of the kernel driver does.
+void endpoint::find_channels() {
+	std::uint32_t info = bar_[CHANNEL_INFO_REG / 4];
+	unsigned int cnt = chn_cnt(info);
+
+	for(unsigned int id = 1; id <= cnt; ++id) {
+		std::uint32_t chn_info = read_reg(id, CHN_INFO_REG);
+		if(chn_info == 0xFFFFFFFF) {
+			throw std::runtime_error("Failed to read channel info for id " + std::to_string(id));
+		}
+		if(chn_info_kind(chn_info) != CHN_KIND_HOST) {
+			continue;
+		}
+
+		unsigned int dir = chn_info_dir(chn_info);
+		if(dir != CHN_DIR_RX && dir != CHN_DIR_TX) {
+			throw std::runtime_error("Channel " + std::to_string(id) + " is not unidirectional");
+		}
+		if(!chn_info_queue_depth(chn_info)) {
+			throw std::runtime_error("Channel " + std::to_string(id) +
+				" has no result queue to poll, the hardware is too old");
+		}
+
+		channels_.emplace_back(new channel(*this, id, chn_info));
+	}
+}
+
+}
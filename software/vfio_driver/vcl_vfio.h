@@ -0,0 +1,127 @@
+// Userspace driver for VerCoLib-PCIe endpoints bound to vfio-pci
+//
+// The endpoint's BAR0 is mapped into the process and the host channels are
+// programmed with the same registers the kernel driver uses. DMA buffers
+// are hugepages mapped through the IOMMU, completions are found by polling
+// the channel registers instead of waiting for interrupts.
+
+#ifndef VCL_VFIO_H
+#define VCL_VFIO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vcl {
+
+// Memory the endpoint can access, at address `iova` from its point of view.
+struct dma_buffer {
+	void *ptr;
+	std::uint64_t iova;
+	std::size_t size;
+};
+
+class endpoint;
+
+// A host channel. rx channels transfer from the host to the FPGA, tx
+// channels from the FPGA to the host.
+class channel {
+public:
+	// `info` is the channel's CHN_INFO_REG
+	channel(endpoint &ep, unsigned int id, std::uint32_t info);
+
+	unsigned int id() const { return id_; }
+	bool is_rx() const { return rx_; }
+	// transfers the hardware accepts in advance
+	unsigned int queue_depth() const { return queue_depth_; }
+	bool can_abort() const { return can_abort_; }
+	std::size_t in_flight() const { return in_flight_.size(); }
+
+	// Writes the packet settings, like opening the channel device does.
+	void configure(std::uint32_t max_tlp_bytes, std::uint32_t tlp_attr = 0, bool crc = false);
+
+	// Hands `bytes` of `buf` starting at `offset` to the hardware. At most
+	// queue_depth() transfers may be in flight. A tx transfer ends early
+	// when the FPGA ends its stream.
+	void submit(const dma_buffer &buf, std::size_t offset, std::size_t bytes);
+
+	// Checks for the oldest transfer in flight to be complete and returns
+	// its transferred bytes in `bytes`. Costs one register read per call.
+	bool poll(std::size_t &bytes);
+
+	// Busy-polls until the oldest transfer is complete.
+	std::size_t wait();
+
+	// Aborts the current transfer and drops the queued ones, returns the
+	// bytes transferred of those in flight. Needs can_abort().
+	std::size_t abort();
+
+private:
+	endpoint &ep_;
+	unsigned int id_;
+	bool rx_;
+	unsigned int queue_depth_;
+	bool can_abort_;
+	// transfers the hardware has completed but poll() not returned yet
+	std::uint32_t completed_;
+	std::deque<std::size_t> in_flight_;
+};
+
+class endpoint {
+public:
+	// `bdf` is the PCI address of the endpoint, e.g. "0000:04:00.0".
+	// The device has to be bound to vfio-pci and its IOMMU group must not
+	// contain other devices in use.
+	explicit endpoint(const std::string &bdf);
+	~endpoint();
+
+	endpoint(const endpoint &) = delete;
+	endpoint &operator=(const endpoint &) = delete;
+
+	std::uint32_t read_reg(unsigned int chn_id, unsigned int reg);
+	void write_reg(unsigned int chn_id, unsigned int reg, std::uint32_t value);
+
+	// host channels found on the endpoint, in the order of their ids
+	std::vector<std::unique_ptr<channel>> &channels() { return channels_; }
+	channel &get_channel(unsigned int id);
+
+	// negotiated by the host, in bytes
+	std::uint32_t max_payload() const { return max_payload_; }
+	std::uint32_t max_read_request() const { return max_read_request_; }
+
+	// Allocates DMA memory from hugepages, or normal pages if there are none
+	// reserved. Freed with the endpoint.
+	dma_buffer alloc(std::size_t bytes);
+
+private:
+	void open_device(const std::string &bdf);
+	void enable_bus_master();
+	void read_packet_sizes();
+	void enable_interrupts(unsigned int vectors);
+	void find_channels();
+	void release();
+
+	int container_ = -1;
+	int group_ = -1;
+	int device_ = -1;
+
+	volatile std::uint32_t *bar_ = nullptr;
+	std::size_t bar_size_ = 0;
+	std::uint64_t config_offset_ = 0;
+
+	std::uint32_t max_payload_ = 128;
+	std::uint32_t max_read_request_ = 128;
+
+	std::vector<int> irq_fds_;
+	std::vector<dma_buffer> buffers_;
+	std::uint64_t next_iova_;
+
+	std::vector<std::unique_ptr<channel>> channels_;
+};
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+// C interface of the VFIO userspace driver, exceptions become error codes
+
+#include "vcl_vfio_c.h"
+#include "vcl_vfio.h"
+
+#include <exception>
+#include <string>
+
+struct vcl_vfio_endpoint {
+	explicit vcl_vfio_endpoint(const char *bdf): ep(bdf) {}
+	vcl::endpoint ep;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+template<typename F>
+int guarded(F f) {
+	try {
+		f();
+		return 0;
+	} catch(std::exception &e) {
+		last_error = e.what();
+		return -1;
+	}
+}
+
+}
+
+const char *vcl_vfio_error(void) {
+	return last_error.c_str();
+}
+
+vcl_vfio_endpoint *vcl_vfio_open(const char *bdf) {
+	vcl_vfio_endpoint *ep = nullptr;
+	guarded([&] { ep = new vcl_vfio_endpoint(bdf); });
+	return ep;
+}
+
+void vcl_vfio_close(vcl_vfio_endpoint *ep) {
+	delete ep;
+}
+
+unsigned int vcl_vfio_channel_count(vcl_vfio_endpoint *ep) {
+	return ep->ep.channels().size();
+}
+
+int vcl_vfio_channel_info(vcl_vfio_endpoint *ep, unsigned int idx,
+	unsigned int *id, int *is_rx, unsigned int *queue_depth) {
+	return guarded([&] {
+		vcl::channel &chn = *ep->ep.channels().at(idx);
+		*id = chn.id();
+		*is_rx = chn.is_rx();
+		*queue_depth = chn.queue_depth();
+	});
+}
+
+uint32_t vcl_vfio_read_reg(vcl_vfio_endpoint *ep, unsigned int chn_id, unsigned int reg) {
+	return ep->ep.read_reg(chn_id, reg);
+}
+
+void vcl_vfio_write_reg(vcl_vfio_endpoint *ep, unsigned int chn_id, unsigned int reg, uint32_t value) {
+	ep->ep.write_reg(chn_id, reg, value);
+}
+
+uint32_t vcl_vfio_max_payload(vcl_vfio_endpoint *ep) {
+	return ep->ep.max_payload();
+}
+
+uint32_t vcl_vfio_max_read_request(vcl_vfio_endpoint *ep) {
+	return ep->ep.max_read_request();
+}
+
+int vcl_vfio_alloc(vcl_vfio_endpoint *ep, size_t bytes, void **ptr, uint64_t *iova) {
+	return guarded([&] {
+		vcl::dma_buffer buf = ep->ep.alloc(bytes);
+		*ptr = buf.ptr;
+		*iova = buf.iova;
+	});
+}
+
+int vcl_vfio_configure(vcl_vfio_endpoint *ep, unsigned int chn_id,
+	uint32_t max_tlp_bytes, uint32_t tlp_attr, int crc) {
+	return guarded([&] {
+		ep->ep.get_channel(chn_id).configure(max_tlp_bytes, tlp_attr, crc);
+	});
+}
+
+int vcl_vfio_submit(vcl_vfio_endpoint *ep, unsigned int chn_id, uint64_t iova, size_t bytes) {
+	return guarded([&] {
+		// the channel only needs the device address
+		vcl::dma_buffer buf = {nullptr, iova, bytes};
+		ep->ep.get_channel(chn_id).submit(buf, 0, bytes);
+	});
+}
+
+int vcl_vfio_poll(vcl_vfio_endpoint *ep, unsigned int chn_id, size_t *bytes) {
+	bool done = false;
+	int ret = guarded([&] { done = ep->ep.get_channel(chn_id).poll(*bytes); });
+	return ret ? ret : done;
+}
+
+int vcl_vfio_wait(vcl_vfio_endpoint *ep, unsigned int chn_id, size_t *bytes) {
+	return guarded([&] { *bytes = ep->ep.get_channel(chn_id).wait(); });
+}
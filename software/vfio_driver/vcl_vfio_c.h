@@ -0,0 +1,54 @@
+// C interface of the VFIO userspace driver, for bindings from other
+// languages such as the Python package in software/python.
+//
+// Functions returning int return 0 on success and -1 on failure, the
+// reason is returned by vcl_vfio_error() of the same thread.
+
+#ifndef VCL_VFIO_C_H
+#define VCL_VFIO_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct vcl_vfio_endpoint vcl_vfio_endpoint;
+
+const char *vcl_vfio_error(void);
+
+// NULL on failure
+vcl_vfio_endpoint *vcl_vfio_open(const char *bdf);
+void vcl_vfio_close(vcl_vfio_endpoint *ep);
+
+// Host channels in the order of their ids, `idx` counts from 0.
+unsigned int vcl_vfio_channel_count(vcl_vfio_endpoint *ep);
+int vcl_vfio_channel_info(vcl_vfio_endpoint *ep, unsigned int idx,
+	unsigned int *id, int *is_rx, unsigned int *queue_depth);
+
+uint32_t vcl_vfio_read_reg(vcl_vfio_endpoint *ep, unsigned int chn_id, unsigned int reg);
+void vcl_vfio_write_reg(vcl_vfio_endpoint *ep, unsigned int chn_id, unsigned int reg, uint32_t value);
+uint32_t vcl_vfio_max_payload(vcl_vfio_endpoint *ep);
+uint32_t vcl_vfio_max_read_request(vcl_vfio_endpoint *ep);
+
+// DMA memory, freed with the endpoint
+int vcl_vfio_alloc(vcl_vfio_endpoint *ep, size_t bytes, void **ptr, uint64_t *iova);
+
+int vcl_vfio_configure(vcl_vfio_endpoint *ep, unsigned int chn_id,
+	uint32_t max_tlp_bytes, uint32_t tlp_attr, int crc);
+
+// Transfers `bytes` at `iova`, which has to lie in memory of vcl_vfio_alloc.
+int vcl_vfio_submit(vcl_vfio_endpoint *ep, unsigned int chn_id, uint64_t iova, size_t bytes);
+
+// 1 and the transferred bytes if the oldest transfer in flight is
+// complete, 0 if it isn't, -1 on failure.
+int vcl_vfio_poll(vcl_vfio_endpoint *ep, unsigned int chn_id, size_t *bytes);
+
+int vcl_vfio_wait(vcl_vfio_endpoint *ep, unsigned int chn_id, size_t *bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+// Measures the round-trip latency of the loopback design through VFIO.
+//
+// Like `linktest ping`, but the channels are driven by the userspace driver
+// and completions are polled, so no system call is on the path.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+#include "vcl_vfio.h"
+
+using std::uint32_t;
+using std::vector;
+using clk = std::chrono::steady_clock;
+
+// config channel registers, see cfg_channel_types.vhd
+enum { TRAFFIC_CTRL = 3 };
+enum { TRAFFIC_OFF = 0, TRAFFIC_PING = 2 };
+
+static int ping(vcl::endpoint &ep, size_t bytes, size_t count) {
+	vcl::channel &rx = ep.get_channel(1);
+	vcl::channel &tx = ep.get_channel(2);
+	vcl::dma_buffer buf = ep.alloc(2 * bytes);
+	uint32_t *msg = static_cast<uint32_t*>(buf.ptr);
+	uint32_t *echo = msg + bytes / 4;
+	vector<double> rtt;
+
+	ep.write_reg(0, TRAFFIC_CTRL, TRAFFIC_PING);
+
+	for(size_t n = 0; n < count; ++n) {
+		std::fill(msg, msg + bytes / 4, n);
+
+		auto start = clk::now();
+		tx.submit(buf, bytes, bytes);
+		rx.submit(buf, 0, bytes);
+		rx.wait();
+		size_t received = tx.wait();
+		rtt.push_back(std::chrono::duration<double>(clk::now() - start).count() * 1e6);
+
+		if(received != bytes || memcmp(msg, echo, bytes)) {
+			fprintf(stderr, "Echo %zu differs from the message\n", n);
+		}
+	}
+
+	ep.write_reg(0, TRAFFIC_CTRL, TRAFFIC_OFF);
+
+	std::sort(rtt.begin(), rtt.end());
+	double sum = 0;
+	for(double t: rtt) {
+		sum += t;
+	}
+	printf("%zu messages of %zu bytes, round trip min %.2f us, median %.2f us, "
+	       "mean %.2f us, max %.2f us\n",
+		count, bytes, rtt.front(), rtt[rtt.size() / 2], sum / count, rtt.back());
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		fprintf(stderr, "Usage: %s <domain:bus:device.function> [bytes] [count]\n", argv[0]);
+		return 1;
+	}
+
+	size_t bytes = argc > 2 ? strtoul(argv[2], nullptr, 0) : 64;
+	size_t count = argc > 3 ? strtoul(argv[3], nullptr, 0) : 1000;
+
+	try {
+		vcl::endpoint ep(argv[1]);
+		return ping(ep, std::max<size_t>(bytes & ~size_t(3), 4), std::max<size_t>(count, 1));
+	} catch(std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}